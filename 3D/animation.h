@@ -0,0 +1,324 @@
+//
+//  animation.h
+//  3D Object Drawing
+//
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "soft_simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// the local axis of a binding's pivot frame that a node turns about
+enum Anim_Axis {
+    ANIM_AXIS_X,
+    ANIM_AXIS_Y,
+    ANIM_AXIS_Z
+};
+
+// one key of a keyframe channel: the angle at a time into the loop
+struct AnimKey
+{
+    float time;         // seconds
+    float degrees;
+};
+
+// Default animation values
+const unsigned int ANIM_PARALLEL_CHANNELS = 4096;   // below this many channels (or bindings) handing out work costs more than it saves
+const unsigned int ANIM_PARALLEL_BINDINGS = 4096;
+
+
+// Angles that change over time, and the scene nodes they turn. Every channel advances a phase by rate * dt and
+// wraps it to [0, period) on every update, so nothing grows without bound however long the program runs.
+// The angle is offset + phase * phaseScale + amplitude * sin(2 pi phase / period), which covers
+//  - spins: period 360, the phase is the angle and the rate is in degrees per second;
+//  - oscillations: period 1, the rate is in Hz and the angle swings amplitude degrees around a center;
+//  - keyframes: the phase is the time into a looping clip, and a scalar pass after the batch looks the angle up.
+// Channels are kept as structure-of-arrays and evaluated four at a time with SoftFloat4; bindings then rotate
+// their node by the channel's angle about an axis of a pivot frame. With a ThreadPool both stages are split
+// across the workers once there are enough of them. Call update from one thread only.
+class AnimationSystem
+{
+public:
+    AnimationSystem(Scene& scene, ThreadPool* pool = NULL) : scene(scene), pool(pool), count(0)
+    {
+    }
+
+    int addSpin(float degreesPerSecond, float startDegrees = 0.0f)
+    {
+        return addChannel(360.0f, 1.0f, 0.0f, 0.0f, degreesPerSecond, startDegrees);
+    }
+
+    // startPhase in cycles, 0.25 starts at the top of the swing
+    int addOscillation(float centerDegrees, float amplitudeDegrees, float frequencyHz, float startPhase = 0.0f)
+    {
+        return addChannel(1.0f, 0.0f, centerDegrees, amplitudeDegrees, frequencyHz, startPhase);
+    }
+
+    // keys sorted by time; the last key's time is the loop length, and its angle should match the first key's
+    // for a seamless loop. speed scales playback (negative plays backwards). Returns -1 for an empty clip.
+    int addKeyframes(const AnimKey* keyList, int keyCount, float speed = 1.0f)
+    {
+        if (keyCount < 1 || keyList[keyCount - 1].time <= 0.0f)
+        {
+            std::cout << "ERROR::ANIMATION:: a keyframe clip needs keys and a length above zero" << std::endl;
+            return -1;
+        }
+        Clip clip;
+        clip.channel = addChannel(keyList[keyCount - 1].time, 0.0f, 0.0f, 0.0f, speed, 0.0f);
+        clip.first = (int)keys.size();
+        clip.count = keyCount;
+        keys.insert(keys.end(), keyList, keyList + keyCount);
+        clips.push_back(clip);
+        evaluateClip(clip);
+        return clip.channel;
+    }
+
+    // degrees per second for spins, Hz for oscillations, playback speed for keyframes
+    void setRate(int channel, float value)
+    {
+        rate[channel] = value;
+    }
+
+    // the channel's angle as of the last update, in degrees; spins stay in [0, 360)
+    float angle(int channel) const
+    {
+        return angles[channel];
+    }
+
+    int channelCount() const
+    {
+        return count;
+    }
+
+    // Turns scene node about axis of the pivot frame (a world transform, e.g. a fan's hub) by the channel's angle.
+    // The node keeps where it is relative to the pivot as of now, so bind it in its rest pose. Its culling box
+    // becomes the volume it sweeps, so culling never needs the animated matrix. A node takes one binding.
+    bool bind(int channel, int node, const glm::mat4& pivot, Anim_Axis axis)
+    {
+        if (channel < 0 || channel >= count || node < 0 || node >= (int)scene.nodes.size())
+        {
+            std::cout << "ERROR::ANIMATION:: no channel " << channel << " or node " << node << " to bind" << std::endl;
+            return false;
+        }
+        if (nodeBound.size() < scene.nodes.size())
+            nodeBound.resize(scene.nodes.size(), 0);
+        if (nodeBound[node])
+        {
+            std::cout << "ERROR::ANIMATION:: node " << node << " is already bound" << std::endl;
+            return false;
+        }
+        nodeBound[node] = 1;
+
+        Binding binding;
+        binding.pivot = pivot;
+        binding.local = glm::inverse(pivot) * scene.nodes[node].model;
+        binding.channel = channel;
+        binding.node = node;
+        // the two pivot columns the rotation mixes: R's columns a and b are (c, s) and (-s, c) in that plane
+        binding.columnA = axis == ANIM_AXIS_X ? 1 : axis == ANIM_AXIS_Y ? 2 : 0;
+        binding.columnB = axis == ANIM_AXIS_X ? 2 : axis == ANIM_AXIS_Y ? 0 : 1;
+        bindings.push_back(binding);
+        sweptBounds(binding, scene.nodes[node]);
+        applyBinding(binding);
+        return true;
+    }
+
+    int bindingCount() const
+    {
+        return (int)bindings.size();
+    }
+
+    // advances every channel by dt seconds and writes the bound nodes' model matrices
+    void update(float dt)
+    {
+        unsigned int lanes = (unsigned int)phase.size();
+        split(lanes, ANIM_PARALLEL_CHANNELS, [this, dt](unsigned int begin, unsigned int end) { evaluateChannels(begin, end, dt); });
+        for (size_t i = 0; i < clips.size(); i++)
+            evaluateClip(clips[i]);
+        split((unsigned int)bindings.size(), ANIM_PARALLEL_BINDINGS, [this](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+                applyBinding(bindings[i]);
+        });
+    }
+
+private:
+    struct Clip
+    {
+        int channel;
+        int first, count;   // into keys
+    };
+
+    struct Binding
+    {
+        glm::mat4 pivot;
+        glm::mat4 local;    // the node relative to the pivot, at rest
+        int channel;
+        int node;
+        int columnA, columnB;
+    };
+
+    Scene& scene;
+    ThreadPool* pool;
+    int count;
+    // one lane per channel, padded to a multiple of four with lanes that stay at zero
+    std::vector<float> phase, rate, period, invPeriod, waveScale, offset, phaseScale, amplitude;
+    std::vector<float> angles, cosines, sines;
+    std::vector<AnimKey> keys;
+    std::vector<Clip> clips;
+    std::vector<Binding> bindings;
+    std::vector<char> nodeBound;
+
+    int addChannel(float length, float scale, float center, float swing, float speed, float start)
+    {
+        if (count == (int)phase.size())
+        {
+            // four padding lanes: a period of 1 keeps the wrap finite, a rate of 0 keeps them still
+            size_t lanes = phase.size() + 4;
+            phase.resize(lanes, 0.0f);
+            rate.resize(lanes, 0.0f);
+            period.resize(lanes, 1.0f);
+            invPeriod.resize(lanes, 1.0f);
+            waveScale.resize(lanes, 0.0f);
+            offset.resize(lanes, 0.0f);
+            phaseScale.resize(lanes, 0.0f);
+            amplitude.resize(lanes, 0.0f);
+            angles.resize(lanes, 0.0f);
+            cosines.resize(lanes, 1.0f);
+            sines.resize(lanes, 0.0f);
+        }
+        int channel = count++;
+        rate[channel] = speed;
+        period[channel] = length;
+        invPeriod[channel] = 1.0f / length;
+        waveScale[channel] = 6.2831853f / length;
+        offset[channel] = center;
+        phaseScale[channel] = scale;
+        amplitude[channel] = swing;
+        phase[channel] = start - length * std::floor(start / length);
+        angles[channel] = center + phase[channel] * scale + swing * std::sin(phase[channel] * waveScale[channel]);
+        cosines[channel] = std::cos(glm::radians(angles[channel]));
+        sines[channel] = std::sin(glm::radians(angles[channel]));
+        return channel;
+    }
+
+    // lanes [begin, end), both multiples of four
+    void evaluateChannels(unsigned int begin, unsigned int end, float dt)
+    {
+        const SoftFloat4 step = soft4(dt);
+        const SoftFloat4 toRadians = soft4(0.017453293f);
+        for (unsigned int i = begin; i < end; i += 4)
+        {
+            SoftFloat4 p = soft4Load(&phase[i]) + soft4Load(&rate[i]) * step;
+            SoftFloat4 length = soft4Load(&period[i]);
+            p = p - length * soft4Floor(p * soft4Load(&invPeriod[i]));
+            // rounding can land exactly on the period from just below zero
+            p = soft4Select(soft4Ge(p, length), p - length, p);
+            soft4Store(&phase[i], p);
+
+            SoftFloat4 wave, unused;
+            soft4SinCos(p * soft4Load(&waveScale[i]), wave, unused);
+            SoftFloat4 a = soft4Load(&offset[i]) + p * soft4Load(&phaseScale[i]) + soft4Load(&amplitude[i]) * wave;
+            soft4Store(&angles[i], a);
+
+            SoftFloat4 s, c;
+            soft4SinCos(a * toRadians, s, c);
+            soft4Store(&sines[i], s);
+            soft4Store(&cosines[i], c);
+        }
+    }
+
+    // linear between the keys around the clip time
+    void evaluateClip(const Clip& clip)
+    {
+        float t = phase[clip.channel];
+        const AnimKey* first = &keys[clip.first];
+        const AnimKey* last = first + clip.count;
+        const AnimKey* next = std::upper_bound(first, last, t, [](float time, const AnimKey& key) { return time < key.time; });
+        float degrees;
+        if (next == first)
+            degrees = first->degrees;
+        else if (next == last)
+            degrees = (last - 1)->degrees;
+        else
+        {
+            const AnimKey* previous = next - 1;
+            float span = next->time - previous->time;
+            degrees = previous->degrees + (next->degrees - previous->degrees) * (span > 0.0f ? (t - previous->time) / span : 0.0f);
+        }
+        angles[clip.channel] = degrees;
+        cosines[clip.channel] = std::cos(glm::radians(degrees));
+        sines[clip.channel] = std::sin(glm::radians(degrees));
+    }
+
+    // model = pivot * R * local, with pivot * R done as a mix of two columns
+    void applyBinding(const Binding& binding)
+    {
+        float c = cosines[binding.channel];
+        float s = sines[binding.channel];
+        glm::mat4 turned = binding.pivot;
+        turned[binding.columnA] = binding.pivot[binding.columnA] * c + binding.pivot[binding.columnB] * s;
+        turned[binding.columnB] = binding.pivot[binding.columnB] * c - binding.pivot[binding.columnA] * s;
+        scene.nodes[binding.node].model = turned * binding.local;
+    }
+
+    // the box around every pose: in the pivot frame the node's corners span a range along the axis and stay
+    // within their largest distance from it, a box that is then carried into the world
+    void sweptBounds(const Binding& binding, SceneNode& node) const
+    {
+        int axis = 3 - binding.columnA - binding.columnB;
+        float alongMin = 1e30f, alongMax = -1e30f, radius = 0.0f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner(i & 1 ? CUBE_MAX.x : CUBE_MIN.x, i & 2 ? CUBE_MAX.y : CUBE_MIN.y, i & 4 ? CUBE_MAX.z : CUBE_MIN.z);
+            glm::vec3 p = glm::vec3(binding.local * glm::vec4(corner, 1.0f));
+            alongMin = std::min(alongMin, p[axis]);
+            alongMax = std::max(alongMax, p[axis]);
+            radius = std::max(radius, std::sqrt(p[binding.columnA] * p[binding.columnA] + p[binding.columnB] * p[binding.columnB]));
+        }
+        glm::vec3 boxMin(-radius), boxMax(radius);
+        boxMin[axis] = alongMin;
+        boxMax[axis] = alongMax;
+        node.boundsMin = glm::vec3(1e30f);
+        node.boundsMax = glm::vec3(-1e30f);
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z);
+            glm::vec3 p = glm::vec3(binding.pivot * glm::vec4(corner, 1.0f));
+            node.boundsMin = glm::min(node.boundsMin, p);
+            node.boundsMax = glm::max(node.boundsMax, p);
+        }
+    }
+
+    // work(begin, end) over [0, total), in chunks of a multiple of four per worker when there is enough of it
+    void split(unsigned int total, unsigned int threshold, const std::function<void(unsigned int, unsigned int)>& work)
+    {
+        if (total == 0)
+            return;
+        if (!pool || pool->size() < 2 || total < threshold)
+        {
+            work(0, total);
+            return;
+        }
+        unsigned int workers = pool->size();
+        unsigned int chunk = ((total + workers - 1) / workers + 3) & ~3u;
+        pool->runOnAll([&](unsigned int worker)
+        {
+            unsigned int begin = std::min(total, worker * chunk);
+            unsigned int end = std::min(total, begin + chunk);
+            if (begin < end)
+                work(begin, end);
+        });
+    }
+};
+#endif
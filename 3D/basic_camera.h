@@ -12,6 +12,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "camera_component.h"
+
 class BasicCamera {
 public:
 
@@ -48,6 +50,12 @@ public:
         return viewMatrix;
     }
 
+    // adapter: drives the shared camera component with this eye/look-at/view-up setup
+    void ApplyTo(CameraComponent& component) const
+    {
+        component.SetLookAt(eye, lookAt, V);
+    }
+
     void changeEye(float eyeX, float eyeY, float eyeZ)
     {
         eye = glm::vec3(eyeX, eyeY, eyeZ);
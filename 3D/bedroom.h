@@ -0,0 +1,87 @@
+//
+//  bedroom.h
+//  3D Object Drawing
+//
+
+#ifndef BEDROOM_H
+#define BEDROOM_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+#include <cstddef>
+#include <functional>
+
+// One piece of furniture: a box from the cube, optionally replaced by a model authored in the cube's local space
+// and optionally textured; the color tints the texture
+struct BedroomPart
+{
+    const char* name;
+    glm::vec3 translate;
+    glm::vec3 scale;
+    glm::vec3 color;
+    const char* model;
+    const char* texture;
+};
+
+// every part lies on its side: rotateX 90 degrees, then scale
+const glm::vec3 BEDROOM_ROTATION = glm::vec3(90.0f, 0.0f, 0.0f);
+
+const BedroomPart BEDROOM_PARTS[] = {
+    { "bed", glm::vec3(0.5f, -0.85f, -1.0f), glm::vec3(2.0f, 3.0f, 0.5f), glm::vec3(0.6f, 0.2f, 0.4f), "models/bed.obj", "textures/bedsheet.dds" },
+    { "pillow", glm::vec3(1.05f, -0.7f, -1.0f), glm::vec3(0.8f, 0.5f, 0.5f), glm::vec3(1.0f, 0.6f, 0.8f), NULL, NULL },
+    { "pillow", glm::vec3(0.58f, -0.7f, -1.0f), glm::vec3(0.8f, 0.5f, 0.5f), glm::vec3(1.0f, 0.6f, 0.8f), NULL, NULL },
+    { "almirah body", glm::vec3(-1.9f, 0.9f, -1.0f), glm::vec3(0.2f, 2.0f, 4.0f), glm::vec3(1.0f, 0.6f, 0.8f), "models/almirah.obj", NULL },
+    { "almirah panel", glm::vec3(-1.9f, 0.9f, -1.0f), glm::vec3(1.0f, 2.0f, 0.2f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah shelf", glm::vec3(-1.9f, 0.5f, -1.0f), glm::vec3(1.0f, 2.0f, 0.2f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah shelf", glm::vec3(-1.9f, 0.05f, -1.0f), glm::vec3(1.0f, 2.0f, 0.2f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah shelf", glm::vec3(-1.9f, -0.45f, -1.0f), glm::vec3(1.0f, 2.0f, 0.2f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah shelf", glm::vec3(-1.9f, -0.9f, -1.0f), glm::vec3(1.0f, 2.0f, 0.2f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah side", glm::vec3(-1.9f, 0.9f, -1.0f), glm::vec3(1.0f, 0.2f, 4.0f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "almirah side", glm::vec3(-1.9f, 0.9f, 0.0f), glm::vec3(1.0f, 0.2f, 4.0f), glm::vec3(0.6f, 0.2f, 0.4f), NULL, NULL },
+    { "table top", glm::vec3(-1.9f, -0.1f, 1.0f), glm::vec3(1.2f, 2.0f, 0.2f), glm::vec3(0.6f, 0.35f, 0.2f), "models/table.obj", "textures/wood.ktx2" },
+    { "table leg", glm::vec3(-1.8f, -0.1f, 1.0f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.6f, 0.35f, 0.2f), NULL, NULL },
+    { "table leg", glm::vec3(-1.4f, -0.1f, 1.0f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.6f, 0.35f, 0.2f), NULL, NULL },
+    { "table leg", glm::vec3(-1.8f, -0.1f, 1.9f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.6f, 0.35f, 0.2f), NULL, NULL },
+    { "table leg", glm::vec3(-1.4f, -0.1f, 1.9f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.6f, 0.35f, 0.2f), NULL, NULL },
+    { "chair seat", glm::vec3(-0.9f, -0.6f, 1.0f), glm::vec3(0.9f, 0.9f, 0.1f), glm::vec3(0.8f, 0.5f, 0.2f), "models/chair.obj", "textures/wood.ktx2" },
+    { "chair leg", glm::vec3(-0.8f, -0.6f, 1.0f), glm::vec3(0.1f, 0.1f, 1.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair leg", glm::vec3(-0.55f, -0.6f, 1.0f), glm::vec3(0.1f, 0.1f, 1.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair leg", glm::vec3(-0.55f, -0.6f, 1.4f), glm::vec3(0.1f, 0.1f, 1.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair leg", glm::vec3(-0.8f, -0.6f, 1.4f), glm::vec3(0.1f, 0.1f, 1.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair back post", glm::vec3(-0.55f, 0.0f, 1.4f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair back post", glm::vec3(-0.55f, 0.0f, 1.0f), glm::vec3(0.1f, 0.1f, 2.0f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair back rail", glm::vec3(-0.55f, -0.0f, 1.0f), glm::vec3(0.1f, 0.9f, 0.06f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "chair back rail", glm::vec3(-0.55f, -0.1f, 1.0f), glm::vec3(0.1f, 0.9f, 0.06f), glm::vec3(0.8f, 0.5f, 0.2f), NULL, NULL },
+    { "floor", glm::vec3(-2.4f, -1.1f, -2.0f), glm::vec3(9.0f, 8.0f, 0.2f), glm::vec3(0.9f, 0.9f, 0.9f), NULL, "textures/floor.ktx2" },
+    { "side wall", glm::vec3(-2.4f, 0.9f, -2.0f), glm::vec3(0.3f, 8.0f, 4.0f), glm::vec3(1.0f, 0.9f, 0.9f), NULL, NULL },
+    { "side wall", glm::vec3(1.95f, 0.9f, -2.0f), glm::vec3(0.3f, 8.0f, 4.0f), glm::vec3(1.0f, 0.9f, 0.9f), NULL, NULL },
+    { "back wall", glm::vec3(-2.3f, -0.6f, -2.0f), glm::vec3(8.8f, 0.3f, 1.0f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "back wall", glm::vec3(-2.3f, 0.91f, -2.0f), glm::vec3(8.8f, 0.3f, 1.0f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "back wall", glm::vec3(-2.3f, 0.8f, -2.0f), glm::vec3(3.0f, 0.3f, 3.0f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "back wall", glm::vec3(0.8f, 0.6f, -2.0f), glm::vec3(2.5f, 0.3f, 3.0f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "window bar", glm::vec3(0.0f, 0.6f, -2.0f), glm::vec3(0.1f, 0.3f, 3.0f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "window sill", glm::vec3(-2.3f, -0.1f, -2.0f), glm::vec3(8.8f, 0.1f, 0.1f), glm::vec3(1.0f, 0.0f, 0.9f), NULL, NULL },
+    { "ceiling", glm::vec3(-2.4f, 1.0f, -2.0f), glm::vec3(9.0f, 8.0f, 0.2f), glm::vec3(0.9f, 0.9f, 0.9f), NULL, NULL },
+};
+const int BEDROOM_PART_COUNT = sizeof(BEDROOM_PARTS) / sizeof(BEDROOM_PARTS[0]);
+
+
+// adds the static bedroom to the scene; resolveMesh and resolveTexture turn file paths into handles (cube and flat color when empty)
+inline void buildBedroom(Scene& scene, std::function<int(const char*)> resolveMesh = std::function<int(const char*)>(),
+    std::function<int(const char*)> resolveTexture = std::function<int(const char*)>(), const glm::mat4& placement = glm::mat4(1.0f))
+{
+    for (int i = 0; i < BEDROOM_PART_COUNT; i++)
+    {
+        const BedroomPart& part = BEDROOM_PARTS[i];
+        int mesh = CUBE_MESH;
+        if (part.model && resolveMesh)
+            mesh = resolveMesh(part.model);
+        int texture = -1;
+        if (part.texture && resolveTexture)
+            texture = resolveTexture(part.texture);
+        scene.addNode(placement * composeTRS(part.translate, BEDROOM_ROTATION, part.scale), part.color, mesh, texture);
+    }
+}
+#endif
@@ -0,0 +1,652 @@
+//
+//  bench.cpp
+//  3D Object Drawing
+//
+//  CPU benchmarks that need no window or GL context.
+//  Exits with a non-zero code when a case misses its expected result, so it can gate a build.
+//
+
+#include "animation.h"
+#include "box_bake.h"
+#include "mesh_optimizer.h"
+#include "bedroom.h"
+#include "camera_component.h"
+#include "collision.h"
+#include "metrics.h"
+#include "ray_tracer.h"
+#include "soft_rasterizer.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// settings
+const unsigned int BENCH_SEED = 1234;
+const int GRID_SIZE = 256;  // quads per side of the generated mesh
+const int SOFT_WIDTH = 1280;        // software rasterizer target
+const int SOFT_HEIGHT = 720;
+const int SOFT_FRAMES = 30;         // frames per thread count
+const int SOFT_BEDROOM_GRID = 4;    // bedrooms per side of the furnished floor
+const int TRACE_WIDTH = 640;        // ray tracer target
+const int TRACE_HEIGHT = 360;
+const int TRACE_SAMPLES = 8;        // accumulated passes per thread count
+const int ANIM_ROOM_GRID = 100;     // rooms per side of the animation stress scene, one ceiling fan each
+const int ANIM_UPDATES = 600;       // updates per thread count, ten seconds at 60 Hz
+const double ANIM_BUDGET_MS = 1.0;  // what an update may cost the simulation tick
+const int ANIM_LONG_RUN_TICKS = 20000000;   // the wrap check: 92 hours of 60 Hz ticks
+const int COLLISION_BODIES = 100000;        // collision stress: random boxes in a 200 x 10 x 200 block
+const int COLLISION_QUERIES = 200000;       // timed sweeps and slides
+const int COLLISION_CHECKED = 200;          // sweeps also compared against every body
+const int COLLISION_MOVED = 10000;          // dynamic bodies moved per round
+const int COLLISION_ROUNDS = 10;
+const float CAMERA_SPHERE = 0.2f;
+const int METRICS_UPDATES = 10000000;   // recordings per thread
+const int OVERDRAW_VIEWS = 8;           // camera positions on an orbit, averaged
+const double OVERDRAW_BUDGET = 2.25;    // shaded fragments per covered pixel the bedroom may reach; it measures 2.01
+const double BAKE_MIN_TRIANGLE_CUT = 0.25;      // share of the box triangles the bake has to remove
+const double BAKE_MAX_CHANGED_PIXELS = 0.01;    // share of pixels that may differ: the unbaked floor z-fights where
+                                                // coplanar walls overlap, and the bake draws one of them
+const float BAKE_EYE_HEIGHT = 0.2f;             // orbit height: the bake assumes the camera is never inside a box
+
+// a flat GRID_SIZE x GRID_SIZE patch of quads, bent into a bowl so the overdraw sort has something to look at
+void buildGrid(MeshData& mesh, int size)
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    for (int y = 0; y <= size; y++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float u = (float)x / size - 0.5f;
+            float v = (float)y / size - 0.5f;
+            float vertex[MESH_VERTEX_FLOATS] = { u, u * u + v * v, v, 0.0f, 1.0f, 0.0f, u + 0.5f, v + 0.5f };
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + MESH_VERTEX_FLOATS);
+        }
+    }
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            unsigned int i0 = y * (size + 1) + x;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + size + 1;
+            unsigned int i3 = i2 + 1;
+            unsigned int quad[6] = { i0, i2, i1, i1, i2, i3 };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// exporters often emit triangles in no useful order; a seeded Fisher-Yates keeps the run reproducible
+void shuffleTriangles(MeshData& mesh, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    size_t triangleCount = mesh.indices.size() / 3;
+    for (size_t i = triangleCount - 1; i > 0; i--)
+    {
+        size_t j = rng() % (i + 1);
+        for (int k = 0; k < 3; k++)
+            std::swap(mesh.indices[i * 3 + k], mesh.indices[j * 3 + k]);
+    }
+}
+
+bool benchOptimize(const char* name, MeshData& mesh)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MeshOptimizeReport report = optimizeMesh(mesh);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << mesh.indices.size() / 3 << " triangles, " << ms << " ms" << std::endl;
+    std::cout << "    ACMR " << report.before.acmr << " -> " << report.after.acmr
+        << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+    std::cout << "    vertex shader runs " << report.before.transforms << " -> " << report.after.transforms
+        << " (" << 100.0 * (1.0 - (double)report.after.transforms / report.before.transforms) << "% fewer), "
+        << report.clusters << " overdraw clusters" << std::endl;
+    // the optimized order must never transform more vertices than the input order
+    return report.after.transforms <= report.before.transforms;
+}
+
+// Known answers for the FIFO model: a vertex stays cached through cacheSize - 1 later misses and is gone after
+// cacheSize of them, the same cache Tipsify orders for
+bool checkVertexCacheModel()
+{
+    std::vector<unsigned int> hit, miss;
+    const int fresh = VERTEX_CACHE_SIZE - 1;    // misses after vertex 0 before it comes back
+    for (int i = 0; i <= fresh; i++)
+        hit.push_back(i);
+    hit.push_back(0);
+    hit.push_back(fresh + 1);
+    for (int i = 0; i <= fresh + 1; i++)
+        miss.push_back(i);
+    miss.push_back(0);
+    unsigned int hitTransforms = analyzeVertexCache(hit, fresh + 2).transforms;
+    unsigned int missTransforms = analyzeVertexCache(miss, fresh + 2).transforms;
+    if (hitTransforms != (unsigned int)fresh + 2 || missTransforms != (unsigned int)fresh + 3)
+    {
+        std::cout << "ERROR::BENCH:: vertex cache model: " << hitTransforms << " and " << missTransforms << " transforms, expected "
+            << fresh + 2 << " and " << fresh + 3 << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Renders SOFT_FRAMES frames of an orbit around the scene with 1, 2, 4 ... threads up to the core count.
+// Every thread count has to produce the same final image; the single thread image is written to ppmPath.
+bool benchSoftRasterizer(const char* name, const Scene& scene, const MeshData* mesh, float orbitRadius, const char* ppmPath)
+{
+    std::cout << "software rasterizer, " << name << ": " << SOFT_WIDTH << "x" << SOFT_HEIGHT << ", " << scene.nodes.size() << " nodes" << std::endl;
+    CameraComponent camera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 45.0f, (float)SOFT_WIDTH / SOFT_HEIGHT, 0.1f, 100.0f);
+    std::vector<const SceneNode*> drawList;
+    unsigned int cores = std::thread::hardware_concurrency();
+    double singleMs = 0.0;
+    uint64_t expected = 0;
+    bool ok = true;
+    for (unsigned int threads = 1; threads <= (cores > 0 ? cores : 1); threads *= 2)
+    {
+        ThreadPool pool(threads);
+        SoftRasterizer rasterizer(pool);
+        if (mesh)
+            rasterizer.addMesh(*mesh);
+        SoftFramebuffer framebuffer;
+        framebuffer.resize(SOFT_WIDTH, SOFT_HEIGHT);
+        size_t triangles = 0;
+        double geometryMs = 0.0, rasterMs = 0.0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < SOFT_FRAMES; frame++)
+        {
+            float angle = frame * 0.05f;
+            camera.SetLookAt(glm::vec3(orbitRadius * std::sin(angle), 1.0f, orbitRadius * std::cos(angle)), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            drawList.clear();
+            for (size_t i = 0; i < scene.nodes.size(); i++)
+            {
+                if (camera.IsBoxVisible(scene.nodes[i].boundsMin, scene.nodes[i].boundsMax))
+                    drawList.push_back(&scene.nodes[i]);
+            }
+            rasterizer.draw(framebuffer, camera.GetViewMatrix(), camera.GetProjectionMatrix(), drawList.empty() ? NULL : &drawList[0], drawList.size());
+            triangles += rasterizer.Stats.submittedTriangles;
+            geometryMs += rasterizer.Stats.geometryMs;
+            rasterMs += rasterizer.Stats.rasterMs;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+        {
+            singleMs = ms;
+            expected = framebuffer.checksum();
+            if (ppmPath && !framebuffer.writePpm(ppmPath))
+                std::cout << "ERROR::BENCH:: could not write " << ppmPath << std::endl;
+        }
+        std::cout << "    " << threads << " threads: " << ms / SOFT_FRAMES << " ms/frame (geometry " << geometryMs / SOFT_FRAMES << ", raster "
+            << rasterMs / SOFT_FRAMES << "), " << SOFT_FRAMES * 1000.0 / ms << " frames/s, " << triangles / ms / 1000.0 << " Mtriangles/s, "
+            << singleMs / ms << "x" << std::endl;
+        // tiles own their pixels and bins keep draw order, so the thread count must not change a single pixel
+        if (framebuffer.checksum() != expected)
+        {
+            std::cout << "ERROR::BENCH:: " << threads << " threads produced a different image" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Counts fragments per pixel over OVERDRAW_VIEWS views of an orbit, once as shaded with early depth in draw order
+// and once as rasterized, and prints mean, max and histogram of both. Counts must not depend on the thread count,
+// and the shaded ratio has to stay within budget (0 for no budget) so an overlapping box added to the scene shows up.
+bool benchOverdraw(const char* name, const Scene& scene, float orbitRadius, double budget, const char* ppmPath)
+{
+    std::cout << "overdraw, " << name << ": " << SOFT_WIDTH << "x" << SOFT_HEIGHT << ", " << OVERDRAW_VIEWS << " views" << std::endl;
+    CameraComponent camera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 45.0f, (float)SOFT_WIDTH / SOFT_HEIGHT, 0.1f, 100.0f);
+    std::vector<const SceneNode*> drawList;
+    unsigned int cores = std::thread::hardware_concurrency();
+    const Overdraw_Mode modes[2] = { OVERDRAW_SHADED, OVERDRAW_RASTERIZED };
+    bool ok = true;
+    for (int m = 0; m < 2; m++)
+    {
+        OverdrawStats expected;
+        for (unsigned int threads = 1; threads <= (cores > 0 ? cores : 1); threads *= 2)
+        {
+            ThreadPool pool(threads);
+            SoftRasterizer rasterizer(pool);
+            rasterizer.Overdraw = modes[m];
+            SoftFramebuffer framebuffer;
+            framebuffer.resize(SOFT_WIDTH, SOFT_HEIGHT);
+            OverdrawStats total;
+            for (int view = 0; view < OVERDRAW_VIEWS; view++)
+            {
+                float angle = view * 6.2831853f / OVERDRAW_VIEWS;
+                camera.SetLookAt(glm::vec3(orbitRadius * std::sin(angle), 1.0f, orbitRadius * std::cos(angle)), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                drawList.clear();
+                for (size_t i = 0; i < scene.nodes.size(); i++)
+                {
+                    if (camera.IsBoxVisible(scene.nodes[i].boundsMin, scene.nodes[i].boundsMax))
+                        drawList.push_back(&scene.nodes[i]);
+                }
+                rasterizer.draw(framebuffer, camera.GetViewMatrix(), camera.GetProjectionMatrix(), drawList.empty() ? NULL : &drawList[0], drawList.size());
+                total.merge(framebuffer.overdrawStats());
+                if (view == 0 && threads == 1 && m == 0 && ppmPath && !framebuffer.writeOverdrawPpm(ppmPath))
+                    std::cout << "ERROR::BENCH:: could not write " << ppmPath << std::endl;
+            }
+            if (threads == 1)
+            {
+                expected = total;
+                std::cout << "    ";
+                total.print(std::cout, overdrawModeName(modes[m]));
+            }
+            // tiles count their own pixels in bin order, so the counts are exact whatever the thread count
+            else if (total.fragments != expected.fragments || total.maxCount != expected.maxCount || total.coveredPixels != expected.coveredPixels)
+            {
+                std::cout << "ERROR::BENCH:: " << threads << " threads counted different fragments" << std::endl;
+                ok = false;
+            }
+        }
+        if (modes[m] == OVERDRAW_SHADED && budget > 0.0 && expected.ratio() > budget)
+        {
+            std::cout << "ERROR::BENCH:: " << name << " overdraw " << expected.ratio() << " is over the budget of " << budget << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Bakes the scene's boxes and draws OVERDRAW_VIEWS views of an orbit before and after, counting triangles and
+// fragments both as shaded and as rasterized. The bake has to remove at least BAKE_MIN_TRIANGLE_CUT of the
+// triangles without adding fragments, shaded or rasterized, and may only move pixels along the edges it re-cut.
+// Shaded fragments depend on draw order, so they also check that the baked quads draw where their faces did.
+// The orbit stays at BAKE_EYE_HEIGHT, clear of the slabs: seen from inside a box the removed faces would show.
+bool benchBoxBake(const char* name, const Scene& scene, float orbitRadius)
+{
+    std::cout << "box bake, " << name << ": " << SOFT_WIDTH << "x" << SOFT_HEIGHT << ", " << OVERDRAW_VIEWS << " views" << std::endl;
+    CameraComponent camera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 45.0f, (float)SOFT_WIDTH / SOFT_HEIGHT, 0.1f, 100.0f);
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    SoftRasterizer original(pool), baked(pool);
+    SoftRasterizer* rasterizers[2] = { &original, &baked };
+    Scene scenes[2] = { scene, scene };
+    BoxBakeStats stats = bakeBoxes(scenes[1], [&baked](const MeshData& mesh) { return baked.addMesh(mesh); });
+    std::cout << "    ";
+    stats.print(std::cout);
+
+    const Overdraw_Mode modes[2] = { OVERDRAW_SHADED, OVERDRAW_RASTERIZED };
+    SoftFramebuffer framebuffers[2];
+    std::vector<const SceneNode*> drawList;
+    size_t triangles[2] = { 0, 0 }, changedPixels = 0;
+    OverdrawStats overdraw[2][2];
+    for (int m = 0; m < 2; m++)
+    {
+        for (int view = 0; view < OVERDRAW_VIEWS; view++)
+        {
+            float angle = view * 6.2831853f / OVERDRAW_VIEWS;
+            camera.SetLookAt(glm::vec3(orbitRadius * std::sin(angle), BAKE_EYE_HEIGHT, orbitRadius * std::cos(angle)), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            for (int s = 0; s < 2; s++)
+            {
+                drawList.clear();
+                for (size_t i = 0; i < scenes[s].nodes.size(); i++)
+                {
+                    if (camera.IsBoxVisible(scenes[s].nodes[i].boundsMin, scenes[s].nodes[i].boundsMax))
+                        drawList.push_back(&scenes[s].nodes[i]);
+                }
+                rasterizers[s]->Overdraw = modes[m];
+                framebuffers[s].resize(SOFT_WIDTH, SOFT_HEIGHT);
+                rasterizers[s]->draw(framebuffers[s], camera.GetViewMatrix(), camera.GetProjectionMatrix(), drawList.empty() ? NULL : &drawList[0], drawList.size());
+                overdraw[m][s].merge(framebuffers[s].overdrawStats());
+                if (m == 0)
+                    triangles[s] += rasterizers[s]->Stats.submittedTriangles;
+            }
+            for (int y = 0; y < SOFT_HEIGHT && m == 0; y++)
+            {
+                for (int x = 0; x < SOFT_WIDTH; x++)
+                    changedPixels += framebuffers[0].pixel(x, y) != framebuffers[1].pixel(x, y);
+            }
+        }
+    }
+    double changed = (double)changedPixels / ((double)SOFT_WIDTH * SOFT_HEIGHT * OVERDRAW_VIEWS);
+    std::cout << "    triangles drawn " << triangles[0] << " -> " << triangles[1] << ", fragments shaded " << overdraw[0][0].fragments << " -> "
+        << overdraw[0][1].fragments << ", rasterized " << overdraw[1][0].fragments << " -> " << overdraw[1][1].fragments << ", "
+        << changed * 100.0 << "% of pixels changed" << std::endl;
+
+    bool ok = true;
+    if (stats.trianglesAfter > stats.trianglesBefore * (1.0 - BAKE_MIN_TRIANGLE_CUT))
+    {
+        std::cout << "ERROR::BENCH:: " << name << " bake kept " << stats.trianglesAfter << " of " << stats.trianglesBefore << " triangles" << std::endl;
+        ok = false;
+    }
+    if (overdraw[0][1].fragments > overdraw[0][0].fragments || overdraw[1][1].fragments > overdraw[1][0].fragments)
+    {
+        std::cout << "ERROR::BENCH:: " << name << " bake added fragments" << std::endl;
+        ok = false;
+    }
+    if (changed > BAKE_MAX_CHANGED_PIXELS)
+    {
+        std::cout << "ERROR::BENCH:: " << name << " bake changed " << changed * 100.0 << "% of the pixels" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// Accumulates TRACE_SAMPLES passes of one view with 1, 2, 4 ... threads up to the core count and reports rays
+// per second. The samples depend only on the pixel, so every thread count has to produce the same image.
+bool benchRayTracer(const char* name, const Scene& scene, const glm::vec3& eye, const char* ppmPath)
+{
+    std::cout << "ray tracer, " << name << ": " << TRACE_WIDTH << "x" << TRACE_HEIGHT << ", " << TRACE_SAMPLES << " samples per pixel" << std::endl;
+    CameraComponent camera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 45.0f, (float)TRACE_WIDTH / TRACE_HEIGHT, 0.1f, 100.0f);
+    camera.SetLookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    unsigned int cores = std::thread::hardware_concurrency();
+    double singleMs = 0.0;
+    uint64_t expected = 0;
+    bool ok = true;
+    for (unsigned int threads = 1; threads <= (cores > 0 ? cores : 1); threads *= 2)
+    {
+        ThreadPool pool(threads);
+        RayTracer tracer(pool);
+        tracer.build(scene.nodes);
+        tracer.setView(TRACE_WIDTH, TRACE_HEIGHT, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+        if (threads == 1)
+            std::cout << "    " << tracer.Stats.boxCount << " boxes, " << tracer.Stats.bvhNodes << " BVH nodes built in " << tracer.Stats.buildMs << " ms" << std::endl;
+        size_t rays = 0, stolen = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int sample = 0; sample < TRACE_SAMPLES; sample++)
+        {
+            tracer.renderPass();
+            rays += tracer.raysPerPass();
+            stolen += tracer.Stats.stolenTiles;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        SoftFramebuffer framebuffer;
+        tracer.resolve(framebuffer);
+        if (threads == 1)
+        {
+            singleMs = ms;
+            expected = framebuffer.checksum();
+            if (ppmPath && !framebuffer.writePpm(ppmPath))
+                std::cout << "ERROR::BENCH:: could not write " << ppmPath << std::endl;
+        }
+        std::cout << "    " << threads << " threads: " << ms / TRACE_SAMPLES << " ms/pass, " << rays / ms / 1000.0 << " Mrays/s, "
+            << stolen / TRACE_SAMPLES << " tiles stolen per pass, " << singleMs / ms << "x" << std::endl;
+        if (framebuffer.checksum() != expected)
+        {
+            std::cout << "ERROR::BENCH:: " << threads << " threads produced a different image" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// A ceiling fan in each of ANIM_ROOM_GRID^2 rooms, three blade nodes on one channel: most spin, every fourth
+// swings back and forth, and every tenth room also has a door on a looping keyframe clip. Runs ANIM_UPDATES
+// updates with 1, 2, 4 ... threads up to the core count; bindings are independent, so every thread count
+// has to leave the same matrices behind.
+bool benchAnimation()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    double singleMs = 0.0;
+    uint64_t expected = 0;
+    bool ok = true;
+    for (unsigned int threads = 1; threads <= (cores > 0 ? cores : 1); threads *= 2)
+    {
+        ThreadPool pool(threads);
+        Scene scene;
+        AnimationSystem animation(scene, &pool);
+        const AnimKey doorKeys[] = { { 0.0f, 0.0f }, { 1.5f, 90.0f }, { 4.0f, 90.0f }, { 5.5f, 0.0f } };
+        for (int room = 0; room < ANIM_ROOM_GRID * ANIM_ROOM_GRID; room++)
+        {
+            glm::vec3 corner((room % ANIM_ROOM_GRID) * 5.0f, 0.0f, (room / ANIM_ROOM_GRID) * 5.0f);
+            glm::mat4 hub = glm::translate(glm::mat4(1.0f), corner + glm::vec3(2.5f, 2.2f, 2.5f));
+            int channel = room % 4 == 3 ? animation.addOscillation(0.0f, 45.0f, 0.25f, room * 0.01f) : animation.addSpin(60.0f * (1 + room % 3), (float)(room % 360));
+            for (int blade = 0; blade < 3; blade++)
+            {
+                glm::mat4 model = hub * glm::rotate(glm::mat4(1.0f), glm::radians(60.0f * blade), glm::vec3(0.0f, 1.0f, 0.0f))
+                    * glm::scale(glm::mat4(1.0f), glm::vec3(1.5f, 0.2f, 0.5f)) * glm::translate(glm::mat4(1.0f), glm::vec3(-0.25f, 0.0f, -0.25f));
+                ok = animation.bind(channel, scene.addNode(model, glm::vec3(0.0f, 0.0f, 1.0f)), hub, ANIM_AXIS_Y) && ok;
+            }
+            if (room % 10 == 0)
+            {
+                glm::mat4 hinge = glm::translate(glm::mat4(1.0f), corner + glm::vec3(1.0f, 0.0f, 0.0f));
+                int door = scene.addNode(hinge * glm::scale(glm::mat4(1.0f), glm::vec3(1.6f, 4.0f, 0.1f)), glm::vec3(0.5f, 0.3f, 0.1f));
+                ok = animation.bind(animation.addKeyframes(doorKeys, 4), door, hinge, ANIM_AXIS_Y) && ok;
+            }
+        }
+        if (threads == 1)
+            std::cout << "animation: " << animation.channelCount() << " channels, " << animation.bindingCount() << " bound nodes" << std::endl;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int update = 0; update < ANIM_UPDATES; update++)
+            animation.update(1.0f / 60.0f);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t hash = 1469598103934665603ull;
+        for (size_t i = 0; i < scene.nodes.size(); i++)
+        {
+            const unsigned char* bytes = (const unsigned char*)&scene.nodes[i].model[0][0];
+            for (size_t b = 0; b < sizeof(glm::mat4); b++)
+                hash = (hash ^ bytes[b]) * 1099511628211ull;
+        }
+        if (threads == 1)
+        {
+            singleMs = ms;
+            expected = hash;
+        }
+        std::cout << "    " << threads << " threads: " << ms * 1000.0 / ANIM_UPDATES << " us/update, " << animation.bindingCount() * (double)ANIM_UPDATES / ms / 1000.0
+            << " Mnodes/s, " << singleMs / ms << "x" << (ms / ANIM_UPDATES <= ANIM_BUDGET_MS ? "" : " (over the budget of 1 ms)") << std::endl;
+        if (hash != expected)
+        {
+            std::cout << "ERROR::BENCH:: " << threads << " threads left different matrices" << std::endl;
+            ok = false;
+        }
+    }
+
+    // a kiosk left on for days: the old accumulator loses precision, the channel keeps wrapping
+    Scene empty;
+    AnimationSystem animation(empty);
+    int fan = animation.addSpin(60.0f);
+    float accumulated = 0.0f;
+    for (int tick = 0; tick < ANIM_LONG_RUN_TICKS; tick++)
+    {
+        animation.update(1.0f / 60.0f);
+        accumulated += 1.0f;
+    }
+    double exact = std::fmod((double)ANIM_LONG_RUN_TICKS, 360.0);
+    std::cout << "    after " << ANIM_LONG_RUN_TICKS << " ticks: channel " << animation.angle(fan) << " degrees, unwrapped float " << std::fmod(accumulated, 360.0f)
+        << ", exact " << exact << std::endl;
+    if (!(animation.angle(fan) >= 0.0f && animation.angle(fan) < 360.0f))
+    {
+        std::cout << "ERROR::BENCH:: the spin left [0, 360)" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// COLLISION_BODIES randomly placed, rotated and scaled boxes; sweeps of a camera sized sphere through them.
+// Reports sweeps, slides and dynamic moves per second. A sample of sweeps is repeated against every body,
+// before and after the moves, and the grid has to find the same first contact.
+bool benchCollision()
+{
+    std::mt19937 random(BENCH_SEED);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    CollisionWorld world;
+    std::vector<glm::mat4> models;
+    for (int i = 0; i < COLLISION_BODIES; i++)
+    {
+        glm::vec3 position(unit(random) * 200.0f, unit(random) * 10.0f, unit(random) * 200.0f);
+        glm::vec3 rotation(unit(random) * 360.0f, unit(random) * 360.0f, unit(random) * 360.0f);
+        glm::vec3 scale(0.4f + unit(random) * 2.6f, 0.4f + unit(random) * 2.6f, 0.4f + unit(random) * 2.6f);
+        models.push_back(composeTRS(position, rotation, scale));
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < COLLISION_BODIES; i++)
+        world.addBox(models[i]);
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "collision: " << world.bodyCount() << " boxes filed in " << buildMs << " ms" << std::endl;
+
+    std::vector<glm::vec3> starts, motions;
+    for (int i = 0; i < COLLISION_QUERIES; i++)
+    {
+        starts.push_back(glm::vec3(unit(random) * 200.0f, unit(random) * 10.0f, unit(random) * 200.0f));
+        glm::vec3 direction(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+        motions.push_back(glm::normalize(direction) * 0.5f);
+    }
+
+    bool ok = true;
+    for (int round = 0; round <= COLLISION_ROUNDS; round++)
+    {
+        if (round > 0)
+        {
+            // bodies drift, most of them staying in their cells
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < COLLISION_MOVED; i++)
+            {
+                int id = (int)(unit(random) * (COLLISION_BODIES - 1));
+                models[id] = glm::translate(glm::mat4(1.0f), glm::vec3(unit(random) - 0.5f, 0.0f, unit(random) - 0.5f) * 0.2f) * models[id];
+                world.moveBox(id, models[id]);
+            }
+            double moveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (round < COLLISION_ROUNDS)
+                continue;
+            std::cout << "    " << COLLISION_MOVED << " moves: " << COLLISION_MOVED / moveMs / 1000.0 << " Mmoves/s" << std::endl;
+        }
+
+        unsigned int hits = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < COLLISION_QUERIES; i++)
+        {
+            CollisionHit hit;
+            if (world.sweep(starts[i], CAMERA_SPHERE, motions[i], hit))
+                hits++;
+        }
+        double sweepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        glm::vec3 checksum(0.0f);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < COLLISION_QUERIES; i++)
+            checksum += world.slide(starts[i], CAMERA_SPHERE, motions[i]);
+        double slideMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "    " << (round == 0 ? "static" : "after moving") << ": " << COLLISION_QUERIES / sweepMs << "k sweeps/s (" << hits * 100.0 / COLLISION_QUERIES
+            << "% hit), " << COLLISION_QUERIES / slideMs << "k slides/s" << std::endl;
+
+        for (int i = 0; i < COLLISION_CHECKED; i++)
+        {
+            CollisionHit hit, expected;
+            expected.time = 2.0f;
+            for (int id = 0; id < COLLISION_BODIES; id++)
+            {
+                CollisionHit bodyHit;
+                if (world.sweepBody(id, starts[i], CAMERA_SPHERE, motions[i], bodyHit) && bodyHit.time < expected.time)
+                    expected = bodyHit;
+            }
+            bool found = world.sweep(starts[i], CAMERA_SPHERE, motions[i], hit);
+            if (found != (expected.time <= 1.0f) || (found && hit.time != expected.time))
+            {
+                std::cout << "ERROR::BENCH:: sweep " << i << " missed the first contact the scan over every body found" << std::endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+// What recording a metric costs: a counter and a histogram on one thread, then every core hammering the same
+// counter, the worst case for its cache line. The histogram's quantiles have to be within its 1/16 resolution.
+bool benchMetrics()
+{
+    MetricsRegistry registry;
+    MetricCounter& counter = registry.counter("bench_total", "Counter updates");
+    MetricHistogram& histogram = registry.histogram("bench_seconds", "Histogram updates");
+    std::cout << "metrics: " << METRICS_UPDATES << " updates per thread" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < METRICS_UPDATES; i++)
+        counter.add();
+    double counterNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / METRICS_UPDATES;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < METRICS_UPDATES; i++)
+        histogram.record((uint64_t)i * 100);
+    double histogramNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / METRICS_UPDATES;
+
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < cores; t++)
+    {
+        threads.push_back(std::thread([&counter]()
+        {
+            for (int i = 0; i < METRICS_UPDATES; i++)
+                counter.add();
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    double contendedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / METRICS_UPDATES;
+    std::cout << "    counter " << counterNs << " ns, histogram " << histogramNs << " ns, counter on " << cores << " threads " << contendedNs
+        << " ns per update and thread" << std::endl;
+
+    bool ok = true;
+    if (counter.value.load() != (uint64_t)METRICS_UPDATES * (cores + 1))
+    {
+        std::cout << "ERROR::BENCH:: the counter lost updates" << std::endl;
+        ok = false;
+    }
+    // the values were spread evenly over 0..METRICS_UPDATES * 100 ns
+    const double quantiles[] = { 0.5, 0.9, 0.99 };
+    for (int i = 0; i < 3; i++)
+    {
+        double expected = quantiles[i] * METRICS_UPDATES * 100.0e-9;
+        double measured = MetricsRegistry::quantile(histogram, quantiles[i]);
+        if (std::fabs(measured - expected) > expected / 16.0)
+        {
+            std::cout << "ERROR::BENCH:: quantile " << quantiles[i] << " is " << measured << " s, expected " << expected << " s" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    MeshData mesh;
+
+    ok = checkVertexCacheModel() && ok;
+
+    buildGrid(mesh, GRID_SIZE);
+    ok = benchOptimize("grid, exporter order", mesh) && ok;
+
+    buildGrid(mesh, GRID_SIZE);
+    shuffleTriangles(mesh, BENCH_SEED);
+    unsigned int shuffled = analyzeVertexCache(mesh.indices, mesh.vertexCount()).transforms;
+    ok = benchOptimize("grid, shuffled", mesh) && ok;
+    // a shuffled large mesh must lose at least half its vertex shader work
+    if (analyzeVertexCache(mesh.indices, mesh.vertexCount()).transforms * 2 > shuffled)
+    {
+        std::cout << "ERROR::BENCH:: shuffled grid did not improve enough" << std::endl;
+        ok = false;
+    }
+
+    Scene bedrooms;
+    for (int x = 0; x < SOFT_BEDROOM_GRID; x++)
+    {
+        for (int z = 0; z < SOFT_BEDROOM_GRID; z++)
+        {
+            glm::vec3 offset((x - SOFT_BEDROOM_GRID / 2) * 5.0f, 0.0f, (z - SOFT_BEDROOM_GRID / 2) * 5.0f);
+            buildBedroom(bedrooms, std::function<int(const char*)>(), std::function<int(const char*)>(), glm::translate(glm::mat4(1.0f), offset));
+        }
+    }
+    ok = benchSoftRasterizer("furnished floor", bedrooms, NULL, 6.0f, "soft_bedrooms.ppm") && ok;
+    ok = benchRayTracer("furnished floor", bedrooms, glm::vec3(0.0f, 1.0f, 6.0f), "traced_bedrooms.ppm") && ok;
+    Scene bedroom;
+    buildBedroom(bedroom, std::function<int(const char*)>(), std::function<int(const char*)>(), glm::mat4(1.0f));
+    ok = benchOverdraw("bedroom", bedroom, 2.0f, OVERDRAW_BUDGET, "overdraw_bedroom.ppm") && ok;
+    ok = benchOverdraw("furnished floor", bedrooms, 6.0f, 0.0, NULL) && ok;
+    ok = benchBoxBake("bedroom", bedroom, 1.5f) && ok;
+    ok = benchBoxBake("furnished floor", bedrooms, 6.0f) && ok;
+
+    // one dense mesh: many small triangles, so setup and binning dominate instead of fill
+    buildGrid(mesh, GRID_SIZE);
+    optimizeMesh(mesh);
+    Scene dense;
+    dense.addNode(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(4.0f), glm::vec3(0.8f, 0.6f, 0.3f), 0);
+    ok = benchSoftRasterizer("dense mesh", dense, &mesh, 3.0f, NULL) && ok;
+
+    ok = benchAnimation() && ok;
+    ok = benchCollision() && ok;
+    ok = benchMetrics() && ok;
+
+    return ok ? 0 : 1;
+}
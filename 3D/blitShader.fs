@@ -0,0 +1,26 @@
+#version 330 core
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+uniform vec2 uvScale;
+uniform vec2 texelSize;
+uniform float sharpness;
+
+void main()
+{
+    // the scene only covers the lower-left uvScale part of the target; clamp so bilinear taps never read outside it
+    vec2 maxUV = uvScale - 0.5f * texelSize;
+    vec2 uv = min(texCoord * uvScale, maxUV);
+    vec3 center = texture(sceneColor, uv).rgb;
+    if (sharpness > 0.0f)
+    {
+        vec3 neighbours = texture(sceneColor, min(uv + vec2(texelSize.x, 0.0f), maxUV)).rgb
+                        + texture(sceneColor, max(uv - vec2(texelSize.x, 0.0f), vec2(0.0f))).rgb
+                        + texture(sceneColor, min(uv + vec2(0.0f, texelSize.y), maxUV)).rgb
+                        + texture(sceneColor, max(uv - vec2(0.0f, texelSize.y), vec2(0.0f))).rgb;
+        center = clamp(center * (1.0f + 4.0f * sharpness) - neighbours * sharpness, 0.0f, 1.0f);
+    }
+    FragColor = vec4(center, 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+out vec2 texCoord;
+
+void main()
+{
+    // fullscreen triangle generated from the vertex index, no vertex buffer needed
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord = pos;
+    gl_Position = vec4(pos * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,452 @@
+//
+//  box_bake.h
+//  3D Object Drawing
+//
+
+#ifndef BOX_BAKE_H
+#define BOX_BAKE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "mesh_data.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Default box bake values
+const float BOX_BAKE_EPSILON = 1.0e-4f;     // coordinates closer than this are the same plane or edge
+const float BOX_BAKE_CELL_SIZE = 4.0f;      // boxes are grouped by the cell of their center; about a room, so baked meshes still cull
+
+
+struct BoxBakeStats
+{
+    size_t boxes;               // nodes baked away
+    size_t hiddenFaces;         // of their 6 * boxes faces, the ones with nothing left to see
+    size_t quads;               // what the visible parts merged into
+    size_t meshes;              // one per cell and color
+    size_t trianglesBefore, trianglesAfter;
+    double ms;
+
+    BoxBakeStats() : boxes(0), hiddenFaces(0), quads(0), meshes(0), trianglesBefore(0), trianglesAfter(0), ms(0.0) {}
+
+    void print(std::ostream& out) const
+    {
+        out << "BAKE:: " << boxes << " boxes into " << meshes << " meshes, " << hiddenFaces << " of " << boxes * 6 << " faces hidden, "
+            << trianglesBefore << " -> " << trianglesAfter << " triangles ("
+            << (trianglesBefore ? 100.0 - 100.0 * trianglesAfter / trianglesBefore : 0.0) << "% fewer) in " << ms << " ms" << std::endl;
+    }
+};
+
+// Bakes the scene's static boxes: untextured cube nodes whose model keeps them axis aligned. Every face plane
+// is cut into a grid at the edges of all faces and boxes touching it; a grid cell is dropped where a box fills
+// the space in front of it (buried, or pressed against another box) and, where faces of several boxes coincide,
+// kept for the first in draw order as the depth test would. What is left is merged greedily into rectangles of
+// one color and written as one mesh per BOX_BAKE_CELL_SIZE cell and color, in the cube's local space like every
+// mesh, so culling and the node bounds keep working. Textured boxes hide faces but stay as they are; meshes and
+// rotated boxes are left alone. The merged rectangles meet in T-junctions, which the depth test hides well enough
+// for flat shaded slabs. Nodes are replaced in the scene; addMesh takes each baked mesh and returns its handle.
+// Collision and the ray tracer treat every node as its box, so they need the scene from before the bake.
+inline BoxBakeStats bakeBoxes(Scene& scene, const std::function<int(const MeshData&)>& addMesh)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BoxBakeStats stats;
+
+    struct Box
+    {
+        glm::vec3 min, max;
+        int color;          // index into colors, or -1 for an occluder that is not baked
+        int cell;
+        int order[3][2];    // draw order of its face along each world axis and side: node index and cube face
+    };
+    std::vector<Box> boxes;
+    std::vector<glm::vec3> colors;
+    std::map<int64_t, int> cellIndex;
+    std::map<std::pair<int, int>, int> meshIndex;  // by cell and color, numbered in draw order of their first box
+    std::vector<int> meshColors;
+    std::vector<std::pair<int, SceneNode> > kept;      // by draw order, as box face orders count it
+    // the axis and side of each face of the built-in cube, in the order CUBE_INDICES draws them
+    int cubeAxis[6], cubeSide[6];
+    for (int f = 0; f < 6; f++)
+    {
+        const float* corner = CUBE_VERTICES + (size_t)CUBE_INDICES[f * 6] * MESH_VERTEX_FLOATS;
+        for (int c = 0; c < 3; c++)
+        {
+            bool flat = true;
+            for (int k = 1; k < 6; k++)
+                flat = flat && CUBE_VERTICES[(size_t)CUBE_INDICES[f * 6 + k] * MESH_VERTEX_FLOATS + c] == corner[c];
+            if (flat)
+            {
+                cubeAxis[f] = c;
+                cubeSide[f] = corner[c] == CUBE_MAX[c];
+            }
+        }
+    }
+    for (size_t i = 0; i < scene.nodes.size(); i++)
+    {
+        const SceneNode& node = scene.nodes[i];
+        // axis aligned: every axis of the model maps onto one world axis
+        bool aligned = node.mesh == CUBE_MESH;
+        for (int c = 0; c < 3 && aligned; c++)
+        {
+            glm::vec3 axis = glm::abs(glm::vec3(node.model[c]));
+            float largest = std::max(axis.x, std::max(axis.y, axis.z));
+            aligned = largest > 0.0f && axis.x + axis.y + axis.z - largest <= largest * BOX_BAKE_EPSILON;
+        }
+        if (!aligned)
+        {
+            kept.push_back(std::make_pair((int)i * 6, node));
+            continue;
+        }
+        Box box;
+        box.min = node.boundsMin;
+        box.max = node.boundsMax;
+        box.color = -1;
+        box.cell = -1;
+        for (int f = 0; f < 6; f++)
+        {
+            glm::vec3 axis = glm::vec3(node.model[cubeAxis[f]]);
+            int world = 0;
+            for (int c = 1; c < 3; c++)
+                world = std::fabs(axis[c]) > std::fabs(axis[world]) ? c : world;
+            box.order[world][(axis[world] > 0.0f) == (cubeSide[f] == 1)] = (int)i * 6 + f;
+        }
+        if (node.texture < 0)
+        {
+            box.color = (int)(std::find(colors.begin(), colors.end(), node.color) - colors.begin());
+            if (box.color == (int)colors.size())
+                colors.push_back(node.color);
+            glm::vec3 cell = glm::floor(0.5f * (box.min + box.max) / BOX_BAKE_CELL_SIZE);
+            int64_t key = ((int64_t)cell.x & 0x1FFFFF) | (((int64_t)cell.y & 0x1FFFFF) << 21) | (((int64_t)cell.z & 0x1FFFFF) << 42);
+            std::map<int64_t, int>::iterator it = cellIndex.insert(std::make_pair(key, (int)cellIndex.size())).first;
+            box.cell = it->second;
+            std::map<std::pair<int, int>, int>::iterator mesh = meshIndex.insert(std::make_pair(std::make_pair(box.cell, box.color), (int)meshIndex.size())).first;
+            if (mesh->second == (int)meshColors.size())
+                meshColors.push_back(box.color);
+            stats.boxes++;
+        }
+        else
+            kept.push_back(std::make_pair((int)i * 6, node));
+        boxes.push_back(box);
+    }
+    stats.trianglesBefore = stats.boxes * CUBE_INDEX_COUNT / 3;
+
+    // every baked face, sorted so each plane of each cell is one run, its faces in draw order
+    struct Face
+    {
+        int cell, axis, side;   // side 1 faces +axis
+        float plane;
+        int box;
+    };
+    std::vector<Face> faces;
+    for (size_t b = 0; b < boxes.size(); b++)
+    {
+        if (boxes[b].color < 0)
+            continue;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int side = 0; side < 2; side++)
+            {
+                Face face = { boxes[b].cell, axis, side, side ? boxes[b].max[axis] : boxes[b].min[axis], (int)b };
+                faces.push_back(face);
+            }
+        }
+    }
+    std::sort(faces.begin(), faces.end(), [](const Face& a, const Face& b)
+    {
+        if (a.cell != b.cell)
+            return a.cell < b.cell;
+        if (a.axis != b.axis)
+            return a.axis < b.axis;
+        if (a.side != b.side)
+            return a.side < b.side;
+        if (a.plane != b.plane)
+            return a.plane < b.plane;
+        return a.box < b.box;
+    });
+
+    // the boxes that can touch a cell's faces: all those overlapping the bounds of the cell's baked boxes
+    std::vector<glm::vec3> cellMin(cellIndex.size(), glm::vec3(1e30f)), cellMax(cellIndex.size(), glm::vec3(-1e30f));
+    for (size_t b = 0; b < boxes.size(); b++)
+    {
+        if (boxes[b].cell < 0)
+            continue;
+        cellMin[boxes[b].cell] = glm::min(cellMin[boxes[b].cell], boxes[b].min - glm::vec3(BOX_BAKE_EPSILON));
+        cellMax[boxes[b].cell] = glm::max(cellMax[boxes[b].cell], boxes[b].max + glm::vec3(BOX_BAKE_EPSILON));
+    }
+    std::vector<std::vector<size_t> > neighbours(cellIndex.size());
+    for (size_t c = 0; c < neighbours.size(); c++)
+    {
+        for (size_t b = 0; b < boxes.size(); b++)
+        {
+            const Box& box = boxes[b];
+            if (box.min.x <= cellMax[c].x && box.min.y <= cellMax[c].y && box.min.z <= cellMax[c].z
+                && box.max.x >= cellMin[c].x && box.max.y >= cellMin[c].y && box.max.z >= cellMin[c].z)
+                neighbours[c].push_back(b);
+        }
+    }
+
+    // quads in world space until the end, each drawn where the first face it came from was
+    struct BakeQuad
+    {
+        int order;
+        float vertices[4 * MESH_VERTEX_FLOATS];
+    };
+    std::vector<std::vector<BakeQuad> > meshQuads(meshIndex.size());
+    std::vector<float> us, vs;
+    std::vector<size_t> occluders;
+    std::vector<int> owner, ownerOrder;
+    std::vector<unsigned char> done;
+    std::vector<size_t> run;
+    struct BakeRect
+    {
+        int u0, v0, u1, v1;     // grid lines
+        int color;
+        int order;              // the earliest face it covers
+    };
+    std::vector<BakeRect> rects[2];
+    for (size_t first = 0; first < faces.size();)
+    {
+        // one plane: faces of the same cell, axis and side within BOX_BAKE_EPSILON of the first
+        const Face& base = faces[first];
+        run.clear();
+        size_t last = first;
+        while (last < faces.size() && faces[last].cell == base.cell && faces[last].axis == base.axis && faces[last].side == base.side
+            && faces[last].plane - base.plane <= BOX_BAKE_EPSILON)
+            run.push_back(last++);
+        std::sort(run.begin(), run.end(), [&faces](size_t a, size_t b) { return faces[a].box < faces[b].box; });
+        int axis = base.axis, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+        float plane = base.plane;
+
+        float uMin = 1e30f, uMax = -1e30f, vMin = 1e30f, vMax = -1e30f;
+        us.clear();
+        vs.clear();
+        for (size_t f = 0; f < run.size(); f++)
+        {
+            const Box& box = boxes[faces[run[f]].box];
+            uMin = std::min(uMin, box.min[uAxis]);
+            uMax = std::max(uMax, box.max[uAxis]);
+            vMin = std::min(vMin, box.min[vAxis]);
+            vMax = std::max(vMax, box.max[vAxis]);
+            us.push_back(box.min[uAxis]);
+            us.push_back(box.max[uAxis]);
+            vs.push_back(box.min[vAxis]);
+            vs.push_back(box.max[vAxis]);
+        }
+        // boxes filling the space just in front of the plane, clipped to what the faces cover
+        occluders.clear();
+        const std::vector<size_t>& candidates = neighbours[base.cell];
+        for (size_t n = 0; n < candidates.size(); n++)
+        {
+            size_t b = candidates[n];
+            const Box& box = boxes[b];
+            bool inFront = base.side ? box.min[axis] <= plane + BOX_BAKE_EPSILON && box.max[axis] > plane + BOX_BAKE_EPSILON
+                : box.max[axis] >= plane - BOX_BAKE_EPSILON && box.min[axis] < plane - BOX_BAKE_EPSILON;
+            if (!inFront || box.max[uAxis] <= uMin || box.min[uAxis] >= uMax || box.max[vAxis] <= vMin || box.min[vAxis] >= vMax)
+                continue;
+            occluders.push_back(b);
+            us.push_back(std::max(box.min[uAxis], uMin));
+            us.push_back(std::min(box.max[uAxis], uMax));
+            vs.push_back(std::max(box.min[vAxis], vMin));
+            vs.push_back(std::min(box.max[vAxis], vMax));
+        }
+        std::vector<float>* edges[2] = { &us, &vs };
+        for (int e = 0; e < 2; e++)
+        {
+            std::vector<float>& values = *edges[e];
+            std::sort(values.begin(), values.end());
+            size_t unique = 0;
+            for (size_t k = 0; k < values.size(); k++)
+            {
+                if (unique == 0 || values[k] - values[unique - 1] > BOX_BAKE_EPSILON)
+                    values[unique++] = values[k];
+            }
+            values.resize(unique);
+        }
+        // grid lines at or after value, allowing for rounding
+        auto line = [](const std::vector<float>& values, float value)
+        {
+            return (int)(std::lower_bound(values.begin(), values.end(), value - BOX_BAKE_EPSILON) - values.begin());
+        };
+        int columns = (int)us.size() - 1, rows = (int)vs.size() - 1;
+        if (columns <= 0 || rows <= 0)
+        {
+            stats.hiddenFaces += run.size();
+            first = last;
+            continue;
+        }
+
+        // a color is the first face there; BURIED has solid on both sides, so any rectangle may run across it
+        enum { EMPTY = -1, HIDDEN = -2, BURIED = -3 };
+        owner.assign((size_t)columns * rows, EMPTY);
+        ownerOrder.assign(owner.size(), 0);
+        for (size_t o = 0; o < occluders.size(); o++)
+        {
+            const Box& box = boxes[occluders[o]];
+            int u0 = line(us, box.min[uAxis]), u1 = std::min(columns, line(us, box.max[uAxis]));
+            int v0 = line(vs, box.min[vAxis]), v1 = std::min(rows, line(vs, box.max[vAxis]));
+            for (int v = v0; v < v1; v++)
+            {
+                for (int u = u0; u < u1; u++)
+                    owner[(size_t)v * columns + u] = HIDDEN;
+            }
+        }
+        for (size_t f = 0; f < run.size(); f++)
+        {
+            const Box& box = boxes[faces[run[f]].box];
+            int order = box.order[axis][base.side];
+            int u0 = line(us, box.min[uAxis]), u1 = line(us, box.max[uAxis]);
+            int v0 = line(vs, box.min[vAxis]), v1 = line(vs, box.max[vAxis]);
+            bool visible = false;
+            for (int v = v0; v < v1; v++)
+            {
+                for (int u = u0; u < u1; u++)
+                {
+                    int& cell = owner[(size_t)v * columns + u];
+                    if (cell == EMPTY)
+                    {
+                        cell = box.color;
+                        ownerOrder[(size_t)v * columns + u] = order;
+                        visible = true;
+                    }
+                    else if (cell == HIDDEN)
+                        cell = BURIED;
+                }
+            }
+            if (!visible)
+                stats.hiddenFaces++;
+        }
+
+        // greedy merge: grow each rectangle along one axis, then along the other while the whole span matches;
+        // both ways round, keeping whichever needs fewer rectangles
+        auto merge = [&](bool alongVFirst, std::vector<BakeRect>& rects)
+        {
+            rects.clear();
+            done.assign(owner.size(), 0);
+            int majors = alongVFirst ? columns : rows, minors = alongVFirst ? rows : columns;
+            auto at = [&](int minor, int major) { return alongVFirst ? (size_t)minor * columns + major : (size_t)major * columns + minor; };
+            auto fits = [&](size_t cell, int color) { return (owner[cell] == color && !done[cell]) || owner[cell] == BURIED; };
+            for (int major = 0; major < majors; major++)
+            {
+                for (int minor = 0; minor < minors; minor++)
+                {
+                    int color = owner[at(minor, major)];
+                    if (color < 0 || done[at(minor, major)])
+                        continue;
+                    int minor1 = minor + 1;
+                    while (minor1 < minors && fits(at(minor1, major), color))
+                        minor1++;
+                    int major1 = major + 1;
+                    while (major1 < majors)
+                    {
+                        bool match = true;
+                        for (int k = minor; k < minor1 && match; k++)
+                            match = fits(at(k, major1), color);
+                        if (!match)
+                            break;
+                        major1++;
+                    }
+                    int order = ownerOrder[at(minor, major)];
+                    for (int j = major; j < major1; j++)
+                    {
+                        for (int k = minor; k < minor1; k++)
+                        {
+                            done[at(k, j)] = 1;
+                            if (owner[at(k, j)] == color)
+                                order = std::min(order, ownerOrder[at(k, j)]);
+                        }
+                    }
+                    BakeRect rect = { alongVFirst ? major : minor, alongVFirst ? minor : major, alongVFirst ? major1 : minor1, alongVFirst ? minor1 : major1, color, order };
+                    rects.push_back(rect);
+                }
+            }
+        };
+        merge(false, rects[0]);
+        merge(true, rects[1]);
+        const std::vector<BakeRect>& best = rects[1].size() < rects[0].size() ? rects[1] : rects[0];
+        for (size_t r = 0; r < best.size(); r++)
+        {
+            const BakeRect& rect = best[r];
+            // counter-clockwise seen from the side the face looks at
+            BakeQuad quad;
+            quad.order = rect.order;
+            const float cornerU[4] = { us[rect.u0], us[rect.u1], us[rect.u1], us[rect.u0] };
+            const float cornerV[4] = { vs[rect.v0], vs[rect.v0], vs[rect.v1], vs[rect.v1] };
+            glm::vec3 normal(0.0f);
+            normal[axis] = base.side ? 1.0f : -1.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                int c = base.side ? k : 3 - k;
+                glm::vec3 p;
+                p[axis] = plane;
+                p[uAxis] = cornerU[c];
+                p[vAxis] = cornerV[c];
+                const float vertex[MESH_VERTEX_FLOATS] = { p.x, p.y, p.z, normal.x, normal.y, normal.z, cornerU[c], cornerV[c] };
+                std::copy(vertex, vertex + MESH_VERTEX_FLOATS, quad.vertices + k * MESH_VERTEX_FLOATS);
+            }
+            meshQuads[meshIndex[std::make_pair(base.cell, rect.color)]].push_back(quad);
+            stats.quads++;
+        }
+        first = last;
+    }
+
+    // Into the cube's local space: the node's model stretches the cube's box over the mesh's bounds. Quads keep
+    // the draw order of the faces they came from and a mesh goes where its first quad was, among the nodes that
+    // stay, so what drew early and occluded the rest still does. With the faces in the order the sides were
+    // merged in, a floor's underside draws before its top and every covered pixel is shaded twice.
+    MeshData mesh;
+    for (size_t m = 0; m < meshQuads.size(); m++)
+    {
+        std::vector<BakeQuad>& quads = meshQuads[m];
+        if (quads.empty())
+            continue;
+        std::stable_sort(quads.begin(), quads.end(), [](const BakeQuad& a, const BakeQuad& b) { return a.order < b.order; });
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        for (size_t q = 0; q < quads.size(); q++)
+        {
+            unsigned int index = mesh.vertexCount();
+            mesh.vertices.insert(mesh.vertices.end(), quads[q].vertices, quads[q].vertices + 4 * MESH_VERTEX_FLOATS);
+            const unsigned int quad[6] = { index, index + 1, index + 2, index + 2, index + 3, index };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+        glm::vec3 low(1e30f), high(-1e30f);
+        for (size_t k = 0; k < mesh.vertices.size(); k += MESH_VERTEX_FLOATS)
+        {
+            glm::vec3 p(mesh.vertices[k], mesh.vertices[k + 1], mesh.vertices[k + 2]);
+            low = glm::min(low, p);
+            high = glm::max(high, p);
+        }
+        glm::vec3 extent = glm::max(high - low, glm::vec3(BOX_BAKE_EPSILON));
+        glm::vec3 toLocal = (CUBE_MAX - CUBE_MIN) / extent;
+        for (size_t k = 0; k < mesh.vertices.size(); k += MESH_VERTEX_FLOATS)
+        {
+            for (int c = 0; c < 3; c++)
+                mesh.vertices[k + c] = CUBE_MIN[c] + (mesh.vertices[k + c] - low[c]) * toLocal[c];
+        }
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), low - CUBE_MIN / toLocal), 1.0f / toLocal);
+        SceneNode node;
+        node.model = model;
+        node.color = colors[meshColors[m]];
+        node.mesh = addMesh(mesh);
+        node.texture = -1;
+        computeNodeBounds(node);
+        kept.push_back(std::make_pair(quads[0].order, node));
+        stats.trianglesAfter += mesh.indices.size() / 3;
+        stats.meshes++;
+    }
+    std::stable_sort(kept.begin(), kept.end(), [](const std::pair<int, SceneNode>& a, const std::pair<int, SceneNode>& b) { return a.first < b.first; });
+    scene.nodes.resize(kept.size());
+    for (size_t i = 0; i < kept.size(); i++)
+        scene.nodes[i] = kept[i].second;
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+#endif
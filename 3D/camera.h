@@ -12,6 +12,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "camera_component.h"
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -75,6 +77,13 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // adapter: drives the shared camera component with this camera's pose and zoom, it only rebuilds what changed
+    void ApplyTo(CameraComponent& component) const
+    {
+        component.SetLookAt(Position, Position + Front, Up);
+        component.SetFov(Zoom);
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
@@ -117,6 +126,28 @@ public:
         updateCameraVectors();
     }
 
+    // processes a whole frame of coalesced input at once, so the camera basis is only recomputed a single time.
+    // forward/right/yaw are -1, 0 or 1 per axis, the offsets are the summed mouse movement since the last frame
+    void ProcessFrameInput(float forward, float right, float yaw, float xoffset, float yoffset, float deltaTime, GLboolean constrainPitch = true)
+    {
+        float velocity = MovementSpeed * deltaTime;
+        Position += Front * (forward * velocity) + Right * (right * velocity);
+        Yaw += 15 * velocity * yaw + xoffset * MouseSensitivity;
+        Pitch += yoffset * MouseSensitivity;
+
+        if (constrainPitch)
+        {
+            if (Pitch > 89.0f)
+                Pitch = 89.0f;
+            if (Pitch < -89.0f)
+                Pitch = -89.0f;
+        }
+
+        // translation alone leaves the basis untouched
+        if (yaw != 0.0f || xoffset != 0.0f || yoffset != 0.0f)
+            updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
@@ -0,0 +1,249 @@
+//
+//  camera_component.h
+//  3D Object Drawing
+//
+
+#ifndef CAMERA_COMPONENT_H
+#define CAMERA_COMPONENT_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Frustum plane order returned by CameraComponent::GetFrustumPlanes
+enum Frustum_Plane {
+    PLANE_LEFT,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR
+};
+
+// Default lens values
+const float CAMERA_FOV = 45.0f;
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.0f;
+
+
+// The single camera representation used for rendering: a position, a quaternion orientation and a perspective or
+// orthographic lens.
+// Control schemes (the Euler fly Camera and the look-at BasicCamera) drive it through their ApplyTo adapters.
+// View, projection, view-projection, its inverse and the frustum planes are cached and only rebuilt when an input changed.
+class CameraComponent
+{
+public:
+    CameraComponent(glm::vec3 initialPosition = glm::vec3(0.0f, 0.0f, 0.0f), glm::quat initialOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+        float fovDegrees = CAMERA_FOV, float aspectRatio = 4.0f / 3.0f, float nearValue = CAMERA_NEAR, float farValue = CAMERA_FAR)
+        : position(initialPosition), orientation(initialOrientation), fov(fovDegrees), aspect(aspectRatio), nearPlane(nearValue), farPlane(farValue),
+          orthoHeight(0.0f), lookEye(0.0f), lookTarget(0.0f), lookUp(0.0f), dirty(ALL_DIRTY), version(1)
+    {
+    }
+
+    // pose
+    // ------------------------------------------------------------------------
+    void SetPosition(glm::vec3 value)
+    {
+        if (value == position)
+            return;
+        position = value;
+        lookUp = glm::vec3(0.0f);
+        markDirty(VIEW_DIRTY);
+    }
+
+    void SetOrientation(glm::quat value)
+    {
+        if (value == orientation)
+            return;
+        orientation = value;
+        lookUp = glm::vec3(0.0f);
+        markDirty(VIEW_DIRTY);
+    }
+
+    // same convention as glm::lookAt; the up vector does not have to be orthogonal to the view direction
+    void SetLookAt(glm::vec3 eye, glm::vec3 target, glm::vec3 up)
+    {
+        if (eye == lookEye && target == lookTarget && up == lookUp)
+            return;
+        lookEye = eye;
+        lookTarget = target;
+        lookUp = up;
+        position = eye;
+        orientation = glm::quatLookAt(glm::normalize(target - eye), up);
+        markDirty(VIEW_DIRTY);
+    }
+
+    // lens
+    // ------------------------------------------------------------------------
+    void SetPerspective(float fovDegrees, float aspectRatio, float nearValue, float farValue)
+    {
+        if (orthoHeight == 0.0f && fovDegrees == fov && aspectRatio == aspect && nearValue == nearPlane && farValue == farPlane)
+            return;
+        orthoHeight = 0.0f;
+        fov = fovDegrees;
+        aspect = aspectRatio;
+        nearPlane = nearValue;
+        farPlane = farValue;
+        markDirty(PROJECTION_DIRTY);
+    }
+
+    // height is the world-space extent the view shows from bottom to top; the width follows from the aspect
+    void SetOrthographic(float height, float aspectRatio, float nearValue, float farValue)
+    {
+        if (height == orthoHeight && aspectRatio == aspect && nearValue == nearPlane && farValue == farPlane)
+            return;
+        orthoHeight = height;
+        aspect = aspectRatio;
+        nearPlane = nearValue;
+        farPlane = farValue;
+        markDirty(PROJECTION_DIRTY);
+    }
+
+    void SetFov(float fovDegrees)
+    {
+        SetPerspective(fovDegrees, aspect, nearPlane, farPlane);
+    }
+
+    // keeps the current kind of lens
+    void SetAspect(float aspectRatio)
+    {
+        if (IsOrthographic())
+            SetOrthographic(orthoHeight, aspectRatio, nearPlane, farPlane);
+        else
+            SetPerspective(fov, aspectRatio, nearPlane, farPlane);
+    }
+
+    // cached matrices
+    // ------------------------------------------------------------------------
+    const glm::mat4& GetViewMatrix()
+    {
+        if (dirty & VIEW_DIRTY)
+        {
+            view = glm::mat4_cast(glm::conjugate(orientation)) * glm::translate(glm::mat4(1.0f), -position);
+            dirty &= ~VIEW_DIRTY;
+        }
+        return view;
+    }
+
+    const glm::mat4& GetProjectionMatrix()
+    {
+        if (dirty & PROJECTION_DIRTY)
+        {
+            if (IsOrthographic())
+            {
+                float halfHeight = orthoHeight * 0.5f;
+                projection = glm::ortho(-halfHeight * aspect, halfHeight * aspect, -halfHeight, halfHeight, nearPlane, farPlane);
+            }
+            else
+                projection = glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
+            dirty &= ~PROJECTION_DIRTY;
+        }
+        return projection;
+    }
+
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        if (dirty & VIEW_PROJECTION_DIRTY)
+        {
+            viewProjection = GetProjectionMatrix() * GetViewMatrix();
+            dirty &= ~VIEW_PROJECTION_DIRTY;
+        }
+        return viewProjection;
+    }
+
+    const glm::mat4& GetInverseViewProjectionMatrix()
+    {
+        if (dirty & INVERSE_DIRTY)
+        {
+            inverseViewProjection = glm::inverse(GetViewProjectionMatrix());
+            dirty &= ~INVERSE_DIRTY;
+        }
+        return inverseViewProjection;
+    }
+
+    // planes point inwards: dot(plane.xyz, p) + plane.w >= 0 for points inside
+    const glm::vec4* GetFrustumPlanes()
+    {
+        if (dirty & FRUSTUM_DIRTY)
+        {
+            const glm::mat4& m = GetViewProjectionMatrix();
+            glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+            glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+            glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+            glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+            planes[PLANE_LEFT] = row3 + row0;
+            planes[PLANE_RIGHT] = row3 - row0;
+            planes[PLANE_BOTTOM] = row3 + row1;
+            planes[PLANE_TOP] = row3 - row1;
+            planes[PLANE_NEAR] = row3 + row2;
+            planes[PLANE_FAR] = row3 - row2;
+            for (int i = 0; i < 6; i++)
+                planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+            dirty &= ~FRUSTUM_DIRTY;
+        }
+        return planes;
+    }
+
+    // conservative world-space AABB test against the cached frustum
+    bool IsBoxVisible(glm::vec3 boxMin, glm::vec3 boxMax)
+    {
+        const glm::vec4* p = GetFrustumPlanes();
+        for (int i = 0; i < 6; i++)
+        {
+            // the corner furthest along the plane normal
+            glm::vec3 corner(p[i].x >= 0.0f ? boxMax.x : boxMin.x,
+                             p[i].y >= 0.0f ? boxMax.y : boxMin.y,
+                             p[i].z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(p[i]), corner) + p[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // accessors
+    // ------------------------------------------------------------------------
+    glm::vec3 GetPosition() const { return position; }
+    glm::quat GetOrientation() const { return orientation; }
+    glm::vec3 GetFront() const { return orientation * glm::vec3(0.0f, 0.0f, -1.0f); }
+    glm::vec3 GetRight() const { return orientation * glm::vec3(1.0f, 0.0f, 0.0f); }
+    glm::vec3 GetUp() const { return orientation * glm::vec3(0.0f, 1.0f, 0.0f); }
+    float GetFov() const { return fov; }
+    float GetAspect() const { return aspect; }
+    float GetNear() const { return nearPlane; }
+    float GetFar() const { return farPlane; }
+    bool IsOrthographic() const { return orthoHeight > 0.0f; }
+    float GetOrthographicHeight() const { return orthoHeight; }
+
+    // increases on every change, so users can skip uploading matrices that did not move
+    unsigned int GetVersion() const { return version; }
+
+private:
+    enum {
+        VIEW_DIRTY = 1,
+        PROJECTION_DIRTY = 2,
+        VIEW_PROJECTION_DIRTY = 4,
+        INVERSE_DIRTY = 8,
+        FRUSTUM_DIRTY = 16,
+        ALL_DIRTY = 31
+    };
+
+    glm::vec3 position;
+    glm::quat orientation;
+    float fov, aspect, nearPlane, farPlane;
+    float orthoHeight;      // 0 for a perspective lens
+    // last SetLookAt arguments, so re-applying an unchanged pose is free
+    glm::vec3 lookEye, lookTarget, lookUp;
+
+    glm::mat4 view, projection, viewProjection, inverseViewProjection;
+    glm::vec4 planes[6];
+    unsigned int dirty;
+    unsigned int version;
+
+    void markDirty(unsigned int flags)
+    {
+        // everything derived from view or projection goes stale with them
+        dirty |= flags | VIEW_PROJECTION_DIRTY | INVERSE_DIRTY | FRUSTUM_DIRTY;
+        version++;
+    }
+};
+#endif
@@ -0,0 +1,60 @@
+//
+//  ceiling_fan.h
+//  3D Object Drawing
+//
+
+#ifndef CEILING_FAN_H
+#define CEILING_FAN_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Default ceiling fan values
+const int FAN_PARTS = 4;    // the rod and three blades, each one unit cube
+
+
+// The ceiling fan of the scene pass: a rod hanging from the ceiling and three blades that turn about the rod
+// by fanAngle degrees. Only the matrices live here, so the renderer draws them and the benchmarks time them.
+struct CeilingFan
+{
+    glm::mat4 models[FAN_PARTS];
+    glm::vec3 colors[FAN_PARTS];
+};
+
+inline void buildCeilingFan(float fanAngle, CeilingFan& fan)
+{
+    glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
+    glm::mat4 translateMatrix, rotateYMatrix, scaleMatrix, model;
+
+    // rod
+    glm::mat4 moveMatrix = glm::translate(identityMatrix, glm::vec3(-0.15f, 2.2f, 0.0f));
+    translateMatrix = glm::translate(identityMatrix, glm::vec3(-0.30f, -3.0f, -0.60f));
+    scaleMatrix = glm::scale(identityMatrix, glm::vec3(0.1f, 0.5f, 0.1f));
+    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(225.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = rotateYMatrix * scaleMatrix * translateMatrix;
+    fan.models[0] = moveMatrix * model;
+    fan.colors[0] = glm::vec3(0.48f, 0.35f, 0.0f);
+
+    // blades, turned as one about the rod
+    translateMatrix = glm::translate(identityMatrix, glm::vec3(-0.2f, 0.6f, 0.0f));
+    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(fanAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    moveMatrix = rotateYMatrix * translateMatrix;
+
+    translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, 0));
+    scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.5f, 0.2f, 0.5f));
+    model = scaleMatrix * translateMatrix;
+    fan.models[1] = moveMatrix * model;
+
+    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = rotateYMatrix * scaleMatrix * translateMatrix;
+    fan.models[2] = moveMatrix * model;
+
+    translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, -0.5f));
+    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(225.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = rotateYMatrix * scaleMatrix * translateMatrix;
+    fan.models[3] = moveMatrix * model;
+
+    for (int i = 1; i < FAN_PARTS; i++)
+        fan.colors[i] = glm::vec3(0.0f, 0.0f, 1.0f);
+}
+#endif
@@ -0,0 +1,501 @@
+//
+//  collision.h
+//  3D Object Drawing
+//
+
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Default collision values
+const float COLLISION_CELL_SIZE = 1.0f;         // grid cell edge in world units, about the size of a piece of furniture
+const int COLLISION_MAX_BODY_CELLS = 64;        // bodies covering more cells than this (floors, long walls) skip the grid
+const int COLLISION_MAX_SLIDES = 4;             // contacts resolved per move before the rest of it is dropped
+const float COLLISION_SKIN = 0.001f;            // kept between a swept sphere and what it hit
+
+
+// the first contact of a sweep
+struct CollisionHit
+{
+    float time;         // fraction of the motion, 0..1
+    glm::vec3 normal;   // world space, pointing from the box towards the sphere
+    int body;
+};
+
+// An oriented box: center, three orthonormal axes and the half extent along each
+struct CollisionBox
+{
+    glm::vec3 center;
+    glm::vec3 axes[3];
+    glm::vec3 half;
+};
+
+// Boxes a sphere can collide with, for keeping the camera out of walls and furniture.
+// Every body is an oriented box taken from a model matrix (the scene's unit cube, or any local box) and is also
+// filed in a uniform grid hashed into a bucket table: a query visits only the cells its bounds touch, so its cost
+// depends on what is nearby, not on how many bodies there are. Moving a body refiles it only when its cell range
+// changes. Sweeps are exact for a sphere against an oriented box (the box grown by the radius, with rounded
+// edges and corners), and slide() turns the first contact into motion along the surface.
+// Queries keep per-call scratch in the world, so one thread at a time.
+class CollisionWorld
+{
+public:
+    CollisionWorld(float cellSize = COLLISION_CELL_SIZE) : cellSize(cellSize), stamp(0), liveBodies(0)
+    {
+        buckets.resize(64);
+    }
+
+    // the box localMin..localMax under model; returns the body id
+    int addBox(const glm::mat4& model, glm::vec3 localMin = CUBE_MIN, glm::vec3 localMax = CUBE_MAX)
+    {
+        Body body;
+        body.box = orientedBox(model, localMin, localMax);
+        body.live = true;
+        body.oversized = false;
+        body.stamp = 0;
+        bodies.push_back(body);
+        int id = (int)bodies.size() - 1;
+        liveBodies++;
+        if (liveBodies * 2 > buckets.size())
+            rehash(buckets.size() * 2);
+        file(id);
+        return id;
+    }
+
+    // one body per scene node
+    void addScene(const Scene& scene)
+    {
+        for (size_t i = 0; i < scene.nodes.size(); i++)
+            addBox(scene.nodes[i].model);
+    }
+
+    // a dynamic body moved; it keeps its local box
+    void moveBox(int id, const glm::mat4& model, glm::vec3 localMin = CUBE_MIN, glm::vec3 localMax = CUBE_MAX)
+    {
+        Body& body = bodies[id];
+        if (!body.live)
+            return;
+        body.box = orientedBox(model, localMin, localMax);
+        glm::ivec3 cellMin, cellMax;
+        cellRange(body, cellMin, cellMax);
+        bool oversized = cellCount(cellMin, cellMax) > COLLISION_MAX_BODY_CELLS;
+        if (oversized == body.oversized && (oversized || (cellMin == body.cellMin && cellMax == body.cellMax)))
+            return;
+        unfile(id);
+        file(id);
+    }
+
+    void removeBox(int id)
+    {
+        if (!bodies[id].live)
+            return;
+        unfile(id);
+        bodies[id].live = false;
+        liveBodies--;
+    }
+
+    size_t bodyCount() const
+    {
+        return liveBodies;
+    }
+
+    // bodies whose bounds overlap boxMin..boxMax, each once
+    void query(glm::vec3 boxMin, glm::vec3 boxMax, std::vector<int>& out)
+    {
+        out.clear();
+        stamp++;
+        glm::ivec3 cellMin = cellOf(boxMin), cellMax = cellOf(boxMax);
+        if (cellCount(cellMin, cellMax) > COLLISION_MAX_BODY_CELLS * 8)
+        {
+            // a query this large is cheaper as a scan than as a walk over its cells
+            for (size_t i = 0; i < bodies.size(); i++)
+                visit((int)i, boxMin, boxMax, out);
+            return;
+        }
+        for (int z = cellMin.z; z <= cellMax.z; z++)
+        {
+            for (int y = cellMin.y; y <= cellMax.y; y++)
+            {
+                for (int x = cellMin.x; x <= cellMax.x; x++)
+                {
+                    const std::vector<int>& bucket = buckets[bucketOf(x, y, z)];
+                    for (size_t i = 0; i < bucket.size(); i++)
+                        visit(bucket[i], boxMin, boxMax, out);
+                }
+            }
+        }
+        for (size_t i = 0; i < oversized.size(); i++)
+            visit(oversized[i], boxMin, boxMax, out);
+    }
+
+    // the first body a sphere of radius hits moving from start by motion; false if the path is clear.
+    // A sphere that already overlaps a box hits it at time 0 only while moving further in, so it can back out.
+    bool sweep(glm::vec3 start, float radius, glm::vec3 motion, CollisionHit& hit)
+    {
+        glm::vec3 end = start + motion;
+        query(glm::min(start, end) - glm::vec3(radius), glm::max(start, end) + glm::vec3(radius), candidates);
+        hit.time = 2.0f;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            CollisionHit bodyHit;
+            if (sweepBody(candidates[i], start, radius, motion, bodyHit) && bodyHit.time < hit.time)
+                hit = bodyHit;
+        }
+        return hit.time <= 1.0f;
+    }
+
+    // the narrow phase against one body, without the grid
+    bool sweepBody(int id, glm::vec3 start, float radius, glm::vec3 motion, CollisionHit& hit) const
+    {
+        const CollisionBox& box = bodies[id].box;
+        // into the box frame: the box is then -half..half on every axis
+        glm::vec3 offset = start - box.center;
+        glm::vec3 p(glm::dot(offset, box.axes[0]), glm::dot(offset, box.axes[1]), glm::dot(offset, box.axes[2]));
+        glm::vec3 d(glm::dot(motion, box.axes[0]), glm::dot(motion, box.axes[1]), glm::dot(motion, box.axes[2]));
+        float t;
+        glm::vec3 n;
+        if (!sweepSphereBox(p, d, radius, box.half, t, n))
+            return false;
+        hit.time = t;
+        hit.normal = box.axes[0] * n.x + box.axes[1] * n.y + box.axes[2] * n.z;
+        hit.body = id;
+        return true;
+    }
+
+    // where a sphere moving by motion ends up when every contact takes away the motion into the surface
+    glm::vec3 slide(glm::vec3 start, float radius, glm::vec3 motion)
+    {
+        glm::vec3 position = start;
+        for (int i = 0; i < COLLISION_MAX_SLIDES; i++)
+        {
+            float length = glm::length(motion);
+            if (length < 1e-6f)
+                break;
+            CollisionHit hit;
+            if (!sweep(position, radius, motion, hit))
+                return position + motion;
+            // stop just short of the contact, then keep what is left of the motion along the surface
+            float time = std::max(0.0f, hit.time - COLLISION_SKIN / length);
+            position += motion * time;
+            motion *= 1.0f - time;
+            motion -= hit.normal * std::min(0.0f, glm::dot(motion, hit.normal));
+        }
+        return position;
+    }
+
+    // the model matrix's columns, made orthonormal; a sheared box (a scaled parent over a rotated child) gets
+    // the oriented box that encloses it
+    static CollisionBox orientedBox(const glm::mat4& model, glm::vec3 localMin, glm::vec3 localMax)
+    {
+        CollisionBox box;
+        glm::vec3 localHalf = (localMax - localMin) * 0.5f;
+        box.center = glm::vec3(model * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+        glm::vec3 edges[3];
+        for (int i = 0; i < 3; i++)
+            edges[i] = glm::vec3(model[i]) * localHalf[i];
+        // Gram-Schmidt from the longest edge, so the box follows the object's main direction
+        int first = 0;
+        for (int i = 1; i < 3; i++)
+        {
+            if (glm::dot(edges[i], edges[i]) > glm::dot(edges[first], edges[first]))
+                first = i;
+        }
+        int second = (first + 1) % 3, third = (first + 2) % 3;
+        glm::vec3 u0 = safeNormalize(edges[first], glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::vec3 u1 = edges[second] - u0 * glm::dot(edges[second], u0);
+        u1 = safeNormalize(u1, std::fabs(u0.y) < 0.9f ? glm::normalize(glm::cross(u0, glm::vec3(0.0f, 1.0f, 0.0f))) : glm::normalize(glm::cross(u0, glm::vec3(1.0f, 0.0f, 0.0f))));
+        glm::vec3 u2 = glm::cross(u0, u1);
+        box.axes[first] = u0;
+        box.axes[second] = u1;
+        box.axes[third] = u2;
+        for (int i = 0; i < 3; i++)
+        {
+            box.half[i] = 0.0f;
+            for (int j = 0; j < 3; j++)
+                box.half[i] += std::fabs(glm::dot(edges[j], box.axes[i]));
+        }
+        return box;
+    }
+
+private:
+    struct Body
+    {
+        CollisionBox box;
+        glm::vec3 boundsMin, boundsMax;
+        glm::ivec3 cellMin, cellMax;
+        bool live;
+        bool oversized;
+        unsigned int stamp;     // the last query that visited it
+    };
+
+    float cellSize;
+    std::vector<Body> bodies;
+    std::vector<std::vector<int> > buckets;     // a power of two of them
+    std::vector<int> oversized;
+    std::vector<int> candidates;
+    unsigned int stamp;
+    size_t liveBodies;
+
+    static glm::vec3 safeNormalize(glm::vec3 v, glm::vec3 fallback)
+    {
+        float length = glm::length(v);
+        return length > 1e-12f ? v / length : fallback;
+    }
+
+    glm::ivec3 cellOf(glm::vec3 p) const
+    {
+        return glm::ivec3((int)std::floor(p.x / cellSize), (int)std::floor(p.y / cellSize), (int)std::floor(p.z / cellSize));
+    }
+
+    static int64_t cellCount(glm::ivec3 cellMin, glm::ivec3 cellMax)
+    {
+        return (int64_t)(cellMax.x - cellMin.x + 1) * (cellMax.y - cellMin.y + 1) * (cellMax.z - cellMin.z + 1);
+    }
+
+    size_t bucketOf(int x, int y, int z) const
+    {
+        uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+        return h & (buckets.size() - 1);
+    }
+
+    void cellRange(Body& body, glm::ivec3& cellMin, glm::ivec3& cellMax) const
+    {
+        glm::vec3 extent(0.0f);
+        for (int i = 0; i < 3; i++)
+            extent += glm::abs(body.box.axes[i]) * body.box.half[i];
+        body.boundsMin = body.box.center - extent;
+        body.boundsMax = body.box.center + extent;
+        cellMin = cellOf(body.boundsMin);
+        cellMax = cellOf(body.boundsMax);
+    }
+
+    void file(int id)
+    {
+        Body& body = bodies[id];
+        cellRange(body, body.cellMin, body.cellMax);
+        body.oversized = cellCount(body.cellMin, body.cellMax) > COLLISION_MAX_BODY_CELLS;
+        if (body.oversized)
+        {
+            oversized.push_back(id);
+            return;
+        }
+        for (int z = body.cellMin.z; z <= body.cellMax.z; z++)
+            for (int y = body.cellMin.y; y <= body.cellMax.y; y++)
+                for (int x = body.cellMin.x; x <= body.cellMax.x; x++)
+                    buckets[bucketOf(x, y, z)].push_back(id);
+    }
+
+    static void eraseId(std::vector<int>& list, int id)
+    {
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            if (list[i] == id)
+            {
+                list[i] = list.back();
+                list.pop_back();
+                return;
+            }
+        }
+    }
+
+    // from the cells it was filed under, which the body remembers
+    void unfile(int id)
+    {
+        const Body& body = bodies[id];
+        if (body.oversized)
+        {
+            eraseId(oversized, id);
+            return;
+        }
+        for (int z = body.cellMin.z; z <= body.cellMax.z; z++)
+            for (int y = body.cellMin.y; y <= body.cellMax.y; y++)
+                for (int x = body.cellMin.x; x <= body.cellMax.x; x++)
+                    eraseId(buckets[bucketOf(x, y, z)], id);
+    }
+
+    void rehash(size_t count)
+    {
+        buckets.assign(count, std::vector<int>());
+        oversized.clear();
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            if (bodies[i].live)
+                file((int)i);
+        }
+    }
+
+    void visit(int id, glm::vec3 boxMin, glm::vec3 boxMax, std::vector<int>& out)
+    {
+        Body& body = bodies[id];
+        if (!body.live || body.stamp == stamp)
+            return;
+        body.stamp = stamp;
+        if (body.boundsMin.x > boxMax.x || body.boundsMax.x < boxMin.x || body.boundsMin.y > boxMax.y || body.boundsMax.y < boxMin.y
+            || body.boundsMin.z > boxMax.z || body.boundsMax.z < boxMin.z)
+            return;
+        out.push_back(id);
+    }
+
+    // first t in [0, 1] where the ray p + t d comes within r of the segment a..b (a capsule)
+    static bool rayCapsule(glm::vec3 p, glm::vec3 d, glm::vec3 a, glm::vec3 b, float r, float& t)
+    {
+        bool found = false;
+        t = 2.0f;
+        glm::vec3 axis = b - a;
+        float length = glm::length(axis);
+        glm::vec3 n = axis / length;
+        glm::vec3 m = p - a;
+        glm::vec3 mPerp = m - n * glm::dot(m, n);
+        glm::vec3 dPerp = d - n * glm::dot(d, n);
+        float qa = glm::dot(dPerp, dPerp);
+        float qb = glm::dot(mPerp, dPerp);
+        float qc = glm::dot(mPerp, mPerp) - r * r;
+        if (qa > 1e-12f)
+        {
+            float disc = qb * qb - qa * qc;
+            if (disc >= 0.0f)
+            {
+                float tc = (-qb - std::sqrt(disc)) / qa;
+                float s = glm::dot(m + d * tc, n);
+                if (tc >= 0.0f && tc <= 1.0f && s >= 0.0f && s <= length)
+                {
+                    t = tc;
+                    found = true;
+                }
+            }
+        }
+        // the rounded ends
+        glm::vec3 ends[2] = { a, b };
+        for (int i = 0; i < 2; i++)
+        {
+            glm::vec3 e = p - ends[i];
+            float sa = glm::dot(d, d);
+            float sb = glm::dot(e, d);
+            float sc = glm::dot(e, e) - r * r;
+            float disc = sb * sb - sa * sc;
+            if (sa <= 1e-12f || disc < 0.0f)
+                continue;
+            float ts = (-sb - std::sqrt(disc)) / sa;
+            if (ts >= 0.0f && ts <= 1.0f && ts < t)
+            {
+                t = ts;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // a sphere of radius r moving from p by d against the box -half..half, all in the box frame.
+    // The slab test against the box grown by r finds the entry; where that lands beside an edge or a corner of
+    // the box the grown shape is rounded, and the capsules along the nearby edges decide.
+    static bool sweepSphereBox(glm::vec3 p, glm::vec3 d, float r, glm::vec3 half, float& t, glm::vec3& normal)
+    {
+        // already touching: a hit at 0 only while moving further in
+        glm::vec3 closest = glm::clamp(p, -half, half);
+        glm::vec3 away = p - closest;
+        float distance2 = glm::dot(away, away);
+        if (distance2 < r * r)
+        {
+            if (distance2 > 1e-12f)
+                normal = away / std::sqrt(distance2);
+            else
+            {
+                // the center is inside: out through the nearest face
+                glm::vec3 depth = half - glm::abs(p);
+                int axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+                normal = glm::vec3(0.0f);
+                normal[axis] = p[axis] < 0.0f ? -1.0f : 1.0f;
+            }
+            if (glm::dot(d, normal) >= 0.0f)
+                return false;
+            t = 0.0f;
+            return true;
+        }
+
+        glm::vec3 grown = half + glm::vec3(r);
+        float enter = -1e30f, leave = 1e30f;
+        int enterAxis = -1;
+        for (int i = 0; i < 3; i++)
+        {
+            if (std::fabs(d[i]) < 1e-12f)
+            {
+                if (p[i] < -grown[i] || p[i] > grown[i])
+                    return false;
+                continue;
+            }
+            float t0 = (-grown[i] - p[i]) / d[i];
+            float t1 = (grown[i] - p[i]) / d[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            if (t0 > enter)
+            {
+                enter = t0;
+                enterAxis = i;
+            }
+            leave = std::min(leave, t1);
+        }
+        if (enter > leave || leave < 0.0f || enter > 1.0f)
+            return false;
+
+        // which sides of the box the entry point is beyond
+        glm::vec3 q = p + d * std::max(enter, 0.0f);
+        int outside = 0;
+        glm::vec3 side(0.0f);
+        for (int i = 0; i < 3; i++)
+        {
+            if (q[i] < -half[i])
+                side[i] = -1.0f;
+            else if (q[i] > half[i])
+                side[i] = 1.0f;
+            if (side[i] != 0.0f)
+                outside++;
+        }
+        if (outside <= 1 && enter >= 0.0f && enterAxis >= 0)
+        {
+            // a face
+            t = enter;
+            normal = glm::vec3(0.0f);
+            normal[enterAxis] = d[enterAxis] > 0.0f ? -1.0f : 1.0f;
+            return true;
+        }
+        if (outside <= 1)
+            return false;
+
+        // beside an edge (two sides) or a corner (three): the capsules along the edges there
+        bool found = false;
+        t = 2.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            // an edge along axis, at the sides the point is beyond on the other two
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            if (side[u] == 0.0f || side[v] == 0.0f)
+                continue;
+            glm::vec3 a, b;
+            a[u] = b[u] = side[u] * half[u];
+            a[v] = b[v] = side[v] * half[v];
+            a[axis] = -half[axis];
+            b[axis] = half[axis];
+            float tc;
+            if (rayCapsule(p, d, a, b, r, tc) && tc < t)
+            {
+                t = tc;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+        glm::vec3 contact = p + d * t;
+        normal = safeNormalize(contact - glm::clamp(contact, -half, half), -glm::normalize(d));
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,119 @@
+//
+//  cooker.cpp
+//  3D Object Drawing
+//
+//  Offline tool: turns a text scene description and the meshes it references into one scene pack.
+//
+//      cooker <input.scene> <output.pack>
+//      cooker --bedrooms <count> <output.pack>     a square grid of bedrooms, for load time tests
+//
+
+#include "mesh_data.h"
+#include "mesh_optimizer.h"
+#include "scene.h"
+#include "bedroom.h"
+#include "scene_file.h"
+#include "scene_pack.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// settings
+const float BEDROOM_SPACING = 6.0f;    // grid pitch of generated bedrooms
+
+CookedScene cooked;
+std::unordered_map<std::string, int> meshHandles;
+std::unordered_map<std::string, int> textureHandles;
+
+// meshes are loaded and optimized once per path; a missing file keeps the node on the cube, as at runtime
+int resolveMesh(const char* path)
+{
+    std::unordered_map<std::string, int>::iterator it = meshHandles.find(path);
+    if (it != meshHandles.end())
+        return it->second;
+    CookedMesh mesh;
+    mesh.path = path;
+    std::string error;
+    int handle = CUBE_MESH;
+    if (loadObj(mesh.path, mesh.data, error))
+    {
+        MeshOptimizeReport report = optimizeMesh(mesh.data);
+        std::cout << "mesh " << path << ": " << mesh.data.indices.size() / 3 << " triangles, ACMR " << report.before.acmr << " -> " << report.after.acmr << std::endl;
+        handle = (int)cooked.meshes.size();
+        cooked.meshes.push_back(mesh);
+    }
+    else
+        std::cout << "WARNING::COOKER:: " << path << ": " << error << ", using the cube" << std::endl;
+    meshHandles[path] = handle;
+    return handle;
+}
+
+// textures stay separate files; the pack only records the paths
+int resolveTexture(const char* path)
+{
+    std::unordered_map<std::string, int>::iterator it = textureHandles.find(path);
+    if (it != textureHandles.end())
+        return it->second;
+    int handle = (int)cooked.textures.size();
+    cooked.textures.push_back(path);
+    textureHandles[path] = handle;
+    return handle;
+}
+
+int main(int argc, char** argv)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Scene scene;
+    std::string error;
+    const char* output;
+    if (argc == 4 && strcmp(argv[1], "--bedrooms") == 0)
+    {
+        int count = atoi(argv[2]);
+        int side = (int)std::ceil(std::sqrt((float)count));
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 offset((i % side) * BEDROOM_SPACING, 0.0f, (i / side) * BEDROOM_SPACING);
+            buildBedroom(scene, resolveMesh, resolveTexture, glm::translate(glm::mat4(1.0f), offset));
+        }
+        output = argv[3];
+    }
+    else if (argc == 3)
+    {
+        if (!loadSceneFile(argv[1], scene, resolveMesh, resolveTexture, error))
+        {
+            std::cout << "ERROR::COOKER:: " << argv[1] << ": " << error << std::endl;
+            return 1;
+        }
+        output = argv[2];
+    }
+    else
+    {
+        std::cout << "usage: cooker <input.scene> <output.pack>" << std::endl;
+        std::cout << "       cooker --bedrooms <count> <output.pack>" << std::endl;
+        return 1;
+    }
+
+    cooked.nodes.swap(scene.nodes);
+    if (!writeScenePack(output, cooked, error))
+    {
+        std::cout << "ERROR::COOKER:: " << output << ": " << error << std::endl;
+        return 1;
+    }
+
+    // read it back the way the runtime does, so a bad pack never leaves the cooker
+    ScenePack pack;
+    if (!pack.open(output, error))
+    {
+        std::cout << "ERROR::COOKER:: verification of " << output << " failed: " << error << std::endl;
+        return 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << output << ": " << pack.nodeCount() << " nodes, " << pack.meshCount() << " meshes, " << pack.textureCount() << " textures, "
+        << pack.fileSize() / 1024 << " KiB, cooked in " << ms << " ms" << std::endl;
+    return 0;
+}
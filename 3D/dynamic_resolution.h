@@ -0,0 +1,169 @@
+//
+//  dynamic_resolution.h
+//  3D Object Drawing
+//
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <cmath>
+
+// Default dynamic resolution values
+const float FRAME_BUDGET_MS = 8.3f;
+const float MIN_RENDER_SCALE = 0.35f;
+const float MAX_RENDER_SCALE = 1.0f;
+const float SHARPEN_STRENGTH = 0.25f;
+const int TIMER_QUERY_COUNT = 4;
+
+
+// Picks a scene resolution that follows the measured GPU time and upscales it to the window with a bilinear
+// (optionally sharpened) blit. The scene target itself comes from the render graph at window size; the scene
+// is drawn into its lower-left sub-rectangle, so changing the scale every frame never reallocates anything.
+class DynamicResolution
+{
+public:
+    // controller options
+    float TargetFrameMs;
+    float MinScale;
+    float MaxScale;
+    bool Sharpen;
+    float SharpenStrength;
+    bool Enabled;
+    // current state
+    float Scale;
+    float LastGpuMs;
+
+    DynamicResolution(const char* blitVertexPath, const char* blitFragmentPath, float targetFrameMs = FRAME_BUDGET_MS)
+        : TargetFrameMs(targetFrameMs), MinScale(MIN_RENDER_SCALE), MaxScale(MAX_RENDER_SCALE), Sharpen(true), SharpenStrength(SHARPEN_STRENGTH),
+          Enabled(true), Scale(1.0f), LastGpuMs(0.0f), blitShader(blitVertexPath, blitFragmentPath),
+          targetWidth(0), targetHeight(0), renderW(0), renderH(0), queryHead(0), pendingQueries(0)
+    {
+        // core profile needs a bound VAO even though the fullscreen triangle is generated from gl_VertexID
+        glGenVertexArrays(1, &emptyVAO);
+        glGenQueries(TIMER_QUERY_COUNT, queries);
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        glDeleteQueries(TIMER_QUERY_COUNT, queries);
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteProgram(blitShader.ID);
+    }
+
+    // pick this frame's render size and start timing; call before the render graph runs
+    void beginFrame(int windowWidth, int windowHeight)
+    {
+        targetWidth = windowWidth;
+        targetHeight = windowHeight;
+
+        float scale = Enabled ? Scale : 1.0f;
+        // keep the render size on an 8 pixel grid so small scale changes don't move the image every frame
+        renderW = quantize(windowWidth * scale, windowWidth);
+        renderH = quantize(windowHeight * scale, windowHeight);
+
+        if (pendingQueries < TIMER_QUERY_COUNT)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, queries[queryHead]);
+            queryActive = true;
+        }
+        else
+            queryActive = false;
+    }
+
+    // scene pass: restrict drawing to the scaled sub-rectangle of the window sized target
+    void setRenderViewport() const
+    {
+        glViewport(0, 0, renderW, renderH);
+    }
+
+    // upscale pass: stretch the rendered sub-rectangle of colorTexture over the bound window sized framebuffer
+    void upscale(unsigned int colorTexture)
+    {
+        glDisable(GL_DEPTH_TEST);
+        blitShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        blitShader.setInt("sceneColor", 0);
+        blitShader.setVec2("uvScale", (float)renderW / targetWidth, (float)renderH / targetHeight);
+        blitShader.setVec2("texelSize", 1.0f / targetWidth, 1.0f / targetHeight);
+        // sharpen harder the further we are below native resolution
+        float sharpness = 0.0f;
+        if (Sharpen && renderW < targetWidth)
+            sharpness = SharpenStrength * (1.0f - (float)renderW / targetWidth) / (1.0f - MinScale);
+        blitShader.setFloat("sharpness", sharpness);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // stop timing after the graph has run and feed the controller
+    void endFrame()
+    {
+        if (queryActive)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            queryHead = (queryHead + 1) % TIMER_QUERY_COUNT;
+            pendingQueries++;
+        }
+        collectQueries();
+    }
+
+    int renderWidth() const { return renderW; }
+    int renderHeight() const { return renderH; }
+
+private:
+    Shader blitShader;
+    unsigned int emptyVAO;
+    int targetWidth, targetHeight;
+    int renderW, renderH;
+    unsigned int queries[TIMER_QUERY_COUNT];
+    int queryHead, pendingQueries;
+    bool queryActive = false;
+
+    static int quantize(float size, int limit)
+    {
+        int s = ((int)size + 7) & ~7;
+        if (s < 8)
+            s = 8;
+        return s < limit ? s : limit;
+    }
+
+    // read back finished timer queries without ever waiting on the GPU
+    void collectQueries()
+    {
+        while (pendingQueries > 0)
+        {
+            int oldest = (queryHead - pendingQueries + TIMER_QUERY_COUNT) % TIMER_QUERY_COUNT;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &elapsed);
+            pendingQueries--;
+            LastGpuMs = (float)(elapsed / 1.0e6);
+            updateScale(LastGpuMs);
+        }
+    }
+
+    // pixel cost scales with area, so move the linear scale by the square root of the time ratio
+    void updateScale(float gpuMs)
+    {
+        if (!Enabled || gpuMs <= 0.0f)
+            return;
+        float desired = Scale * std::sqrt(TargetFrameMs / gpuMs);
+        // damp the response so a single slow frame doesn't make the image pump
+        float next = Scale + (desired - Scale) * 0.2f;
+        if (next < MinScale)
+            next = MinScale;
+        if (next > MaxScale)
+            next = MaxScale;
+        Scale = next;
+    }
+};
+#endif
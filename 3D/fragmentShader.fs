@@ -1,9 +1,54 @@
 #version 330 core
 in vec4 color;
+in vec2 texCoord;
+in vec3 worldPos;
+#ifdef SHADOWED
+in vec4 lightSpacePos;
+#endif
 
 out vec4 FragColor;
 
+#ifdef TEXTURED
+// every texture lives in a layer of an array that stays bound to its own unit
+uniform sampler2DArray textureArray;
+uniform float textureLayer;     // negative for flat colored draws
+uniform float textureMinLod;    // finest mip of this layer that has been streamed in
+#endif
+#ifdef LIT
+const vec3 LIGHT_DIRECTION = vec3(0.37, 0.84, 0.4);  // towards the light
+#endif
+#ifdef SHADOWED
+uniform sampler2DShadow shadowMap;
+#endif
+
 void main()
 {
-    FragColor = color;
+#ifdef OVERDRAW
+    // one per fragment; the overdraw view adds them up with additive blending
+    FragColor = vec4(1.0);
+    return;
+#endif
+    vec4 result = color;
+#ifdef TEXTURED
+    if (textureLayer >= 0.0)
+    {
+        // the usual LOD selection, clamped so a layer never samples mips it does not have yet
+        vec2 texel = texCoord * vec2(textureSize(textureArray, 0).xy);
+        vec2 dx = dFdx(texel);
+        vec2 dy = dFdy(texel);
+        float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+        result *= textureLod(textureArray, vec3(texCoord, textureLayer), max(lod, textureMinLod));
+    }
+#endif
+#ifdef LIT
+    // face normal from screen space derivatives, so meshes and the cube light the same way
+    vec3 normal = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+    float light = abs(dot(normal, LIGHT_DIRECTION));
+#ifdef SHADOWED
+    vec3 shadowCoord = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    light *= texture(shadowMap, vec3(shadowCoord.xy, shadowCoord.z - 0.002));
+#endif
+    result.rgb *= 0.35 + 0.65 * light;
+#endif
+    FragColor = result;
 }
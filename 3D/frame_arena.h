@@ -0,0 +1,174 @@
+//
+//  frame_arena.h
+//  3D Object Drawing
+//
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Default arena values
+const size_t FRAME_ARENA_BLOCK_BYTES = 1024 * 1024;     // the first block; later blocks are at least this big
+const size_t FRAME_ARENA_ALIGNMENT = 16;
+
+
+// A linear allocator for data that lives for one frame: draw lists, culling results, matrices.
+// Allocation is a pointer bump, there is no per-allocation free, and reset() rewinds everything at frame end.
+// When a frame needs more than the arena has, another block is added and kept, so after the first few frames
+// the arena has reached its high-water mark and never touches the heap again.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t firstBlockBytes = FRAME_ARENA_BLOCK_BYTES) : blockBytes(firstBlockBytes), current(0), offset(0), usedBytes(0), peakBytes(0)
+    {
+    }
+
+    ~FrameArena()
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+            free(blocks[i].memory);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = FRAME_ARENA_ALIGNMENT)
+    {
+        while (current < blocks.size())
+        {
+            Block& block = blocks[current];
+            uintptr_t base = (uintptr_t)block.memory;
+            uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            if (aligned + size <= base + block.size)
+            {
+                usedBytes += aligned + size - (base + offset);
+                offset = aligned + size - base;
+                if (usedBytes > peakBytes)
+                    peakBytes = usedBytes;
+                return (void*)aligned;
+            }
+            // the rest of this block is wasted for this frame; move on to the next one
+            current++;
+            offset = 0;
+        }
+        Block block;
+        block.size = size + alignment > blockBytes ? size + alignment : blockBytes;
+        block.memory = malloc(block.size);
+        if (!block.memory)
+            throw std::bad_alloc();
+        blocks.push_back(block);
+        current = blocks.size() - 1;
+        offset = 0;
+        return allocate(size, alignment);
+    }
+
+    // uninitialized storage for count objects; only for types that need no destructor
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return (T*)allocate(count * sizeof(T), alignof(T) > FRAME_ARENA_ALIGNMENT ? alignof(T) : FRAME_ARENA_ALIGNMENT);
+    }
+
+    // frees everything allocated since the last reset; the blocks stay for the next frame
+    void reset()
+    {
+        current = 0;
+        offset = 0;
+        usedBytes = 0;
+    }
+
+    size_t used() const { return usedBytes; }
+    size_t peak() const { return peakBytes; }
+
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            total += blocks[i].size;
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        void* memory;
+        size_t size;
+    };
+
+    size_t blockBytes;
+    std::vector<Block> blocks;
+    size_t current;
+    size_t offset;
+    size_t usedBytes;
+    size_t peakBytes;
+};
+
+// A standard allocator drawing from a FrameArena, so containers can hold per-frame data:
+//     std::vector<int, ArenaAllocator<int> > visible(ArenaAllocator<int>(frameArena));
+// deallocate is a no-op; the memory comes back when the arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena& source) : arena(&source) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    FrameArena* arena;
+};
+
+// Per-thread arenas for transient data produced by worker jobs. Each thread's arena rewinds itself the first time
+// it is used after endFrameArenas(), so jobs must not keep arena memory across a frame boundary.
+inline std::atomic<unsigned int>& frameArenaEpoch()
+{
+    static std::atomic<unsigned int> epoch(0);
+    return epoch;
+}
+
+inline FrameArena& threadFrameArena()
+{
+    static thread_local FrameArena arena;
+    static thread_local unsigned int epoch = 0;
+    unsigned int now = frameArenaEpoch().load(std::memory_order_acquire);
+    if (epoch != now)
+    {
+        arena.reset();
+        epoch = now;
+    }
+    return arena;
+}
+
+// render thread, after the frame's jobs have finished
+inline void endFrameArenas()
+{
+    frameArenaEpoch().fetch_add(1, std::memory_order_release);
+}
+
+// Heap allocation counter. With COUNT_HEAP_ALLOCATIONS defined, as it is in debug builds, main.cpp replaces the
+// global operator new to bump it; it counts per thread so the render thread's steady state can be checked while
+// loaders keep allocating on the workers. Release builds keep the library's allocator and never count.
+#if !defined(NDEBUG) && !defined(COUNT_HEAP_ALLOCATIONS)
+#define COUNT_HEAP_ALLOCATIONS
+#endif
+inline size_t& threadHeapAllocations()
+{
+    static thread_local size_t count = 0;
+    return count;
+}
+#endif
@@ -0,0 +1,364 @@
+//
+//  frame_capture.h
+//  3D Object Drawing
+//
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define CAPTURE_POPEN _popen
+#define CAPTURE_PCLOSE _pclose
+#define CAPTURE_PIPE_MODE "wb"
+#else
+#define CAPTURE_POPEN popen
+#define CAPTURE_PCLOSE pclose
+#define CAPTURE_PIPE_MODE "w"    // POSIX pipes have no text mode, and glibc rejects the 'b'
+#endif
+
+// Default capture values
+const int CAPTURE_BUFFERS = 6;              // pixel buffers in the ring: frames in flight on the GPU plus frames the writer holds
+const int CAPTURE_LATE_FRAMES = 3;          // a readback whose fence has not signalled this many frames later counts as late
+const int CAPTURE_DEFAULT_FPS = 60;         // frame rate written into the Y4M header
+
+
+// Records the backbuffer to a Y4M file, or pipes the same stream into an encoder when the path starts with '|'
+// (e.g. "|ffmpeg -i - walk.mp4"). Every frame is read with glReadPixels into the next pixel buffer object of a
+// ring, which only queues a copy on the GPU, and fenced. Later frames map the buffers whose fences have
+// signalled, oldest first, without waiting, and hand the mapped memory to a writer thread that converts it to
+// 4:2:0 YCbCr and writes it out; the render thread unmaps it once the writer is done. The render thread never
+// waits for the GPU or the disk: when no buffer is free the frame is dropped, and both dropped frames and
+// readbacks that took longer than CAPTURE_LATE_FRAMES frames are counted.
+// The size is fixed by the first frame; frames of another size (after a resize) are dropped.
+class FrameCapture
+{
+public:
+    FrameCapture() : output(NULL), piped(false), width(0), height(0), fps(CAPTURE_DEFAULT_FPS), head(0), tail(0), writing(0),
+        stopping(false), frameIndex(0), hasLastCall(false)
+    {
+        for (int i = 0; i < CAPTURE_BUFFERS; i++)
+        {
+            slots[i].buffer = 0;
+            slots[i].fence = 0;
+            slots[i].state.store(SLOT_FREE);
+        }
+        resetStats();
+    }
+
+    ~FrameCapture()
+    {
+        if (writer.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            writer.join();
+        }
+    }
+
+    bool active() const { return output != NULL; }
+
+    // opens the file or starts the encoder; the GL objects are created on the first frame
+    bool start(const char* path, int framesPerSecond = CAPTURE_DEFAULT_FPS)
+    {
+        piped = path[0] == '|';
+        output = piped ? CAPTURE_POPEN(path + 1, CAPTURE_PIPE_MODE) : fopen(path, "wb");
+        if (!output)
+        {
+            std::cout << "ERROR::CAPTURE:: could not open " << path << std::endl;
+            return false;
+        }
+        fps = framesPerSecond > 0 ? framesPerSecond : CAPTURE_DEFAULT_FPS;
+        stopping = false;
+        writer = std::thread([this]() { writerLoop(); });
+        return true;
+    }
+
+    // after the frame's last pass and before the swap: queue this frame's readback, map the ones that are done
+    void captureFrame(int frameWidth, int frameHeight)
+    {
+        if (!output)
+            return;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (hasLastCall)
+        {
+            frameNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(start - lastCall).count();
+            frameCount++;
+        }
+        lastCall = start;
+        hasLastCall = true;
+
+        if (width == 0)
+            createBuffers(frameWidth, frameHeight);
+        reclaim();
+        mapFinished(false);
+
+        Slot& slot = slots[head];
+        // 4:2:0 needs even sizes; the odd last row or column is left out
+        if ((frameWidth & ~1) != width || (frameHeight & ~1) != height || slot.state.load(std::memory_order_acquire) != SLOT_FREE)
+            dropped++;
+        else
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glReadBuffer(GL_BACK);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.frame = frameIndex;
+            slot.late = false;
+            slot.state.store(SLOT_READING, std::memory_order_relaxed);
+            head = (head + 1) % CAPTURE_BUFFERS;
+            captured++;
+        }
+        frameIndex++;
+
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        renderNs += ns;
+        maxRenderNs = std::max(maxRenderNs, ns);
+    }
+
+    // waits for every frame in flight, writes them and closes the output; call while the context is current
+    void stop()
+    {
+        if (!output)
+            return;
+        mapFinished(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+        reclaim();
+        for (int i = 0; i < CAPTURE_BUFFERS; i++)
+        {
+            if (slots[i].fence)
+                glDeleteSync(slots[i].fence);
+            slots[i].fence = 0;
+            slots[i].state.store(SLOT_FREE);
+        }
+        if (width > 0)
+        {
+            GLuint buffers[CAPTURE_BUFFERS];
+            for (int i = 0; i < CAPTURE_BUFFERS; i++)
+                buffers[i] = slots[i].buffer;
+            glDeleteBuffers(CAPTURE_BUFFERS, buffers);
+        }
+        if (piped)
+            CAPTURE_PCLOSE(output);
+        else
+            fclose(output);
+        output = NULL;
+        printStats();
+        std::cout << "CAPTURE:: " << written.load() << " frames of " << width << "x" << height << " written" << std::endl;
+        width = height = 0;
+    }
+
+    // render thread cost against the frame time, frames the writer has finished, dropped and late frames since the last call
+    void printStats()
+    {
+        if (frameIndex == 0)
+            return;
+        double frameMs = frameCount > 0 ? frameNs / 1.0e6 / frameCount : 0.0;
+        double calls = (double)(captured + dropped);
+        double renderMs = calls > 0 ? renderNs / 1.0e6 / calls : 0.0;
+        uint64_t writes = written.load() - writtenBefore;
+        std::cout << "CAPTURE:: " << captured << " frames read back, " << dropped << " dropped, " << late << " late; render thread mean/max "
+            << renderMs << "/" << maxRenderNs / 1.0e6 << " ms (" << (frameMs > 0.0 ? 100.0 * renderMs / frameMs : 0.0) << "% of the frame), writer "
+            << (writes > 0 ? writerNs.load() / 1.0e6 / writes : 0.0) << " ms/frame" << std::endl;
+        resetStats();
+    }
+
+    // converts a bottom-up RGBA8 image to the planes of a top-down 4:2:0 frame (BT.601, video range); width and
+    // height are even and yuv holds width * height * 3 / 2 bytes
+    static void rgbaToYuv420(const unsigned char* rgba, int width, int height, unsigned char* yuv)
+    {
+        unsigned char* yPlane = yuv;
+        unsigned char* uPlane = yuv + (size_t)width * height;
+        unsigned char* vPlane = uPlane + (size_t)width * height / 4;
+        for (int y = 0; y < height; y += 2)
+        {
+            // row y of the output is row height - 1 - y of the readback
+            const unsigned char* row0 = rgba + (size_t)(height - 1 - y) * width * 4;
+            const unsigned char* row1 = row0 - (size_t)width * 4;
+            unsigned char* y0 = yPlane + (size_t)y * width;
+            unsigned char* y1 = y0 + width;
+            unsigned char* u = uPlane + (size_t)(y / 2) * (width / 2);
+            unsigned char* v = vPlane + (size_t)(y / 2) * (width / 2);
+            for (int x = 0; x < width; x += 2)
+            {
+                const unsigned char* a = row0 + x * 4;
+                const unsigned char* b = row1 + x * 4;
+                y0[x] = luma(a[0], a[1], a[2]);
+                y0[x + 1] = luma(a[4], a[5], a[6]);
+                y1[x] = luma(b[0], b[1], b[2]);
+                y1[x + 1] = luma(b[4], b[5], b[6]);
+                int r = a[0] + a[4] + b[0] + b[4];
+                int g = a[1] + a[5] + b[1] + b[5];
+                int bl = a[2] + a[6] + b[2] + b[6];
+                // the four pixels' sum, so the chroma weights carry two more bits
+                u[x / 2] = (unsigned char)(((-38 * r - 74 * g + 112 * bl + 512) >> 10) + 128);
+                v[x / 2] = (unsigned char)(((112 * r - 94 * g - 18 * bl + 512) >> 10) + 128);
+            }
+        }
+    }
+
+private:
+    enum Slot_State {
+        SLOT_FREE,
+        SLOT_READING,       // glReadPixels queued, fence pending
+        SLOT_MAPPED,        // mapped, queued for the writer
+        SLOT_WRITTEN        // the writer is done; the render thread unmaps it
+    };
+
+    struct Slot
+    {
+        GLuint buffer;
+        GLsync fence;
+        const unsigned char* pixels;    // while mapped
+        uint64_t frame;
+        bool late;
+        std::atomic<int> state;
+    };
+
+    FILE* output;
+    bool piped;
+    int width, height, fps;
+    Slot slots[CAPTURE_BUFFERS];
+    int head;           // next slot to read into
+    int tail;           // oldest slot still being read
+    int writing;        // render thread: next slot to reclaim once written
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    uint64_t frameIndex;
+
+    // statistics since the last printStats
+    uint64_t captured, dropped, late, frameCount, frameNs, renderNs, maxRenderNs, writtenBefore;
+    std::atomic<uint64_t> written, writerNs;
+    std::chrono::steady_clock::time_point lastCall;
+    bool hasLastCall;
+
+    static unsigned char luma(int r, int g, int b)
+    {
+        return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    void resetStats()
+    {
+        captured = dropped = late = frameCount = frameNs = renderNs = maxRenderNs = 0;
+        writtenBefore = written.load();
+        writerNs.store(0);
+    }
+
+    void createBuffers(int frameWidth, int frameHeight)
+    {
+        width = frameWidth & ~1;
+        height = frameHeight & ~1;
+        GLuint buffers[CAPTURE_BUFFERS];
+        glGenBuffers(CAPTURE_BUFFERS, buffers);
+        for (int i = 0; i < CAPTURE_BUFFERS; i++)
+        {
+            slots[i].buffer = buffers[i];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        // the header goes out before the writer can see a frame
+        fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    // maps finished readbacks in order and hands them to the writer; with wait, blocks until all are done
+    void mapFinished(bool wait)
+    {
+        while (slots[tail].state.load(std::memory_order_relaxed) == SLOT_READING)
+        {
+            Slot& slot = slots[tail];
+            GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                if (wait)
+                    continue;
+                if (!slot.late && frameIndex - slot.frame >= (uint64_t)CAPTURE_LATE_FRAMES)
+                {
+                    slot.late = true;
+                    late++;
+                }
+                break;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            slot.pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4, GL_MAP_READ_BIT);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot.state.store(SLOT_MAPPED, std::memory_order_relaxed);
+            }
+            wake.notify_one();
+            tail = (tail + 1) % CAPTURE_BUFFERS;
+        }
+    }
+
+    // unmaps what the writer has finished, in ring order
+    void reclaim()
+    {
+        while (slots[writing].state.load(std::memory_order_acquire) == SLOT_WRITTEN)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[writing].buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slots[writing].pixels = NULL;
+            slots[writing].state.store(SLOT_FREE, std::memory_order_relaxed);
+            writing = (writing + 1) % CAPTURE_BUFFERS;
+        }
+    }
+
+    // writer thread: converts and writes mapped frames in ring order; never touches GL, only the mapped memory
+    void writerLoop()
+    {
+        std::vector<unsigned char> yuv;
+        int next = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, next]() { return stopping || slots[next].state.load(std::memory_order_relaxed) == SLOT_MAPPED; });
+                if (slots[next].state.load(std::memory_order_relaxed) != SLOT_MAPPED)
+                    return;
+            }
+            Slot& slot = slots[next];
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (slot.pixels)
+            {
+                yuv.resize((size_t)width * height * 3 / 2);
+                rgbaToYuv420(slot.pixels, width, height, &yuv[0]);
+                fputs("FRAME\n", output);
+                fwrite(&yuv[0], 1, yuv.size(), output);
+                written.fetch_add(1, std::memory_order_relaxed);
+            }
+            writerNs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+                std::memory_order_relaxed);
+            slot.state.store(SLOT_WRITTEN, std::memory_order_release);
+            next = (next + 1) % CAPTURE_BUFFERS;
+        }
+    }
+};
+#endif
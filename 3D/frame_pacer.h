@@ -0,0 +1,248 @@
+//
+//  frame_pacer.h
+//  3D Object Drawing
+//
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <mmsystem.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib")
+#endif
+#endif
+
+// Default frame pacing values
+const int PACER_SWAP_INTERVAL = 1;
+const int PACER_FRAMES_IN_FLIGHT = 2;
+const int PACER_MAX_FRAMES_IN_FLIGHT = 3;
+const double PACER_SPIN_MS = 2.0;                       // the limiter sleeps until this close to the deadline, then spins
+const GLuint64 PACER_FENCE_TIMEOUT_NS = 100000000;      // per glClientWaitSync call; it is called again until the fence signals
+
+// Where one frame's time went, in milliseconds
+struct FrameTimings
+{
+    double cpuMs;       // after the waits until the swap: input, culling, recording GL commands
+    double gpuMs;       // GPU execution; known once the frame's fence has signalled, so it lags by the frames in flight
+    double waitMs;      // limiter sleep plus waiting for the frames-in-flight fence
+    double presentMs;   // inside glfwSwapBuffers, which blocks there when vsync is on and the driver queue is full
+    double frameMs;     // from the previous swap to this one
+};
+
+
+// Paces the frame loop between three knobs:
+//  - SwapInterval goes to glfwSwapInterval (0 tears but adds no vsync wait, 1 waits for every vblank);
+//  - FramesInFlight (1-3) bounds how far the CPU may run ahead of the GPU: a fence goes in after every swap and
+//    beginFrame waits for the one from FramesInFlight frames ago, so the driver cannot queue up extra latency;
+//  - TargetFps, a limiter meant for a rate below refresh: it sleeps until shortly before the deadline and spins
+//    the rest, because OS sleeps overshoot by a millisecond or more.
+// The waits happen in beginFrame, before input and time are sampled, so the frame shows the freshest input.
+class FramePacer
+{
+public:
+    // set before init()
+    int SwapInterval;
+    int FramesInFlight;
+    // may change at any time; 0 turns the limiter off
+    double TargetFps;
+    FrameTimings Last;
+
+    FramePacer() : SwapInterval(PACER_SWAP_INTERVAL), FramesInFlight(PACER_FRAMES_IN_FLIGHT), TargetFps(0.0), frameIndex(0), frameOpen(false),
+        presented(false), statFrames(0)
+    {
+        Last = FrameTimings();
+        resetStats();
+        for (int i = 0; i < PACER_MAX_FRAMES_IN_FLIGHT; i++)
+            fences[i] = 0;
+    }
+
+    // after the context is current
+    void init()
+    {
+        FramesInFlight = std::max(1, std::min(FramesInFlight, PACER_MAX_FRAMES_IN_FLIGHT));
+        glfwSwapInterval(SwapInterval);
+        glGenQueries(PACER_MAX_FRAMES_IN_FLIGHT * 2, queries);
+#ifdef _WIN32
+        // 1 ms scheduler ticks, or the limiter's sleep would be rounded to 15.6 ms
+        timeBeginPeriod(1);
+#endif
+        int refresh = refreshRate();
+        std::cout << "PACER:: swap interval " << SwapInterval << ", " << FramesInFlight << " frames in flight, limit ";
+        if (TargetFps > 0.0)
+            std::cout << TargetFps << " fps";
+        else
+            std::cout << "off";
+        std::cout << ", display " << refresh << " Hz" << std::endl;
+        if (TargetFps > 0.0 && SwapInterval > 0 && refresh > 0 && TargetFps >= refresh / (double)SwapInterval)
+            std::cout << "PACER:: the limit is not below the vsync rate and will not take effect" << std::endl;
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        for (int i = 0; i < PACER_MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        glDeleteQueries(PACER_MAX_FRAMES_IN_FLIGHT * 2, queries);
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+    // top of the frame: the limiter, then the fence of the frame FramesInFlight back
+    void beginFrame()
+    {
+        Clock::time_point start = Clock::now();
+        if (TargetFps > 0.0)
+        {
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / TargetFps));
+            deadline += period;
+            // after a hitch start over instead of rushing out frames to catch up
+            if (deadline + period < start)
+                deadline = start;
+            waitUntil(deadline);
+        }
+
+        int slot = frameIndex % FramesInFlight;
+        if (fences[slot])
+        {
+            while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, PACER_FENCE_TIMEOUT_NS) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+            // the fence came after the frame's end timestamp, so both are available without stalling
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+            Last.gpuMs = end > begin ? (end - begin) / 1.0e6 : 0.0;
+            statGpu.add(Last.gpuMs);
+        }
+
+        cpuStart = Clock::now();
+        Last.waitMs = std::chrono::duration<double, std::milli>(cpuStart - start).count();
+        glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+        frameOpen = true;
+    }
+
+    // the loop decided not to draw after all (minimized, nothing changed); the next beginFrame starts over
+    void cancelFrame()
+    {
+        frameOpen = false;
+    }
+
+    // swaps and fences the frame
+    void endFrame(GLFWwindow* window)
+    {
+        if (!frameOpen)
+            return;
+        int slot = frameIndex % FramesInFlight;
+        glQueryCounter(queries[slot * 2 + 1], GL_TIMESTAMP);
+        Clock::time_point swapStart = Clock::now();
+        Last.cpuMs = std::chrono::duration<double, std::milli>(swapStart - cpuStart).count();
+        glfwSwapBuffers(window);
+        Clock::time_point swapEnd = Clock::now();
+        Last.presentMs = std::chrono::duration<double, std::milli>(swapEnd - swapStart).count();
+        Last.frameMs = presented ? std::chrono::duration<double, std::milli>(swapEnd - lastPresent).count() : 0.0;
+        lastPresent = swapEnd;
+        presented = true;
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frameIndex++;
+        frameOpen = false;
+
+        statFrames++;
+        statCpu.add(Last.cpuMs);
+        statWait.add(Last.waitMs);
+        statPresent.add(Last.presentMs);
+        if (Last.frameMs > 0.0)
+            statFrame.add(Last.frameMs);
+    }
+
+    // mean and worst of every timing since the last call
+    void printStats()
+    {
+        if (statFrames == 0)
+            return;
+        std::cout << "PACER:: " << statFrames << " frames, mean/max ms: cpu " << statCpu.mean() << "/" << statCpu.max << ", gpu " << statGpu.mean()
+            << "/" << statGpu.max << ", wait " << statWait.mean() << "/" << statWait.max << ", present " << statPresent.mean() << "/"
+            << statPresent.max << ", frame " << statFrame.mean() << "/" << statFrame.max << std::endl;
+        resetStats();
+    }
+
+    static int refreshRate()
+    {
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+        return mode ? mode->refreshRate : 0;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stat
+    {
+        double sum, max;
+        unsigned int count;
+
+        void add(double ms)
+        {
+            sum += ms;
+            max = std::max(max, ms);
+            count++;
+        }
+        double mean() const { return count ? sum / count : 0.0; }
+    };
+
+    GLsync fences[PACER_MAX_FRAMES_IN_FLIGHT];
+    GLuint queries[PACER_MAX_FRAMES_IN_FLIGHT * 2];     // begin and end timestamp per slot
+    unsigned int frameIndex;
+    bool frameOpen;
+    bool presented;
+    Clock::time_point deadline;
+    Clock::time_point cpuStart;
+    Clock::time_point lastPresent;
+    unsigned int statFrames;
+    Stat statCpu, statGpu, statWait, statPresent, statFrame;
+
+    void resetStats()
+    {
+        statFrames = 0;
+        Stat zero = { 0.0, 0.0, 0 };
+        statCpu = statGpu = statWait = statPresent = statFrame = zero;
+    }
+
+    static void waitUntil(Clock::time_point target)
+    {
+        const Clock::duration spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(PACER_SPIN_MS));
+        for (;;)
+        {
+            Clock::duration remaining = target - Clock::now();
+            if (remaining <= Clock::duration::zero())
+                return;
+            if (remaining > spin)
+                std::this_thread::sleep_for(remaining - spin);
+            else
+                std::this_thread::yield();
+        }
+    }
+};
+#endif
@@ -0,0 +1,181 @@
+//
+//  input_queue.h
+//  3D Object Drawing
+//
+
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// Kinds of window-system events recorded by the GLFW callbacks
+enum InputEventType {
+    KEY_EVENT,
+    CURSOR_EVENT,
+    SCROLL_EVENT
+};
+
+// A single window-system event together with the time it arrived
+struct InputEvent
+{
+    InputEventType type;
+    int key;
+    int action;
+    double x;
+    double y;
+    int64_t timestampNs;
+};
+
+// Default input queue values
+const unsigned int INPUT_QUEUE_SIZE = 1024;   // must be a power of two
+
+
+// monotonic time in nanoseconds, shared by event timestamps and latency measurement
+inline int64_t inputClockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Everything that happened since the previous frame, coalesced into one set of deltas
+struct FrameInput
+{
+    float cursorOffsetX;
+    float cursorOffsetY;
+    float scrollOffset;
+    int eventCount;
+    int64_t oldestEventNs;
+};
+
+// Single-producer/single-consumer lock-free ring buffer of timestamped input events.
+// The GLFW callbacks push, the frame loop drains once per frame just before the view matrix is built.
+class InputQueue
+{
+public:
+    unsigned int Dropped;
+
+    InputQueue() : Dropped(0), head(0), tail(0), firstCursor(true), lastCursorX(0.0), lastCursorY(0.0)
+    {
+        memset(keyDown, 0, sizeof(keyDown));
+    }
+
+    // producer side: never blocks, drops the event when the ring is full
+    bool push(InputEventType type, int key, int action, double x, double y)
+    {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= INPUT_QUEUE_SIZE)
+        {
+            Dropped++;
+            return false;
+        }
+        InputEvent& e = events[h & (INPUT_QUEUE_SIZE - 1)];
+        e.type = type;
+        e.key = key;
+        e.action = action;
+        e.x = x;
+        e.y = y;
+        e.timestampNs = inputClockNs();
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side: apply every queued event to the key state and sum cursor/scroll motion
+    FrameInput drain()
+    {
+        FrameInput frame = { 0.0f, 0.0f, 0.0f, 0, 0 };
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        unsigned int h = head.load(std::memory_order_acquire);
+        for (; t != h; t++)
+        {
+            const InputEvent& e = events[t & (INPUT_QUEUE_SIZE - 1)];
+            if (frame.eventCount == 0)
+                frame.oldestEventNs = e.timestampNs;
+            frame.eventCount++;
+
+            if (e.type == KEY_EVENT)
+            {
+                if (e.key >= 0 && e.key <= GLFW_KEY_LAST && e.action != GLFW_REPEAT)
+                    keyDown[e.key] = (e.action == GLFW_PRESS);
+            }
+            else if (e.type == CURSOR_EVENT)
+            {
+                if (firstCursor)
+                {
+                    lastCursorX = e.x;
+                    lastCursorY = e.y;
+                    firstCursor = false;
+                }
+                frame.cursorOffsetX += (float)(e.x - lastCursorX);
+                frame.cursorOffsetY += (float)(lastCursorY - e.y); // reversed since y-coordinates go from bottom to top
+                lastCursorX = e.x;
+                lastCursorY = e.y;
+            }
+            else
+                frame.scrollOffset += (float)e.y;
+        }
+        tail.store(t, std::memory_order_release);
+        return frame;
+    }
+
+    bool isKeyDown(int key) const
+    {
+        return keyDown[key];
+    }
+
+    bool anyKeyDown() const
+    {
+        for (int key = 0; key <= GLFW_KEY_LAST; key++)
+        {
+            if (keyDown[key])
+                return true;
+        }
+        return false;
+    }
+
+private:
+    InputEvent events[INPUT_QUEUE_SIZE];
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+    // consumer-only state
+    bool keyDown[GLFW_KEY_LAST + 1];
+    bool firstCursor;
+    double lastCursorX, lastCursorY;
+};
+
+// Measures how long input events wait between arriving in a callback and the frame that uses them being submitted
+class InputLatency
+{
+public:
+    double MeanMs;
+    double MaxMs;
+    unsigned int Frames;
+
+    InputLatency() : MeanMs(0.0), MaxMs(0.0), Frames(0), sumMs(0.0) {}
+
+    // call right after the frame's last GL command, before swapping
+    void recordSubmit(const FrameInput& frame)
+    {
+        if (frame.eventCount == 0)
+            return;
+        double ms = (inputClockNs() - frame.oldestEventNs) / 1.0e6;
+        sumMs += ms;
+        Frames++;
+        MeanMs = sumMs / Frames;
+        if (ms > MaxMs)
+            MaxMs = ms;
+    }
+
+    void reset()
+    {
+        MeanMs = MaxMs = sumMs = 0.0;
+        Frames = 0;
+    }
+
+private:
+    double sumMs;
+};
+#endif
@@ -11,24 +11,82 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "shader.h"
+#include "shader_variants.h"
 #include "camera.h"
 #include "basic_camera.h"
-
+#include "camera_component.h"
+#include "dynamic_resolution.h"
+#include "overdraw.h"
+#include "render_graph.h"
+#include "input_queue.h"
+#include "redraw_scheduler.h"
+#include "frame_pacer.h"
+#include "frame_capture.h"
+#include "multi_view.h"
+#include "world_partition.h"
+#include "sim_pipeline.h"
+#include "animation.h"
+#include "collision.h"
+#include "metrics.h"
+#include "thread_pool.h"
+#include "mesh_asset.h"
+#include "texture_array.h"
+#include "scene.h"
+#include "bedroom.h"
+#include "ceiling_fan.h"
+#include "scene_file.h"
+#include "scene_pack.h"
+#include "box_bake.h"
+#include "frame_arena.h"
+#include "soft_rasterizer.h"
+#include "ray_tracer.h"
+#include "render_service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h>     // _aligned_malloc
+#endif
 
 using namespace std;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow* window);
-void Fan(Shader ourShader, glm::mat4 moveMatrix);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void refresh_callback(GLFWwindow* window);
+void processInput(GLFWwindow* window, const FrameInput& frameInput, float dt);
+void drawSceneElements(GLsizei indexCount);
+int renderSoftware(const char* outputPath, Overdraw_Mode overdrawMode);
+int renderTraced(int samples, const char* outputPath);
+int serveRenders(const char* socketPath, int contexts, int metricsPort);
+void loadCpuScene(Scene& scene, const std::function<int(const MeshData&)>& addMesh);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const char* SCENE_PACK_PATH = "scene.pack";     // cooked by the cooker tool; used when present
+const char* SCENE_FILE_PATH = "bedroom.scene";  // text description, the next choice
+const int BENCH_WARMUP_FRAMES = 120;            // --bench: frames before the steady state is measured
+const int BENCH_FRAMES = 600;                   // --bench: measured frames
+const char* SOFT_FRAME_PATH = "soft_frame.ppm"; // --soft: where the CPU rendered frame goes
+const char* OVERDRAW_FRAME_PATH = "overdraw_frame.ppm";     // --soft --overdraw: where the fragment count heatmap goes
+const char* TRACE_FRAME_PATH = "traced_frame.ppm";  // --trace: where the ray traced still goes
+const int TRACE_DEFAULT_SAMPLES = 64;           // --trace: accumulated samples per pixel
+const float FAN_DEGREES_PER_LEVEL = 60.0f;      // fan speed per press of X, in degrees per second
+const float CAMERA_RADIUS = 0.2f;               // the fly camera's collision sphere
+int scrWidth = SCR_WIDTH;      // current framebuffer size, updated on resize
+int scrHeight = SCR_HEIGHT;
 
 // modelling transform
 float rotateAngle_X = 45.0;
@@ -44,31 +102,256 @@ float scale_X = 1.0;
 float scale_Y = 1.0;
 float scale_Z = 1.0;
 float rotateLevel = 0.0;
-float rotate_Now = 0.0;
+float rotate_Now = 0.0;         // the fan channel's angle, wrapped to [0, 360)
 
 // camera
 Camera camera(glm::vec3(1.5f, 0.0f, 3.0f));
-float lastX = SCR_WIDTH / 2.0f;
-float lastY = SCR_HEIGHT / 2.0f;
-bool firstMouse = true;
+// the scene's boxes, which the fly camera slides along instead of passing through; --noclip turns that off
+CollisionWorld collision;
+bool cameraCollision = true;
+
+// input events recorded by the glfw callbacks, applied once per frame
+InputQueue inputQueue;
+InputLatency inputLatency;
+
+// decides which loop iterations draw; in on-demand mode only those where something changed
+RedrawScheduler redraw;
+
+// what --metrics serves; each is looked up once and then costs an atomic add or store per update
+MetricCounter& framesMetric = metricsRegistry().counter("frames_total", "Frames presented");
+MetricCounter& drawCallsMetric = metricsRegistry().counter("draw_calls_total", "Draw calls of the scene pass, one per view set");
+MetricHistogram& frameTimeMetric = metricsRegistry().histogram("frame_time_seconds", "Time from one present to the next");
+MetricHistogram& frameCpuMetric = metricsRegistry().histogram("frame_cpu_seconds", "CPU time from the end of the pacer waits to the swap");
+MetricHistogram& frameGpuMetric = metricsRegistry().histogram("frame_gpu_seconds", "GPU time of a frame, a few frames late");
+MetricGauge& nodesDrawnMetric = metricsRegistry().gauge("scene_nodes_drawn", "Scene nodes that passed culling last frame");
+MetricGauge& renderScaleMetric = metricsRegistry().gauge("render_scale", "Dynamic resolution scale of the scene pass");
+MetricGauge& frameArenaMetric = metricsRegistry().gauge("frame_arena_peak_bytes", "Most frame arena memory one frame has used");
+MetricGauge& worldCpuMetric = metricsRegistry().gauge("world_resident_cpu_bytes", "CPU memory of the resident world cells");
+MetricGauge& worldGpuMetric = metricsRegistry().gauge("world_resident_gpu_bytes", "GPU memory of the resident world cells");
+MetricGauge& overdrawRatioMetric = metricsRegistry().gauge("overdraw_fragments_per_pixel", "Fragments per covered pixel in the overdraw view");
+MetricGauge& overdrawMaxMetric = metricsRegistry().gauge("overdraw_max_fragments", "Most fragments any one pixel got in the overdraw view");
 
 float eyeX = 0.0, eyeY = 1.0, eyeZ = 3.0;
 float lookAtX = 0.0, lookAtY = 0.0, lookAtZ = 0.0;
 glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f);
 BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
 
+// the camera used for rendering; either control scheme above drives it
+CameraComponent viewCamera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), CAMERA_FOV, (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+// --multi-view: the fly camera on the left half, the look-at camera top right and an overhead map bottom right,
+// all drawn by the same pass
+CameraComponent basicViewCamera(glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), CAMERA_FOV, 1.0f, 0.1f, 100.0f);
+CameraComponent mapCamera;
+MultiView multiView;
+int sceneInstances = 1;    // instances per scene draw: one per view while the multi-view shader is in use
+
+// What the simulation thread hands the renderer for one tick: both cameras' poses and the fan's angle.
+// The simulation owns the control schemes and the animation globals above; the renderer only sees these.
+struct SimState
+{
+    glm::vec3 flyPosition;
+    glm::quat flyOrientation;
+    float flyFov;
+    glm::vec3 lookPosition;     // the look-at camera
+    glm::quat lookOrientation;
+    float fanAngle;             // degrees
+};
+
+struct SimFrame
+{
+    SimState previous, current;             // the renderer blends from one to the other over the following tick
+    double tickTime;
+    unsigned int changes;                   // Redraw_Reason bits
+    FrameInput input;                       // what the tick consumed, for the latency measurement
+    std::vector<const SceneNode*> drawList; // the fly camera's culling, against the frusta of both poses
+};
+
+// the pose between two ticks; angles take the short way round
+SimState blendSimState(const SimState& a, const SimState& b, float t)
+{
+    float fanStep = b.fanAngle - a.fanAngle;
+    if (fanStep > 180.0f)
+        fanStep -= 360.0f;
+    else if (fanStep < -180.0f)
+        fanStep += 360.0f;
+    SimState state;
+    state.flyPosition = glm::mix(a.flyPosition, b.flyPosition, t);
+    state.flyOrientation = glm::slerp(a.flyOrientation, b.flyOrientation, t);
+    state.flyFov = a.flyFov + (b.flyFov - a.flyFov) * t;
+    state.lookPosition = glm::mix(a.lookPosition, b.lookPosition, t);
+    state.lookOrientation = glm::slerp(a.lookOrientation, b.lookOrientation, t);
+    state.fanAngle = a.fanAngle + fanStep * t;
+    return state;
+}
+
+bool sameSimState(const SimState& a, const SimState& b)
+{
+    return a.flyPosition == b.flyPosition && a.flyOrientation == b.flyOrientation && a.flyFov == b.flyFov && a.lookPosition == b.lookPosition
+        && a.lookOrientation == b.lookOrientation && a.fanAngle == b.fanAngle;
+}
+
+// the fan's angle as of the frame being drawn
+float fanAngle = 0.0f;
+
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
 
-int main()
+// transient data of the current frame (draw lists, culling results); rewound at the end of every frame
+FrameArena frameArena;
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// heap allocation hook: every operator new bumps the calling thread's counter, which --bench uses to prove
+// the render loop does not allocate once it has warmed up. Debug builds only, or with COUNT_HEAP_ALLOCATIONS
+// defined; the nothrow forms are not replaced and are not counted.
+void* operator new(std::size_t size)
+{
+    threadHeapAllocations()++;
+    void* memory = malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept
+{
+    free(memory);
+}
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    free(memory);
+}
+#ifdef __cpp_aligned_new
+// over-aligned types (alignas above the default new alignment) come here from C++17 on
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    threadHeapAllocations()++;
+    std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+    void* memory = NULL;
+    if (posix_memalign(&memory, align, size ? size : 1) != 0)
+        memory = NULL;
+#endif
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(memory, alignment);
+}
+#endif
+#endif
+
+int main(int argc, char** argv)
 {
+    // --bench: hidden window, scripted camera, fixed frame count; fails if the steady state touches the heap, in
+    // builds that count allocations (COUNT_HEAP_ALLOCATIONS)
+    bool benchMode = argc > 1 && strcmp(argv[1], "--bench") == 0;
+    // --on-demand: draw only when input, the window, an animation or streaming changed the picture; sleep otherwise
+    // --swap-interval n, --frames-in-flight n (1-3), --fps n: frame pacing, see frame_pacer.h
+    // --multi-view: both cameras and a map side by side in one pass, see multi_view.h
+    // --world n: an n x n grid of rooms streamed around the camera under a memory budget, see world_partition.h
+    // --serial-sim: run the simulation ticks on the render thread instead of their own, see sim_pipeline.h
+    // --noclip: the fly camera passes through walls and furniture, see collision.h
+    // --metrics [port]: serve live counters to a Prometheus scraper on 127.0.0.1:port/metrics, see metrics.h
+    // --overdraw [rasterized]: a heatmap of fragments per pixel instead of the scene, with statistics; see overdraw.h
+    // --capture file [fps]: record every frame to a Y4M file, or into an encoder for "|command"; see frame_capture.h
+    // --stats: print frame, streaming and pacing statistics every 2 seconds and redraw statistics every 10; --metrics
+    // serves the same counters
+    // --lit: shade the scene with a fixed directional light instead of flat colors; see fragmentShader.fs
+    // --bake: drop the buried faces of the static boxes and merge coplanar ones into a few meshes; see box_bake.h
+    FramePacer framePacer;
+    int worldRooms = 0;
+    bool serialSim = false;
+    bool bakeScene = false;
+    bool statsReport = false;
+    bool litScene = false;
+    int metricsPort = 0;
+    Overdraw_Mode overdrawMode = OVERDRAW_OFF;
+    const char* capturePath = NULL;
+    int captureFps = CAPTURE_DEFAULT_FPS;
+    for (int i = 1; i < argc; i++)
+    {
+        redraw.OnDemand = redraw.OnDemand || (!benchMode && strcmp(argv[i], "--on-demand") == 0);
+        multiView.Enabled = multiView.Enabled || (!benchMode && strcmp(argv[i], "--multi-view") == 0);
+        serialSim = serialSim || strcmp(argv[i], "--serial-sim") == 0;
+        bakeScene = bakeScene || strcmp(argv[i], "--bake") == 0;
+        statsReport = statsReport || (!benchMode && strcmp(argv[i], "--stats") == 0);
+        litScene = litScene || strcmp(argv[i], "--lit") == 0;
+        cameraCollision = cameraCollision && strcmp(argv[i], "--noclip") != 0;
+        if (i + 1 < argc && strcmp(argv[i], "--swap-interval") == 0)
+            framePacer.SwapInterval = atoi(argv[i + 1]);
+        else if (i + 1 < argc && strcmp(argv[i], "--frames-in-flight") == 0)
+            framePacer.FramesInFlight = atoi(argv[i + 1]);
+        else if (i + 1 < argc && strcmp(argv[i], "--fps") == 0)
+            framePacer.TargetFps = atof(argv[i + 1]);
+        else if (i + 1 < argc && !benchMode && strcmp(argv[i], "--world") == 0)
+            worldRooms = std::max(0, atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--metrics") == 0)
+            metricsPort = i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1]) : METRICS_PORT;
+        else if (strcmp(argv[i], "--overdraw") == 0)
+            overdrawMode = i + 1 < argc && strcmp(argv[i + 1], "rasterized") == 0 ? OVERDRAW_RASTERIZED : OVERDRAW_SHADED;
+        else if (i + 1 < argc && strcmp(argv[i], "--capture") == 0)
+        {
+            capturePath = argv[i + 1];
+            if (i + 2 < argc && atoi(argv[i + 2]) > 0)
+                captureFps = atoi(argv[i + 2]);
+        }
+    }
+    // --soft [file]: no window and no GPU; the CPU rasterizer draws one frame into a PPM file, with --overdraw
+    // also its fragment counts
+    if (argc > 1 && strcmp(argv[1], "--soft") == 0)
+        return renderSoftware(argc > 2 && argv[2][0] != '-' ? argv[2] : SOFT_FRAME_PATH, overdrawMode);
+    // --trace [samples] [file]: no window and no GPU; the CPU ray tracer accumulates a still into a PPM file
+    if (argc > 1 && strcmp(argv[1], "--trace") == 0)
+        return renderTraced(argc > 2 ? atoi(argv[2]) : TRACE_DEFAULT_SAMPLES, argc > 3 ? argv[3] : TRACE_FRAME_PATH);
+    // --serve [socket] [contexts]: no window and no GPU; renders batches of views for clients on a local socket
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0)
+        return serveRenders(argc > 2 && argv[2][0] != '-' ? argv[2] : SERVICE_SOCKET_PATH, argc > 3 ? atoi(argv[3]) : 0, metricsPort);
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (benchMode)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -87,9 +370,12 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
 
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchMode)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -105,7 +391,129 @@ int main()
 
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader ourShader("vertexShader.vs", "fragmentShader.fs");
+    // the scene's permutation less MULTIVIEW is built before the first frame, so the picture looks the same from
+    // the start; it draws only the fly camera's view until the multi-view permutation has linked in the background
+    ShaderVariants shaderVariants("vertexShader.vs", "fragmentShader.fs");
+    shaderVariants.enableParallelCompile((GLADloadproc)glfwGetProcAddress);
+    const unsigned int SCENE_SHADER = SHADER_TEXTURED | (litScene ? SHADER_LIT : 0) | (multiView.Enabled ? SHADER_MULTIVIEW : 0);
+    const Shader& ourShader = shaderVariants.build(SCENE_SHADER & ~SHADER_MULTIVIEW);
+    // world cells are drawn one instanced call per cell
+    const unsigned int WORLD_SHADER = SCENE_SHADER | SHADER_INSTANCED;
+    const unsigned int sceneShaders[] = { SCENE_SHADER, WORLD_SHADER };
+    shaderVariants.request(sceneShaders, worldRooms > 0 ? 2 : 1);
+    // the overdraw view draws the same geometry with variants that only count fragments
+    const unsigned int overdrawShaders[] = { SCENE_SHADER | SHADER_OVERDRAW, WORLD_SHADER | SHADER_OVERDRAW };
+    if (overdrawMode != OVERDRAW_OFF)
+        shaderVariants.request(overdrawShaders, worldRooms > 0 ? 2 : 1);
+    unsigned int activeProgram = 0;
+
+    // offscreen scene target whose resolution follows the GPU frame time budget
+    // -------------------------------------------------------------------------
+    glfwGetFramebufferSize(window, &scrWidth, &scrHeight);
+    DynamicResolution dynamicResolution("blitShader.vs", "blitShader.fs", FRAME_BUDGET_MS);
+    OverdrawView overdraw("blitShader.vs", "overdrawHeatmap.fs");
+    overdraw.Mode = overdrawMode;
+    float lastReport = 0.0f;
+
+    // furniture models are parsed on worker threads and streamed to the GPU; until then their nodes draw the cube
+    // --------------------------------------------------------------------------------------------------------------
+    ThreadPool workerPool;
+    AssetManager assets(workerPool);
+    // compressed textures share a few arrays that stay bound; low mips arrive first, detail streams in under a VRAM budget
+    TextureArrayManager textures(workerPool);
+    std::function<int(const char*)> requestMesh = [&assets](const char* path) { return assets.requestMesh(path); };
+    std::function<int(const char*)> requestTexture = [&textures](const char* path) { return textures.requestTexture(path); };
+    Scene scene;
+    // every cell of the world is a bedroom, built on a worker when the camera comes near
+    WorldPartition world(workerPool, worldRooms, worldRooms, [](int cellX, int cellZ, Scene& cell)
+    {
+        glm::vec3 center((cellX + 0.5f) * WORLD_CELL_SIZE, 0.0f, (cellZ + 0.5f) * WORLD_CELL_SIZE);
+        buildBedroom(cell, std::function<int(const char*)>(), std::function<int(const char*)>(), glm::translate(glm::mat4(1.0f), center));
+    });
+
+    // the scene comes from the cooked pack if there is one: nodes are taken from the mapped table and meshes go
+    // to glBufferData straight from the mapping. Otherwise the text description, otherwise the built-in bedroom.
+    // A streamed world replaces all of them.
+    // ------------------------------------------------------------------------------------------------------------
+    float loadStart = static_cast<float>(glfwGetTime());
+    ScenePack pack;
+    std::string sceneError;
+    if (worldRooms > 0)
+        world.init();
+    else if (pack.open(SCENE_PACK_PATH, sceneError))
+    {
+        std::vector<int> meshHandles(pack.meshCount());
+        for (size_t i = 0; i < pack.meshCount(); i++)
+        {
+            const PackMesh& mesh = pack.meshes()[i];
+            meshHandles[i] = assets.addMesh(pack.meshName(mesh), pack.meshVertices(mesh), mesh.vertexCount, pack.meshIndices(mesh), mesh.indexCount);
+        }
+        std::vector<int> textureHandles(pack.textureCount());
+        for (size_t i = 0; i < pack.textureCount(); i++)
+            textureHandles[i] = textures.requestTexture(pack.texturePath(i));
+        const PackNode* packNodes = pack.nodes();
+        scene.nodes.resize(pack.nodeCount());
+        for (size_t i = 0; i < pack.nodeCount(); i++)
+        {
+            SceneNode& node = scene.nodes[i];
+            node.model = glm::make_mat4(packNodes[i].model);
+            node.color = glm::make_vec3(packNodes[i].color);
+            node.mesh = packNodes[i].mesh == CUBE_MESH ? CUBE_MESH : meshHandles[packNodes[i].mesh];
+            node.texture = packNodes[i].texture < 0 ? NO_TEXTURE : textureHandles[packNodes[i].texture];
+            computeNodeBounds(node);
+        }
+        std::cout << "SCENE::PACK " << SCENE_PACK_PATH << ": " << pack.nodeCount() << " nodes, " << pack.meshCount() << " meshes, "
+            << pack.fileSize() / 1024 << " KiB in " << (static_cast<float>(glfwGetTime()) - loadStart) * 1000.0f << " ms" << std::endl;
+        pack.close();
+    }
+    else
+    {
+        if (sceneError != "file not found")
+            std::cout << "ERROR::SCENE:: " << SCENE_PACK_PATH << ": " << sceneError << std::endl;
+        if (!loadSceneFile(SCENE_FILE_PATH, scene, requestMesh, requestTexture, sceneError))
+        {
+            if (sceneError != "file not found")
+                std::cout << "ERROR::SCENE:: " << SCENE_FILE_PATH << ": " << sceneError << std::endl;
+            scene.nodes.clear();
+            buildBedroom(scene, requestMesh, requestTexture);
+        }
+    }
+
+    if (cameraCollision)
+        collision.addScene(scene);
+    // after collision, which needs every node as its box; a streamed world loads its rooms later and is not baked
+    if (bakeScene && worldRooms == 0)
+    {
+        int bakedMeshes = 0;
+        BoxBakeStats bakeStats = bakeBoxes(scene, [&assets, &bakedMeshes](const MeshData& mesh)
+        {
+            std::string name = "baked boxes " + std::to_string(bakedMeshes++);
+            return assets.addMesh(name.c_str(), &mesh.vertices[0], mesh.vertexCount(), &mesh.indices[0], (unsigned int)mesh.indices.size());
+        });
+        bakeStats.print(std::cout);
+    }
+
+    // the map looks straight down on the whole scene, north up
+    if (multiView.Enabled)
+    {
+        glm::vec3 sceneMin(-1.0f), sceneMax(1.0f);
+        for (size_t i = 0; i < scene.nodes.size(); i++)
+        {
+            sceneMin = glm::min(sceneMin, scene.nodes[i].boundsMin);
+            sceneMax = glm::max(sceneMax, scene.nodes[i].boundsMax);
+        }
+        glm::vec3 center = 0.5f * (sceneMin + sceneMax);
+        glm::vec3 extent = sceneMax - sceneMin;
+        mapCamera.SetLookAt(glm::vec3(center.x, sceneMax.y + 1.0f, center.z), center, glm::vec3(0.0f, 0.0f, -1.0f));
+        mapCamera.SetOrthographic(std::max(extent.x, extent.z) * 1.1f, 1.0f, 0.1f, extent.y + 2.0f);
+        multiView.addView(&viewCamera, 0.0f, 0.0f, 0.5f, 1.0f);
+        multiView.addView(&basicViewCamera, 0.5f, 0.5f, 0.5f, 0.5f);
+        multiView.addView(&mapCamera, 0.5f, 0.0f, 0.5f, 0.5f);
+    }
+    unsigned int uploadedCameraVersion = 0;
+    int frameCount = 0;
+    size_t steadyAllocations = 0;
+    float benchStart = 0.0f;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -129,56 +537,6 @@ int main()
         0.5f, 0.5f, 0.5f,
         0.0f, 0.5f, 0.5f
     };*/
-    float cube_vertices[] = {
-        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
-
-        0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f,
-
-        0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
-
-        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-
-        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f,
-
-        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f
-    };
-    unsigned int cube_indices[] = {
-        0, 3, 2,
-        2, 1, 0,
-
-        4, 5, 7,
-        7, 6, 4,
-
-        8, 9, 10,
-        10, 11, 8,
-
-        12, 13, 14,
-        14, 15, 12,
-
-        16, 17, 18,
-        18, 19, 16,
-
-        20, 21, 22,
-        22, 23, 20
-    };
     /*unsigned int cube_indices[] = {
         0, 3, 2,
         2, 1, 0,
@@ -262,23 +620,27 @@ int main()
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES, GL_STATIC_DRAW);
 
     // position attribute
    // glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     //glEnableVertexAttribArray(0);
 
     // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
     glEnableVertexAttribArray(1);
 
+    // texture coordinate attribute
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)24);
+    glEnableVertexAttribArray(2);
+
 
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -286,38 +648,48 @@ int main()
 
     //ourShader.use();
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+    // the benchmark measures throughput, so no vsync and no limiter
+    if (benchMode)
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        // render
-        // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        // activate shader
-        ourShader.use();
-
-        // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection);
+        framePacer.SwapInterval = 0;
+        framePacer.TargetFps = 0.0;
+    }
+    framePacer.init();
+
+    // the frame as a render graph: the scene pass draws into a window sized target that dynamic resolution
+    // only partly covers, the upscale pass blits it to the window. Further passes declare what they read and
+    // write here and the graph orders them, culls the unused ones and shares target memory between them.
+    // ---------------------------------------------------------------------------------------------------------
+    RenderGraph renderGraph;
+    const int sceneColor = renderGraph.createTarget("sceneColor", RenderTargetDesc::windowSized(GL_RGBA8));
+    const int sceneDepth = renderGraph.createTarget("sceneDepth", RenderTargetDesc::windowSized(GL_DEPTH24_STENCIL8));
+    // filled by the frame loop before the graph runs
+    const Shader* sceneShader = &ourShader;
+    const Shader* worldShader = NULL;
+    const SceneNode* const* drawList = NULL;
+    size_t drawCount = 0;
+    std::function<bool(const glm::vec3&, const glm::vec3&)> worldVisible = [](const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        return sceneInstances > 1 ? multiView.isBoxVisible(boxMin, boxMax) : viewCamera.IsBoxVisible(boxMin, boxMax);
+    };
 
-        // camera/view transformation
-        glm::mat4 view = camera.GetViewMatrix();
-        //glm::mat4 view = basic_camera.createViewMatrix();
-        ourShader.setMat4("view", view);
+    // everything in the scene, with sceneShader and worldShader; the scene pass and the overdraw pass both draw it
+    std::function<void()> drawScene = [&]()
+    {
+        // activate shader; the camera uniforms go up only when the camera or the program changed
+        sceneShader->use();
+        if (sceneInstances > 1)
+        {
+            multiView.setUniforms(*sceneShader);
+            multiView.beginPass();
+        }
+        else if (viewCamera.GetVersion() != uploadedCameraVersion)
+        {
+            //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
+            sceneShader->setMat4("projection", viewCamera.GetProjectionMatrix());
+            sceneShader->setMat4("view", viewCamera.GetViewMatrix());
+            uploadedCameraVersion = viewCamera.GetVersion();
+        }
 
         // Modelling Transformation
         /*
@@ -333,445 +705,63 @@ int main()
         */
         //ourShader.setVec3("aColor", glm::vec3(0.2f, 0.1f, 0.4f));
 
-        //khat o 2ta pillow
-        glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-        glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model;
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(0.5, -0.85, -1.0));
-        rotateXMatrix = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(2.0, 3.0, 0.5));
-        model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-        glm::mat4 translateMatrix2, rotateXMatrix2, rotateYMatrix2, rotateZMatrix2, scaleMatrix2, model2;
-        translateMatrix2 = glm::translate(identityMatrix, glm::vec3(1.05, -0.7, -1.0));
-        rotateXMatrix2 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix2 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix2 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix2 = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 0.5));
-        model2 = translateMatrix2 * rotateXMatrix2 * rotateYMatrix2 * rotateZMatrix2 * scaleMatrix2;
-        ourShader.setMat4("model", model2);
+        // static furniture; nodes whose model is still loading draw the cube in its place
+        for (size_t i = 0; i < drawCount; i++)
+        {
+            const SceneNode& node = *drawList[i];
+            sceneShader->setMat4("model", node.model);
+            sceneShader->setVec3("COLOR", node.color);
+            // selecting a texture is a unit, a layer and a LOD clamp; nothing gets bound
+            TextureBinding binding;
+            if (node.texture != NO_TEXTURE && textures.binding(node.texture, binding))
+            {
+                sceneShader->setInt("textureArray", binding.unit);
+                sceneShader->setFloat("textureLayer", binding.layer);
+                sceneShader->setFloat("textureMinLod", binding.minLod);
+            }
+            else
+                sceneShader->setFloat("textureLayer", -1.0f);
+            if (node.mesh != CUBE_MESH && assets.isResident(node.mesh))
+            {
+                const MeshAsset& mesh = assets.mesh(node.mesh);
+                glBindVertexArray(mesh.VAO);
+                drawSceneElements(mesh.indexCount);
+            }
+            else
+            {
+                glBindVertexArray(VAO);
+                drawSceneElements(36);
+            }
+        }
+
+        // streamed world cells, one instanced draw each; the instanced program needs its own camera uniforms
+        if (worldShader)
+        {
+            worldShader->use();
+            if (sceneInstances > 1)
+                multiView.setUniforms(*worldShader);
+            else
+            {
+                worldShader->setMat4("projection", viewCamera.GetProjectionMatrix());
+                worldShader->setMat4("view", viewCamera.GetViewMatrix());
+            }
+            world.draw(*worldShader, sceneInstances, worldVisible);
+            sceneShader->use();
+        }
         glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.6f, 0.8f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix3, rotateXMatrix3, rotateYMatrix3, rotateZMatrix3, scaleMatrix3, model3;
-        translateMatrix3 = glm::translate(identityMatrix, glm::vec3(0.58, -0.7, -1.0));
-        rotateXMatrix3 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix3 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix3 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix3 = glm::scale(identityMatrix, glm::vec3(0.8, 0.5, 0.5));
-        model3 = translateMatrix3 * rotateXMatrix3 * rotateYMatrix3 * rotateZMatrix3 * scaleMatrix3;
-        ourShader.setMat4("model", model3);
-
-        glBindVertexArray(VAO);
-        //ourShader.setVec3("COLOR", glm::vec3(0.48f, 0.35f, 0.0f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //almira
-
-        glm::mat4 translateMatrix4, rotateXMatrix4, rotateYMatrix4, rotateZMatrix4, scaleMatrix4, model4;
-        translateMatrix4 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.9, -1.0));
-        rotateXMatrix4 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix4 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix4 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix4 = glm::scale(identityMatrix, glm::vec3(0.2, 2.0, 4.0));
-        model4 = translateMatrix4 * rotateXMatrix4 * rotateYMatrix4 * rotateZMatrix4 * scaleMatrix4;
-        ourShader.setMat4("model", model4);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix19, rotateXMatrix19, rotateYMatrix19, rotateZMatrix19, scaleMatrix19, model19;
-        translateMatrix19 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.9, -1.0));
-        rotateXMatrix19 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix19 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix19 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix19 = glm::scale(identityMatrix, glm::vec3(1.0, 2.0, 0.2));
-        model19 = translateMatrix19 * rotateXMatrix19 * rotateYMatrix19 * rotateZMatrix19 * scaleMatrix19;
-        ourShader.setMat4("model", model19);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix20, rotateXMatrix20, rotateYMatrix20, rotateZMatrix20, scaleMatrix20, model20;
-        translateMatrix20 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.5, -1.0));
-        rotateXMatrix20 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix20 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix20 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix20 = glm::scale(identityMatrix, glm::vec3(1.0, 2.0, 0.2));
-        model20 = translateMatrix20 * rotateXMatrix20 * rotateYMatrix20 * rotateZMatrix20 * scaleMatrix20;
-        ourShader.setMat4("model", model20);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix21, rotateXMatrix21, rotateYMatrix21, rotateZMatrix21, scaleMatrix21, model21;
-        translateMatrix21 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.05, -1.0));
-        rotateXMatrix21 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix21 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix21 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix21 = glm::scale(identityMatrix, glm::vec3(1.0, 2.0, 0.2));
-        model21 = translateMatrix21 * rotateXMatrix21 * rotateYMatrix21 * rotateZMatrix21 * scaleMatrix21;
-        ourShader.setMat4("model", model21);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix22, rotateXMatrix22, rotateYMatrix22, rotateZMatrix22, scaleMatrix22, model22;
-        translateMatrix22 = glm::translate(identityMatrix, glm::vec3(-1.9, -0.45, -1.0));
-        rotateXMatrix22 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix22 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix22 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix22 = glm::scale(identityMatrix, glm::vec3(1.0, 2.0, 0.2));
-        model22 = translateMatrix22 * rotateXMatrix22 * rotateYMatrix22 * rotateZMatrix22 * scaleMatrix22;
-        ourShader.setMat4("model", model22);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix23, rotateXMatrix23, rotateYMatrix23, rotateZMatrix23, scaleMatrix23, model23;
-        translateMatrix23 = glm::translate(identityMatrix, glm::vec3(-1.9, -0.9, -1.0));
-        rotateXMatrix23 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix23 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix23 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix23 = glm::scale(identityMatrix, glm::vec3(1.0, 2.0, 0.2));
-        model23 = translateMatrix23 * rotateXMatrix23 * rotateYMatrix23 * rotateZMatrix23 * scaleMatrix23;
-        ourShader.setMat4("model", model23);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix24, rotateXMatrix24, rotateYMatrix24, rotateZMatrix24, scaleMatrix24, model24;
-        translateMatrix24 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.9, -1.0));
-        rotateXMatrix24 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix24 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix24 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix24 = glm::scale(identityMatrix, glm::vec3(1.0, 0.2, 4.0));
-        model24 = translateMatrix24 * rotateXMatrix24 * rotateYMatrix24 * rotateZMatrix24 * scaleMatrix24;
-        ourShader.setMat4("model", model24);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix25, rotateXMatrix25, rotateYMatrix25, rotateZMatrix25, scaleMatrix25, model25;
-        translateMatrix25 = glm::translate(identityMatrix, glm::vec3(-1.9, 0.9, 0.0));
-        rotateXMatrix25 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix25 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix25 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix25 = glm::scale(identityMatrix, glm::vec3(1.0, 0.2, 4.0));
-        model25 = translateMatrix25 * rotateXMatrix25 * rotateYMatrix25 * rotateZMatrix25 * scaleMatrix25;
-        ourShader.setMat4("model", model25);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.2f, 0.4f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-       
-        //table o 4ta pa
-
-        glm::mat4 translateMatrix5, rotateXMatrix5, rotateYMatrix5, rotateZMatrix5, scaleMatrix5, model5;
-        translateMatrix5 = glm::translate(identityMatrix, glm::vec3(-1.9, -0.1, 1.0));
-        rotateXMatrix5 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix5 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix5 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix5 = glm::scale(identityMatrix, glm::vec3(1.2, 2.0, 0.2));
-        model5 = translateMatrix5 * rotateXMatrix5 * rotateYMatrix5 * rotateZMatrix5 * scaleMatrix5;
-        ourShader.setMat4("model", model5);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.6f, 0.35f, 0.2f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix6, rotateXMatrix6, rotateYMatrix6, rotateZMatrix6, scaleMatrix6, model6;
-        translateMatrix6 = glm::translate(identityMatrix, glm::vec3(-1.8, -0.1, 1.0));
-        rotateXMatrix6 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix6 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix6 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix6 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model6 = translateMatrix6 * rotateXMatrix6 * rotateYMatrix6 * rotateZMatrix6 * scaleMatrix6;
-        ourShader.setMat4("model", model6);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix7, rotateXMatrix7, rotateYMatrix7, rotateZMatrix7, scaleMatrix7, model7;
-        translateMatrix7 = glm::translate(identityMatrix, glm::vec3(-1.4, -0.1, 1.0));
-        rotateXMatrix7 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix7 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix7 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix7 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model7 = translateMatrix7 * rotateXMatrix7 * rotateYMatrix7 * rotateZMatrix7 * scaleMatrix7;
-        ourShader.setMat4("model", model7);
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix8, rotateXMatrix8, rotateYMatrix8, rotateZMatrix8, scaleMatrix8, model8;
-        translateMatrix8 = glm::translate(identityMatrix, glm::vec3(-1.8, -0.1, 1.9));
-        rotateXMatrix8 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix8 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix8 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix8 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model8 = translateMatrix8 * rotateXMatrix8 * rotateYMatrix8 * rotateZMatrix8 * scaleMatrix8;
-        ourShader.setMat4("model", model8);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix9, rotateXMatrix9, rotateYMatrix9, rotateZMatrix9, scaleMatrix9, model9;
-        translateMatrix9 = glm::translate(identityMatrix, glm::vec3(-1.4, -0.1, 1.9));
-        rotateXMatrix9 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix9 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix9 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix9 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model9 = translateMatrix9 * rotateXMatrix9 * rotateYMatrix9 * rotateZMatrix9 * scaleMatrix9;
-        ourShader.setMat4("model", model9);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //chair
-
-        glm::mat4 translateMatrix10, rotateXMatrix10, rotateYMatrix10, rotateZMatrix10, scaleMatrix10, model10;
-        translateMatrix10 = glm::translate(identityMatrix, glm::vec3(-0.9, -0.6, 1.0));
-        rotateXMatrix10 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix10 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix10 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix10 = glm::scale(identityMatrix, glm::vec3(0.9, 0.9, 0.1));
-        model10 = translateMatrix10 * rotateXMatrix10 * rotateYMatrix10 * rotateZMatrix10 * scaleMatrix10;
-        ourShader.setMat4("model", model10);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.8f, 0.5f, 0.2f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix11, rotateXMatrix11, rotateYMatrix11, rotateZMatrix11, scaleMatrix11, model11;
-        translateMatrix11 = glm::translate(identityMatrix, glm::vec3(-0.8, -0.6, 1.0));
-        rotateXMatrix11 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix11 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix11 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix11 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 1.0));
-        model11 = translateMatrix11 * rotateXMatrix11 * rotateYMatrix11 * rotateZMatrix11 * scaleMatrix11;
-        ourShader.setMat4("model", model11);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix12, rotateXMatrix12, rotateYMatrix12, rotateZMatrix12, scaleMatrix12, model12;
-        translateMatrix12 = glm::translate(identityMatrix, glm::vec3(-0.55, -0.6, 1.0));
-        rotateXMatrix12 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix12 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix12 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix12 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 1.0));
-        model12 = translateMatrix12 * rotateXMatrix12 * rotateYMatrix12 * rotateZMatrix12 * scaleMatrix12;
-        ourShader.setMat4("model", model12);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix13, rotateXMatrix13, rotateYMatrix13, rotateZMatrix13, scaleMatrix13, model13;
-        translateMatrix13 = glm::translate(identityMatrix, glm::vec3(-0.55, -0.6, 1.4));
-        rotateXMatrix13 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix13 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix13 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix13 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 1.0));
-        model13 = translateMatrix13 * rotateXMatrix13 * rotateYMatrix13 * rotateZMatrix13 * scaleMatrix13;
-        ourShader.setMat4("model", model13);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix14, rotateXMatrix14, rotateYMatrix14, rotateZMatrix14, scaleMatrix14, model14;
-        translateMatrix14 = glm::translate(identityMatrix, glm::vec3(-0.8, -0.6, 1.4));
-        rotateXMatrix14 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix14 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix14 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix14 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 1.0));
-        model14 = translateMatrix14 * rotateXMatrix14 * rotateYMatrix14 * rotateZMatrix14 * scaleMatrix14;
-        ourShader.setMat4("model", model14);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix15, rotateXMatrix15, rotateYMatrix15, rotateZMatrix15, scaleMatrix15, model15;
-        translateMatrix15 = glm::translate(identityMatrix, glm::vec3(-0.55, 0.0, 1.4));
-        rotateXMatrix15 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix15 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix15 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix15 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model15 = translateMatrix15 * rotateXMatrix15 * rotateYMatrix15 * rotateZMatrix15 * scaleMatrix15;
-        ourShader.setMat4("model", model15);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix16, rotateXMatrix16, rotateYMatrix16, rotateZMatrix16, scaleMatrix16, model16;
-        translateMatrix16 = glm::translate(identityMatrix, glm::vec3(-0.55, 0.0, 1.0));
-        rotateXMatrix16 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix16 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix16 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix16 = glm::scale(identityMatrix, glm::vec3(0.1, 0.1, 2.0));
-        model16 = translateMatrix16 * rotateXMatrix16 * rotateYMatrix16 * rotateZMatrix16 * scaleMatrix16;
-        ourShader.setMat4("model", model16);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix17, rotateXMatrix17, rotateYMatrix17, rotateZMatrix17, scaleMatrix17, model17;
-        translateMatrix17 = glm::translate(identityMatrix, glm::vec3(-0.55, -0.0, 1.0));
-        rotateXMatrix17 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix17 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix17 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix17 = glm::scale(identityMatrix, glm::vec3(0.1, 0.9, 0.06));
-        model17 = translateMatrix17 * rotateXMatrix17 * rotateYMatrix17 * rotateZMatrix17 * scaleMatrix17;
-        ourShader.setMat4("model", model17);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix18, rotateXMatrix18, rotateYMatrix18, rotateZMatrix18, scaleMatrix18, model18;
-        translateMatrix18 = glm::translate(identityMatrix, glm::vec3(-0.55, -0.1, 1.0));
-        rotateXMatrix18 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix18 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix18 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix18 = glm::scale(identityMatrix, glm::vec3(0.1, 0.9, 0.06));
-        model18 = translateMatrix18 * rotateXMatrix18 * rotateYMatrix18 * rotateZMatrix18 * scaleMatrix18;
-        ourShader.setMat4("model", model18);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //floor
-        glm::mat4 translateMatrix26, rotateXMatrix26, rotateYMatrix26, rotateZMatrix26, scaleMatrix26, model26;
-        translateMatrix26 = glm::translate(identityMatrix, glm::vec3(-2.4, -1.1, -2.0));
-        rotateXMatrix26 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix26 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix26 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix26 = glm::scale(identityMatrix, glm::vec3(9.0, 8.0, 0.2));
-        model26 = translateMatrix26 * rotateXMatrix26 * rotateYMatrix26 * rotateZMatrix26 * scaleMatrix26;
-        ourShader.setMat4("model", model26);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.9f, 0.9f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix27, rotateXMatrix27, rotateYMatrix27, rotateZMatrix27, scaleMatrix27, model27;
-        translateMatrix27 = glm::translate(identityMatrix, glm::vec3(-2.4, 0.9, -2.0));
-        rotateXMatrix27 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix27 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix27 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix27 = glm::scale(identityMatrix, glm::vec3(0.3, 8.0, 4.0));
-        model27 = translateMatrix27 * rotateXMatrix27 * rotateYMatrix27 * rotateZMatrix27 * scaleMatrix27;
-        ourShader.setMat4("model", model27);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.9f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix28, rotateXMatrix28, rotateYMatrix28, rotateZMatrix28, scaleMatrix28, model28;
-        translateMatrix28 = glm::translate(identityMatrix, glm::vec3(1.95, 0.9, -2.0));
-        rotateXMatrix28 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix28 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix28 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix28 = glm::scale(identityMatrix, glm::vec3(0.3, 8.0, 4.0));
-        model28 = translateMatrix28 * rotateXMatrix28 * rotateYMatrix28 * rotateZMatrix28 * scaleMatrix28;
-        ourShader.setMat4("model", model28);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.9f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix29, rotateXMatrix29, rotateYMatrix29, rotateZMatrix29, scaleMatrix29, model29;
-        translateMatrix29 = glm::translate(identityMatrix, glm::vec3(-2.3, -0.6, -2.0));
-        rotateXMatrix29 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix29 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix29 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix29 = glm::scale(identityMatrix, glm::vec3(8.8, 0.3, 1.0));
-        model29 = translateMatrix29 * rotateXMatrix29 * rotateYMatrix29 * rotateZMatrix29 * scaleMatrix29;
-        ourShader.setMat4("model", model29);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix30, rotateXMatrix30, rotateYMatrix30, rotateZMatrix30, scaleMatrix30, model30;
-        translateMatrix30 = glm::translate(identityMatrix, glm::vec3(-2.3, 0.91, -2.0));
-        rotateXMatrix30 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix30 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix30 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix30 = glm::scale(identityMatrix, glm::vec3(8.8, 0.3, 1.0));
-        model30 = translateMatrix30 * rotateXMatrix30 * rotateYMatrix30 * rotateZMatrix30 * scaleMatrix30;
-        ourShader.setMat4("model", model30);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix31, rotateXMatrix31, rotateYMatrix31, rotateZMatrix31, scaleMatrix31, model31;
-        translateMatrix31 = glm::translate(identityMatrix, glm::vec3(-2.3, 0.8, -2.0));
-        rotateXMatrix31 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix31 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix31 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix31 = glm::scale(identityMatrix, glm::vec3(3.0, 0.3, 3.0));
-        model31 = translateMatrix31 * rotateXMatrix31 * rotateYMatrix31 * rotateZMatrix31 * scaleMatrix31;
-        ourShader.setMat4("model", model31);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix32, rotateXMatrix32, rotateYMatrix32, rotateZMatrix32, scaleMatrix32, model32;
-        translateMatrix32 = glm::translate(identityMatrix, glm::vec3(0.8, 0.6, -2.0));
-        rotateXMatrix32 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix32 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix32 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix32 = glm::scale(identityMatrix, glm::vec3(2.5, 0.3, 3.0));
-        model32 = translateMatrix32 * rotateXMatrix32 * rotateYMatrix32 * rotateZMatrix32 * scaleMatrix32;
-        ourShader.setMat4("model", model32);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix33, rotateXMatrix33, rotateYMatrix33, rotateZMatrix33, scaleMatrix33, model33;
-        translateMatrix33 = glm::translate(identityMatrix, glm::vec3(0.0, 0.6, -2.0));
-        rotateXMatrix33 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix33 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix33 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix33 = glm::scale(identityMatrix, glm::vec3(0.1, 0.3, 3.0));
-        model33 = translateMatrix33 * rotateXMatrix33 * rotateYMatrix33 * rotateZMatrix33 * scaleMatrix33;
-        ourShader.setMat4("model", model33);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix34, rotateXMatrix34, rotateYMatrix34, rotateZMatrix34, scaleMatrix34, model34;
-        translateMatrix34 = glm::translate(identityMatrix, glm::vec3(-2.3, -0.1, -2.0));
-        rotateXMatrix34 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix34 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix34 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix34 = glm::scale(identityMatrix, glm::vec3(8.8, 0.1, 0.1));
-        model34 = translateMatrix34 * rotateXMatrix34 * rotateYMatrix34 * rotateZMatrix34 * scaleMatrix34;
-        ourShader.setMat4("model", model34);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(1.0f, 0.0f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glm::mat4 translateMatrix35, rotateXMatrix35, rotateYMatrix35, rotateZMatrix35, scaleMatrix35, model35;
-        translateMatrix35 = glm::translate(identityMatrix, glm::vec3(-2.4, 1.0, -2.0));
-        rotateXMatrix35 = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        rotateYMatrix35 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        rotateZMatrix35 = glm::rotate(identityMatrix, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        scaleMatrix35 = glm::scale(identityMatrix, glm::vec3(9.0, 8.0, 0.2));
-        model35 = translateMatrix35 * rotateXMatrix35 * rotateYMatrix35 * rotateZMatrix35 * scaleMatrix35;
-        ourShader.setMat4("model", model35);
-        glBindVertexArray(VAO);
-        ourShader.setVec3("COLOR", glm::vec3(0.9f, 0.9f, 0.9f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        sceneShader->setFloat("textureLayer", -1.0f);
 
         //Fan
-        glm::mat4 moveMatrix = glm::translate(identityMatrix, glm::vec3(-0.15f, 2.2f, 0.0f));
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-0.30f, -3.0f, -0.60f));//,
-        scaleMatrix = glm::scale(identityMatrix, glm::vec3(0.1f, 0.5f, 0.1f));
-        rotateYMatrix = glm::rotate(identityMatrix, glm::radians(225.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        //model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-        model = rotateYMatrix * scaleMatrix * translateMatrix;
-        //moveMatrix = rotateZMatrix * moveMatrix;
-        ourShader.setMat4("model", moveMatrix* model);
-        ourShader.setVec3("COLOR", glm::vec3(0.48f, 0.35f, 0.0f));
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        translateMatrix = glm::translate(identityMatrix, glm::vec3(-0.2f, 0.6f, 0.0f));
-        rotate_Now = (rotate_Now + rotateLevel);
-        if (rotate_Now == 361.0)
-            rotate_Now = 0.0;
-
-        rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotate_Now), glm::vec3(0.0f, 1.0f, 0.0f));
-
-        Fan(ourShader, rotateYMatrix * translateMatrix);
-
+        CeilingFan fan;
+        buildCeilingFan(fanAngle, fan);
+        for (int i = 0; i < FAN_PARTS; i++)
+        {
+            sceneShader->setMat4("model", fan.models[i]);
+            sceneShader->setVec3("COLOR", fan.colors[i]);
+            drawSceneElements(36);
+        }
+        if (sceneInstances > 1)
+            multiView.endPass();
 
 
         // render boxes
@@ -786,94 +776,434 @@ int main()
 
         //    glDrawArrays(GL_TRIANGLES, 0, 36);
         //}
+    };
+
+    int scenePass = renderGraph.addPass("scene", [&](const RenderGraph&)
+    {
+        dynamicResolution.setRenderViewport();
+        drawScene();
+    });
+    renderGraph.write(scenePass, sceneColor, RT_CLEAR, glm::vec4(0.2f, 0.3f, 0.3f, 1.0f));
+    renderGraph.write(scenePass, sceneDepth, RT_CLEAR, glm::vec4(1.0f));
+
+    // upscale the scene to the window
+    int upscalePass = renderGraph.addPass("upscale", [&](const RenderGraph& graph)
+    {
+        dynamicResolution.upscale(graph.texture(sceneColor));
+    });
+    renderGraph.read(upscalePass, sceneColor);
+    renderGraph.write(upscalePass, BACKBUFFER);
+
+    // the overdraw view replaces both: the scene again with the counting variants, summed into a float target,
+    // then shown as a heatmap. The frame loop switches between the two pairs.
+    const int overdrawCount = renderGraph.createTarget("overdrawCount", RenderTargetDesc::windowSized(GL_R32F));
+    int overdrawPass = renderGraph.addPass("overdraw", [&](const RenderGraph&)
+    {
+        dynamicResolution.setRenderViewport();
+        overdraw.beginCount();
+        drawScene();
+        overdraw.endCount(dynamicResolution.renderWidth(), dynamicResolution.renderHeight());
+    });
+    renderGraph.write(overdrawPass, overdrawCount, RT_CLEAR, glm::vec4(0.0f));
+    renderGraph.write(overdrawPass, sceneDepth, RT_CLEAR, glm::vec4(1.0f));
+    int heatmapPass = renderGraph.addPass("overdraw heatmap", [&](const RenderGraph& graph)
+    {
+        overdraw.showHeatmap(graph.texture(overdrawCount), dynamicResolution.renderWidth(), dynamicResolution.renderHeight(), scrWidth, scrHeight);
+    });
+    renderGraph.read(heatmapPass, overdrawCount);
+    renderGraph.write(heatmapPass, BACKBUFFER);
+    renderGraph.setPassEnabled(overdrawPass, false);
+    renderGraph.setPassEnabled(heatmapPass, false);
+
+    // the simulation: input, both cameras, the fan and the fly camera's culling, at a fixed rate on its own
+    // thread. The render loop draws the newest tick blended with the one before, while the next one is computed.
+    // ------------------------------------------------------------------------------------------------------------
+    SimulationPipeline<SimFrame> simulation;
+    simulation.Threaded = !serialSim;
+    simulation.WakeRenderer = redraw.OnDemand;
+    for (int i = 0; i < 3; i++)
+        simulation.slot(i).drawList.reserve(scene.nodes.size());
+    std::atomic<float> simAspect((float)SCR_WIDTH / (float)SCR_HEIGHT);
+    CameraComponent simCamera = viewCamera;
+    CameraComponent simPreviousCamera = viewCamera;
+    CameraComponent simLookCamera;
+    SimState simLast = SimState();
+    unsigned int simTicks = 0;
+    // the ceiling fan's spin; the channel wraps its angle, so it keeps full precision however long this runs
+    AnimationSystem animation(scene);
+    int fanChannel = animation.addSpin(0.0f);
+    simulation.start([&](SimFrame& frame, double dt, double)
+    {
+        frame.changes = 0;
+        frame.input = inputQueue.drain();
+        if (!benchMode)
+            processInput(window, frame.input, (float)dt);
+        // held keys keep moving the camera or the furniture even without new events
+        if (frame.input.eventCount > 0 || inputQueue.anyKeyDown())
+            frame.changes |= REDRAW_INPUT;
+
+        simPreviousCamera = simCamera;
+        if (benchMode)
+        {
+            // scripted orbit around the room, the same path every run
+            float angle = simTicks * 0.01f;
+            simCamera.SetLookAt(glm::vec3(4.0f * std::sin(angle), 1.0f, 4.0f * std::cos(angle)), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            frame.changes |= REDRAW_ANIMATION;
+        }
+        else
+            camera.ApplyTo(simCamera);
+        basic_camera.ApplyTo(simLookCamera);
+
+        animation.setRate(fanChannel, rotateLevel * FAN_DEGREES_PER_LEVEL);
+        animation.update((float)dt);
+        rotate_Now = animation.angle(fanChannel);
+        // the fan only asks for frames while it turns
+        if (rotateLevel != 0.0f)
+            frame.changes |= REDRAW_ANIMATION;
+
+        SimState state = { simCamera.GetPosition(), simCamera.GetOrientation(), simCamera.GetFov(), simLookCamera.GetPosition(),
+            simLookCamera.GetOrientation(), rotate_Now };
+        frame.previous = simTicks == 0 ? state : simLast;
+        frame.current = state;
+        simLast = state;
+        simTicks++;
+
+        // whatever the renderer blends to lies between the two poses, so cull against both
+        float aspect = simAspect.load(std::memory_order_relaxed);
+        simCamera.SetAspect(aspect);
+        simPreviousCamera.SetAspect(aspect);
+        frame.drawList.clear();
+        for (size_t i = 0; i < scene.nodes.size(); i++)
+        {
+            const SceneNode& node = scene.nodes[i];
+            if (simCamera.IsBoxVisible(node.boundsMin, node.boundsMax) || simPreviousCamera.IsBoxVisible(node.boundsMin, node.boundsMax))
+                frame.drawList.push_back(&node);
+        }
+    });
+    float lastSimReport = static_cast<float>(glfwGetTime());
+
+    // the endpoint runs on its own thread and only reads the metrics
+    MetricsServer metricsServer;
+    if (metricsPort > 0)
+        metricsServer.start((unsigned short)metricsPort);
+
+    // frames go to the file through pixel buffers and a writer thread, a few frames behind the GPU; a file that
+    // cannot be opened leaves the capture off
+    FrameCapture capture;
+    if (capturePath)
+        capture.start(capturePath, captureFps);
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // the steady state starts after the warm-up: arenas, queues and driver state have reached their size by then
+        if (benchMode && frameCount == BENCH_WARMUP_FRAMES)
+        {
+            threadHeapAllocations() = 0;
+            benchStart = static_cast<float>(glfwGetTime());
+        }
+        if (benchMode && frameCount == BENCH_WARMUP_FRAMES + BENCH_FRAMES)
+        {
+            steadyAllocations = threadHeapAllocations();
+            break;
+        }
+        frameCount++;
+
+        // on demand: nothing changed last time round, so sleep until an event (or a load finishing) wakes us
+        bool loading = assets.pendingCount() > 0 || textures.pendingCount() > 0 || shaderVariants.pendingCount() > 0 || world.loadingCount() > 0;
+        if (redraw.waitIfIdle(loading))
+            lastFrame = static_cast<float>(glfwGetTime());    // time spent asleep does not move the camera
+        // the frame limiter and the frames-in-flight fence wait here, before input and time are sampled
+        framePacer.beginFrame();
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        if (statsReport)
+            redraw.report(currentFrame);
+
+        // nothing to draw into while the window is minimized
+        if (scrWidth == 0 || scrHeight == 0)
+        {
+            framePacer.cancelFrame();
+            glfwWaitEvents();
+            continue;
+        }
+
+        // the scene shader; a program switch means the camera uniforms have to go to the new program too
+        shaderVariants.poll();
+        const unsigned int sceneFeatures = overdraw.enabled() ? overdrawShaders[0] : SCENE_SHADER;
+        const Shader* variant = shaderVariants.get(sceneFeatures);
+        sceneShader = variant ? variant : &ourShader;
+        // the heatmap takes over once the counting variant has linked; until then the scene shows as usual
+        bool counting = overdraw.enabled() && variant != NULL;
+        renderGraph.setPassEnabled(scenePass, !counting);
+        renderGraph.setPassEnabled(upscalePass, !counting);
+        renderGraph.setPassEnabled(overdrawPass, counting);
+        renderGraph.setPassEnabled(heatmapPass, counting);
+        if (sceneShader->ID != activeProgram)
+        {
+            activeProgram = sceneShader->ID;
+            uploadedCameraVersion = 0;
+            redraw.request(REDRAW_STREAMING);
+        }
+        // the world draws only once its variant is there too, and with the same number of views
+        const Shader* worldVariant = worldRooms > 0 && variant ? shaderVariants.get(sceneFeatures | SHADER_INSTANCED) : NULL;
+        if (worldVariant != worldShader)
+        {
+            worldShader = worldVariant;
+            redraw.request(REDRAW_STREAMING);
+        }
+
+        // input: the callbacks queue whatever arrived; the simulation applies it on its next tick
+        // -----
         glfwPollEvents();
+
+        // move loaded models and textures a bounded number of bytes closer to the GPU
+        if (assets.update())
+            redraw.request(REDRAW_STREAMING);
+        if (textures.update())
+            redraw.request(REDRAW_STREAMING);
+
+        // the newest simulation tick, blended with the one before by how far we are into the tick
+        unsigned int simChanges = 0;
+        bool simFresh = simulation.update(simChanges);
+        redraw.request(simChanges);
+        const SimFrame& simFrame = simulation.frame();
+        float blend = simulation.blend(simFrame, currentFrame);
+        SimState simState = blendSimState(simFrame.previous, simFrame.current, blend);
+        // still on the way from the previous tick's pose to the current one
+        if (blend < 1.0f && !sameSimState(simFrame.previous, simFrame.current))
+            redraw.request(REDRAW_ANIMATION);
+        fanAngle = simState.fanAngle;
+
+        // camera/view transformation; the component only rebuilds its matrices when the pose, zoom or aspect changed
+        viewCamera.SetPosition(simState.flyPosition);
+        viewCamera.SetOrientation(simState.flyOrientation);
+        viewCamera.SetFov(simState.flyFov);
+        //basic_camera.ApplyTo(viewCamera);
+        // the views share the frame only once the multi-view variant has linked
+        sceneInstances = multiView.Enabled && sceneShader != &ourShader ? multiView.instanceCount() : 1;
+        if (sceneInstances > 1)
+        {
+            basicViewCamera.SetPosition(simState.lookPosition);
+            basicViewCamera.SetOrientation(simState.lookOrientation);
+            multiView.update(scrWidth, scrHeight);
+        }
+        else
+            viewCamera.SetAspect((float)scrWidth / (float)scrHeight);
+        simAspect.store((float)scrWidth / (float)scrHeight, std::memory_order_relaxed);
+
+        // world cells around the camera and ahead of it start loading, finished ones become resident
+        if (worldRooms > 0 && world.update(viewCamera.GetPosition(), deltaTime))
+            redraw.request(REDRAW_STREAMING);
+
+        if (!redraw.frameDue())
+        {
+            framePacer.cancelFrame();
+            redraw.frameSkipped();
+            continue;
+        }
+
+        // pick the render size and start the GPU timer
+        dynamicResolution.beginFrame(scrWidth, scrHeight);
+
+        // the simulation culled for the fly camera; several views cull here, into the frame arena, against the
+        // union of their frusta
+        if (sceneInstances > 1)
+        {
+            const SceneNode** viewsDrawList = frameArena.allocateArray<const SceneNode*>(scene.nodes.size());
+            drawCount = 0;
+            for (size_t i = 0; i < scene.nodes.size(); i++)
+            {
+                const SceneNode& node = scene.nodes[i];
+                if (multiView.isBoxVisible(node.boundsMin, node.boundsMax))
+                    viewsDrawList[drawCount++] = &node;
+            }
+            drawList = viewsDrawList;
+        }
+        else
+        {
+            drawList = simFrame.drawList.empty() ? NULL : &simFrame.drawList[0];
+            drawCount = simFrame.drawList.size();
+        }
+
+        // render
+        // ------
+        renderGraph.setBackbufferSize(scrWidth, scrHeight);
+        renderGraph.execute();
+        dynamicResolution.endFrame();
+        // fragment counts of a frame a few frames back, if the GPU is done with one
+        if (overdraw.enabled() && overdraw.collect())
+        {
+            overdrawRatioMetric.set(overdraw.Stats.ratio());
+            overdrawMaxMetric.set((double)overdraw.Stats.maxCount);
+        }
+        // the finished backbuffer, before the swap hands it to the window system
+        capture.captureFrame(scrWidth, scrHeight);
+        if (simFresh)
+            inputLatency.recordSubmit(simFrame.input);
+        frameArena.reset();
+        endFrameArenas();
+        if (statsReport && currentFrame - lastReport > 2.0f)
+        {
+            std::cout << "render scale " << dynamicResolution.Scale << " (" << dynamicResolution.renderWidth() << "x" << dynamicResolution.renderHeight()
+                << "), gpu " << dynamicResolution.LastGpuMs << " ms" << std::endl;
+            if (inputLatency.Frames > 0)
+                std::cout << "input-to-submit latency mean " << inputLatency.MeanMs << " ms, max " << inputLatency.MaxMs << " ms" << std::endl;
+            if (textures.arrayCount() > 0)
+                std::cout << "textures " << textures.CompressedBytes / 1024 << " KiB compressed (" << textures.Rgba8Bytes / 1024 << " KiB as RGBA8), "
+                    << textures.VramBytes / 1024 << " KiB allocated in " << textures.arrayCount() << " arrays, " << textures.BindsThisFrame << " binds last frame" << std::endl;
+            std::cout << "frame arena peak " << frameArena.peak() / 1024 << " KiB, " << drawCount << " of " << scene.nodes.size() << " nodes drawn" << std::endl;
+            if (overdraw.StatsFrames > 0)
+                overdraw.Stats.print(std::cout, overdrawModeName(overdraw.Mode));
+            renderGraph.printStats();
+            framePacer.printStats();
+            if (capture.active())
+                capture.printStats();
+            if (worldRooms > 0)
+                world.printStats();
+            simulation.printStats(currentFrame - lastSimReport);
+            lastSimReport = currentFrame;
+            inputLatency.reset();
+            lastReport = currentFrame;
+        }
+
+        // glfw: swap buffers (IO events are polled right before the next view matrix is built) and fence the frame
+        // -------------------------------------------------------------------------------------
+        framePacer.endFrame(window);
+        redraw.frameDrawn();
+
+        framesMetric.add();
+        if (framePacer.Last.frameMs > 0.0)
+            frameTimeMetric.recordMs(framePacer.Last.frameMs);
+        frameCpuMetric.recordMs(framePacer.Last.cpuMs);
+        frameGpuMetric.recordMs(framePacer.Last.gpuMs);
+        nodesDrawnMetric.set((double)drawCount);
+        renderScaleMetric.set(dynamicResolution.Scale);
+        frameArenaMetric.set((double)frameArena.peak());
+        if (worldRooms > 0)
+        {
+            worldCpuMetric.set((double)world.cpuBytes());
+            worldGpuMetric.set((double)world.gpuBytes());
+        }
     }
 
+    simulation.stop();
+    metricsServer.stop();
+    capture.stop();
+
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    assets.release();
+    textures.release();
+    shaderVariants.release();
+    renderGraph.release();
+    world.release();
+    overdraw.release();
+
+    int exitCode = 0;
+    if (benchMode)
+    {
+        float seconds = static_cast<float>(glfwGetTime()) - benchStart;
+        std::cout << "BENCH:: " << BENCH_FRAMES << " frames in " << seconds * 1000.0f << " ms (" << seconds * 1000.0f / BENCH_FRAMES << " ms/frame), "
+            << scene.nodes.size() << " nodes, frame arena peak " << frameArena.peak() / 1024 << " KiB" << std::endl;
+#ifdef COUNT_HEAP_ALLOCATIONS
+        std::cout << "BENCH:: heap allocations on the render thread in steady state: " << steadyAllocations << std::endl;
+#else
+        std::cout << "BENCH:: heap allocations not counted; build with COUNT_HEAP_ALLOCATIONS (on in debug builds)" << std::endl;
+#endif
+        if (overdraw.StatsFrames > 0)
+        {
+            std::cout << "BENCH:: ";
+            overdraw.Stats.print(std::cout, overdrawModeName(overdraw.Mode));
+        }
+        renderGraph.printStats();
+        framePacer.printStats();
+        if (steadyAllocations != 0)
+        {
+            std::cout << "ERROR::BENCH:: the frame loop allocated from the heap" << std::endl;
+            exitCode = 1;
+        }
+    }
+    dynamicResolution.release();
+    framePacer.release();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// process all input: apply this frame's coalesced events and react to the keys currently held down
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, const FrameInput& frameInput, float dt)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-    {
-        camera.ProcessKeyboard(YAW_R, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-    {
-        camera.ProcessKeyboard(YAW_L, deltaTime);
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+    // camera movement, mouse look and zoom are applied together so the camera basis is recomputed once
+    float forward = 0.0f, right = 0.0f, yaw = 0.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_W)) forward += 1.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_S)) forward -= 1.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_D)) right += 1.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_A)) right -= 1.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_1)) yaw += 1.0f;
+    if (inputQueue.isKeyDown(GLFW_KEY_2)) yaw -= 1.0f;
+    glm::vec3 cameraBefore = camera.Position;
+    camera.ProcessFrameInput(forward, right, yaw, frameInput.cursorOffsetX, frameInput.cursorOffsetY, dt);
+    // walls and furniture stop the camera, which then slides along them
+    if (cameraCollision && camera.Position != cameraBefore)
+        camera.Position = collision.slide(cameraBefore, CAMERA_RADIUS, camera.Position - cameraBefore);
+    if (frameInput.scrollOffset != 0.0f)
+        camera.ProcessMouseScroll(frameInput.scrollOffset);
+
+    if (inputQueue.isKeyDown(GLFW_KEY_R))
     {
         if (rotateAxis_X) rotateAngle_X -= 1;
         else if (rotateAxis_Y) rotateAngle_Y -= 1;
         else rotateAngle_Z -= 1;
     }
-    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) translate_Y += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) translate_Y -= 0.01;
-    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) translate_X += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) translate_X -= 0.01;
-    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) translate_Z += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) translate_Z -= 0.01;
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) scale_X += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) scale_X -= 0.01;
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) scale_Y += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) scale_Y -= 0.01;
-    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) scale_Z += 0.01;
-    if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) scale_Z -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_I)) translate_Y += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_K)) translate_Y -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_L)) translate_X += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_J)) translate_X -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_O)) translate_Z += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_P)) translate_Z -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_C)) scale_X += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_V)) scale_X -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_B)) scale_Y += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_N)) scale_Y -= 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_M)) scale_Z += 0.01;
+    if (inputQueue.isKeyDown(GLFW_KEY_U)) scale_Z -= 0.01;
 /*
-    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_X))
     {
         rotateAngle_X += 1;
         rotateAxis_X = 1.0;
         rotateAxis_Y = 0.0;
         rotateAxis_Z = 0.0;
     }*/
-    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_X))
     {
         rotateLevel = rotateLevel + 1.0;
         if (rotateLevel == 3.0)
             rotateLevel = 0.0;
     }
-    if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_Y))
     {
         rotateAngle_Y += 1;
         rotateAxis_X = 0.0;
         rotateAxis_Y = 1.0;
         rotateAxis_Z = 0.0;
     }
-    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_Z))
     {
         rotateAngle_Z += 1;
         rotateAxis_X = 0.0;
@@ -881,66 +1211,66 @@ void processInput(GLFWwindow* window)
         rotateAxis_Z = 1.0;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_H))
     {
-        eyeX += 2.5 * deltaTime;
+        eyeX += 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_F))
     {
-        eyeX -= 2.5 * deltaTime;
+        eyeX -= 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_T))
     {
-        eyeZ += 2.5 * deltaTime;
+        eyeZ += 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_G))
     {
-        eyeZ -= 2.5 * deltaTime;
+        eyeZ -= 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_Q))
     {
-        eyeY += 2.5 * deltaTime;
+        eyeY += 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_E))
     {
-        eyeY -= 2.5 * deltaTime;
+        eyeY -= 2.5 * dt;
         basic_camera.changeEye(eyeX, eyeY, eyeZ);
     }
     
-    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_3))
     {
-        lookAtY += 2.5 * deltaTime;
+        lookAtY += 2.5 * dt;
         basic_camera.changeLookAt(lookAtX, lookAtY, lookAtZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_4))
     {
-        lookAtY -= 2.5 * deltaTime;
+        lookAtY -= 2.5 * dt;
         basic_camera.changeLookAt(lookAtX, lookAtY, lookAtZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_5))
     {
-        lookAtZ += 2.5 * deltaTime;
+        lookAtZ += 2.5 * dt;
         basic_camera.changeLookAt(lookAtX, lookAtY, lookAtZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_6))
     {
-        lookAtZ -= 2.5 * deltaTime;
+        lookAtZ -= 2.5 * dt;
         basic_camera.changeLookAt(lookAtX, lookAtY, lookAtZ);
     }
-    if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_7))
     {
         basic_camera.changeViewUpVector(glm::vec3(1.0f, 0.0f, 0.0f));
     }
-    if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_8))
     {
         basic_camera.changeViewUpVector(glm::vec3(0.0f, 1.0f, 0.0f));
     }
-    if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS)
+    if (inputQueue.isKeyDown(GLFW_KEY_9))
     {
         basic_camera.changeViewUpVector(glm::vec3(0.0f, 0.0f, 1.0f));
     }
@@ -953,72 +1283,189 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
+    // The scene target and the projection aspect follow these on the next frame.
+    scrWidth = width;
+    scrHeight = height;
     glViewport(0, 0, width, height);
+    redraw.request(REDRAW_WINDOW);
+}
+
+// glfw: the window system needs the contents again, e.g. after being uncovered
+// ---------------------------------------------------------------------------------------------
+void refresh_callback(GLFWwindow* window)
+{
+    redraw.request(REDRAW_WINDOW);
 }
 
 
-// glfw: whenever the mouse moves, this callback is called
+// glfw: whenever the mouse moves, this callback is called; the offset is worked out when the frame drains the queue
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-    float xpos = static_cast<float>(xposIn);
-    float ypos = static_cast<float>(yposIn);
+    inputQueue.push(CURSOR_EVENT, 0, 0, xposIn, yposIn);
+}
 
-    if (firstMouse)
-    {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    inputQueue.push(SCROLL_EVENT, 0, 0, xoffset, yoffset);
+}
 
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+// glfw: whenever a key is pressed or released, this callback is called
+// ----------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    inputQueue.push(KEY_EVENT, key, action, 0.0, 0.0);
+}
 
-    lastX = xpos;
-    lastY = ypos;
+// every draw of the scene pass goes through here, so multi-view repeats it once per view
+void drawSceneElements(GLsizei indexCount)
+{
+    drawCallsMetric.add();
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, sceneInstances);
+}
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+// the first frame of the --bench orbit, drawn by the software rasterizer on every core
+// ---------------------------------------------------------------------------------------------------------
+int renderSoftware(const char* outputPath, Overdraw_Mode overdrawMode)
+{
+    ThreadPool softPool(std::thread::hardware_concurrency());
+    SoftRasterizer rasterizer(softPool);
+    rasterizer.Overdraw = overdrawMode;
+    Scene scene;
+    loadCpuScene(scene, [&rasterizer](const MeshData& mesh) { return rasterizer.addMesh(mesh); });
+
+    viewCamera.SetLookAt(glm::vec3(0.0f, 1.0f, 4.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    viewCamera.SetAspect((float)SCR_WIDTH / (float)SCR_HEIGHT);
+    std::vector<const SceneNode*> drawList;
+    for (size_t i = 0; i < scene.nodes.size(); i++)
+    {
+        if (viewCamera.IsBoxVisible(scene.nodes[i].boundsMin, scene.nodes[i].boundsMax))
+            drawList.push_back(&scene.nodes[i]);
+    }
+
+    SoftFramebuffer framebuffer;
+    framebuffer.resize(SCR_WIDTH, SCR_HEIGHT);
+    rasterizer.draw(framebuffer, viewCamera.GetViewMatrix(), viewCamera.GetProjectionMatrix(), drawList.empty() ? NULL : &drawList[0], drawList.size());
+    std::cout << "SOFT:: " << drawList.size() << " of " << scene.nodes.size() << " nodes, " << rasterizer.Stats.submittedTriangles << " triangles ("
+        << rasterizer.Stats.rasterizedTriangles << " set up, " << rasterizer.Stats.binEntries << " tile bin entries) on " << softPool.size()
+        << " threads: geometry " << rasterizer.Stats.geometryMs << " ms, raster " << rasterizer.Stats.rasterMs << " ms" << std::endl;
+    if (!framebuffer.writePpm(outputPath))
+    {
+        std::cout << "ERROR::SOFT:: could not write " << outputPath << std::endl;
+        return 1;
+    }
+    if (overdrawMode != OVERDRAW_OFF)
+    {
+        std::cout << "SOFT:: ";
+        framebuffer.overdrawStats().print(std::cout, overdrawModeName(overdrawMode));
+        if (!framebuffer.writeOverdrawPpm(OVERDRAW_FRAME_PATH))
+        {
+            std::cout << "ERROR::SOFT:: could not write " << OVERDRAW_FRAME_PATH << std::endl;
+            return 1;
+        }
+    }
+    return 0;
 }
 
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+// thumbnails for many viewpoints: the scene is loaded once into every context of the service, which then
+// renders whatever batches its clients send until one of them asks it to shut down
+// ---------------------------------------------------------------------------------------------------------
+int serveRenders(const char* socketPath, int contexts, int metricsPort)
 {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+    RenderService service(contexts > 0 ? (unsigned int)contexts : 0);
+    Scene scene;
+    loadCpuScene(scene, [&service](const MeshData& mesh) { return service.addMesh(mesh); });
+    MetricsServer metricsServer;
+    if (metricsPort > 0)
+        metricsServer.start((unsigned short)metricsPort);
+    return service.serve(scene, socketPath) ? 0 : 1;
 }
 
-void Fan(Shader ourShader, glm::mat4 moveMatrix)
+// the scene for the CPU renderers, chosen as the GL path does: cooked pack, text description, built-in bedroom
+// ---------------------------------------------------------------------------------------------------------
+void loadCpuScene(Scene& scene, const std::function<int(const MeshData&)>& addMesh)
 {
-    glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-    glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model;
-    translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, 0));
-    rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_X), glm::vec3(1.0f, 0.0f, 0.0f));
-    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Y), glm::vec3(0.0f, 1.0f, 0.0f));
-    rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Z), glm::vec3(0.0f, 0.0f, 1.0f));
-    scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.5f, 0.2f, 0.5f));
-    //model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-    model = scaleMatrix * translateMatrix;
-    //moveMatrix = rotateZMatrix * moveMatrix;
-    ourShader.setMat4("model", moveMatrix * model);
-    ourShader.setVec3("COLOR", glm::vec3(0.0f, 0.0f, 1.0f));
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-    translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, 0));//,translate_X, translate_Y, translate_Z
-    scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.5f, 0.2f, 0.5f));
-    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    //model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-    model = rotateYMatrix * scaleMatrix * translateMatrix;
-    //moveMatrix = rotateZMatrix * moveMatrix;
-    ourShader.setMat4("model", moveMatrix * model);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-    translateMatrix = glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, -0.5f));//,
-    scaleMatrix = glm::scale(identityMatrix, glm::vec3(1.5f, 0.2f, 0.5f));
-    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(225.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    //model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-    model = rotateYMatrix * scaleMatrix * translateMatrix;
-    //moveMatrix = rotateZMatrix * moveMatrix;
-    ourShader.setMat4("model", moveMatrix * model);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    // models are loaded right here; with nothing to stream to there is no reason to defer them
+    std::function<int(const char*)> loadMesh = [&addMesh](const char* path)
+    {
+        MeshData mesh;
+        std::string error;
+        if (!loadObj(path, mesh, error))
+        {
+            if (error != "file not found")
+                std::cout << "ASSET::LOAD_FAILED " << path << ": " << error << std::endl;
+            return CUBE_MESH;
+        }
+        return addMesh(mesh);
+    };
 
+    ScenePack pack;
+    std::string sceneError;
+    if (pack.open(SCENE_PACK_PATH, sceneError))
+    {
+        std::vector<int> meshHandles(pack.meshCount());
+        for (size_t i = 0; i < pack.meshCount(); i++)
+        {
+            const PackMesh& packMesh = pack.meshes()[i];
+            MeshData mesh;
+            mesh.vertices.assign(pack.meshVertices(packMesh), pack.meshVertices(packMesh) + (size_t)packMesh.vertexCount * MESH_VERTEX_FLOATS);
+            mesh.indices.assign(pack.meshIndices(packMesh), pack.meshIndices(packMesh) + packMesh.indexCount);
+            meshHandles[i] = addMesh(mesh);
+        }
+        const PackNode* packNodes = pack.nodes();
+        scene.nodes.resize(pack.nodeCount());
+        for (size_t i = 0; i < pack.nodeCount(); i++)
+        {
+            SceneNode& node = scene.nodes[i];
+            node.model = glm::make_mat4(packNodes[i].model);
+            node.color = glm::make_vec3(packNodes[i].color);
+            node.mesh = packNodes[i].mesh == CUBE_MESH ? CUBE_MESH : meshHandles[packNodes[i].mesh];
+            node.texture = NO_TEXTURE;
+            computeNodeBounds(node);
+        }
+        pack.close();
+    }
+    else if (!loadSceneFile(SCENE_FILE_PATH, scene, loadMesh, std::function<int(const char*)>(), sceneError))
+    {
+        scene.nodes.clear();
+        buildBedroom(scene, loadMesh);
+    }
+}
 
+// the --soft view again, ray traced on every core with shadows and ambient occlusion
+// ---------------------------------------------------------------------------------------------------------
+int renderTraced(int samples, const char* outputPath)
+{
+    ThreadPool tracePool(std::thread::hardware_concurrency());
+    RayTracer tracer(tracePool);
+    Scene scene;
+    // the tracer sees every node as its box, so meshes need no CPU copy
+    loadCpuScene(scene, [](const MeshData&) { return CUBE_MESH; });
+    tracer.build(scene.nodes);
+
+    viewCamera.SetLookAt(glm::vec3(0.0f, 1.0f, 4.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    viewCamera.SetAspect((float)SCR_WIDTH / (float)SCR_HEIGHT);
+    tracer.setView(SCR_WIDTH, SCR_HEIGHT, viewCamera.GetViewMatrix(), viewCamera.GetProjectionMatrix());
+    size_t rays = 0;
+    double ms = 0.0;
+    for (int i = 0; i < std::max(samples, 1); i++)
+    {
+        tracer.renderPass();
+        rays += tracer.raysPerPass();
+        ms += tracer.Stats.traceMs;
+    }
+    std::cout << "TRACE:: " << tracer.Stats.boxCount << " boxes, " << tracer.Stats.bvhNodes << " BVH nodes (" << tracer.Stats.buildMs << " ms), "
+        << tracer.sampleCount() << " samples per pixel on " << tracePool.size() << " threads: " << ms << " ms, "
+        << rays / ms / 1000.0 << " Mrays/s" << std::endl;
+
+    SoftFramebuffer framebuffer;
+    tracer.resolve(framebuffer);
+    if (!framebuffer.writePpm(outputPath))
+    {
+        std::cout << "ERROR::TRACE:: could not write " << outputPath << std::endl;
+        return 1;
+    }
+    return 0;
 }
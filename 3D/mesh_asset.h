@@ -0,0 +1,341 @@
+//
+//  mesh_asset.h
+//  3D Object Drawing
+//
+
+#ifndef MESH_ASSET_H
+#define MESH_ASSET_H
+
+#include <glad/glad.h>
+
+#include "mesh_data.h"
+#include "mesh_optimizer.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Lifetime of a mesh asset; the worker owns it up to ASSET_PARSED, the render thread afterwards
+enum AssetState {
+    ASSET_QUEUED,
+    ASSET_LOADING,
+    ASSET_PARSED,
+    ASSET_UPLOADING,
+    ASSET_RESIDENT,
+    ASSET_FAILED
+};
+
+// Default asset values
+const size_t UPLOAD_BUDGET_BYTES = 1024 * 1024; // buffer bytes copied to the GPU per frame
+
+
+inline double assetClockMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One mesh file on its way from disk to the GPU
+struct MeshAsset
+{
+    std::string path;
+    std::atomic<int> state;
+    MeshData data;
+    MeshOptimizeReport optimizeReport;
+    std::string error;
+    // GPU side, valid once resident
+    unsigned int VAO, VBO, EBO;
+    unsigned int indexCount;
+    // upload progress
+    size_t vertexBytesUploaded, indexBytesUploaded;
+    // timings in milliseconds on the asset clock
+    double requestTime, parseStart, parseEnd, uploadStart;
+    int uploadFrames;
+
+    MeshAsset() : state(ASSET_QUEUED), optimizeReport(), VAO(0), VBO(0), EBO(0), indexCount(0), vertexBytesUploaded(0), indexBytesUploaded(0),
+        requestTime(0.0), parseStart(0.0), parseEnd(0.0), uploadStart(0.0), uploadFrames(0) {}
+};
+
+// Loads meshes in the background: files are parsed on worker threads, then copied to the GPU through a
+// staging buffer a bounded number of bytes per frame, so a large model never hitches the frame it arrives in.
+// Until an asset is resident its users keep drawing their placeholder.
+class AssetManager
+{
+public:
+    size_t UploadBudgetBytes;
+
+    AssetManager(ThreadPool& pool, size_t uploadBudgetBytes = UPLOAD_BUDGET_BYTES) : UploadBudgetBytes(uploadBudgetBytes), workers(pool)
+    {
+        glGenBuffers(1, &stagingBuffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        glBufferData(GL_COPY_READ_BUFFER, UploadBudgetBytes, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    ~AssetManager()
+    {
+        // parse jobs hold pointers to our assets
+        workers.waitIdle();
+    }
+
+    // returns a handle right away; the same path always maps to the same handle
+    int requestMesh(const char* path)
+    {
+        std::unordered_map<std::string, int>::iterator it = handles.find(path);
+        if (it != handles.end())
+            return it->second;
+
+        int handle = (int)assets.size();
+        assets.push_back(std::unique_ptr<MeshAsset>(new MeshAsset()));
+        MeshAsset* asset = assets.back().get();
+        asset->path = path;
+        asset->requestTime = assetClockMs();
+        handles[asset->path] = handle;
+
+        workers.submit([asset]() {
+            asset->parseStart = assetClockMs();
+            asset->state.store(ASSET_LOADING);
+            bool ok = loadObj(asset->path, asset->data, asset->error);
+            if (ok)
+                asset->optimizeReport = optimizeMesh(asset->data);
+            asset->parseEnd = assetClockMs();
+            asset->state.store(ok ? ASSET_PARSED : ASSET_FAILED, std::memory_order_release);
+        });
+        return handle;
+    }
+
+    // makes a mesh resident right away from memory that is already in its final layout, e.g. a mapped scene pack;
+    // glBufferData reads straight from the pointers, nothing is parsed or copied on the CPU
+    int addMesh(const char* path, const float* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+    {
+        std::unordered_map<std::string, int>::iterator it = handles.find(path);
+        if (it != handles.end())
+            return it->second;
+
+        int handle = (int)assets.size();
+        assets.push_back(std::unique_ptr<MeshAsset>(new MeshAsset()));
+        MeshAsset& asset = *assets.back();
+        asset.path = path;
+        handles[asset.path] = handle;
+        glGenBuffers(1, &asset.VBO);
+        glGenBuffers(1, &asset.EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, asset.VBO);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)vertexCount * MESH_VERTEX_FLOATS * sizeof(float), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        createVertexArray(asset);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        bufferUploads().add(2);
+        bufferUploadBytes().add((size_t)vertexCount * MESH_VERTEX_FLOATS * sizeof(float) + (size_t)indexCount * sizeof(unsigned int));
+        asset.indexCount = indexCount;
+        asset.state.store(ASSET_RESIDENT, std::memory_order_relaxed);
+        return handle;
+    }
+
+    // render thread, once per frame: moves parsed meshes towards residency within the upload budget;
+    // true if anything was uploaded
+    bool update()
+    {
+        size_t budget = UploadBudgetBytes;
+        copies.clear();
+        for (size_t i = 0; i < assets.size() && budget > 0; i++)
+        {
+            MeshAsset& asset = *assets[i];
+            int state = asset.state.load(std::memory_order_acquire);
+            if (state == ASSET_FAILED && !asset.error.empty())
+            {
+                // an optional model that is not on disk keeps its cube quietly, like a missing scene file
+                if (asset.error != "file not found")
+                    std::cout << "ASSET::LOAD_FAILED " << asset.path << ": " << asset.error << std::endl;
+                asset.error.clear();
+                continue;
+            }
+            if (state == ASSET_PARSED)
+                beginUpload(asset);
+            else if (state != ASSET_UPLOADING)
+                continue;
+
+            asset.uploadFrames++;
+            size_t vertexBytes = asset.data.vertices.size() * sizeof(float);
+            size_t indexBytes = asset.data.indices.size() * sizeof(unsigned int);
+            queueChunk(asset.VBO, (const char*)asset.data.vertices.data(), vertexBytes, asset.vertexBytesUploaded, budget);
+            queueChunk(asset.EBO, (const char*)asset.data.indices.data(), indexBytes, asset.indexBytesUploaded, budget);
+        }
+        bool uploaded = !copies.empty() && submitCopies(UploadBudgetBytes - budget);
+
+        // also runs on frames that queued nothing, so an asset whose last chunk went up earlier still becomes resident
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            MeshAsset& asset = *assets[i];
+            if (asset.state.load(std::memory_order_relaxed) == ASSET_UPLOADING &&
+                asset.vertexBytesUploaded == asset.data.vertices.size() * sizeof(float) &&
+                asset.indexBytesUploaded == asset.data.indices.size() * sizeof(unsigned int))
+                finishUpload(asset);
+        }
+        return uploaded;
+    }
+
+    // meshes still on their way: queued, parsing or uploading
+    int pendingCount() const
+    {
+        int pending = 0;
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            int state = assets[i]->state.load(std::memory_order_relaxed);
+            pending += state != ASSET_RESIDENT && state != ASSET_FAILED;
+        }
+        return pending;
+    }
+
+    bool isResident(int handle) const
+    {
+        return handle >= 0 && handle < (int)assets.size() && assets[handle]->state.load(std::memory_order_relaxed) == ASSET_RESIDENT;
+    }
+
+    const MeshAsset& mesh(int handle) const
+    {
+        return *assets[handle];
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        workers.waitIdle();
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            MeshAsset& asset = *assets[i];
+            if (asset.VAO)
+                glDeleteVertexArrays(1, &asset.VAO);
+            if (asset.VBO)
+            {
+                glDeleteBuffers(1, &asset.VBO);
+                glDeleteBuffers(1, &asset.EBO);
+            }
+            asset.VAO = asset.VBO = asset.EBO = 0;
+        }
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+    }
+
+private:
+    struct PendingCopy
+    {
+        unsigned int target;
+        const char* source;
+        size_t size;
+        size_t stagingOffset;
+        size_t targetOffset;
+        size_t* uploaded;
+    };
+
+    ThreadPool& workers;
+    std::vector<std::unique_ptr<MeshAsset> > assets;
+    std::unordered_map<std::string, int> handles;
+    std::vector<PendingCopy> copies;
+    unsigned int stagingBuffer;
+
+    void beginUpload(MeshAsset& asset)
+    {
+        asset.uploadStart = assetClockMs();
+        glGenBuffers(1, &asset.VBO);
+        glGenBuffers(1, &asset.EBO);
+        // allocate the destination storage only; the contents arrive through the staging buffer
+        glBindBuffer(GL_COPY_WRITE_BUFFER, asset.VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, asset.data.vertices.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, asset.EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, asset.data.indices.size() * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        asset.state.store(ASSET_UPLOADING, std::memory_order_relaxed);
+    }
+
+    void queueChunk(unsigned int target, const char* source, size_t total, size_t& uploaded, size_t& budget)
+    {
+        size_t size = total - uploaded;
+        if (size > budget)
+            size = budget;
+        if (size == 0)
+            return;
+        PendingCopy copy;
+        copy.target = target;
+        copy.source = source + uploaded;
+        copy.size = size;
+        copy.stagingOffset = UploadBudgetBytes - budget;
+        copy.targetOffset = uploaded;
+        copy.uploaded = &uploaded;
+        copies.push_back(copy);
+        budget -= size;
+    }
+
+    // one mapping of the staging buffer per frame; invalidating it lets the driver hand out fresh memory instead of waiting
+    bool submitCopies(size_t used)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        char* staging = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, used, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!staging)
+        {
+            std::cout << "ERROR::ASSET:: Could not map the staging buffer" << std::endl;
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return false;
+        }
+        for (size_t i = 0; i < copies.size(); i++)
+            memcpy(staging + copies[i].stagingOffset, copies[i].source, copies[i].size);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        for (size_t i = 0; i < copies.size(); i++)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, copies[i].target);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copies[i].stagingOffset, copies[i].targetOffset, copies[i].size);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        bufferUploads().add(copies.size());
+        bufferUploadBytes().add(used);
+        // the progress counters move only once the bytes are really on their way, so a failed map is retried next frame
+        for (size_t i = 0; i < copies.size(); i++)
+            *copies[i].uploaded += copies[i].size;
+        return true;
+    }
+
+    // leaves the new vertex array bound with the mesh's element buffer attached
+    void createVertexArray(MeshAsset& asset)
+    {
+        glGenVertexArrays(1, &asset.VAO);
+        glBindVertexArray(asset.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, asset.VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset.EBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)12);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, MESH_VERTEX_FLOATS * sizeof(float), (void*)24);
+        glEnableVertexAttribArray(2);
+    }
+
+    void finishUpload(MeshAsset& asset)
+    {
+        createVertexArray(asset);
+        glBindVertexArray(0);
+
+        asset.indexCount = (unsigned int)asset.data.indices.size();
+        double now = assetClockMs();
+        std::cout << "ASSET::RESIDENT " << asset.path << ": " << asset.data.vertexCount() << " vertices, " << asset.indexCount / 3 << " triangles; "
+            << "queued " << asset.parseStart - asset.requestTime << " ms, parse " << asset.parseEnd - asset.parseStart << " ms, "
+            << "upload " << now - asset.uploadStart << " ms over " << asset.uploadFrames << " frames, total " << now - asset.requestTime << " ms" << std::endl;
+        const MeshOptimizeReport& report = asset.optimizeReport;
+        std::cout << "ASSET::OPTIMIZED " << asset.path << ": ACMR " << report.before.acmr << " -> " << report.after.acmr
+            << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << ", vertex shader runs " << report.before.transforms
+            << " -> " << report.after.transforms << ", " << report.clusters << " overdraw clusters" << std::endl;
+
+        // the GPU copy is all we need from now on
+        std::vector<float>().swap(asset.data.vertices);
+        std::vector<unsigned int>().swap(asset.data.indices);
+        asset.state.store(ASSET_RESIDENT, std::memory_order_relaxed);
+    }
+};
+#endif
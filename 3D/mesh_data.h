@@ -0,0 +1,231 @@
+//
+//  mesh_data.h
+//  3D Object Drawing
+//
+
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Default mesh layout
+const int MESH_VERTEX_FLOATS = 8;   // position + normal + texture coordinates, the same layout as cube_vertices
+const float MESH_BOUNDS_TOLERANCE = 1e-4f;  // how far a vertex may stray outside CUBE_MIN..CUBE_MAX to rounding in the exporter
+
+
+// CPU side geometry: interleaved vertices and a triangle list
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    unsigned int vertexCount() const { return (unsigned int)(vertices.size() / MESH_VERTEX_FLOATS); }
+};
+
+// one corner of an OBJ face: 1-based position, texture coordinate and normal indices, 0 where absent
+struct ObjCorner
+{
+    long position, texCoord, normal;
+
+    bool operator==(const ObjCorner& other) const
+    {
+        return position == other.position && texCoord == other.texCoord && normal == other.normal;
+    }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner& corner) const
+    {
+        // FNV-1a over the three indices; equality compares them in full, so a clash only costs a probe
+        unsigned long long h = 14695981039346656037ULL;
+        const long values[3] = { corner.position, corner.texCoord, corner.normal };
+        for (int i = 0; i < 3; i++)
+        {
+            h ^= (unsigned long long)values[i];
+            h *= 1099511628211ULL;
+            h ^= h >> 29;
+        }
+        return (size_t)h;
+    }
+};
+
+// parses the v/vt/vn/f subset of Wavefront OBJ; polygons are fanned into triangles and
+// missing normals are replaced by area weighted vertex normals. Positions must lie in the cube's local box,
+// which culling, collision and the ray tracer use as every mesh's bounds
+inline bool loadObj(const std::string& path, MeshData& mesh, std::string& error)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        error = "file not found";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    // one output vertex per distinct position/texture coordinate/normal triple
+    std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> remap;
+    std::vector<unsigned int> face;
+    bool hasNormals = false;
+
+    const char* p = text.c_str();
+    while (*p)
+    {
+        const char* lineEnd = p;
+        while (*lineEnd && *lineEnd != '\n')
+            lineEnd++;
+
+        if (p[0] == 'v' && p[1] == ' ')
+        {
+            char* next;
+            float x = strtof(p + 2, &next);
+            float y = strtof(next, &next);
+            float z = strtof(next, &next);
+            glm::vec3 position(x, y, z);
+            for (int c = 0; c < 3; c++)
+            {
+                if (position[c] < CUBE_MIN[c] - MESH_BOUNDS_TOLERANCE || position[c] > CUBE_MAX[c] + MESH_BOUNDS_TOLERANCE)
+                {
+                    error = "vertex outside the cube's local box";
+                    return false;
+                }
+            }
+            positions.push_back(position);
+        }
+        else if (p[0] == 'v' && p[1] == 't' && p[2] == ' ')
+        {
+            char* next;
+            float u = strtof(p + 3, &next);
+            float v = strtof(next, &next);
+            texCoords.push_back(glm::vec2(u, v));
+        }
+        else if (p[0] == 'v' && p[1] == 'n' && p[2] == ' ')
+        {
+            char* next;
+            float x = strtof(p + 3, &next);
+            float y = strtof(next, &next);
+            float z = strtof(next, &next);
+            normals.push_back(glm::vec3(x, y, z));
+        }
+        else if (p[0] == 'f' && p[1] == ' ')
+        {
+            face.clear();
+            const char* q = p + 2;
+            while (q < lineEnd)
+            {
+                while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r'))
+                    q++;
+                if (q >= lineEnd)
+                    break;
+                char* next;
+                long vi = strtol(q, &next, 10);
+                long ti = 0, ni = 0;
+                bool hasTi = false, hasNi = false;
+                if (*next == '/')
+                {
+                    next++;
+                    const char* start = next;
+                    ti = strtol(next, &next, 10);
+                    hasTi = next != start;
+                    if (*next == '/')
+                    {
+                        start = ++next;
+                        ni = strtol(next, &next, 10);
+                        hasNi = next != start;
+                    }
+                }
+                if (next == q)
+                {
+                    error = "malformed face";
+                    return false;
+                }
+                q = next;
+                // negative indices count back from the end
+                if (vi < 0)
+                    vi += (long)positions.size() + 1;
+                if (ti < 0)
+                    ti += (long)texCoords.size() + 1;
+                if (ni < 0)
+                    ni += (long)normals.size() + 1;
+                if (vi < 1 || vi > (long)positions.size() || (hasTi && (ti < 1 || ti > (long)texCoords.size()))
+                    || (hasNi && (ni < 1 || ni > (long)normals.size())))
+                {
+                    error = "face index out of range";
+                    return false;
+                }
+                if (ni > 0)
+                    hasNormals = true;
+
+                ObjCorner key = { vi, ti, ni };
+                std::unordered_map<ObjCorner, unsigned int, ObjCornerHash>::iterator it = remap.find(key);
+                if (it == remap.end())
+                {
+                    unsigned int index = mesh.vertexCount();
+                    glm::vec3 pos = positions[vi - 1];
+                    glm::vec3 nrm = ni > 0 ? normals[ni - 1] : glm::vec3(0.0f);
+                    glm::vec2 uv = ti > 0 ? texCoords[ti - 1] : glm::vec2(0.0f);
+                    float v[MESH_VERTEX_FLOATS] = { pos.x, pos.y, pos.z, nrm.x, nrm.y, nrm.z, uv.x, uv.y };
+                    mesh.vertices.insert(mesh.vertices.end(), v, v + MESH_VERTEX_FLOATS);
+                    it = remap.insert(std::make_pair(key, index)).first;
+                }
+                face.push_back(it->second);
+            }
+            for (size_t i = 2; i < face.size(); i++)
+            {
+                mesh.indices.push_back(face[0]);
+                mesh.indices.push_back(face[i - 1]);
+                mesh.indices.push_back(face[i]);
+            }
+        }
+        p = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+
+    if (mesh.indices.empty())
+    {
+        error = "no faces";
+        return false;
+    }
+
+    if (!hasNormals)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            float* a = &mesh.vertices[mesh.indices[i] * MESH_VERTEX_FLOATS];
+            float* b = &mesh.vertices[mesh.indices[i + 1] * MESH_VERTEX_FLOATS];
+            float* c = &mesh.vertices[mesh.indices[i + 2] * MESH_VERTEX_FLOATS];
+            glm::vec3 n = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+            float* corners[3] = { a, b, c };
+            for (int k = 0; k < 3; k++)
+            {
+                corners[k][3] += n.x;
+                corners[k][4] += n.y;
+                corners[k][5] += n.z;
+            }
+        }
+        for (size_t i = 0; i < mesh.vertices.size(); i += MESH_VERTEX_FLOATS)
+        {
+            glm::vec3 n(mesh.vertices[i + 3], mesh.vertices[i + 4], mesh.vertices[i + 5]);
+            float len = glm::length(n);
+            if (len > 0.0f)
+                n = n / len;
+            mesh.vertices[i + 3] = n.x;
+            mesh.vertices[i + 4] = n.y;
+            mesh.vertices[i + 5] = n.z;
+        }
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,286 @@
+//
+//  mesh_optimizer.h
+//  3D Object Drawing
+//
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_data.h"
+
+#include <algorithm>
+#include <vector>
+
+// Default optimizer values
+const int VERTEX_CACHE_SIZE = 16;        // post-transform cache entries assumed when reordering and measuring
+const float OVERDRAW_CLUSTER_SLACK = 1.05f; // a cluster may end once its local ACMR is within this factor of the mesh ACMR
+
+
+// Post-transform vertex cache efficiency of an index buffer under a FIFO cache model
+struct VertexCacheStats
+{
+    float acmr;                 // average cache misses per triangle (0.5 is ideal for large regular meshes, 3 is worst)
+    float atvr;                 // average transforms per referenced vertex (1 is ideal)
+    unsigned int transforms;    // vertex shader invocations
+};
+
+// Before/after numbers of one optimizeMesh call
+struct MeshOptimizeReport
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+    unsigned int clusters;
+};
+
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f, 0 };
+    if (indices.empty())
+        return stats;
+    // a vertex is in the FIFO while fewer than cacheSize misses happened since it was inserted
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<char> referenced(vertexCount, 0);
+    unsigned int misses = 0, unique = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (!referenced[v])
+        {
+            referenced[v] = 1;
+            unique++;
+        }
+        if (insertedAt[v] == 0 || misses - insertedAt[v] >= (unsigned int)cacheSize)
+        {
+            misses++;
+            insertedAt[v] = misses; // its own miss, counted from 1 so 0 means never cached
+        }
+    }
+    stats.transforms = misses;
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / unique;
+    return stats;
+}
+
+// Tipsify vertex cache reordering (Sander, Nehab, Barczak: "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// Runs in linear time; triangles keep their winding. clusterStarts receives the triangle index of every dead end,
+// which is where the fan walk had to jump and therefore where the order can be changed without hurting the cache.
+inline void tipsify(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize,
+    std::vector<unsigned int>& result, std::vector<unsigned int>& clusterStarts)
+{
+    size_t triangleCount = indices.size() / 3;
+    result.clear();
+    result.reserve(indices.size());
+    clusterStarts.clear();
+
+    // vertex -> triangle adjacency in compressed rows
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        live[indices[i]]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = vertexCount > 0 ? 0 : -1;
+    bool newCluster = true;
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            if (newCluster)
+            {
+                clusterStarts.push_back((unsigned int)(result.size() / 3));
+                newCluster = false;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > (unsigned int)cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // next fanning vertex: the candidate still in cache with the most live triangles left
+        int best = -1, bestPriority = -1;
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            unsigned int v = candidates[c];
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= (unsigned int)cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = (int)v;
+            }
+        }
+        if (best < 0)
+        {
+            // dead end: back up through recently used vertices, then scan forward for any vertex with work left
+            newCluster = true;
+            while (!deadEnd.empty() && best < 0)
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    best = (int)v;
+            }
+            while (best < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    best = (int)cursor;
+                cursor++;
+            }
+        }
+        fanning = best;
+    }
+}
+
+// Reorders whole tipsify clusters so outward facing ones come first (Sander et al., view independent overdraw).
+// Large clusters are first split where their own ACMR is close to the mesh ACMR so there is something to sort.
+inline unsigned int optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int stride,
+    const std::vector<unsigned int>& hardStarts, int cacheSize = VERTEX_CACHE_SIZE, float slack = OVERDRAW_CLUSTER_SLACK)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return 0;
+    unsigned int vertexCount = (unsigned int)(vertices.size() / stride);
+    float threshold = analyzeVertexCache(indices, vertexCount, cacheSize).acmr * slack;
+
+    // soft boundaries inside each hard cluster
+    std::vector<unsigned int> starts;
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    for (size_t h = 0; h < hardStarts.size(); h++)
+    {
+        unsigned int begin = hardStarts[h];
+        unsigned int end = h + 1 < hardStarts.size() ? hardStarts[h + 1] : (unsigned int)triangleCount;
+        unsigned int clusterStart = begin, misses = 0;
+        std::fill(insertedAt.begin(), insertedAt.end(), 0);
+        starts.push_back(begin);
+        for (unsigned int t = begin; t < end; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if (insertedAt[v] == 0 || misses - insertedAt[v] >= (unsigned int)cacheSize)
+                    insertedAt[v] = ++misses;
+            }
+            unsigned int tris = t + 1 - clusterStart;
+            if (t + 1 < end && tris >= 32 && (float)misses / tris <= threshold)
+            {
+                clusterStart = t + 1;
+                misses = 0;
+                std::fill(insertedAt.begin(), insertedAt.end(), 0);
+                starts.push_back(clusterStart);
+            }
+        }
+    }
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    struct Cluster { unsigned int begin, end; float key; };
+    std::vector<Cluster> clusters(starts.size());
+    std::vector<glm::vec3> centroids(starts.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(starts.size(), glm::vec3(0.0f));
+    std::vector<float> areas(starts.size(), 0.0f);
+    for (size_t c = 0; c < starts.size(); c++)
+    {
+        clusters[c].begin = starts[c];
+        clusters[c].end = c + 1 < starts.size() ? starts[c + 1] : (unsigned int)triangleCount;
+        for (unsigned int t = clusters[c].begin; t < clusters[c].end; t++)
+        {
+            const float* a = &vertices[indices[t * 3] * stride];
+            const float* b = &vertices[indices[t * 3 + 1] * stride];
+            const float* d = &vertices[indices[t * 3 + 2] * stride];
+            glm::vec3 p0(a[0], a[1], a[2]), p1(b[0], b[1], b[2]), p2(d[0], d[1], d[2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(n) * 0.5f;
+            glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+            centroids[c] += center * area;
+            normals[c] += n;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid = meshCentroid / meshArea;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        glm::vec3 center = areas[c] > 0.0f ? centroids[c] / areas[c] : meshCentroid;
+        float len = glm::length(normals[c]);
+        glm::vec3 n = len > 0.0f ? normals[c] / len : glm::vec3(0.0f);
+        clusters[c].key = glm::dot(center - meshCentroid, n);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+        sorted.insert(sorted.end(), indices.begin() + clusters[c].begin * 3, indices.begin() + clusters[c].end * 3);
+    indices.swap(sorted);
+    return (unsigned int)clusters.size();
+}
+
+// Renumbers vertices in the order the index buffer first touches them, so vertex fetch walks memory linearly.
+// Vertices no triangle references are dropped.
+inline void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<float>& vertices, int stride)
+{
+    unsigned int vertexCount = (unsigned int)(vertices.size() / stride);
+    const unsigned int unused = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(vertexCount, unused);
+    std::vector<float> reordered;
+    reordered.reserve(vertices.size());
+    unsigned int next = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (remap[v] == unused)
+        {
+            remap[v] = next++;
+            reordered.insert(reordered.end(), vertices.begin() + v * stride, vertices.begin() + (v + 1) * stride);
+        }
+        indices[i] = remap[v];
+    }
+    vertices.swap(reordered);
+}
+
+// The import-time pipeline: vertex cache order, then overdraw order of whole clusters, then vertex fetch order
+inline MeshOptimizeReport optimizeMesh(MeshData& mesh, int cacheSize = VERTEX_CACHE_SIZE)
+{
+    MeshOptimizeReport report;
+    report.before = analyzeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+
+    std::vector<unsigned int> reordered, clusterStarts;
+    tipsify(mesh.indices, mesh.vertexCount(), cacheSize, reordered, clusterStarts);
+    mesh.indices.swap(reordered);
+    report.clusters = optimizeOverdraw(mesh.indices, mesh.vertices, MESH_VERTEX_FLOATS, clusterStarts, cacheSize);
+    optimizeVertexFetch(mesh.indices, mesh.vertices, MESH_VERTEX_FLOATS);
+
+    report.after = analyzeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+    return report;
+}
+#endif
@@ -0,0 +1,479 @@
+//
+//  metrics.h
+//  3D Object Drawing
+//
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <intrin.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET MetricsSocket;
+const MetricsSocket METRICS_NO_SOCKET = INVALID_SOCKET;
+const int METRICS_SEND_FLAGS = 0;
+inline void closeMetricsSocket(MetricsSocket socket) { closesocket(socket); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int MetricsSocket;
+const MetricsSocket METRICS_NO_SOCKET = -1;
+const int METRICS_SEND_FLAGS = MSG_NOSIGNAL;    // a scraper hanging up must not raise SIGPIPE
+inline void closeMetricsSocket(MetricsSocket socket) { close(socket); }
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Default metrics values
+const int METRICS_MAX_COUNTERS = 64;
+const int METRICS_MAX_GAUGES = 64;
+const int METRICS_MAX_HISTOGRAMS = 16;
+const int METRICS_SUB_BUCKET_BITS = 4;          // 16 buckets per power of two: a recorded value is known to within 1/16
+const int METRICS_SUB_BUCKETS = 1 << METRICS_SUB_BUCKET_BITS;
+const int METRICS_MAX_VALUE_BITS = 40;          // nanoseconds up to 2^40, about 18 minutes; longer ones land in the last bucket
+const int METRICS_HISTOGRAM_BUCKETS = (METRICS_MAX_VALUE_BITS - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS;
+const unsigned short METRICS_PORT = 9464;
+const int METRICS_POLL_MS = 100;                // how often the server thread checks whether it should stop
+const int METRICS_REQUEST_TIMEOUT_MS = 1000;    // a scraper that stalls longer than this is dropped
+const size_t METRICS_MAX_REQUEST_BYTES = 8192;
+
+// A count that only goes up. Recording is one relaxed atomic add on the metric's own cache line.
+struct alignas(64) MetricCounter
+{
+    const char* name;
+    const char* help;
+    std::atomic<uint64_t> value;
+
+    void add(uint64_t amount = 1)
+    {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+};
+
+// A value that is set, like a byte count or a scale; kept as the bits of a double
+struct alignas(64) MetricGauge
+{
+    const char* name;
+    const char* help;
+    std::atomic<uint64_t> bits;
+
+    void set(double value)
+    {
+        uint64_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        bits.store(raw, std::memory_order_relaxed);
+    }
+
+    double get() const
+    {
+        uint64_t raw = bits.load(std::memory_order_relaxed);
+        double value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+};
+
+// Latencies in HDR style: every power of two of nanoseconds is split into METRICS_SUB_BUCKETS linear buckets,
+// so any quantile is known to within 6% whether it is 50 ns or 50 s, in a fixed 5 KiB per histogram.
+// Recording is two relaxed atomic adds; the quantiles are worked out when the endpoint is scraped.
+struct alignas(64) MetricHistogram
+{
+    const char* name;
+    const char* help;
+    std::atomic<uint64_t> sumNs;
+    std::atomic<uint64_t> buckets[METRICS_HISTOGRAM_BUCKETS];
+
+    void record(uint64_t ns)
+    {
+        buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        sumNs.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void recordMs(double ms)
+    {
+        record(ms > 0.0 ? (uint64_t)(ms * 1.0e6) : 0);
+    }
+
+    static int bucketOf(uint64_t ns)
+    {
+        if (ns < (uint64_t)METRICS_SUB_BUCKETS)
+            return (int)ns;
+        int bit = highestBit(ns);
+        if (bit >= METRICS_MAX_VALUE_BITS)
+            return METRICS_HISTOGRAM_BUCKETS - 1;
+        return (bit - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS + (int)((ns >> (bit - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1));
+    }
+
+    // the middle of the values a bucket holds
+    static double bucketMiddleNs(int bucket)
+    {
+        if (bucket < METRICS_SUB_BUCKETS)
+            return bucket;
+        int shift = bucket / METRICS_SUB_BUCKETS - 1;
+        uint64_t lower = (uint64_t)(METRICS_SUB_BUCKETS + bucket % METRICS_SUB_BUCKETS) << shift;
+        return lower + ((uint64_t)1 << shift) * 0.5;
+    }
+
+    static int highestBit(uint64_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+};
+
+// Every metric of the program in fixed arrays, so a metric's address never changes and nothing is allocated
+// while recording. Registering takes a lock (look the metric up once and keep the reference, e.g. in a
+// function-local static); the same name returns the same metric. write() only reads atomics and the
+// published counts, so the server thread never holds anything the recording threads wait for.
+class MetricsRegistry
+{
+public:
+    MetricsRegistry() : counterCount(0), gaugeCount(0), histogramCount(0)
+    {
+        spareCounter.name = spareGauge.name = spareHistogram.name = NULL;
+        spareCounter.value.store(0);
+        spareGauge.bits.store(0);
+        spareHistogram.sumNs.store(0);
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+            spareHistogram.buckets[i].store(0);
+    }
+
+    // names follow Prometheus: counters end in _total, histograms are in seconds and end in _seconds
+    MetricCounter& counter(const char* name, const char* help)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int count = counterCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(counters[i].name, name) == 0)
+                return counters[i];
+        }
+        if (count == METRICS_MAX_COUNTERS)
+            return full(name, spareCounter);
+        counters[count].name = name;
+        counters[count].help = help;
+        counters[count].value.store(0, std::memory_order_relaxed);
+        counterCount.store(count + 1, std::memory_order_release);
+        return counters[count];
+    }
+
+    MetricGauge& gauge(const char* name, const char* help)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int count = gaugeCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(gauges[i].name, name) == 0)
+                return gauges[i];
+        }
+        if (count == METRICS_MAX_GAUGES)
+            return full(name, spareGauge);
+        gauges[count].name = name;
+        gauges[count].help = help;
+        gauges[count].set(0.0);
+        gaugeCount.store(count + 1, std::memory_order_release);
+        return gauges[count];
+    }
+
+    MetricHistogram& histogram(const char* name, const char* help)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int count = histogramCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(histograms[i].name, name) == 0)
+                return histograms[i];
+        }
+        if (count == METRICS_MAX_HISTOGRAMS)
+            return full(name, spareHistogram);
+        MetricHistogram& histogram = histograms[count];
+        histogram.name = name;
+        histogram.help = help;
+        histogram.sumNs.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+            histogram.buckets[i].store(0, std::memory_order_relaxed);
+        histogramCount.store(count + 1, std::memory_order_release);
+        return histogram;
+    }
+
+    // the Prometheus text exposition format, version 0.0.4; histograms are written as summaries with quantiles
+    void write(std::ostream& out) const
+    {
+        out << std::setprecision(15);
+        int counters = counterCount.load(std::memory_order_acquire);
+        for (int i = 0; i < counters; i++)
+        {
+            const MetricCounter& metric = this->counters[i];
+            out << "# HELP " << metric.name << " " << metric.help << "\n# TYPE " << metric.name << " counter\n"
+                << metric.name << " " << metric.value.load(std::memory_order_relaxed) << "\n";
+        }
+        int gauges = gaugeCount.load(std::memory_order_acquire);
+        for (int i = 0; i < gauges; i++)
+        {
+            const MetricGauge& metric = this->gauges[i];
+            out << "# HELP " << metric.name << " " << metric.help << "\n# TYPE " << metric.name << " gauge\n" << metric.name << " " << metric.get() << "\n";
+        }
+        int histograms = histogramCount.load(std::memory_order_acquire);
+        for (int i = 0; i < histograms; i++)
+            writeSummary(out, this->histograms[i]);
+    }
+
+    std::string text() const
+    {
+        std::ostringstream out;
+        write(out);
+        return out.str();
+    }
+
+    // a quantile (0..1) of what a histogram has recorded, in seconds; 0 while it is empty
+    static double quantile(const MetricHistogram& histogram, double q, uint64_t* total = NULL)
+    {
+        uint64_t counts[METRICS_HISTOGRAM_BUCKETS];
+        uint64_t count = 0;
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+        {
+            counts[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+            count += counts[i];
+        }
+        if (total)
+            *total = count;
+        if (count == 0)
+            return 0.0;
+        uint64_t rank = (uint64_t)(q * (count - 1));
+        uint64_t seen = 0;
+        for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen > rank)
+                return MetricHistogram::bucketMiddleNs(i) * 1.0e-9;
+        }
+        return MetricHistogram::bucketMiddleNs(METRICS_HISTOGRAM_BUCKETS - 1) * 1.0e-9;
+    }
+
+private:
+    MetricCounter counters[METRICS_MAX_COUNTERS];
+    MetricGauge gauges[METRICS_MAX_GAUGES];
+    MetricHistogram histograms[METRICS_MAX_HISTOGRAMS];
+    std::atomic<int> counterCount, gaugeCount, histogramCount;
+    // handed out once an array is full, so callers always have something to record into; never written out
+    MetricCounter spareCounter;
+    MetricGauge spareGauge;
+    MetricHistogram spareHistogram;
+    std::mutex mutex;
+
+    template <typename Metric>
+    static Metric& full(const char* name, Metric& spare)
+    {
+        std::cout << "ERROR::METRICS:: no room for " << name << ", raise the METRICS_MAX_ limit" << std::endl;
+        return spare;
+    }
+
+    static void writeSummary(std::ostream& out, const MetricHistogram& metric)
+    {
+        static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+        out << "# HELP " << metric.name << " " << metric.help << "\n# TYPE " << metric.name << " summary\n";
+        uint64_t count = 0;
+        for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++)
+            out << metric.name << "{quantile=\"" << QUANTILES[q] << "\"} " << quantile(metric, QUANTILES[q], &count) << "\n";
+        out << metric.name << "_sum " << metric.sumNs.load(std::memory_order_relaxed) * 1.0e-9 << "\n" << metric.name << "_count " << count << "\n";
+    }
+};
+
+// the program's registry
+inline MetricsRegistry& metricsRegistry()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+// the GL buffer traffic, counted by whichever header does the upload
+inline MetricCounter& bufferUploadBytes()
+{
+    static MetricCounter& counter = metricsRegistry().counter("gl_buffer_upload_bytes_total", "Bytes uploaded into GL buffers");
+    return counter;
+}
+
+inline MetricCounter& bufferUploads()
+{
+    static MetricCounter& counter = metricsRegistry().counter("gl_buffer_uploads_total", "Uploads into GL buffers, one per buffer or staged chunk");
+    return counter;
+}
+
+// Serves a registry on 127.0.0.1:port at /metrics, for a Prometheus scraper on the same machine.
+// One thread accepts and answers one request at a time; it only ever reads the registry, so a slow scraper
+// costs that thread and nothing else. Connections are closed after every response.
+class MetricsServer
+{
+public:
+    MetricsServer(const MetricsRegistry& registry = metricsRegistry()) : registry(registry), listener(METRICS_NO_SOCKET), running(false),
+        scrapes(metricsRegistry().counter("metrics_scrapes_total", "Requests answered by the metrics endpoint"))
+    {
+    }
+
+    ~MetricsServer()
+    {
+        stop();
+    }
+
+    // false, with the reason printed, when the port cannot be had
+    bool start(unsigned short port)
+    {
+        if (running.load())
+            return true;
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        {
+            std::cout << "ERROR::METRICS:: winsock did not start" << std::endl;
+            return false;
+        }
+#endif
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == METRICS_NO_SOCKET)
+        {
+            std::cout << "ERROR::METRICS:: could not create a socket" << std::endl;
+            cleanup();
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+        {
+            std::cout << "ERROR::METRICS:: could not listen on 127.0.0.1:" << port << std::endl;
+            cleanup();
+            return false;
+        }
+        std::cout << "METRICS:: serving http://127.0.0.1:" << port << "/metrics" << std::endl;
+        running.store(true);
+        thread = std::thread([this]() { serveLoop(); });
+        return true;
+    }
+
+    void stop()
+    {
+        if (!running.exchange(false))
+            return;
+        thread.join();
+        cleanup();
+    }
+
+private:
+    const MetricsRegistry& registry;
+    MetricsSocket listener;
+    std::atomic<bool> running;
+    std::thread thread;
+    MetricCounter& scrapes;
+
+    void cleanup()
+    {
+        if (listener != METRICS_NO_SOCKET)
+            closeMetricsSocket(listener);
+        listener = METRICS_NO_SOCKET;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    // select with a timeout rather than a blocking accept, so stop() only has to clear the flag
+    void serveLoop()
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(listener, &readable);
+            timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = METRICS_POLL_MS * 1000;
+            if (select((int)listener + 1, &readable, NULL, NULL, &timeout) <= 0)
+                continue;
+            MetricsSocket client = accept(listener, NULL, NULL);
+            if (client == METRICS_NO_SOCKET)
+                continue;
+            answer(client);
+            closeMetricsSocket(client);
+        }
+    }
+
+    void answer(MetricsSocket client)
+    {
+#ifdef _WIN32
+        DWORD timeout = METRICS_REQUEST_TIMEOUT_MS;
+#else
+        timeval timeout;
+        timeout.tv_sec = METRICS_REQUEST_TIMEOUT_MS / 1000;
+        timeout.tv_usec = (METRICS_REQUEST_TIMEOUT_MS % 1000) * 1000;
+#endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+        // the request line and headers; the body of a GET is empty
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < METRICS_MAX_REQUEST_BYTES)
+        {
+            int received = (int)recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+                break;
+            request.append(buffer, received);
+        }
+
+        std::string status, body;
+        if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+        {
+            status = "200 OK";
+            body = registry.text();
+            scrapes.add();
+        }
+        else
+        {
+            status = "404 Not Found";
+            body = "only /metrics is served here\n";
+        }
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " << body.size()
+            << "\r\nConnection: close\r\n\r\n" << body;
+        std::string bytes = response.str();
+        size_t sent = 0;
+        while (sent < bytes.size())
+        {
+            int written = (int)send(client, bytes.data() + sent, (int)(bytes.size() - sent), METRICS_SEND_FLAGS);
+            if (written <= 0)
+                break;
+            sent += written;
+        }
+    }
+};
+#endif
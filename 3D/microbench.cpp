@@ -0,0 +1,175 @@
+//
+//  microbench.cpp
+//  3D Object Drawing
+//
+//  Microbenchmarks of the per-frame math: camera bases and view matrices, the model transforms and the culling
+//  test. Inputs come from fixed seeds, so two builds time the same work.
+//
+//      microbench [filter] [--json file] [--min-time seconds]
+//
+
+#include "basic_camera.h"
+#include "bedroom.h"
+#include "camera.h"
+#include "camera_component.h"
+#include "ceiling_fan.h"
+#include "microbench.h"
+#include "scene.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// settings
+const int INPUT_COUNT = 1024;       // precomputed inputs per case, cycled through; a power of two
+const int TRS_BATCH = 1024;         // objects per composeTRS iteration
+const int CULL_BEDROOM_GRID = 4;    // bedrooms per side of the culled floor, as bench's furnished floor
+
+std::vector<glm::vec3> randomVectors(std::mt19937& random, float low, float high)
+{
+    std::uniform_real_distribution<float> value(low, high);
+    std::vector<glm::vec3> vectors(INPUT_COUNT);
+    for (size_t i = 0; i < vectors.size(); i++)
+        vectors[i] = glm::vec3(value(random), value(random), value(random));
+    return vectors;
+}
+
+// the fly camera's basis: ProcessMouseMovement is updateCameraVectors behind a clamp, which it never hits here
+void benchUpdateCameraVectors(MicroBenchState& state)
+{
+    std::vector<glm::vec3> offsets = randomVectors(state.random, -5.0f, 5.0f);
+    Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
+    size_t i = 0;
+    while (state.keepRunning())
+    {
+        const glm::vec3& offset = offsets[i++ & (INPUT_COUNT - 1)];
+        // back and forth, so pitch stays near zero however long it runs
+        float sign = i & 1 ? 1.0f : -1.0f;
+        camera.ProcessMouseMovement(offset.x * sign, offset.y * sign);
+        doNotOptimize(camera.Up);
+    }
+}
+
+void benchCameraViewMatrix(MicroBenchState& state)
+{
+    std::vector<glm::vec3> positions = randomVectors(state.random, -10.0f, 10.0f);
+    Camera camera(glm::vec3(0.0f, 1.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 10.0f);
+    size_t i = 0;
+    while (state.keepRunning())
+    {
+        camera.Position = positions[i++ & (INPUT_COUNT - 1)];
+        glm::mat4 view = camera.GetViewMatrix();
+        doNotOptimize(view);
+    }
+}
+
+void benchBasicCameraViewMatrix(MicroBenchState& state)
+{
+    std::vector<glm::vec3> eyes = randomVectors(state.random, -10.0f, 10.0f);
+    BasicCamera camera;
+    size_t i = 0;
+    while (state.keepRunning())
+    {
+        camera.eye = eyes[i++ & (INPUT_COUNT - 1)];
+        glm::mat4 view = camera.createViewMatrix();
+        doNotOptimize(view);
+    }
+}
+
+// the modelling transformation of every scene node
+void benchComposeTRS(MicroBenchState& state)
+{
+    std::vector<glm::vec3> translations = randomVectors(state.random, -10.0f, 10.0f);
+    std::vector<glm::vec3> rotations = randomVectors(state.random, 0.0f, 360.0f);
+    std::vector<glm::vec3> scales = randomVectors(state.random, 0.1f, 3.0f);
+    std::vector<glm::mat4> models(TRS_BATCH);
+    state.ItemsPerIteration = TRS_BATCH;
+    while (state.keepRunning())
+    {
+        for (int i = 0; i < TRS_BATCH; i++)
+            models[i] = composeTRS(translations[i], rotations[i], scales[i]);
+        doNotOptimize(models[0]);
+    }
+}
+
+// the fan hierarchy of the scene pass, once per frame
+void benchCeilingFan(MicroBenchState& state)
+{
+    std::uniform_real_distribution<float> degrees(0.0f, 360.0f);
+    std::vector<float> angles(INPUT_COUNT);
+    for (size_t i = 0; i < angles.size(); i++)
+        angles[i] = degrees(state.random);
+    CeilingFan fan;
+    state.ItemsPerIteration = FAN_PARTS;
+    size_t i = 0;
+    while (state.keepRunning())
+    {
+        buildCeilingFan(angles[i++ & (INPUT_COUNT - 1)], fan);
+        doNotOptimize(fan);
+    }
+}
+
+// the frustum test of every node of a furnished floor, from one cached camera
+void benchCulling(MicroBenchState& state)
+{
+    Scene scene;
+    for (int x = 0; x < CULL_BEDROOM_GRID; x++)
+    {
+        for (int z = 0; z < CULL_BEDROOM_GRID; z++)
+        {
+            glm::vec3 offset((x - CULL_BEDROOM_GRID / 2) * 5.0f, 0.0f, (z - CULL_BEDROOM_GRID / 2) * 5.0f);
+            buildBedroom(scene, std::function<int(const char*)>(), std::function<int(const char*)>(), glm::translate(glm::mat4(1.0f), offset));
+        }
+    }
+    CameraComponent camera;
+    camera.SetPerspective(CAMERA_FOV, 16.0f / 9.0f, CAMERA_NEAR, CAMERA_FAR);
+    camera.SetLookAt(glm::vec3(0.0f, 1.5f, 6.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    camera.IsBoxVisible(glm::vec3(0.0f), glm::vec3(0.0f));     // builds the cached planes before the timing starts
+    state.ItemsPerIteration = scene.nodes.size();
+    while (state.keepRunning())
+    {
+        size_t visible = 0;
+        for (size_t i = 0; i < scene.nodes.size(); i++)
+            visible += camera.IsBoxVisible(scene.nodes[i].boundsMin, scene.nodes[i].boundsMax);
+        doNotOptimize(visible);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    MicroBenchmark suite;
+    std::string filter, jsonPath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            suite.MinTime = atof(argv[++i]);
+        else
+            filter = argv[i];
+    }
+
+    suite.add("camera/updateCameraVectors", benchUpdateCameraVectors);
+    suite.add("camera/GetViewMatrix", benchCameraViewMatrix);
+    suite.add("basic_camera/createViewMatrix", benchBasicCameraViewMatrix);
+    suite.add("transform/composeTRS", benchComposeTRS);
+    suite.add("transform/ceilingFan", benchCeilingFan);
+    suite.add("culling/IsBoxVisible", benchCulling);
+    suite.run(filter);
+
+    if (!jsonPath.empty())
+    {
+        std::ofstream out(jsonPath.c_str());
+        suite.writeJson(out);
+        if (!out)
+        {
+            std::cout << "ERROR::MICROBENCH:: could not write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+//
+//  microbench.h
+//  3D Object Drawing
+//
+
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Default microbenchmark values
+const unsigned int MICROBENCH_SEED = 1234;      // every repetition starts its generator here
+const double MICROBENCH_MIN_TIME = 0.1;         // seconds a repetition runs for at least
+const int MICROBENCH_REPETITIONS = 5;           // the reported time is their median
+const uint64_t MICROBENCH_MAX_ITERATIONS = 1000000000;
+
+// keeps value, and the work that produced it, from being optimized away
+#if defined(_MSC_VER)
+#include <intrin.h>
+namespace microbench_detail { static const volatile void* volatile sink; }
+template <class T> inline void doNotOptimize(const T& value)
+{
+    microbench_detail::sink = &value;
+    _ReadWriteBarrier();
+}
+#else
+template <class T> inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+#endif
+
+// What a case sees while it runs: the loop condition, a seeded generator for its inputs, and how many items one
+// iteration handles. Setup before the first keepRunning() call is not timed.
+class MicroBenchState
+{
+public:
+    std::mt19937 random;
+    uint64_t Iterations;
+    uint64_t ItemsPerIteration;     // set by the case when one iteration handles many items
+    double Seconds, CpuSeconds;     // of the timed loop, once keepRunning() returned false
+
+    explicit MicroBenchState(uint64_t iterations) : random(MICROBENCH_SEED), Iterations(iterations), ItemsPerIteration(1), Seconds(0.0), CpuSeconds(0.0),
+        remaining(iterations), started(false)
+    {
+    }
+
+    bool keepRunning()
+    {
+        if (!started)
+        {
+            started = true;
+            startTime = std::chrono::steady_clock::now();
+            startCpu = std::clock();
+        }
+        if (remaining > 0)
+        {
+            remaining--;
+            return true;
+        }
+        Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        CpuSeconds = (double)(std::clock() - startCpu) / CLOCKS_PER_SEC;
+        return false;
+    }
+
+private:
+    uint64_t remaining;
+    bool started;
+    std::chrono::steady_clock::time_point startTime;
+    std::clock_t startCpu;
+};
+
+struct MicroBenchResult
+{
+    std::string name;
+    uint64_t iterations;
+    double ns;              // per iteration, median of the repetitions
+    double cpuNs;
+    double itemsPerSecond;
+};
+
+
+// A small runner in the manner of Google Benchmark. Every case is first run with growing iteration counts
+// until one run takes MICROBENCH_MIN_TIME, then MICROBENCH_REPETITIONS times at that count; the median is
+// reported, so one descheduled run does not move the number. The JSON output uses Google Benchmark's layout,
+// so its compare.py can diff two builds.
+class MicroBenchmark
+{
+public:
+    double MinTime;
+    int Repetitions;
+
+    MicroBenchmark() : MinTime(MICROBENCH_MIN_TIME), Repetitions(MICROBENCH_REPETITIONS) {}
+
+    void add(const std::string& name, const std::function<void(MicroBenchState&)>& body)
+    {
+        Case benchCase;
+        benchCase.name = name;
+        benchCase.body = body;
+        cases.push_back(benchCase);
+    }
+
+    // runs every case whose name contains filter and prints a row for each
+    const std::vector<MicroBenchResult>& run(const std::string& filter = "")
+    {
+        results.clear();
+        std::cout << std::left << std::setw(40) << "case" << std::right << std::setw(14) << "ns/op" << std::setw(14) << "cpu ns/op"
+            << std::setw(14) << "iterations" << std::setw(16) << "items/s" << std::endl;
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            if (cases[i].name.find(filter) == std::string::npos)
+                continue;
+            MicroBenchResult result = runCase(cases[i]);
+            std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(2) << std::setw(14) << result.ns
+                << std::setw(14) << result.cpuNs << std::setw(14) << result.iterations << std::setprecision(0) << std::setw(16) << result.itemsPerSecond
+                << std::defaultfloat << std::endl;
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        std::time_t now = std::time(NULL);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"num_cpus\": " << std::max(1u, std::thread::hardware_concurrency())
+#ifdef NDEBUG
+            << ",\n    \"library_build_type\": \"release\""
+#else
+            << ",\n    \"library_build_type\": \"debug\""
+#endif
+            << ",\n    \"seed\": " << MICROBENCH_SEED << ",\n    \"repetitions\": " << Repetitions << "\n  },\n  \"benchmarks\": [";
+        out << std::setprecision(10);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const MicroBenchResult& result = results[i];
+            out << (i ? ",\n" : "\n") << "    {\n      \"name\": \"" << result.name << "\",\n      \"run_name\": \"" << result.name
+                << "\",\n      \"run_type\": \"iteration\",\n      \"iterations\": " << result.iterations << ",\n      \"real_time\": " << result.ns
+                << ",\n      \"cpu_time\": " << result.cpuNs << ",\n      \"time_unit\": \"ns\",\n      \"items_per_second\": " << result.itemsPerSecond
+                << "\n    }";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    struct Case
+    {
+        std::string name;
+        std::function<void(MicroBenchState&)> body;
+    };
+
+    std::vector<Case> cases;
+    std::vector<MicroBenchResult> results;
+
+    MicroBenchResult runCase(const Case& benchCase) const
+    {
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            MicroBenchState state(iterations);
+            benchCase.body(state);
+            if (state.Seconds >= MinTime || iterations >= MICROBENCH_MAX_ITERATIONS)
+                break;
+            // aim a little past the minimum, but never grow more than tenfold on a run too short to trust
+            double scale = state.Seconds > 0.0 ? MinTime * 1.4 / state.Seconds : 10.0;
+            iterations = std::min(MICROBENCH_MAX_ITERATIONS, (uint64_t)(iterations * std::min(10.0, std::max(2.0, scale))));
+        }
+
+        std::vector<double> ns, cpuNs;
+        uint64_t items = 1;
+        for (int r = 0; r < Repetitions; r++)
+        {
+            MicroBenchState state(iterations);
+            benchCase.body(state);
+            ns.push_back(state.Seconds * 1.0e9 / iterations);
+            cpuNs.push_back(state.CpuSeconds * 1.0e9 / iterations);
+            items = state.ItemsPerIteration;
+        }
+        std::sort(ns.begin(), ns.end());
+        std::sort(cpuNs.begin(), cpuNs.end());
+
+        MicroBenchResult result;
+        result.name = benchCase.name;
+        result.iterations = iterations;
+        result.ns = ns[ns.size() / 2];
+        result.cpuNs = cpuNs[cpuNs.size() / 2];
+        result.itemsPerSecond = result.ns > 0.0 ? items * 1.0e9 / result.ns : 0.0;
+        return result;
+    }
+};
+#endif
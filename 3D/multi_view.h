@@ -0,0 +1,126 @@
+//
+//  multi_view.h
+//  3D Object Drawing
+//
+
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera_component.h"
+#include "shader.h"
+
+#include <iostream>
+
+// Default multi-view values
+const int MULTIVIEW_MAX_VIEWS = 4;      // MAX_VIEWS in vertexShader.vs
+
+
+// Draws the scene into several cameras with one submission. Each draw is instanced once per view and the
+// MULTIVIEW shader variant takes the view from gl_InstanceID: it transforms with that view's matrices, clips
+// against the view's own frustum sides through gl_ClipDistance and moves the result into the view's rectangle.
+// GL 3.3 has no viewport arrays, so this stands in for gl_ViewportIndex. The CPU walks the scene, sets uniforms
+// and issues draws once however many views there are; a node is culled only when no view can see it.
+// Per-instance attributes (the INSTANCED variant) would need a divisor of viewCount to stay in step.
+class MultiView
+{
+public:
+    bool Enabled;
+
+    MultiView() : Enabled(false), count(0)
+    {
+    }
+
+    // the rectangle is in fractions of the render viewport, origin bottom left; returns the view index or -1
+    int addView(CameraComponent* camera, float x, float y, float width, float height)
+    {
+        if (count == MULTIVIEW_MAX_VIEWS)
+        {
+            std::cout << "ERROR::MULTIVIEW:: no more than " << MULTIVIEW_MAX_VIEWS << " views" << std::endl;
+            return -1;
+        }
+        views[count].camera = camera;
+        views[count].rect = glm::vec4(x, y, width, height);
+        return count++;
+    }
+
+    int viewCount() const
+    {
+        return count;
+    }
+
+    // instances per draw call: one per view, or just one when multi-view is off
+    int instanceCount() const
+    {
+        return Enabled ? count : 1;
+    }
+
+    // matches every camera's aspect to its rectangle of a width x height viewport; once a frame before culling
+    void update(int width, int height)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            float w = views[i].rect.z * width;
+            float h = views[i].rect.w * height;
+            if (w > 0.0f && h > 0.0f)
+                views[i].camera->SetAspect(w / h);
+        }
+    }
+
+    // the union of the frusta: visible if any view sees the box
+    bool isBoxVisible(glm::vec3 boxMin, glm::vec3 boxMax) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (views[i].camera->IsBoxVisible(boxMin, boxMax))
+                return true;
+        }
+        return false;
+    }
+
+    // view-projections and rectangles for the MULTIVIEW variant; the matrices are cached by the cameras, so
+    // this is a few hundred bytes of uniforms a frame
+    void setUniforms(const Shader& shader) const
+    {
+        glm::mat4 viewProjections[MULTIVIEW_MAX_VIEWS];
+        glm::vec4 rects[MULTIVIEW_MAX_VIEWS];
+        for (int i = 0; i < count; i++)
+        {
+            viewProjections[i] = views[i].camera->GetViewProjectionMatrix();
+            // fractions to NDC: center and half extent
+            const glm::vec4& r = views[i].rect;
+            rects[i] = glm::vec4(2.0f * r.x + r.z - 1.0f, 2.0f * r.y + r.w - 1.0f, r.z, r.w);
+        }
+        shader.setInt("viewCount", count);
+        if (count == 0)
+            return;
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "viewProjections"), count, GL_FALSE, &viewProjections[0][0][0]);
+        glUniform4fv(glGetUniformLocation(shader.ID, "viewRects"), count, &rects[0][0]);
+    }
+
+    // the shader writes one clip distance per frustum side; they only count while enabled
+    void beginPass() const
+    {
+        for (int i = 0; i < 4; i++)
+            glEnable(GL_CLIP_DISTANCE0 + i);
+    }
+
+    void endPass() const
+    {
+        for (int i = 0; i < 4; i++)
+            glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+
+private:
+    struct View
+    {
+        CameraComponent* camera;
+        glm::vec4 rect;     // x, y, width, height in fractions of the viewport
+    };
+
+    View views[MULTIVIEW_MAX_VIEWS];
+    int count;
+};
+#endif
@@ -0,0 +1,155 @@
+//
+//  overdraw.h
+//  3D Object Drawing
+//
+
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <glad/glad.h>
+
+#include "overdraw_stats.h"
+#include "shader.h"
+
+#include <cstddef>
+
+// Default overdraw view values
+const int OVERDRAW_READBACKS = 3;           // count targets in flight to the CPU; a frame finding none free goes unmeasured
+
+
+// The overdraw debug view. The scene is drawn once more with the SHADER_OVERDRAW variant, which writes 1.0 per
+// fragment, into an R32F target with additive blending, so every pixel ends up holding its fragment count. In
+// OVERDRAW_SHADED the depth test stays on and counts what survives early depth in draw order; in
+// OVERDRAW_RASTERIZED it is off and counts everything the triangles cover. The counts are shown as a heatmap
+// and read back through a ring of pixel buffers, each fenced and mapped a few frames later once the GPU is done
+// with it, so the statistics never stall the frame.
+class OverdrawView
+{
+public:
+    Overdraw_Mode Mode;
+    float HeatMax;
+    OverdrawStats Stats;        // of the newest frame read back
+    unsigned int StatsFrames;   // frames measured so far
+
+    OverdrawView(const char* heatmapVertexPath, const char* heatmapFragmentPath) : Mode(OVERDRAW_OFF), HeatMax(OVERDRAW_HEAT_MAX), StatsFrames(0),
+        heatmapShader(heatmapVertexPath, heatmapFragmentPath), head(0), tail(0)
+    {
+        glGenVertexArrays(1, &emptyVAO);
+        for (int i = 0; i < OVERDRAW_READBACKS; i++)
+        {
+            glGenBuffers(1, &readbacks[i].buffer);
+            readbacks[i].fence = 0;
+            readbacks[i].bytes = 0;
+            readbacks[i].width = readbacks[i].height = 0;
+        }
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        for (int i = 0; i < OVERDRAW_READBACKS; i++)
+        {
+            if (readbacks[i].fence)
+                glDeleteSync(readbacks[i].fence);
+            glDeleteBuffers(1, &readbacks[i].buffer);
+        }
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteProgram(heatmapShader.ID);
+    }
+
+    bool enabled() const { return Mode != OVERDRAW_OFF; }
+
+    // overdraw pass, before the scene is drawn with the overdraw variant
+    void beginCount()
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        if (Mode == OVERDRAW_RASTERIZED)
+            glDisable(GL_DEPTH_TEST);
+    }
+
+    // after the scene: restores the state and reads the counted width x height corner of the bound framebuffer's
+    // first color attachment into the next free pixel buffer
+    void endCount(int width, int height)
+    {
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+
+        Readback& readback = readbacks[head];
+        if (readback.fence)
+            return;
+        size_t bytes = (size_t)width * height * sizeof(float);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        if (readback.bytes < bytes)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+            readback.bytes = bytes;
+        }
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.width = width;
+        readback.height = height;
+        head = (head + 1) % OVERDRAW_READBACKS;
+    }
+
+    // heatmap pass: the counted sub-rectangle of countTexture stretched over the bound window sized framebuffer
+    void showHeatmap(unsigned int countTexture, int renderWidth, int renderHeight, int targetWidth, int targetHeight)
+    {
+        glDisable(GL_DEPTH_TEST);
+        heatmapShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, countTexture);
+        heatmapShader.setInt("overdrawCount", 0);
+        heatmapShader.setVec2("uvScale", (float)renderWidth / targetWidth, (float)renderHeight / targetHeight);
+        heatmapShader.setFloat("heatMax", HeatMax);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // turns every readback the GPU has finished into Stats without waiting; true if Stats changed
+    bool collect()
+    {
+        bool fresh = false;
+        while (readbacks[tail].fence)
+        {
+            Readback& readback = readbacks[tail];
+            if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+            tail = (tail + 1) % OVERDRAW_READBACKS;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            const float* counts = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)readback.width * readback.height * sizeof(float), GL_MAP_READ_BIT);
+            if (counts)
+            {
+                Stats.reset();
+                for (int y = 0; y < readback.height; y++)
+                    Stats.addRow(counts + (size_t)y * readback.width, readback.width);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                StatsFrames++;
+                fresh = true;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        return fresh;
+    }
+
+private:
+    struct Readback
+    {
+        GLuint buffer;
+        GLsync fence;           // set while the GPU may still be writing the buffer
+        size_t bytes;
+        int width, height;
+    };
+
+    Shader heatmapShader;
+    unsigned int emptyVAO;
+    Readback readbacks[OVERDRAW_READBACKS];
+    int head, tail;             // next buffer to fill, oldest one in flight
+};
+#endif
@@ -0,0 +1,26 @@
+#version 330 core
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D overdrawCount;
+uniform vec2 uvScale;
+uniform float heatMax;
+
+// overdrawHeatColor in overdraw_stats.h
+const vec3 RAMP[5] = vec3[5](vec3(0.0f, 0.2f, 1.0f), vec3(0.0f, 0.9f, 0.3f), vec3(1.0f, 0.9f, 0.0f), vec3(1.0f, 0.1f, 0.0f), vec3(1.0f));
+
+void main()
+{
+    // counts are exact per pixel, so no filtering: the nearest texel of the rendered sub-rectangle
+    ivec2 texel = ivec2(texCoord * uvScale * vec2(textureSize(overdrawCount, 0)));
+    float count = texelFetch(overdrawCount, texel, 0).r;
+    if (count < 0.5f)
+    {
+        FragColor = vec4(vec3(0.05f), 1.0f);
+        return;
+    }
+    float t = clamp((count - 1.0f) / (heatMax - 1.0f), 0.0f, 1.0f) * 4.0f;
+    int i = min(int(t), 3);
+    FragColor = vec4(mix(RAMP[i], RAMP[i + 1], t - float(i)), 1.0f);
+}
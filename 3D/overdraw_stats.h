@@ -0,0 +1,110 @@
+//
+//  overdraw_stats.h
+//  3D Object Drawing
+//
+
+#ifndef OVERDRAW_STATS_H
+#define OVERDRAW_STATS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Default overdraw values
+const int OVERDRAW_HISTOGRAM_BINS = 8;      // pixels drawn 0, 1, ... 6 times, and 7 or more times
+const float OVERDRAW_HEAT_MAX = 8.0f;       // fragment count at the hot end of the heatmap
+
+// What the overdraw mode counts per pixel
+enum Overdraw_Mode {
+    OVERDRAW_OFF,
+    OVERDRAW_SHADED,        // fragments that pass the depth test in draw order: what runs the fragment shader with early depth
+    OVERDRAW_RASTERIZED     // every fragment the triangles cover, depth ignored: the cost without any depth rejection
+};
+
+inline const char* overdrawModeName(Overdraw_Mode mode)
+{
+    return mode == OVERDRAW_SHADED ? "shaded" : mode == OVERDRAW_RASTERIZED ? "rasterized" : "off";
+}
+
+
+// Per-frame overdraw figures over a target of fragment counts. The ratio that matters is fragments per covered
+// pixel: 1.0 means every pixel was shaded once, anything above it is work the final image never shows.
+struct OverdrawStats
+{
+    size_t pixels;
+    size_t coveredPixels;       // pixels with at least one fragment
+    uint64_t fragments;
+    unsigned int maxCount;
+    size_t histogram[OVERDRAW_HISTOGRAM_BINS];
+
+    OverdrawStats() { reset(); }
+
+    void reset()
+    {
+        pixels = coveredPixels = 0;
+        fragments = 0;
+        maxCount = 0;
+        std::fill(histogram, histogram + OVERDRAW_HISTOGRAM_BINS, (size_t)0);
+    }
+
+    void add(unsigned int count)
+    {
+        pixels++;
+        coveredPixels += count > 0;
+        fragments += count;
+        maxCount = std::max(maxCount, count);
+        histogram[std::min(count, (unsigned int)OVERDRAW_HISTOGRAM_BINS - 1)]++;
+    }
+
+    void merge(const OverdrawStats& other)
+    {
+        pixels += other.pixels;
+        coveredPixels += other.coveredPixels;
+        fragments += other.fragments;
+        maxCount = std::max(maxCount, other.maxCount);
+        for (int i = 0; i < OVERDRAW_HISTOGRAM_BINS; i++)
+            histogram[i] += other.histogram[i];
+    }
+
+    // a row of counts, integer (the software rasterizer) or float (the GL readback)
+    template <typename T>
+    void addRow(const T* counts, int width)
+    {
+        for (int x = 0; x < width; x++)
+            add((unsigned int)(counts[x] + (T)0.5));
+    }
+
+    // fragments per covered pixel
+    double ratio() const { return coveredPixels > 0 ? (double)fragments / coveredPixels : 0.0; }
+    // fragments per pixel of the whole target
+    double perPixel() const { return pixels > 0 ? (double)fragments / pixels : 0.0; }
+
+    void print(std::ostream& out, const char* tag) const
+    {
+        out << tag << " overdraw " << ratio() << " fragments per covered pixel (" << perPixel() << " per pixel), max " << maxCount
+            << ", " << coveredPixels << " of " << pixels << " pixels covered, histogram";
+        for (int i = 0; i < OVERDRAW_HISTOGRAM_BINS; i++)
+        {
+            out << " " << i << (i == OVERDRAW_HISTOGRAM_BINS - 1 ? "+:" : ":")
+                << (pixels > 0 ? 100.0 * histogram[i] / pixels : 0.0) << "%";
+        }
+        out << std::endl;
+    }
+};
+
+// heatmap ramp for a fragment count, the same as overdrawHeatmap.fs: dark for none, then blue, green, yellow,
+// red and white at heatMax
+inline glm::vec3 overdrawHeatColor(float count, float heatMax = OVERDRAW_HEAT_MAX)
+{
+    if (count <= 0.0f)
+        return glm::vec3(0.05f);
+    float t = glm::clamp((count - 1.0f) / (heatMax - 1.0f), 0.0f, 1.0f) * 4.0f;
+    static const glm::vec3 ramp[5] = { glm::vec3(0.0f, 0.2f, 1.0f), glm::vec3(0.0f, 0.9f, 0.3f), glm::vec3(1.0f, 0.9f, 0.0f),
+                                       glm::vec3(1.0f, 0.1f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f) };
+    int i = std::min((int)t, 3);
+    return glm::mix(ramp[i], ramp[i + 1], t - (float)i);
+}
+#endif
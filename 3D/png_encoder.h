@@ -0,0 +1,248 @@
+//
+//  png_encoder.h
+//  3D Object Drawing
+//
+
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Default PNG encoder values
+const int PNG_HASH_BITS = 15;               // match finder table size
+const int PNG_WINDOW = 32768;               // deflate's largest distance
+const int PNG_MIN_MATCH = 3;
+const int PNG_MAX_MATCH = 258;
+
+
+// A small PNG writer for RGB8 images: rows get the Sub filter, and the zlib stream is one fixed Huffman
+// deflate block whose matches come from a single-entry hash table of the last position of every 3 byte string.
+// That finds the long runs of flat shaded renders, and the row above at a distance of one row, at a fraction of
+// zlib's cost. Scratch memory is kept between calls, so one encoder per thread encodes without reallocating.
+class PngEncoder
+{
+public:
+    PngEncoder()
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crcTable[n] = c;
+        }
+        // the fixed literal/length code of RFC 1951 section 3.2.6, stored bit reversed, ready to put
+        for (int symbol = 0; symbol < 288; symbol++)
+        {
+            uint32_t code;
+            int length;
+            if (symbol < 144)
+                code = 0x30 + symbol, length = 8;
+            else if (symbol < 256)
+                code = 0x190 + symbol - 144, length = 9;
+            else if (symbol < 280)
+                code = symbol - 256, length = 7;
+            else
+                code = 0xC0 + symbol - 280, length = 8;
+            literalCodes[symbol] = reverse(code, length);
+            literalLengths[symbol] = length;
+        }
+    }
+
+    // pixels as SoftFramebuffer keeps them: RGBA8 with R in the lowest byte, top row first, stride in pixels
+    void encode(const uint32_t* pixels, int stride, int width, int height, std::vector<unsigned char>& png)
+    {
+        size_t rowBytes = (size_t)width * 3 + 1;
+        filtered.resize(rowBytes * height);
+        for (int y = 0; y < height; y++)
+        {
+            const uint32_t* row = pixels + (size_t)y * stride;
+            unsigned char* out = &filtered[rowBytes * y];
+            out[0] = 1;     // Sub: each byte minus the same channel of the pixel to its left
+            uint32_t left = 0;
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t c = row[x];
+                out[1 + x * 3 + 0] = (unsigned char)((c & 0xFF) - (left & 0xFF));
+                out[1 + x * 3 + 1] = (unsigned char)(((c >> 8) & 0xFF) - ((left >> 8) & 0xFF));
+                out[1 + x * 3 + 2] = (unsigned char)(((c >> 16) & 0xFF) - ((left >> 16) & 0xFF));
+                left = c;
+            }
+        }
+
+        png.clear();
+        static const unsigned char SIGNATURE[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+        png.insert(png.end(), SIGNATURE, SIGNATURE + 8);
+        unsigned char header[13];
+        putBigEndian(header, (uint32_t)width);
+        putBigEndian(header + 4, (uint32_t)height);
+        header[8] = 8;      // bits per channel
+        header[9] = 2;      // RGB
+        header[10] = header[11] = header[12] = 0;
+        writeChunk(png, "IHDR", header, sizeof(header));
+
+        deflate(filtered.empty() ? NULL : &filtered[0], filtered.size());
+        writeChunk(png, "IDAT", compressed.empty() ? NULL : &compressed[0], compressed.size());
+        writeChunk(png, "IEND", NULL, 0);
+    }
+
+private:
+    uint32_t crcTable[256];
+    uint32_t literalCodes[288];
+    int literalLengths[288];
+    std::vector<unsigned char> filtered;
+    std::vector<unsigned char> compressed;
+    std::vector<int32_t> hashHead;
+    uint64_t bitBuffer;
+    int bitCount;
+
+    static void putBigEndian(unsigned char* out, uint32_t value)
+    {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+    uint32_t crc(uint32_t c, const unsigned char* data, size_t size) const
+    {
+        for (size_t i = 0; i < size; i++)
+            c = crcTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        return c;
+    }
+
+    void writeChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, size_t size)
+    {
+        unsigned char word[4];
+        putBigEndian(word, (uint32_t)size);
+        png.insert(png.end(), word, word + 4);
+        png.insert(png.end(), type, type + 4);
+        if (size > 0)
+            png.insert(png.end(), data, data + size);
+        uint32_t c = crc(0xFFFFFFFFu, (const unsigned char*)type, 4);
+        c = crc(c, data, size) ^ 0xFFFFFFFFu;
+        putBigEndian(word, c);
+        png.insert(png.end(), word, word + 4);
+    }
+
+    // deflate's bit order: values least significant bit first, Huffman codes most significant bit first
+    void putBits(uint32_t value, int count)
+    {
+        bitBuffer |= (uint64_t)value << bitCount;
+        bitCount += count;
+        while (bitCount >= 8)
+        {
+            compressed.push_back((unsigned char)bitBuffer);
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    static uint32_t reverse(uint32_t code, int length)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        return reversed;
+    }
+
+    void putLiteralLength(int symbol)
+    {
+        putBits(literalCodes[symbol], literalLengths[symbol]);
+    }
+
+    static uint32_t hashAt(const unsigned char* data)
+    {
+        return ((uint32_t)data[0] << 16 | (uint32_t)data[1] << 8 | data[2]) * 2654435761u >> (32 - PNG_HASH_BITS);
+    }
+
+    void putMatch(int length, int distance)
+    {
+        static const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                               4097, 6145, 8193, 12289, 16385, 24577 };
+        static const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        int l = 28;
+        while (LENGTH_BASE[l] > length)
+            l--;
+        putLiteralLength(257 + l);
+        putBits(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+        int d = 29;
+        while (DISTANCE_BASE[d] > distance)
+            d--;
+        putBits(reverse(d, 5), 5);
+        putBits(distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+    }
+
+    // zlib stream of one final fixed Huffman block
+    void deflate(const unsigned char* data, size_t size)
+    {
+        compressed.clear();
+        compressed.push_back(0x78);
+        compressed.push_back(0x01);
+        bitBuffer = 0;
+        bitCount = 0;
+        putBits(1, 1);      // final block
+        putBits(1, 2);      // fixed Huffman codes
+
+        hashHead.assign((size_t)1 << PNG_HASH_BITS, -1);
+        size_t i = 0;
+        while (i < size)
+        {
+            int length = 0, distance = 0;
+            if (i + PNG_MIN_MATCH <= size)
+            {
+                uint32_t hash = hashAt(data + i);
+                int32_t candidate = hashHead[hash];
+                hashHead[hash] = (int32_t)i;
+                if (candidate >= 0 && i - candidate <= (size_t)PNG_WINDOW)
+                {
+                    size_t limit = std::min(size - i, (size_t)PNG_MAX_MATCH);
+                    size_t n = 0;
+                    while (n < limit && data[candidate + n] == data[i + n])
+                        n++;
+                    if (n >= (size_t)PNG_MIN_MATCH)
+                    {
+                        length = (int)n;
+                        distance = (int)(i - candidate);
+                    }
+                }
+            }
+            if (length > 0)
+            {
+                putMatch(length, distance);
+                // the skipped positions still go into the table, so later matches can start inside this one
+                for (size_t k = i + 1; k < i + length && k + PNG_MIN_MATCH <= size; k++)
+                    hashHead[hashAt(data + k)] = (int32_t)k;
+                i += length;
+            }
+            else
+                putLiteralLength(data[i++]);
+        }
+        putLiteralLength(256);
+        if (bitCount > 0)
+            putBits(0, 8 - bitCount);
+
+        // Adler-32; 5552 bytes is the most that can be summed before the modulo without overflowing
+        uint32_t a = 1, b = 0;
+        for (size_t k = 0; k < size;)
+        {
+            size_t end = std::min(size, k + 5552);
+            for (; k < end; k++)
+            {
+                a += data[k];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        unsigned char adler[4];
+        putBigEndian(adler, (b << 16) | a);
+        compressed.insert(compressed.end(), adler, adler + 4);
+    }
+};
+#endif
@@ -0,0 +1,626 @@
+//
+//  ray_tracer.h
+//  3D Object Drawing
+//
+
+#ifndef RAY_TRACER_H
+#define RAY_TRACER_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "soft_framebuffer.h"
+#include "soft_simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Default ray tracer values
+const int TRACE_TILE_SIZE = 16;                 // pixels per work item side; a multiple of the 2x2 packet
+const int TRACE_LEAF_SIZE = 4;                  // boxes per BVH leaf
+const int TRACE_STACK_SIZE = 64;                // BVH traversal depth; median splits stay far below it
+const float TRACE_EPSILON = 1e-4f;              // secondary rays start this far off the surface
+const float TRACE_OCCLUSION_DISTANCE = 1.0f;    // occluders further away than this do not darken the ambient term
+const float TRACE_FAR = 1e30f;
+const float TRACE_AMBIENT = 0.35f;              // fragmentShader.fs LIT: 0.35 + 0.65 * light
+const float TRACE_DIFFUSE = 0.65f;
+
+struct RayTraceStats
+{
+    size_t primaryRays;     // of the last pass
+    size_t shadowRays;
+    size_t occlusionRays;
+    size_t stolenTiles;     // tiles a thread took from another thread's range
+    double traceMs;         // the last pass
+    double buildMs;
+    size_t boxCount;
+    size_t bvhNodes;
+};
+
+// the hash behind the per pixel random numbers, so every sample is the same whatever thread traces it
+inline uint32_t traceHash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline float traceRandom(uint32_t& state)
+{
+    state = traceHash(state);
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// A CPU reference renderer over the same scene nodes as the GL path. Every node is the built-in cube under its
+// model matrix, so a hit is an analytic slab test in the cube's local space; nodes with a mesh are traced as the
+// box that bounds them, and textured nodes show their tint.
+//
+// Boxes sit in a BVH of world space bounds (median splits on the longest axis). Rays travel in packets of four,
+// one 2x2 pixel block, through the BVH and the box tests four lanes at a time. The image is cut into 16x16 tiles
+// and each worker starts on its own contiguous range of them; a worker that runs dry steals from the range with
+// the most tiles left, so one expensive corner of the room does not leave the other threads idle.
+//
+// Each renderPass() adds one jittered sample per pixel to an accumulation buffer: a primary ray, a shadow ray
+// toward the fixed light and a cosine distributed occlusion ray. The lighting is fragmentShader.fs LIT with
+// what the raster path leaves out: the direct term is shadowed and the ambient term occluded. resolve() writes
+// the running average; the camera moving or the size changing starts the accumulation over.
+class RayTracer
+{
+public:
+    bool Shadows;
+    bool AmbientOcclusion;
+    RayTraceStats Stats;
+
+    // every worker of the pool traces; give it a pool it does not share with long jobs
+    explicit RayTracer(ThreadPool& pool) : Shadows(true), AmbientOcclusion(true), workers(pool), width(0), height(0), tilesX(0), tilesY(0), samples(0)
+    {
+        memset(&Stats, 0, sizeof(Stats));
+        queues.reset(new TileQueue[pool.size()]);
+        counters.resize(pool.size());
+    }
+
+    // all nodes, not a culled list: shadows and occlusion need what the camera cannot see
+    void build(const std::vector<SceneNode>& nodes)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<TraceBox> source;
+        source.reserve(nodes.size());
+        boxBounds.clear();
+        centroids.clear();
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            glm::mat4 toLocal = glm::inverse(nodes[i].model);
+            TraceBox box;
+            bool finite = true;
+            for (int row = 0; row < 3; row++)
+            {
+                for (int column = 0; column < 4; column++)
+                {
+                    box.toLocal[row * 4 + column] = toLocal[column][row];
+                    finite = finite && std::isfinite(toLocal[column][row]);
+                }
+            }
+            // a box squashed flat has no inverse and nothing to hit
+            if (!finite)
+                continue;
+            box.color = nodes[i].color;
+            source.push_back(box);
+
+            glm::vec3 boundsMin(TRACE_FAR), boundsMax(-TRACE_FAR);
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 local((corner & 1) ? CUBE_MAX.x : CUBE_MIN.x, (corner & 2) ? CUBE_MAX.y : CUBE_MIN.y, (corner & 4) ? CUBE_MAX.z : CUBE_MIN.z);
+                glm::vec3 world = glm::vec3(nodes[i].model * glm::vec4(local, 1.0f));
+                boundsMin = glm::min(boundsMin, world);
+                boundsMax = glm::max(boundsMax, world);
+            }
+            boxBounds.push_back(boundsMin);
+            boxBounds.push_back(boundsMax);
+            centroids.push_back((boundsMin + boundsMax) * 0.5f);
+        }
+
+        order.resize(source.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (int)i;
+        bvh.clear();
+        if (!source.empty())
+        {
+            bvh.reserve(source.size() * 2);
+            BvhNode root;
+            root.first = 0;
+            root.count = (int)source.size();
+            root.axis = 0;
+            bvh.push_back(root);
+            subdivide(0);
+        }
+        // leaves refer to runs of boxes, so store the boxes in leaf order
+        boxes.resize(source.size());
+        for (size_t i = 0; i < order.size(); i++)
+            boxes[i] = source[order[i]];
+
+        Stats.boxCount = boxes.size();
+        Stats.bvhNodes = bvh.size();
+        Stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        reset();
+    }
+
+    void setView(int w, int h, const glm::mat4& view, const glm::mat4& projection)
+    {
+        glm::mat4 inverse = glm::inverse(projection * view);
+        if (w == width && h == height && inverse == inverseViewProjection)
+            return;
+        width = w;
+        height = h;
+        tilesX = (w + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE;
+        tilesY = (h + TRACE_TILE_SIZE - 1) / TRACE_TILE_SIZE;
+        inverseViewProjection = inverse;
+        accumulation.resize((size_t)w * h);
+        reset();
+    }
+
+    // drops the accumulated samples, e.g. after the scene changed
+    void reset()
+    {
+        std::fill(accumulation.begin(), accumulation.end(), glm::vec3(0.0f));
+        samples = 0;
+    }
+
+    int sampleCount() const { return samples; }
+
+    // adds one sample to every pixel
+    void renderPass()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int tileCount = tilesX * tilesY;
+        unsigned int workerCount = workers.size();
+        for (unsigned int w = 0; w < workerCount; w++)
+        {
+            queues[w].next = (int)((size_t)tileCount * w / workerCount);
+            queues[w].end = (int)((size_t)tileCount * (w + 1) / workerCount);
+            memset(&counters[w], 0, sizeof(WorkerCounters));
+        }
+        uint32_t sample = (uint32_t)samples;
+        workers.runOnAll([this, sample](unsigned int worker) { traceWorker(worker, sample); });
+        samples++;
+
+        Stats.primaryRays = Stats.shadowRays = Stats.occlusionRays = Stats.stolenTiles = 0;
+        for (unsigned int w = 0; w < workerCount; w++)
+        {
+            Stats.primaryRays += counters[w].primaryRays;
+            Stats.shadowRays += counters[w].shadowRays;
+            Stats.occlusionRays += counters[w].occlusionRays;
+            Stats.stolenTiles += counters[w].stolenTiles;
+        }
+        Stats.traceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t raysPerPass() const { return Stats.primaryRays + Stats.shadowRays + Stats.occlusionRays; }
+
+    // the average of the samples so far
+    void resolve(SoftFramebuffer& target) const
+    {
+        if (target.width != width || target.height != height)
+            target.resize(width, height);
+        float scale = samples > 0 ? 1.0f / samples : 0.0f;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+                target.color[(size_t)y * target.stride + x] = softPackColor(accumulation[(size_t)y * width + x] * scale);
+        }
+    }
+
+private:
+    struct TraceBox
+    {
+        float toLocal[12];  // the first three rows of the inverse model matrix
+        glm::vec3 color;
+    };
+
+    struct BvhNode
+    {
+        glm::vec3 boundsMin, boundsMax;
+        int first;  // leaf: first box; inner node: left child, the right one follows it
+        int count;  // boxes in a leaf, 0 for an inner node
+        int axis;   // the split axis, for visiting the nearer child first
+    };
+
+    // four rays in structure of arrays form, one per lane
+    struct RayPacket
+    {
+        SoftFloat4 originX, originY, originZ;
+        SoftFloat4 dirX, dirY, dirZ;
+        SoftFloat4 invDirX, invDirY, invDirZ;
+        SoftFloat4 tMax;    // closest hit so far, or how far to look
+        SoftFloat4 active;  // lanes that still take part
+        int box[4];         // closest hit per lane, -1 for none
+    };
+
+    // a worker's tiles; padded to a cache line so the atomics of different workers do not share one
+    struct TileQueue
+    {
+        std::atomic<int> next;
+        int end;
+        char padding[64 - sizeof(std::atomic<int>) - sizeof(int)];
+    };
+
+    struct WorkerCounters
+    {
+        size_t primaryRays, shadowRays, occlusionRays, stolenTiles;
+        char padding[64 - 4 * sizeof(size_t)];
+    };
+
+    ThreadPool& workers;
+    std::vector<TraceBox> boxes;
+    std::vector<BvhNode> bvh;
+    std::vector<glm::vec3> boxBounds;   // build scratch: min and max per box
+    std::vector<glm::vec3> centroids;
+    std::vector<int> order;
+    std::unique_ptr<TileQueue[]> queues;
+    std::vector<WorkerCounters> counters;
+    std::vector<glm::vec3> accumulation;
+    glm::mat4 inverseViewProjection;
+    int width, height;
+    int tilesX, tilesY;
+    int samples;
+
+    void subdivide(int index)
+    {
+        int first = bvh[index].first, count = bvh[index].count;
+        glm::vec3 boundsMin(TRACE_FAR), boundsMax(-TRACE_FAR), centerMin(TRACE_FAR), centerMax(-TRACE_FAR);
+        for (int i = first; i < first + count; i++)
+        {
+            boundsMin = glm::min(boundsMin, boxBounds[order[i] * 2]);
+            boundsMax = glm::max(boundsMax, boxBounds[order[i] * 2 + 1]);
+            centerMin = glm::min(centerMin, centroids[order[i]]);
+            centerMax = glm::max(centerMax, centroids[order[i]]);
+        }
+        bvh[index].boundsMin = boundsMin;
+        bvh[index].boundsMax = boundsMax;
+        if (count <= TRACE_LEAF_SIZE)
+            return;
+        glm::vec3 extent = centerMax - centerMin;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        // stacked boxes with one center: splitting them would not separate anything
+        if (extent[axis] <= 0.0f)
+            return;
+
+        int middle = first + count / 2;
+        const std::vector<glm::vec3>& centers = centroids;
+        std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+            [&centers, axis](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+        int left = (int)bvh.size();
+        BvhNode child;
+        child.axis = 0;
+        child.first = first;
+        child.count = middle - first;
+        bvh.push_back(child);
+        child.first = middle;
+        child.count = first + count - middle;
+        bvh.push_back(child);
+        bvh[index].first = left;
+        bvh[index].count = 0;
+        bvh[index].axis = axis;
+        subdivide(left);
+        subdivide(left + 1);
+    }
+
+    // axis parallel directions divide by a tiny value instead of zero, which keeps the slabs free of NaNs
+    static SoftFloat4 safeReciprocal(SoftFloat4 d)
+    {
+        SoftFloat4 tiny = soft4(1e-20f);
+        return soft4(1.0f) / soft4Select(soft4Lt(soft4Abs(d), tiny), tiny, d);
+    }
+
+    static SoftFloat4 packetHitsBounds(const RayPacket& packet, const BvhNode& node)
+    {
+        SoftFloat4 t0x = (soft4(node.boundsMin.x) - packet.originX) * packet.invDirX;
+        SoftFloat4 t1x = (soft4(node.boundsMax.x) - packet.originX) * packet.invDirX;
+        SoftFloat4 t0y = (soft4(node.boundsMin.y) - packet.originY) * packet.invDirY;
+        SoftFloat4 t1y = (soft4(node.boundsMax.y) - packet.originY) * packet.invDirY;
+        SoftFloat4 t0z = (soft4(node.boundsMin.z) - packet.originZ) * packet.invDirZ;
+        SoftFloat4 t1z = (soft4(node.boundsMax.z) - packet.originZ) * packet.invDirZ;
+        SoftFloat4 tNear = soft4Max(soft4Max(soft4Min(t0x, t1x), soft4Min(t0y, t1y)), soft4Min(t0z, t1z));
+        SoftFloat4 tFar = soft4Min(soft4Min(soft4Max(t0x, t1x), soft4Max(t0y, t1y)), soft4Max(t0z, t1z));
+        return packet.active & soft4Ge(tFar, soft4Max(tNear, soft4(0.0f))) & soft4Lt(tNear, packet.tMax);
+    }
+
+    // the packet moved into the box's local space, where the box is CUBE_MIN..CUBE_MAX; the transform is affine,
+    // so t along the local ray is t along the world ray
+    void intersectBox(RayPacket& packet, int index, bool anyHit) const
+    {
+        const float* m = boxes[index].toLocal;
+        SoftFloat4 ox = soft4(m[0]) * packet.originX + soft4(m[1]) * packet.originY + soft4(m[2]) * packet.originZ + soft4(m[3]);
+        SoftFloat4 oy = soft4(m[4]) * packet.originX + soft4(m[5]) * packet.originY + soft4(m[6]) * packet.originZ + soft4(m[7]);
+        SoftFloat4 oz = soft4(m[8]) * packet.originX + soft4(m[9]) * packet.originY + soft4(m[10]) * packet.originZ + soft4(m[11]);
+        SoftFloat4 ix = safeReciprocal(soft4(m[0]) * packet.dirX + soft4(m[1]) * packet.dirY + soft4(m[2]) * packet.dirZ);
+        SoftFloat4 iy = safeReciprocal(soft4(m[4]) * packet.dirX + soft4(m[5]) * packet.dirY + soft4(m[6]) * packet.dirZ);
+        SoftFloat4 iz = safeReciprocal(soft4(m[8]) * packet.dirX + soft4(m[9]) * packet.dirY + soft4(m[10]) * packet.dirZ);
+
+        SoftFloat4 t0x = (soft4(CUBE_MIN.x) - ox) * ix, t1x = (soft4(CUBE_MAX.x) - ox) * ix;
+        SoftFloat4 t0y = (soft4(CUBE_MIN.y) - oy) * iy, t1y = (soft4(CUBE_MAX.y) - oy) * iy;
+        SoftFloat4 t0z = (soft4(CUBE_MIN.z) - oz) * iz, t1z = (soft4(CUBE_MAX.z) - oz) * iz;
+        SoftFloat4 tNear = soft4Max(soft4Max(soft4Min(t0x, t1x), soft4Min(t0y, t1y)), soft4Min(t0z, t1z));
+        SoftFloat4 tFar = soft4Min(soft4Min(soft4Max(t0x, t1x), soft4Max(t0y, t1y)), soft4Max(t0z, t1z));
+        // a ray starting inside the box hits its far side
+        SoftFloat4 epsilon = soft4(TRACE_EPSILON);
+        SoftFloat4 t = soft4Select(soft4Gt(tNear, epsilon), tNear, tFar);
+        SoftFloat4 hit = packet.active & soft4Ge(tFar, tNear) & soft4Gt(tFar, epsilon) & soft4Lt(t, packet.tMax);
+        int bits = soft4Mask(hit);
+        if (!bits)
+            return;
+        packet.tMax = soft4Select(hit, t, packet.tMax);
+        if (anyHit)
+        {
+            packet.active = soft4AndNot(hit, packet.active);
+            return;
+        }
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (bits & (1 << lane))
+                packet.box[lane] = index;
+        }
+    }
+
+    // closest hit per lane, or with anyHit the first hit, which retires the lane
+    void intersect(RayPacket& packet, bool anyHit) const
+    {
+        if (bvh.empty() || !soft4Any(packet.active))
+            return;
+        float dx[4], dy[4], dz[4];
+        soft4Store(dx, packet.dirX);
+        soft4Store(dy, packet.dirY);
+        soft4Store(dz, packet.dirZ);
+        const float direction[3] = { dx[0] + dx[1] + dx[2] + dx[3], dy[0] + dy[1] + dy[2] + dy[3], dz[0] + dz[1] + dz[2] + dz[3] };
+
+        int stack[TRACE_STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const BvhNode& node = bvh[stack[--top]];
+            if (!soft4Any(packetHitsBounds(packet, node)))
+                continue;
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                    intersectBox(packet, i, anyHit);
+                if (anyHit && !soft4Any(packet.active))
+                    return;
+                continue;
+            }
+            // the nearer child goes on the stack last so it is visited first and shortens tMax for the other
+            bool backwards = direction[node.axis] < 0.0f;
+            stack[top++] = node.first + (backwards ? 0 : 1);
+            stack[top++] = node.first + (backwards ? 1 : 0);
+        }
+    }
+
+    static void setupPacket(RayPacket& packet, const float* origin, const float* direction, float tMax, int laneMask)
+    {
+        packet.originX = soft4Load(origin);
+        packet.originY = soft4Load(origin + 4);
+        packet.originZ = soft4Load(origin + 8);
+        packet.dirX = soft4Load(direction);
+        packet.dirY = soft4Load(direction + 4);
+        packet.dirZ = soft4Load(direction + 8);
+        packet.invDirX = safeReciprocal(packet.dirX);
+        packet.invDirY = safeReciprocal(packet.dirY);
+        packet.invDirZ = safeReciprocal(packet.dirZ);
+        packet.tMax = soft4(tMax);
+        uint32_t lanes[4];
+        for (int lane = 0; lane < 4; lane++)
+            lanes[lane] = (laneMask & (1 << lane)) ? 0xFFFFFFFFu : 0u;
+        packet.active = soft4LoadBits(lanes);
+        packet.box[0] = packet.box[1] = packet.box[2] = packet.box[3] = -1;
+    }
+
+    // the face a local space point lies on gives the normal; its world form is that row of the inverse matrix
+    glm::vec3 boxNormal(int index, const glm::vec3& point) const
+    {
+        const float* m = boxes[index].toLocal;
+        int face = 0;
+        float closest = TRACE_FAR, side = 1.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float local = m[axis * 4] * point.x + m[axis * 4 + 1] * point.y + m[axis * 4 + 2] * point.z + m[axis * 4 + 3];
+            float toMin = std::fabs(local - CUBE_MIN[axis]), toMax = std::fabs(local - CUBE_MAX[axis]);
+            if (toMin < closest)
+            {
+                closest = toMin;
+                face = axis;
+                side = -1.0f;
+            }
+            if (toMax < closest)
+            {
+                closest = toMax;
+                face = axis;
+                side = 1.0f;
+            }
+        }
+        return glm::normalize(glm::vec3(m[face * 4], m[face * 4 + 1], m[face * 4 + 2]) * side);
+    }
+
+    // a direction around n, more of them near n, so averaging the hits weighs them as a diffuse surface does
+    static glm::vec3 cosineDirection(const glm::vec3& n, uint32_t& random)
+    {
+        float phi = 6.2831853f * traceRandom(random);
+        float r2 = traceRandom(random);
+        float r = std::sqrt(r2);
+        float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+        float a = -1.0f / (sign + n.z);
+        float b = n.x * n.y * a;
+        glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+        glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+        return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - r2));
+    }
+
+    void traceWorker(unsigned int self, uint32_t sample)
+    {
+        WorkerCounters& count = counters[self];
+        unsigned int workerCount = workers.size();
+        for (;;)
+        {
+            int tile = queues[self].next.fetch_add(1);
+            if (tile < queues[self].end)
+            {
+                traceTile(tile, sample, count);
+                continue;
+            }
+            // this range is done: help the one with the most left
+            int victim = -1, most = 0;
+            for (unsigned int w = 0; w < workerCount; w++)
+            {
+                int left = queues[w].end - queues[w].next.load(std::memory_order_relaxed);
+                if (left > most)
+                {
+                    most = left;
+                    victim = (int)w;
+                }
+            }
+            if (victim < 0)
+                return;
+            tile = queues[victim].next.fetch_add(1);
+            if (tile < queues[victim].end)
+            {
+                traceTile(tile, sample, count);
+                count.stolenTiles++;
+            }
+        }
+    }
+
+    void traceTile(int tile, uint32_t sample, WorkerCounters& count)
+    {
+        int x0 = (tile % tilesX) * TRACE_TILE_SIZE, y0 = (tile / tilesX) * TRACE_TILE_SIZE;
+        int x1 = std::min(x0 + TRACE_TILE_SIZE, width), y1 = std::min(y0 + TRACE_TILE_SIZE, height);
+        for (int y = y0; y < y1; y += 2)
+        {
+            for (int x = x0; x < x1; x += 2)
+                tracePacket(x, y, sample, count);
+        }
+    }
+
+    void tracePacket(int x, int y, uint32_t sample, WorkerCounters& count)
+    {
+        float origin[12], direction[12];
+        uint32_t random[4];
+        int pixels = 0;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            int px = x + (lane & 1), py = y + (lane >> 1);
+            if (px >= width || py >= height)
+            {
+                for (int c = 0; c < 3; c++)
+                    origin[c * 4 + lane] = direction[c * 4 + lane] = 0.0f;
+                continue;
+            }
+            pixels |= 1 << lane;
+            random[lane] = traceHash((uint32_t)(py * width + px) ^ traceHash(sample * 0x9E3779B9u + 1u));
+            // a jittered point in the pixel, unprojected at the near and far planes
+            float ndcX = (px + traceRandom(random[lane])) / width * 2.0f - 1.0f;
+            float ndcY = 1.0f - (py + traceRandom(random[lane])) / height * 2.0f;
+            glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+            glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+            glm::vec3 start = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - start);
+            for (int c = 0; c < 3; c++)
+            {
+                origin[c * 4 + lane] = start[c];
+                direction[c * 4 + lane] = dir[c];
+            }
+        }
+        RayPacket primary;
+        setupPacket(primary, origin, direction, TRACE_FAR, pixels);
+        intersect(primary, false);
+
+        // surface points for the secondary rays, which reuse the origin and direction arrays
+        float t[4];
+        soft4Store(t, primary.tMax);
+        glm::vec3 color[4], normal[4];
+        float light[4];
+        int shadowLanes = 0, occlusionLanes = 0;
+        for (int lane = 0; lane < 4; lane++)
+        {
+            int box = primary.box[lane];
+            if (!(pixels & (1 << lane)) || box < 0)
+                continue;
+            glm::vec3 start(origin[lane], origin[4 + lane], origin[8 + lane]);
+            glm::vec3 dir(direction[lane], direction[4 + lane], direction[8 + lane]);
+            glm::vec3 point = start + dir * t[lane];
+            glm::vec3 n = boxNormal(box, point);
+            // the side facing the viewer, also when the camera is inside a box
+            if (glm::dot(n, dir) > 0.0f)
+                n = -n;
+            color[lane] = boxes[box].color;
+            normal[lane] = n;
+            light[lane] = std::max(0.0f, glm::dot(n, SOFT_LIGHT_DIRECTION));
+            glm::vec3 offset = point + n * TRACE_EPSILON;
+            for (int c = 0; c < 3; c++)
+                origin[c * 4 + lane] = offset[c];
+            if (Shadows && light[lane] > 0.0f)
+                shadowLanes |= 1 << lane;
+            if (AmbientOcclusion)
+                occlusionLanes |= 1 << lane;
+        }
+
+        int shadowed = 0, occluded = 0;
+        if (shadowLanes)
+        {
+            float lightDirection[12];
+            for (int lane = 0; lane < 4; lane++)
+            {
+                for (int c = 0; c < 3; c++)
+                    lightDirection[c * 4 + lane] = SOFT_LIGHT_DIRECTION[c];
+            }
+            RayPacket shadow;
+            setupPacket(shadow, origin, lightDirection, TRACE_FAR, shadowLanes);
+            intersect(shadow, true);
+            shadowed = shadowLanes & ~soft4Mask(shadow.active);
+        }
+        if (occlusionLanes)
+        {
+            float occlusionDirection[12] = {};
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(occlusionLanes & (1 << lane)))
+                    continue;
+                glm::vec3 dir = cosineDirection(normal[lane], random[lane]);
+                for (int c = 0; c < 3; c++)
+                    occlusionDirection[c * 4 + lane] = dir[c];
+            }
+            RayPacket occlusion;
+            setupPacket(occlusion, origin, occlusionDirection, TRACE_OCCLUSION_DISTANCE, occlusionLanes);
+            intersect(occlusion, true);
+            occluded = occlusionLanes & ~soft4Mask(occlusion.active);
+        }
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (!(pixels & (1 << lane)))
+                continue;
+            count.primaryRays++;
+            count.shadowRays += (shadowLanes >> lane) & 1;
+            count.occlusionRays += (occlusionLanes >> lane) & 1;
+            glm::vec3 shade = SOFT_CLEAR_COLOR;
+            if (primary.box[lane] >= 0)
+            {
+                float ambient = (occluded & (1 << lane)) ? 0.0f : TRACE_AMBIENT;
+                float direct = (shadowed & (1 << lane)) ? 0.0f : TRACE_DIFFUSE * light[lane];
+                shade = color[lane] * (ambient + direct);
+            }
+            accumulation[(size_t)(y + (lane >> 1)) * width + x + (lane & 1)] += shade;
+        }
+    }
+};
+#endif
@@ -0,0 +1,150 @@
+//
+//  redraw_scheduler.h
+//  3D Object Drawing
+//
+
+#ifndef REDRAW_SCHEDULER_H
+#define REDRAW_SCHEDULER_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Why a frame has to be drawn; a frame with none of these set is skipped in on-demand mode
+enum Redraw_Reason {
+    REDRAW_INPUT = 1,       // events arrived or a key is held
+    REDRAW_WINDOW = 2,      // resize or the window system asked for a repaint
+    REDRAW_ANIMATION = 4,   // something in the scene is moving
+    REDRAW_STREAMING = 8,   // a mesh, texture level or shader variant changed what is on screen
+    REDRAW_REASON_COUNT = 4
+};
+
+// Default on-demand values
+const double REDRAW_IDLE_TIMEOUT = 0.5;         // seconds the loop sleeps when nothing is pending
+const double REDRAW_LOADING_TIMEOUT = 0.02;     // while workers are still loading, look for finished work this often
+const double REDRAW_REPORT_SECONDS = 10.0;
+
+
+// CPU time used by the whole process so far, all threads, in seconds
+inline double processCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+        return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Decides whether the frame loop draws. Anything that changes the picture calls request(); in on-demand mode a
+// loop iteration with no request skips culling, drawing and the swap, and the next one sleeps in
+// glfwWaitEventsTimeout until an event arrives. With on-demand off every iteration draws, as before.
+// Every REDRAW_REPORT_SECONDS it prints frames per minute, the process CPU usage and the share of time asleep.
+class RedrawScheduler
+{
+public:
+    bool OnDemand;
+
+    RedrawScheduler() : OnDemand(false), dirty(REDRAW_WINDOW), frames(0), skipped(0), idleSeconds(0.0), windowStart(-1.0), cpuStart(0.0)
+    {
+        for (int i = 0; i < REDRAW_REASON_COUNT; i++)
+            reasonFrames[i] = 0;
+    }
+
+    // safe from any thread: the GLFW callbacks run inside the event poll, the simulation on its own thread
+    void request(unsigned int reasons)
+    {
+        if (reasons)
+            dirty.fetch_or(reasons, std::memory_order_relaxed);
+    }
+
+    bool frameDue() const
+    {
+        return !OnDemand || dirty.load(std::memory_order_relaxed) != 0;
+    }
+
+    // the top of the loop: when the last iteration found nothing to draw, sleep until an event or the timeout
+    // (short while loads are in flight, so finished work is picked up promptly). True if it slept.
+    bool waitIfIdle(bool loading)
+    {
+        if (frameDue())
+            return false;
+        double start = glfwGetTime();
+        glfwWaitEventsTimeout(loading ? REDRAW_LOADING_TIMEOUT : REDRAW_IDLE_TIMEOUT);
+        idleSeconds += glfwGetTime() - start;
+        return true;
+    }
+
+    void frameDrawn()
+    {
+        frames++;
+        unsigned int reasons = dirty.exchange(0, std::memory_order_relaxed);
+        for (int i = 0; i < REDRAW_REASON_COUNT; i++)
+        {
+            if (reasons & (1u << i))
+                reasonFrames[i]++;
+        }
+    }
+
+    void frameSkipped()
+    {
+        skipped++;
+    }
+
+    // call once per loop iteration, drawn or not
+    void report(double now)
+    {
+        if (windowStart < 0.0)
+        {
+            windowStart = now;
+            cpuStart = processCpuSeconds();
+            return;
+        }
+        double seconds = now - windowStart;
+        if (seconds < REDRAW_REPORT_SECONDS)
+            return;
+        double cpu = processCpuSeconds();
+        std::cout << "REDRAW:: " << (OnDemand ? "on demand" : "continuous") << ", " << frames * 60.0 / seconds << " frames/min (" << frames
+            << " drawn, " << skipped << " skipped), CPU " << (cpu - cpuStart) * 100.0 / seconds << "% of a core, asleep "
+            << idleSeconds * 100.0 / seconds << "% of the time; frames for input " << reasonFrames[0] << ", window " << reasonFrames[1]
+            << ", animation " << reasonFrames[2] << ", streaming " << reasonFrames[3] << std::endl;
+        windowStart = now;
+        cpuStart = cpu;
+        frames = skipped = 0;
+        idleSeconds = 0.0;
+        for (int i = 0; i < REDRAW_REASON_COUNT; i++)
+            reasonFrames[i] = 0;
+    }
+
+private:
+    std::atomic<unsigned int> dirty;
+    unsigned int frames, skipped;
+    unsigned int reasonFrames[REDRAW_REASON_COUNT];
+    double idleSeconds;
+    double windowStart;
+    double cpuStart;
+};
+#endif
@@ -0,0 +1,677 @@
+//
+//  render_graph.h
+//  3D Object Drawing
+//
+
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Default render graph values
+const int RENDER_GRAPH_MAX_COLOR_ATTACHMENTS = 8;
+const int BACKBUFFER = 0;                   // resource handle of the window's default framebuffer
+
+// what a pass does with a target it writes before drawing
+enum RenderTarget_Load {
+    RT_LOAD,        // keep what earlier passes wrote (the earlier writers are kept and run first)
+    RT_CLEAR,       // clear to the write's clear value
+    RT_DONT_CARE    // the pass covers every pixel it uses; nothing is cleared
+};
+
+// Size and format of a transient target. A width of 0 means "windowScale times the backbuffer", so window sized
+// targets follow resizes on their own.
+struct RenderTargetDesc
+{
+    GLenum internalFormat;
+    int width, height;
+    float windowScale;
+
+    static RenderTargetDesc windowSized(GLenum internalFormat, float scale = 1.0f)
+    {
+        RenderTargetDesc desc = { internalFormat, 0, 0, scale };
+        return desc;
+    }
+
+    static RenderTargetDesc fixed(GLenum internalFormat, int width, int height)
+    {
+        RenderTargetDesc desc = { internalFormat, width, height, 1.0f };
+        return desc;
+    }
+};
+
+class RenderGraph;
+typedef std::function<void(const RenderGraph& graph)> RenderPassExecute;
+
+
+// Passes declare the targets they read and write; the graph works out the rest once per change instead of main()
+// hand-managing framebuffers. compile() drops passes whose output nobody consumes, orders the remaining ones so
+// every reader runs after all writers of what it reads, and gives transient targets whose lifetimes do not overlap
+// the same texture from a shared pool. Framebuffers are built at compile time too, so execute() is only binds,
+// the declared clears and the pass callbacks: no allocation and no GL object creation per frame.
+// The declared graph is kept between frames; it recompiles when the backbuffer size changes or a pass is toggled.
+class RenderGraph
+{
+public:
+    // results of the last compile
+    int LivePasses;
+    int CulledPasses;
+    int TargetCount;            // transient targets used by live passes
+    int TextureCount;           // pool textures backing them
+    size_t PeakBytes;           // most target memory any single pass needs alive at once
+    size_t AllocatedBytes;      // what the pool holds in GL
+    size_t UnaliasedBytes;      // what one texture per target would have cost
+
+    RenderGraph() : LivePasses(0), CulledPasses(0), TargetCount(0), TextureCount(0), PeakBytes(0), AllocatedBytes(0), UnaliasedBytes(0),
+        backbufferWidth(0), backbufferHeight(0), dirty(true)
+    {
+        Resource backbuffer;
+        backbuffer.name = "backbuffer";
+        backbuffer.imported = true;
+        resources.push_back(backbuffer);
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        releaseFramebuffers();
+        for (size_t i = 0; i < pool.size(); i++)
+            glDeleteTextures(1, &pool[i].texture);
+        pool.clear();
+        dirty = true;
+    }
+
+    int createTarget(const char* name, const RenderTargetDesc& desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        dirty = true;
+        return (int)resources.size() - 1;
+    }
+
+    // hasSideEffects keeps a pass alive even when nothing reads what it writes (readbacks, timers, debug output)
+    int addPass(const char* name, RenderPassExecute execute, bool hasSideEffects = false)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.execute = execute;
+        pass.sideEffects = hasSideEffects;
+        passes.push_back(pass);
+        dirty = true;
+        return (int)passes.size() - 1;
+    }
+
+    void read(int pass, int resource)
+    {
+        passes[pass].reads.push_back(resource);
+        dirty = true;
+    }
+
+    // depth formats become the depth attachment, everything else the next color attachment in declaration order
+    void write(int pass, int resource, RenderTarget_Load load = RT_DONT_CARE, const glm::vec4& clearValue = glm::vec4(0.0f))
+    {
+        PassWrite write;
+        write.resource = resource;
+        write.load = load;
+        write.clearValue = clearValue;
+        write.drawBuffer = -1;
+        passes[pass].writes.push_back(write);
+        dirty = true;
+    }
+
+    void setPassEnabled(int pass, bool enabled)
+    {
+        if (passes[pass].enabled != enabled)
+        {
+            passes[pass].enabled = enabled;
+            dirty = true;
+        }
+    }
+
+    void setBackbufferSize(int width, int height)
+    {
+        if (width != backbufferWidth || height != backbufferHeight)
+        {
+            backbufferWidth = width;
+            backbufferHeight = height;
+            dirty = true;
+        }
+    }
+
+    // GL texture behind a target for the current compile; passes look up what they read through this
+    unsigned int texture(int resource) const
+    {
+        int slot = resources[resource].slot;
+        return slot < 0 ? 0 : pool[slot].texture;
+    }
+
+    int width(int resource) const { return resources[resource].width; }
+    int height(int resource) const { return resources[resource].height; }
+
+    // culls, orders, aliases and builds the framebuffers; execute() calls it whenever the graph changed
+    void compile()
+    {
+        dirty = false;
+        releaseFramebuffers();
+        order.clear();
+
+        cullPasses();
+        if (!sortPasses())
+            return;
+        computeLifetimes();
+        assignTextures();
+        buildFramebuffers();
+    }
+
+    void execute()
+    {
+        if (dirty)
+            compile();
+        GLint bound = -1;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Pass& pass = passes[order[i]];
+            if ((GLint)pass.fbo != bound)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+                bound = pass.fbo;
+            }
+            glViewport(0, 0, pass.width, pass.height);
+            for (size_t w = 0; w < pass.writes.size(); w++)
+            {
+                const PassWrite& write = pass.writes[w];
+                if (write.load != RT_CLEAR)
+                    continue;
+                if (write.drawBuffer < 0)
+                {
+                    // depth-stencil attachment, or the default framebuffer's depth
+                    glClearBufferfi(GL_DEPTH_STENCIL, 0, write.clearValue.x, 0);
+                }
+                else
+                    glClearBufferfv(GL_COLOR, write.drawBuffer, &write.clearValue[0]);
+            }
+            pass.execute(*this);
+        }
+        if (bound != 0)
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // one line for the periodic stats output
+    void printStats() const
+    {
+        std::cout << "render graph " << LivePasses << " passes (" << CulledPasses << " culled), " << TargetCount << " targets in " << TextureCount
+            << " textures, peak " << PeakBytes / 1024 << " KiB, allocated " << AllocatedBytes / 1024 << " KiB (" << UnaliasedBytes / 1024
+            << " KiB without aliasing)" << std::endl;
+    }
+
+private:
+    struct Resource
+    {
+        std::string name;
+        RenderTargetDesc desc;
+        bool imported;
+        int width, height;
+        int firstUse, lastUse;  // positions in the execution order, -1 when no live pass touches it
+        int slot;               // pool entry backing it
+
+        Resource() : imported(false), width(0), height(0), firstUse(-1), lastUse(-1), slot(-1)
+        {
+            desc = RenderTargetDesc::windowSized(GL_RGBA8);
+        }
+    };
+
+    struct PassWrite
+    {
+        int resource;
+        RenderTarget_Load load;
+        glm::vec4 clearValue;
+        int drawBuffer;         // color attachment index, -1 for depth
+    };
+
+    struct Pass
+    {
+        std::string name;
+        RenderPassExecute execute;
+        std::vector<int> reads;
+        std::vector<PassWrite> writes;
+        bool sideEffects;
+        bool enabled;
+        bool live;
+        unsigned int fbo;
+        int width, height;
+
+        Pass() : sideEffects(false), enabled(true), live(false), fbo(0), width(0), height(0) {}
+    };
+
+    struct PoolTexture
+    {
+        GLenum internalFormat;
+        int width, height;
+        unsigned int texture;
+        int lastUse;            // last execution position of the targets aliased onto it in this compile
+        bool taken;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<int> order;
+    std::vector<PoolTexture> pool;
+    std::vector<unsigned int> framebuffers;
+    int backbufferWidth, backbufferHeight;
+    bool dirty;
+
+    static bool isDepthFormat(GLenum internalFormat)
+    {
+        return internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8 || internalFormat == GL_DEPTH_COMPONENT24
+            || internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH_COMPONENT16;
+    }
+
+    static bool hasStencil(GLenum internalFormat)
+    {
+        return internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+    }
+
+    // pixel transfer format/type for glTexImage2D and the size per texel
+    static void formatInfo(GLenum internalFormat, GLenum& format, GLenum& type, int& bytes)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; bytes = 1; break;
+        case GL_R16F: format = GL_RED; type = GL_HALF_FLOAT; bytes = 2; break;
+        case GL_R32F: format = GL_RED; type = GL_FLOAT; bytes = 4; break;
+        case GL_RG16F: format = GL_RG; type = GL_HALF_FLOAT; bytes = 4; break;
+        case GL_RGBA16F: format = GL_RGBA; type = GL_HALF_FLOAT; bytes = 8; break;
+        case GL_RGBA32F: format = GL_RGBA; type = GL_FLOAT; bytes = 16; break;
+        case GL_R11F_G11F_B10F: format = GL_RGB; type = GL_FLOAT; bytes = 4; break;
+        case GL_DEPTH_COMPONENT16: format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_SHORT; bytes = 2; break;
+        case GL_DEPTH_COMPONENT24: format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; bytes = 4; break;
+        case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; bytes = 4; break;
+        case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; bytes = 4; break;
+        case GL_DEPTH32F_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; bytes = 8; break;
+        default: format = GL_RGBA; type = GL_UNSIGNED_BYTE; bytes = 4; break;
+        }
+    }
+
+    static size_t targetBytes(const Resource& resource)
+    {
+        GLenum format, type;
+        int bytes;
+        formatInfo(resource.desc.internalFormat, format, type, bytes);
+        return (size_t)resource.width * resource.height * bytes;
+    }
+
+    // a pass is live when it has side effects, writes the backbuffer, or produces something a live pass consumes
+    void cullPasses()
+    {
+        std::vector<int> work;
+        for (size_t p = 0; p < passes.size(); p++)
+        {
+            Pass& pass = passes[p];
+            pass.live = false;
+            if (!pass.enabled)
+                continue;
+            bool root = pass.sideEffects;
+            for (size_t w = 0; w < pass.writes.size(); w++)
+                root = root || resources[pass.writes[w].resource].imported;
+            if (root)
+            {
+                pass.live = true;
+                work.push_back((int)p);
+            }
+        }
+        while (!work.empty())
+        {
+            int consumer = work.back();
+            work.pop_back();
+            for (size_t p = 0; p < passes.size(); p++)
+            {
+                Pass& producer = passes[p];
+                if (producer.live || !producer.enabled || !producerFeeds((int)p, consumer))
+                    continue;
+                producer.live = true;
+                work.push_back((int)p);
+            }
+        }
+        LivePasses = CulledPasses = 0;
+        for (size_t p = 0; p < passes.size(); p++)
+            (passes[p].live ? LivePasses : CulledPasses)++;
+    }
+
+    // producer writes something consumer reads, or something consumer loads and writes on top of (earlier writers only)
+    bool producerFeeds(int producer, int consumer) const
+    {
+        if (producer == consumer)
+            return false;
+        const Pass& from = passes[producer];
+        const Pass& to = passes[consumer];
+        for (size_t w = 0; w < from.writes.size(); w++)
+        {
+            int resource = from.writes[w].resource;
+            for (size_t r = 0; r < to.reads.size(); r++)
+            {
+                if (to.reads[r] == resource)
+                    return true;
+            }
+            if (producer < consumer)
+            {
+                for (size_t cw = 0; cw < to.writes.size(); cw++)
+                {
+                    if (to.writes[cw].resource == resource && to.writes[cw].load == RT_LOAD)
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // must producer run before consumer: readers after every writer, several writers in declaration order
+    bool mustPrecede(int producer, int consumer) const
+    {
+        if (producer == consumer)
+            return false;
+        const Pass& from = passes[producer];
+        const Pass& to = passes[consumer];
+        for (size_t w = 0; w < from.writes.size(); w++)
+        {
+            int resource = from.writes[w].resource;
+            for (size_t r = 0; r < to.reads.size(); r++)
+            {
+                if (to.reads[r] == resource)
+                    return true;
+            }
+            for (size_t cw = 0; cw < to.writes.size(); cw++)
+            {
+                if (to.writes[cw].resource == resource && producer < consumer)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Kahn's algorithm over the live passes; among ready passes the earliest declared goes first so the order is stable
+    bool sortPasses()
+    {
+        std::vector<int> pending(passes.size(), 0);
+        for (size_t a = 0; a < passes.size(); a++)
+        {
+            for (size_t b = 0; b < passes.size(); b++)
+            {
+                if (passes[a].live && passes[b].live && mustPrecede((int)a, (int)b))
+                    pending[b]++;
+            }
+        }
+        std::vector<bool> placed(passes.size(), false);
+        for (int placedCount = 0; placedCount < LivePasses; placedCount++)
+        {
+            int next = -1;
+            for (size_t p = 0; p < passes.size() && next < 0; p++)
+            {
+                if (passes[p].live && !placed[p] && pending[p] == 0)
+                    next = (int)p;
+            }
+            if (next < 0)
+            {
+                std::cout << "ERROR::RENDER_GRAPH:: dependency cycle between passes:";
+                for (size_t p = 0; p < passes.size(); p++)
+                {
+                    if (passes[p].live && !placed[p])
+                        std::cout << " " << passes[p].name;
+                }
+                std::cout << std::endl;
+                order.clear();
+                return false;
+            }
+            placed[next] = true;
+            order.push_back(next);
+            for (size_t b = 0; b < passes.size(); b++)
+            {
+                if (passes[b].live && mustPrecede(next, (int)b))
+                    pending[b]--;
+            }
+        }
+        return true;
+    }
+
+    void touch(int resource, int position)
+    {
+        Resource& r = resources[resource];
+        if (r.firstUse < 0 || position < r.firstUse)
+            r.firstUse = position;
+        if (position > r.lastUse)
+            r.lastUse = position;
+    }
+
+    void computeLifetimes()
+    {
+        for (size_t r = 0; r < resources.size(); r++)
+        {
+            Resource& resource = resources[r];
+            resource.firstUse = resource.lastUse = -1;
+            resource.slot = -1;
+            if (resource.imported)
+            {
+                resource.width = backbufferWidth;
+                resource.height = backbufferHeight;
+            }
+            else if (resource.desc.width > 0)
+            {
+                resource.width = resource.desc.width;
+                resource.height = resource.desc.height;
+            }
+            else
+            {
+                resource.width = (int)(backbufferWidth * resource.desc.windowScale + 0.5f);
+                resource.height = (int)(backbufferHeight * resource.desc.windowScale + 0.5f);
+            }
+        }
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Pass& pass = passes[order[i]];
+            for (size_t r = 0; r < pass.reads.size(); r++)
+                touch(pass.reads[r], (int)i);
+            for (size_t w = 0; w < pass.writes.size(); w++)
+                touch(pass.writes[w].resource, (int)i);
+        }
+    }
+
+    // Interval allocation: targets in order of first use, each takes a pool texture of the same format and size that
+    // no overlapping target holds, else a new one. Textures left over from the previous compile are reused before
+    // anything is created and deleted when nothing claims them.
+    void assignTextures()
+    {
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            pool[i].taken = false;
+            pool[i].lastUse = -1;
+        }
+        TargetCount = 0;
+        UnaliasedBytes = 0;
+        for (int position = 0; position < (int)order.size(); position++)
+        {
+            for (size_t r = 0; r < resources.size(); r++)
+            {
+                Resource& resource = resources[r];
+                if (resource.imported || resource.firstUse != position)
+                    continue;
+                TargetCount++;
+                UnaliasedBytes += targetBytes(resource);
+                int slot = -1;
+                // prefer a texture this compile already uses (true aliasing), then one from the last compile
+                for (size_t i = 0; i < pool.size() && slot < 0; i++)
+                {
+                    if (pool[i].taken && pool[i].lastUse < position && matches(pool[i], resource))
+                        slot = (int)i;
+                }
+                for (size_t i = 0; i < pool.size() && slot < 0; i++)
+                {
+                    if (!pool[i].taken && matches(pool[i], resource))
+                        slot = (int)i;
+                }
+                if (slot < 0)
+                    slot = createTexture(resource);
+                pool[slot].taken = true;
+                pool[slot].lastUse = resource.lastUse;
+                resource.slot = slot;
+            }
+        }
+
+        // drop what this compile did not claim; slots of the targets move with the compaction
+        std::vector<int> remap(pool.size(), -1);
+        size_t kept = 0;
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            if (!pool[i].taken)
+            {
+                glDeleteTextures(1, &pool[i].texture);
+                continue;
+            }
+            remap[i] = (int)kept;
+            pool[kept++] = pool[i];
+        }
+        pool.resize(kept);
+        for (size_t r = 0; r < resources.size(); r++)
+        {
+            if (resources[r].slot >= 0)
+                resources[r].slot = remap[resources[r].slot];
+        }
+
+        TextureCount = (int)pool.size();
+        AllocatedBytes = 0;
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            GLenum format, type;
+            int bytes;
+            formatInfo(pool[i].internalFormat, format, type, bytes);
+            AllocatedBytes += (size_t)pool[i].width * pool[i].height * bytes;
+        }
+        // what is alive while each pass runs: every target whose lifetime covers it
+        PeakBytes = 0;
+        for (int position = 0; position < (int)order.size(); position++)
+        {
+            size_t live = 0;
+            for (size_t r = 0; r < resources.size(); r++)
+            {
+                const Resource& resource = resources[r];
+                if (!resource.imported && resource.firstUse >= 0 && resource.firstUse <= position && position <= resource.lastUse)
+                    live += targetBytes(resource);
+            }
+            if (live > PeakBytes)
+                PeakBytes = live;
+        }
+    }
+
+    static bool matches(const PoolTexture& texture, const Resource& resource)
+    {
+        return texture.internalFormat == resource.desc.internalFormat && texture.width == resource.width && texture.height == resource.height;
+    }
+
+    int createTexture(const Resource& resource)
+    {
+        PoolTexture entry;
+        entry.internalFormat = resource.desc.internalFormat;
+        entry.width = resource.width;
+        entry.height = resource.height;
+        entry.lastUse = -1;
+        entry.taken = false;
+        GLenum format, type;
+        int bytes;
+        formatInfo(entry.internalFormat, format, type, bytes);
+        bool depth = isDepthFormat(entry.internalFormat);
+
+        glGenTextures(1, &entry.texture);
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, entry.internalFormat, entry.width, entry.height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pool.push_back(entry);
+        return (int)pool.size() - 1;
+    }
+
+    // one framebuffer per live pass that writes transient targets; passes writing the backbuffer use framebuffer 0
+    void buildFramebuffers()
+    {
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            Pass& pass = passes[order[i]];
+            pass.fbo = 0;
+            pass.width = backbufferWidth;
+            pass.height = backbufferHeight;
+            bool toBackbuffer = false;
+            for (size_t w = 0; w < pass.writes.size(); w++)
+                toBackbuffer = toBackbuffer || resources[pass.writes[w].resource].imported;
+            if (toBackbuffer)
+            {
+                for (size_t w = 0; w < pass.writes.size(); w++)
+                {
+                    if (!resources[pass.writes[w].resource].imported)
+                        std::cout << "ERROR::RENDER_GRAPH:: pass " << pass.name << " writes the backbuffer and an offscreen target" << std::endl;
+                    pass.writes[w].drawBuffer = 0;
+                }
+                continue;
+            }
+            if (pass.writes.empty())
+                continue;
+
+            glGenFramebuffers(1, &pass.fbo);
+            framebuffers.push_back(pass.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+            GLenum drawBuffers[RENDER_GRAPH_MAX_COLOR_ATTACHMENTS];
+            int colorCount = 0;
+            for (size_t w = 0; w < pass.writes.size(); w++)
+            {
+                PassWrite& write = pass.writes[w];
+                const Resource& resource = resources[write.resource];
+                if (w == 0)
+                {
+                    pass.width = resource.width;
+                    pass.height = resource.height;
+                }
+                else if (resource.width != pass.width || resource.height != pass.height)
+                    std::cout << "ERROR::RENDER_GRAPH:: pass " << pass.name << " writes targets of different sizes" << std::endl;
+                unsigned int texture = pool[resource.slot].texture;
+                if (isDepthFormat(resource.desc.internalFormat))
+                {
+                    write.drawBuffer = -1;
+                    GLenum attachment = hasStencil(resource.desc.internalFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+                }
+                else if (colorCount < RENDER_GRAPH_MAX_COLOR_ATTACHMENTS)
+                {
+                    write.drawBuffer = colorCount;
+                    drawBuffers[colorCount] = GL_COLOR_ATTACHMENT0 + colorCount;
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[colorCount], GL_TEXTURE_2D, texture, 0);
+                    colorCount++;
+                }
+            }
+            if (colorCount > 0)
+                glDrawBuffers(colorCount, drawBuffers);
+            else
+                glDrawBuffer(GL_NONE);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: Render graph pass " << pass.name << " is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void releaseFramebuffers()
+    {
+        if (!framebuffers.empty())
+            glDeleteFramebuffers((GLsizei)framebuffers.size(), &framebuffers[0]);
+        framebuffers.clear();
+        for (size_t p = 0; p < passes.size(); p++)
+            passes[p].fbo = 0;
+    }
+};
+#endif
@@ -0,0 +1,484 @@
+//
+//  render_service.h
+//  3D Object Drawing
+//
+
+#ifndef RENDER_SERVICE_H
+#define RENDER_SERVICE_H
+
+#include "metrics.h"
+#ifdef _WIN32
+#include <afunix.h>
+#else
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "camera_component.h"
+#include "mesh_data.h"
+#include "png_encoder.h"
+#include "scene.h"
+#include "soft_framebuffer.h"
+#include "soft_rasterizer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Default render service values
+const char* const SERVICE_SOCKET_PATH = "render.sock";
+const int SERVICE_MAX_SIZE = 4096;              // largest image side a request may ask for
+const size_t SERVICE_MAX_BATCH = 65536;         // views queued before a render command
+const int SERVICE_POLL_MS = 100;                // how often a waiting service checks whether it should stop
+const int SERVICE_RENDER_AHEAD = 2;             // finished images per context that may wait for earlier ones to be sent
+const int SERVICE_CLIENT_TIMEOUT_MS = 10000;    // a client that neither reads nor writes for this long is dropped
+
+enum Service_Format {
+    SERVICE_RAW,    // RGBA8, top row first
+    SERVICE_PNG
+};
+
+// One view of a batch. yaw and pitch are in degrees as the fly camera (camera.h) has them: yaw -90, pitch 0
+// looks down -Z.
+struct RenderRequest
+{
+    glm::vec3 position;
+    float yaw, pitch, fov;
+    int width, height;
+    Service_Format format;
+};
+
+// "view x y z yaw pitch fov width height [png|raw]"; false for anything else or sizes outside 1..SERVICE_MAX_SIZE
+inline bool parseRenderRequest(const std::string& line, RenderRequest& request)
+{
+    std::istringstream in(line);
+    std::string command, format = "png";
+    in >> command >> request.position.x >> request.position.y >> request.position.z >> request.yaw >> request.pitch >> request.fov
+        >> request.width >> request.height;
+    if (!in || command != "view")
+        return false;
+    in >> format;
+    if (format != "png" && format != "raw")
+        return false;
+    request.format = format == "raw" ? SERVICE_RAW : SERVICE_PNG;
+    return request.width > 0 && request.height > 0 && request.width <= SERVICE_MAX_SIZE && request.height <= SERVICE_MAX_SIZE
+        && request.fov > 0.0f && request.fov < 180.0f;
+}
+
+struct RenderResult
+{
+    std::vector<unsigned char> bytes;
+    int width, height;
+    Service_Format format;
+    bool ready;
+
+    RenderResult() : width(0), height(0), format(SERVICE_PNG), ready(false) {}
+};
+
+
+// Renders batches of views of one scene for thumbnail generation, served over a local Unix socket. The scene
+// and its meshes are loaded once; every context (a CPU rasterizer with its own framebuffer, camera and thread
+// pool) keeps them for the life of the service and renders view after view. A batch is spread over all
+// contexts, which pull the next view in request order, and every image goes back to the client as soon as it
+// and all the ones before it are done. Contexts run at most SERVICE_RENDER_AHEAD views each ahead of what has
+// been sent, so one slow view holds back a few finished images, not the rest of the batch.
+//
+// The protocol is line based. "view ..." (see parseRenderRequest) queues a view; "render" renders the queued
+// views and answers each with "image <index> <width> <height> <png|raw> <bytes>\n" and the bytes, then
+// "done <count> <ms>\n"; "stats" answers one line of totals; "quit" closes the connection; "shutdown" stops the
+// service. Errors are answered with "error <reason>\n". Clients are served one at a time, so one that stops
+// reading its images or goes quiet is dropped after SERVICE_CLIENT_TIMEOUT_MS.
+class RenderService
+{
+public:
+    // contexts 0 picks one per core
+    explicit RenderService(unsigned int contexts = 0, unsigned int threadsPerContext = 1) : running(false), totalImages(0), totalBusyMs(0.0),
+        imagesMetric(metricsRegistry().counter("render_service_images_total", "Images the render service has sent")),
+        latencyMetric(metricsRegistry().histogram("render_service_latency_seconds", "From a view request arriving to its image being sent"))
+    {
+        if (contexts == 0)
+            contexts = std::max(1u, std::thread::hardware_concurrency());
+        contextPool.reset(new ThreadPool(contexts));
+        for (unsigned int i = 0; i < contexts; i++)
+            this->contexts.push_back(std::unique_ptr<Context>(new Context(threadsPerContext)));
+    }
+
+    // a mesh in the 8 float vertex format, for every context; the handle is what SceneNode::mesh refers to
+    int addMesh(const MeshData& mesh)
+    {
+        int handle = -1;
+        for (size_t i = 0; i < contexts.size(); i++)
+            handle = contexts[i]->rasterizer.addMesh(mesh);
+        return handle;
+    }
+
+    unsigned int contextCount() const { return (unsigned int)contexts.size(); }
+
+    // Renders the requests on all contexts; deliver(index, result) runs on the calling thread, in request order,
+    // as soon as each image is ready. A context waits before starting a view more than SERVICE_RENDER_AHEAD per
+    // context past the last delivered one. The result's bytes are released after deliver returns; when it returns
+    // false the views not started yet are dropped. The number of images delivered is returned.
+    size_t renderBatch(const Scene& scene, const std::vector<RenderRequest>& requests, const std::function<bool(size_t, RenderResult&)>& deliver)
+    {
+        std::vector<RenderResult> results(requests.size());
+        std::atomic<size_t> next(0);
+        size_t delivered = 0;
+        bool cancelled = false;
+        const size_t window = contexts.size() * SERVICE_RENDER_AHEAD;
+        std::mutex readyMutex;
+        std::condition_variable readyChanged;
+        for (size_t c = 0; c < contexts.size(); c++)
+        {
+            Context* context = contexts[c].get();
+            contextPool->submit([&, context]()
+            {
+                for (size_t i = next.fetch_add(1); i < requests.size(); i = next.fetch_add(1))
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(readyMutex);
+                        readyChanged.wait(lock, [&delivered, &cancelled, window, i]() { return cancelled || i < delivered + window; });
+                        if (cancelled)
+                            break;
+                    }
+                    context->render(scene, requests[i], results[i]);
+                    std::lock_guard<std::mutex> lock(readyMutex);
+                    results[i].ready = true;
+                    readyChanged.notify_all();
+                }
+            });
+        }
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            {
+                std::unique_lock<std::mutex> lock(readyMutex);
+                readyChanged.wait(lock, [&results, i]() { return results[i].ready; });
+            }
+            bool more = deliver(i, results[i]);
+            std::vector<unsigned char>().swap(results[i].bytes);
+            std::lock_guard<std::mutex> lock(readyMutex);
+            delivered = i + 1;
+            cancelled = !more;
+            readyChanged.notify_all();
+            if (cancelled)
+                break;
+        }
+        contextPool->waitIdle();
+        return delivered;
+    }
+
+    // listens on path until a client sends "shutdown" or stop() is called; false if the socket cannot be had
+    bool serve(const Scene& scene, const char* path = SERVICE_SOCKET_PATH)
+    {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        {
+            std::cout << "ERROR::SERVICE:: winsock did not start" << std::endl;
+            return false;
+        }
+#endif
+        MetricsSocket listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        bool ok = listener != METRICS_NO_SOCKET && strlen(path) < sizeof(address.sun_path);
+        if (ok)
+        {
+            strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+            removeStaleSocket(path);
+            ok = bind(listener, (const sockaddr*)&address, sizeof(address)) == 0 && listen(listener, 4) == 0;
+        }
+        if (!ok)
+        {
+            std::cout << "ERROR::SERVICE:: could not listen on " << path << std::endl;
+            if (listener != METRICS_NO_SOCKET)
+                closeMetricsSocket(listener);
+            cleanup();
+            return false;
+        }
+        std::cout << "SERVICE:: listening on " << path << " with " << contexts.size() << " contexts, " << scene.nodes.size() << " nodes" << std::endl;
+
+        running.store(true);
+        while (running.load())
+        {
+            if (!waitReadable(listener))
+                continue;
+            MetricsSocket client = accept(listener, NULL, NULL);
+            if (client == METRICS_NO_SOCKET)
+                continue;
+            serveClient(scene, client);
+            closeMetricsSocket(client);
+        }
+        closeMetricsSocket(listener);
+        removeStaleSocket(path);
+        cleanup();
+        printStats();
+        return true;
+    }
+
+    // from any thread; serve() returns within SERVICE_POLL_MS once the current batch is done
+    void stop()
+    {
+        running.store(false);
+    }
+
+    void printStats() const
+    {
+        std::cout << "SERVICE:: " << statsLine() << std::endl;
+    }
+
+private:
+    struct Context
+    {
+        ThreadPool pool;
+        SoftRasterizer rasterizer;
+        SoftFramebuffer framebuffer;
+        CameraComponent camera;
+        std::vector<const SceneNode*> drawList;
+        PngEncoder png;
+
+        explicit Context(unsigned int threads) : pool(threads), rasterizer(pool)
+        {
+        }
+
+        void render(const Scene& scene, const RenderRequest& request, RenderResult& result)
+        {
+            glm::vec3 front(std::cos(glm::radians(request.yaw)) * std::cos(glm::radians(request.pitch)), std::sin(glm::radians(request.pitch)),
+                std::sin(glm::radians(request.yaw)) * std::cos(glm::radians(request.pitch)));
+            camera.SetPerspective(request.fov, (float)request.width / request.height, 0.1f, 100.0f);
+            camera.SetLookAt(request.position, request.position + front, glm::vec3(0.0f, 1.0f, 0.0f));
+            drawList.clear();
+            for (size_t i = 0; i < scene.nodes.size(); i++)
+            {
+                if (camera.IsBoxVisible(scene.nodes[i].boundsMin, scene.nodes[i].boundsMax))
+                    drawList.push_back(&scene.nodes[i]);
+            }
+            // the framebuffer is reused as long as the size stays the same
+            if (framebuffer.width != request.width || framebuffer.height != request.height)
+                framebuffer.resize(request.width, request.height);
+            rasterizer.draw(framebuffer, camera.GetViewMatrix(), camera.GetProjectionMatrix(), drawList.empty() ? NULL : &drawList[0], drawList.size());
+
+            result.width = request.width;
+            result.height = request.height;
+            result.format = request.format;
+            if (request.format == SERVICE_PNG)
+                png.encode(&framebuffer.color[0], framebuffer.stride, request.width, request.height, result.bytes);
+            else
+            {
+                result.bytes.resize((size_t)request.width * request.height * 4);
+                for (int y = 0; y < request.height; y++)
+                    memcpy(&result.bytes[(size_t)y * request.width * 4], &framebuffer.color[(size_t)y * framebuffer.stride], (size_t)request.width * 4);
+            }
+        }
+    };
+
+    std::unique_ptr<ThreadPool> contextPool;
+    std::vector<std::unique_ptr<Context> > contexts;
+    std::atomic<bool> running;
+    uint64_t totalImages;
+    double totalBusyMs;
+    MetricCounter& imagesMetric;
+    MetricHistogram& latencyMetric;
+
+    static void cleanup()
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    // a socket file left behind by a service that did not shut down cleanly; anything else at path stays
+    static void removeStaleSocket(const char* path)
+    {
+#ifdef _WIN32
+        DWORD attributes = GetFileAttributesA(path);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            remove(path);
+#else
+        struct stat info;
+        if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+            remove(path);
+#endif
+    }
+
+    static bool waitReadable(MetricsSocket socket)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(socket, &readable);
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = SERVICE_POLL_MS * 1000;
+        return select((int)socket + 1, &readable, NULL, NULL, &timeout) > 0;
+    }
+
+    // a send that makes no progress for SERVICE_CLIENT_TIMEOUT_MS fails instead of blocking the service
+    static void setSendTimeout(MetricsSocket client)
+    {
+#ifdef _WIN32
+        DWORD timeout = SERVICE_CLIENT_TIMEOUT_MS;
+#else
+        timeval timeout;
+        timeout.tv_sec = SERVICE_CLIENT_TIMEOUT_MS / 1000;
+        timeout.tv_usec = (SERVICE_CLIENT_TIMEOUT_MS % 1000) * 1000;
+#endif
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    }
+
+    static bool sendAll(MetricsSocket client, const void* data, size_t size)
+    {
+        const char* bytes = (const char*)data;
+        size_t sent = 0;
+        while (sent < size)
+        {
+            int written = (int)send(client, bytes + sent, (int)std::min(size - sent, (size_t)1 << 30), METRICS_SEND_FLAGS);
+            if (written <= 0)
+                return false;
+            sent += written;
+        }
+        return true;
+    }
+
+    static bool sendLine(MetricsSocket client, const std::string& line)
+    {
+        return sendAll(client, line.data(), line.size());
+    }
+
+    std::string statsLine() const
+    {
+        std::ostringstream line;
+        line << totalImages << " images, " << (totalBusyMs > 0.0 ? totalImages * 1000.0 / totalBusyMs : 0.0) << " images/s while rendering, latency p50/p90/p99 "
+            << MetricsRegistry::quantile(latencyMetric, 0.5) * 1.0e3 << "/" << MetricsRegistry::quantile(latencyMetric, 0.9) * 1.0e3 << "/"
+            << MetricsRegistry::quantile(latencyMetric, 0.99) * 1.0e3 << " ms";
+        return line.str();
+    }
+
+    void serveClient(const Scene& scene, MetricsSocket client)
+    {
+        typedef std::chrono::steady_clock Clock;
+        std::vector<RenderRequest> batch;
+        std::vector<Clock::time_point> arrivals;
+        std::string pending;
+        char buffer[4096];
+        bool connected = true;
+        setSendTimeout(client);
+        Clock::time_point lastActive = Clock::now();
+        while (connected && running.load())
+        {
+            if (!waitReadable(client))
+            {
+                if (Clock::now() - lastActive > std::chrono::milliseconds(SERVICE_CLIENT_TIMEOUT_MS))
+                {
+                    std::cout << "SERVICE:: dropped a client idle for " << SERVICE_CLIENT_TIMEOUT_MS << " ms" << std::endl;
+                    break;
+                }
+                continue;
+            }
+            int received = (int)recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+                break;
+            pending.append(buffer, received);
+            Clock::time_point now = Clock::now();
+
+            size_t start = 0, end;
+            while (connected && (end = pending.find('\n', start)) != std::string::npos)
+            {
+                std::string line = pending.substr(start, end - start);
+                start = end + 1;
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                    line.erase(line.size() - 1);
+                RenderRequest request;
+                if (line.empty())
+                    continue;
+                else if (line.compare(0, 5, "view ") == 0)
+                {
+                    if (batch.size() >= SERVICE_MAX_BATCH)
+                        connected = sendLine(client, "error batch is full\n");
+                    else if (!parseRenderRequest(line, request))
+                        connected = sendLine(client, "error bad view: " + line + "\n");
+                    else
+                    {
+                        batch.push_back(request);
+                        arrivals.push_back(now);
+                    }
+                }
+                else if (line == "render")
+                {
+                    connected = renderForClient(scene, client, batch, arrivals);
+                    batch.clear();
+                    arrivals.clear();
+                }
+                else if (line == "stats")
+                    connected = sendLine(client, "stats " + statsLine() + "\n");
+                else if (line == "quit")
+                    connected = false;
+                else if (line == "shutdown")
+                {
+                    running.store(false);
+                    connected = false;
+                }
+                else
+                    connected = sendLine(client, "error unknown command: " + line + "\n");
+            }
+            pending.erase(0, start);
+            lastActive = Clock::now();
+        }
+    }
+
+    bool renderForClient(const Scene& scene, MetricsSocket client, const std::vector<RenderRequest>& batch,
+        const std::vector<std::chrono::steady_clock::time_point>& arrivals)
+    {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        std::vector<double> latencies;
+        latencies.reserve(batch.size());
+        // a client that stopped reading or went away gets nothing more rendered
+        renderBatch(scene, batch, [&](size_t index, RenderResult& result)
+        {
+            std::ostringstream header;
+            header << "image " << index << " " << result.width << " " << result.height << " " << (result.format == SERVICE_PNG ? "png" : "raw")
+                << " " << result.bytes.size() << "\n";
+            if (!sendLine(client, header.str()) || (!result.bytes.empty() && !sendAll(client, &result.bytes[0], result.bytes.size())))
+                return false;
+            uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - arrivals[index]).count();
+            latencies.push_back(ns / 1.0e6);
+            latencyMetric.record(ns);
+            imagesMetric.add();
+            return true;
+        });
+        bool connected = latencies.size() == batch.size();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        totalImages += latencies.size();
+        totalBusyMs += ms;
+
+        if (!latencies.empty())
+        {
+            std::sort(latencies.begin(), latencies.end());
+            size_t n = latencies.size();
+            std::cout << "SERVICE:: " << n << " of " << batch.size() << " images in " << ms << " ms, " << n * 1000.0 / ms << " images/s on " << contexts.size()
+                << " contexts, latency p50/p90/p99/max " << latencies[n / 2] << "/" << latencies[n * 9 / 10] << "/" << latencies[n * 99 / 100] << "/"
+                << latencies[n - 1] << " ms" << std::endl;
+        }
+        if (!connected)
+        {
+            std::cout << "SERVICE:: dropped a client that stopped reading after " << latencies.size() << " of " << batch.size() << " images" << std::endl;
+            return false;
+        }
+        std::ostringstream done;
+        done << "done " << batch.size() << " " << ms << "\n";
+        return sendLine(client, done.str());
+    }
+};
+#endif
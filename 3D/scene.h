@@ -0,0 +1,136 @@
+//
+//  scene.h
+//  3D Object Drawing
+//
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+// mesh handle of nodes drawn with the built-in cube
+const int CUBE_MESH = -1;
+
+// One drawable object: a model matrix, a flat color, the mesh it is drawn with and an optional texture
+struct SceneNode
+{
+    glm::mat4 model;
+    glm::vec3 color;
+    int mesh;
+    int texture;    // texture handle, or -1 for the flat color only
+    // world space box for culling; meshes are authored in the cube's local space (loadObj rejects any that are not),
+    // so the cube's box bounds them
+    glm::vec3 boundsMin, boundsMax;
+};
+
+// local space box of the built-in cube
+const glm::vec3 CUBE_MIN = glm::vec3(0.0f, 0.0f, 0.0f);
+const glm::vec3 CUBE_MAX = glm::vec3(0.5f, 0.5f, 0.5f);
+
+// the built-in cube: 24 vertices of position, color and texture coordinate (four per face) and 36 indices,
+// shared by the GL path and the software backends
+const float CUBE_VERTICES[] = {
+    0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+    0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+    0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+
+    0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+    0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    0.5f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+
+    0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+    0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+    0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+    0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+
+    0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+    0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+    0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f,
+
+    0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+    0.5f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+    0.0f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f
+};
+const unsigned int CUBE_INDICES[] = {
+    0, 3, 2,
+    2, 1, 0,
+
+    4, 5, 7,
+    7, 6, 4,
+
+    8, 9, 10,
+    10, 11, 8,
+
+    12, 13, 14,
+    14, 15, 12,
+
+    16, 17, 18,
+    18, 19, 16,
+
+    20, 21, 22,
+    22, 23, 20
+};
+const int CUBE_VERTEX_COUNT = 24;
+const int CUBE_INDEX_COUNT = 36;
+
+inline void computeNodeBounds(SceneNode& node)
+{
+    node.boundsMin = glm::vec3(1e30f);
+    node.boundsMax = glm::vec3(-1e30f);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner(i & 1 ? CUBE_MAX.x : CUBE_MIN.x, i & 2 ? CUBE_MAX.y : CUBE_MIN.y, i & 4 ? CUBE_MAX.z : CUBE_MIN.z);
+        glm::vec3 p = glm::vec3(node.model * glm::vec4(corner, 1.0f));
+        node.boundsMin = glm::min(node.boundsMin, p);
+        node.boundsMax = glm::max(node.boundsMax, p);
+    }
+}
+
+// the modelling transformation used for every object: translate * rotateX * rotateY * rotateZ * scale
+inline glm::mat4 composeTRS(glm::vec3 translate, glm::vec3 rotateDegrees, glm::vec3 scale)
+{
+    glm::mat4 identityMatrix = glm::mat4(1.0f);
+    glm::mat4 translateMatrix = glm::translate(identityMatrix, translate);
+    glm::mat4 rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rotateDegrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotateDegrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rotateDegrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 scaleMatrix = glm::scale(identityMatrix, scale);
+    return translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
+}
+
+// The static part of the world. Model matrices are composed once when a node is added instead of every frame.
+class Scene
+{
+public:
+    std::vector<SceneNode> nodes;
+
+    int addNode(const glm::mat4& model, glm::vec3 color, int mesh = CUBE_MESH, int texture = -1)
+    {
+        SceneNode node;
+        node.model = model;
+        node.color = color;
+        node.mesh = mesh;
+        node.texture = texture;
+        computeNodeBounds(node);
+        nodes.push_back(node);
+        return (int)nodes.size() - 1;
+    }
+
+    int addNode(glm::vec3 translate, glm::vec3 rotateDegrees, glm::vec3 scale, glm::vec3 color, int mesh = CUBE_MESH, int texture = -1)
+    {
+        return addNode(composeTRS(translate, rotateDegrees, scale), color, mesh, texture);
+    }
+};
+#endif
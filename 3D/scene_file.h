@@ -0,0 +1,84 @@
+//
+//  scene_file.h
+//  3D Object Drawing
+//
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "bedroom.h"
+
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+
+// Reads a text scene description, one statement per line, '#' starts a comment:
+//
+//   node <tx ty tz> <rx ry rz> <sx sy sz> <r g b> [mesh path | -] [texture path | -]
+//   bedroom <tx ty tz>
+//
+// rotations are in degrees and composed like every other object (composeTRS); a bedroom line places
+// the whole furniture table at an offset. File paths go through the resolvers, just like buildBedroom.
+inline bool loadSceneFile(const char* path, Scene& scene, std::function<int(const char*)> resolveMesh, std::function<int(const char*)> resolveTexture,
+    std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "file not found";
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword))
+            continue;
+
+        if (keyword == "node")
+        {
+            glm::vec3 translate, rotate, scale, color;
+            std::string meshPath = "-", texturePath = "-";
+            if (!(in >> translate.x >> translate.y >> translate.z >> rotate.x >> rotate.y >> rotate.z >> scale.x >> scale.y >> scale.z
+                >> color.x >> color.y >> color.z))
+            {
+                error = "line " + std::to_string(lineNumber) + ": node needs translate, rotate, scale and color";
+                return false;
+            }
+            in >> meshPath >> texturePath;
+            int mesh = CUBE_MESH, texture = -1;
+            if (meshPath != "-" && resolveMesh)
+                mesh = resolveMesh(meshPath.c_str());
+            if (texturePath != "-" && resolveTexture)
+                texture = resolveTexture(texturePath.c_str());
+            scene.addNode(translate, rotate, scale, color, mesh, texture);
+        }
+        else if (keyword == "bedroom")
+        {
+            glm::vec3 offset;
+            if (!(in >> offset.x >> offset.y >> offset.z))
+            {
+                error = "line " + std::to_string(lineNumber) + ": bedroom needs an offset";
+                return false;
+            }
+            buildBedroom(scene, resolveMesh, resolveTexture, glm::translate(glm::mat4(1.0f), offset));
+        }
+        else
+        {
+            error = "line " + std::to_string(lineNumber) + ": unknown statement '" + keyword + "'";
+            return false;
+        }
+    }
+    return true;
+}
+#endif
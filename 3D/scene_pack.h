@@ -0,0 +1,486 @@
+//
+//  scene_pack.h
+//  3D Object Drawing
+//
+
+#ifndef SCENE_PACK_H
+#define SCENE_PACK_H
+
+#include "mesh_data.h"
+#include "scene.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The cooked form of a scene: one file holding the node table, the mesh table, every vertex and index
+// and the texture paths. Sections start on SCENE_PACK_ALIGNMENT boundaries and hold exactly what the
+// runtime uses, so after mapping the file their pointers go straight to Scene and glBufferData.
+//
+//   PackHeader | PackSection[sectionCount] | nodes | meshes | vertices | indices | textures | strings
+//
+// Default pack values
+const char SCENE_PACK_MAGIC[8] = { 'S', 'C', 'N', 'P', 'A', 'C', 'K', '\0' };
+const unsigned int SCENE_PACK_VERSION = 1;
+const size_t SCENE_PACK_ALIGNMENT = 64;
+
+enum Pack_Section {
+    PACK_NODES,
+    PACK_MESHES,
+    PACK_VERTICES,
+    PACK_INDICES,
+    PACK_TEXTURES,
+    PACK_STRINGS,
+    PACK_SECTION_COUNT
+};
+
+struct PackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexFloats;      // MESH_VERTEX_FLOATS of the cooker
+    uint64_t fileSize;
+    uint32_t sectionCount;
+    uint32_t headerCrc;         // over the header with this field zero, then the section table
+};
+
+struct PackSection
+{
+    uint32_t type;
+    uint32_t crc;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t count;
+};
+
+struct PackNode
+{
+    float model[16];
+    float color[4];
+    int32_t mesh;               // index into the mesh table, or CUBE_MESH
+    int32_t texture;            // index into the texture table, or -1
+    int32_t reserved[2];
+};
+
+// offsets are relative to the vertex and index sections
+struct PackMesh
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t nameOffset;        // into the string section
+    uint32_t reserved;
+};
+
+struct PackTexture
+{
+    uint32_t pathOffset;        // into the string section
+    uint32_t pathLength;
+};
+
+static_assert(sizeof(PackHeader) == 32, "pack header layout");
+static_assert(sizeof(PackSection) == 32, "pack section layout");
+static_assert(sizeof(PackNode) == 96, "pack node layout");
+static_assert(sizeof(PackMesh) == 32, "pack mesh layout");
+
+
+// CRC-32 (IEEE 802.3), the checksum of every section
+inline uint32_t packCrc32(const void* data, size_t size, uint32_t crc = 0)
+{
+    struct Table
+    {
+        uint32_t entries[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    };
+    static const Table table;
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// A read-only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() : bytes(NULL), length(0)
+    {
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#endif
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const char* path, std::string& error)
+    {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+        {
+            error = "file not found";
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(fileHandle, &fileSize);
+        length = (size_t)fileSize.QuadPart;
+        mappingHandle = length ? CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        bytes = mappingHandle ? (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            error = "file not found";
+            return false;
+        }
+        struct stat info;
+        fstat(fd, &info);
+        length = (size_t)info.st_size;
+        void* mapped = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        bytes = mapped == MAP_FAILED ? NULL : (const char*)mapped;
+#endif
+        if (!bytes)
+        {
+            error = "could not map the file";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes)
+            UnmapViewOfFile(bytes);
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#else
+        if (bytes)
+            munmap((void*)bytes, length);
+#endif
+        bytes = NULL;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+};
+
+// A mapped and validated pack. Everything it returns points into the mapping and stays valid until close().
+class ScenePack
+{
+public:
+    ScenePack() : header(NULL), sections(NULL) {}
+
+    // checks the layout always and the section checksums when asked to
+    bool open(const char* path, std::string& error, bool verifyChecksums = true)
+    {
+        close();
+        if (!file.open(path, error))
+            return false;
+        if (!validate(error, verifyChecksums))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        header = NULL;
+        sections = NULL;
+    }
+
+    const PackNode* nodes() const { return (const PackNode*)section(PACK_NODES); }
+    size_t nodeCount() const { return (size_t)sections[PACK_NODES].count; }
+    const PackMesh* meshes() const { return (const PackMesh*)section(PACK_MESHES); }
+    size_t meshCount() const { return (size_t)sections[PACK_MESHES].count; }
+    size_t textureCount() const { return (size_t)sections[PACK_TEXTURES].count; }
+
+    const float* meshVertices(const PackMesh& mesh) const { return (const float*)(section(PACK_VERTICES) + mesh.vertexOffset); }
+    const unsigned int* meshIndices(const PackMesh& mesh) const { return (const unsigned int*)(section(PACK_INDICES) + mesh.indexOffset); }
+    const char* meshName(const PackMesh& mesh) const { return section(PACK_STRINGS) + mesh.nameOffset; }
+    const char* texturePath(size_t i) const { return section(PACK_STRINGS) + ((const PackTexture*)section(PACK_TEXTURES))[i].pathOffset; }
+
+    size_t fileSize() const { return file.size(); }
+
+private:
+    MappedFile file;
+    const PackHeader* header;
+    const PackSection* sections;
+
+    const char* section(int type) const
+    {
+        return file.data() + sections[type].offset;
+    }
+
+    bool validate(std::string& error, bool verifyChecksums)
+    {
+        const char* base = file.data();
+        size_t size = file.size();
+        if (size < sizeof(PackHeader) || memcmp(base, SCENE_PACK_MAGIC, sizeof(SCENE_PACK_MAGIC)) != 0)
+        {
+            error = "not a scene pack";
+            return false;
+        }
+        header = (const PackHeader*)base;
+        if (header->version != SCENE_PACK_VERSION || header->vertexFloats != (uint32_t)MESH_VERTEX_FLOATS)
+        {
+            error = "pack version " + std::to_string(header->version) + " does not match " + std::to_string(SCENE_PACK_VERSION) + ", cook it again";
+            return false;
+        }
+        if (header->fileSize != size || header->sectionCount != PACK_SECTION_COUNT ||
+            size < sizeof(PackHeader) + PACK_SECTION_COUNT * sizeof(PackSection))
+        {
+            error = "truncated pack";
+            return false;
+        }
+        sections = (const PackSection*)(base + sizeof(PackHeader));
+        PackHeader copy = *header;
+        copy.headerCrc = 0;
+        uint32_t crc = packCrc32(&copy, sizeof(copy));
+        crc = packCrc32(sections, PACK_SECTION_COUNT * sizeof(PackSection), crc);
+        if (crc != header->headerCrc)
+        {
+            error = "header checksum mismatch";
+            return false;
+        }
+
+        static const size_t elementSizes[PACK_SECTION_COUNT] = { sizeof(PackNode), sizeof(PackMesh), sizeof(float), sizeof(unsigned int), sizeof(PackTexture), 1 };
+        for (int i = 0; i < PACK_SECTION_COUNT; i++)
+        {
+            const PackSection& s = sections[i];
+            if (s.type != (uint32_t)i || s.offset % SCENE_PACK_ALIGNMENT != 0 || s.offset > size || s.size > size - s.offset ||
+                s.size != s.count * elementSizes[i])
+            {
+                error = "bad section " + std::to_string(i);
+                return false;
+            }
+            if (verifyChecksums && packCrc32(base + s.offset, (size_t)s.size) != s.crc)
+            {
+                error = "checksum mismatch in section " + std::to_string(i);
+                return false;
+            }
+        }
+
+        // every reference has to land inside its section, so users never need to check again
+        const PackSection& strings = sections[PACK_STRINGS];
+        if (strings.size > 0 && base[strings.offset + strings.size - 1] != '\0')
+        {
+            error = "unterminated string section";
+            return false;
+        }
+        for (size_t i = 0; i < meshCount(); i++)
+        {
+            const PackMesh& mesh = meshes()[i];
+            if (mesh.vertexOffset % SCENE_PACK_ALIGNMENT != 0 || mesh.indexOffset % SCENE_PACK_ALIGNMENT != 0 ||
+                mesh.vertexOffset + (uint64_t)mesh.vertexCount * MESH_VERTEX_FLOATS * sizeof(float) > sections[PACK_VERTICES].size ||
+                mesh.indexOffset + (uint64_t)mesh.indexCount * sizeof(unsigned int) > sections[PACK_INDICES].size ||
+                mesh.nameOffset >= strings.size)
+            {
+                error = "mesh " + std::to_string(i) + " out of bounds";
+                return false;
+            }
+            const unsigned int* indices = meshIndices(mesh);
+            for (uint32_t k = 0; k < mesh.indexCount; k++)
+            {
+                if (indices[k] >= mesh.vertexCount)
+                {
+                    error = "mesh " + std::to_string(i) + " index out of range";
+                    return false;
+                }
+            }
+        }
+        const PackTexture* textures = (const PackTexture*)section(PACK_TEXTURES);
+        for (size_t i = 0; i < textureCount(); i++)
+        {
+            if ((uint64_t)textures[i].pathOffset + textures[i].pathLength >= strings.size)
+            {
+                error = "texture " + std::to_string(i) + " out of bounds";
+                return false;
+            }
+        }
+        const PackNode* packNodes = nodes();
+        for (size_t i = 0; i < nodeCount(); i++)
+        {
+            if (packNodes[i].mesh < CUBE_MESH || packNodes[i].mesh >= (int32_t)meshCount() ||
+                packNodes[i].texture < -1 || packNodes[i].texture >= (int32_t)textureCount())
+            {
+                error = "node " + std::to_string(i) + " references a missing mesh or texture";
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// What the cooker collected: the scene's nodes with mesh and texture handles indexing these tables
+struct CookedMesh
+{
+    std::string path;
+    MeshData data;
+};
+
+struct CookedScene
+{
+    std::vector<SceneNode> nodes;
+    std::vector<CookedMesh> meshes;
+    std::vector<std::string> textures;
+};
+
+inline size_t packAlign(size_t value)
+{
+    return (value + SCENE_PACK_ALIGNMENT - 1) & ~(SCENE_PACK_ALIGNMENT - 1);
+}
+
+inline bool writeScenePack(const char* path, const CookedScene& scene, std::string& error)
+{
+    std::vector<PackNode> nodes(scene.nodes.size());
+    for (size_t i = 0; i < scene.nodes.size(); i++)
+    {
+        const SceneNode& node = scene.nodes[i];
+        PackNode& out = nodes[i];
+        memset(&out, 0, sizeof(out));
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                out.model[c * 4 + r] = node.model[c][r];
+        out.color[0] = node.color.x;
+        out.color[1] = node.color.y;
+        out.color[2] = node.color.z;
+        out.color[3] = 1.0f;
+        out.mesh = node.mesh;
+        out.texture = node.texture;
+    }
+
+    std::string strings;
+    std::vector<PackMesh> meshes(scene.meshes.size());
+    std::vector<char> vertices, indices;
+    for (size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        const MeshData& data = scene.meshes[i].data;
+        PackMesh& mesh = meshes[i];
+        memset(&mesh, 0, sizeof(mesh));
+        // each mesh's blobs start aligned as well, so they can be handed to GL as they are
+        vertices.resize(packAlign(vertices.size()));
+        indices.resize(packAlign(indices.size()));
+        mesh.vertexOffset = vertices.size();
+        mesh.indexOffset = indices.size();
+        mesh.vertexCount = data.vertexCount();
+        mesh.indexCount = (uint32_t)data.indices.size();
+        mesh.nameOffset = (uint32_t)strings.size();
+        strings.append(scene.meshes[i].path).push_back('\0');
+        vertices.insert(vertices.end(), (const char*)data.vertices.data(), (const char*)(data.vertices.data() + data.vertices.size()));
+        indices.insert(indices.end(), (const char*)data.indices.data(), (const char*)(data.indices.data() + data.indices.size()));
+    }
+    // sections are sized in whole elements
+    vertices.resize(packAlign(vertices.size()));
+    indices.resize(packAlign(indices.size()));
+
+    std::vector<PackTexture> textures(scene.textures.size());
+    for (size_t i = 0; i < scene.textures.size(); i++)
+    {
+        textures[i].pathOffset = (uint32_t)strings.size();
+        textures[i].pathLength = (uint32_t)scene.textures[i].size();
+        strings.append(scene.textures[i]).push_back('\0');
+    }
+
+    const void* payloads[PACK_SECTION_COUNT] = { nodes.data(), meshes.data(), vertices.data(), indices.data(), textures.data(), strings.data() };
+    size_t sizes[PACK_SECTION_COUNT] = { nodes.size() * sizeof(PackNode), meshes.size() * sizeof(PackMesh), vertices.size(), indices.size(),
+        textures.size() * sizeof(PackTexture), strings.size() };
+    size_t counts[PACK_SECTION_COUNT] = { nodes.size(), meshes.size(), vertices.size() / sizeof(float), indices.size() / sizeof(unsigned int),
+        textures.size(), strings.size() };
+
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_PACK_MAGIC, sizeof(SCENE_PACK_MAGIC));
+    header.version = SCENE_PACK_VERSION;
+    header.vertexFloats = MESH_VERTEX_FLOATS;
+    header.sectionCount = PACK_SECTION_COUNT;
+    PackSection sections[PACK_SECTION_COUNT];
+    size_t offset = packAlign(sizeof(PackHeader) + sizeof(sections));
+    for (int i = 0; i < PACK_SECTION_COUNT; i++)
+    {
+        sections[i].type = i;
+        sections[i].offset = offset;
+        sections[i].size = sizes[i];
+        sections[i].count = counts[i];
+        sections[i].crc = packCrc32(payloads[i], sizes[i]);
+        offset = packAlign(offset + sizes[i]);
+    }
+    header.fileSize = offset;
+    header.headerCrc = packCrc32(sections, sizeof(sections), packCrc32(&header, sizeof(header)));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        error = "could not create the file";
+        return false;
+    }
+    static const char padding[SCENE_PACK_ALIGNMENT] = {};
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)sections, sizeof(sections));
+    size_t written = sizeof(header) + sizeof(sections);
+    for (int i = 0; i < PACK_SECTION_COUNT; i++)
+    {
+        file.write(padding, sections[i].offset - written);
+        file.write((const char*)payloads[i], sizes[i]);
+        written = (size_t)(sections[i].offset + sizes[i]);
+    }
+    file.write(padding, offset - written);
+    if (!file)
+    {
+        error = "write failed";
+        return false;
+    }
+    return true;
+}
+#endif
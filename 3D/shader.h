@@ -11,6 +11,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "metrics.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -76,6 +78,11 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+    }
+    // wraps a program that was built elsewhere, e.g. a ShaderVariants permutation
+    // ------------------------------------------------------------------------
+    explicit Shader(unsigned int program) : ID(program)
+    {
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -83,63 +90,129 @@ public:
     {
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // every uniform set below counts towards gl_uniform_uploads_total
+    static MetricCounter& uniformUploads()
+    {
+        static MetricCounter& counter = metricsRegistry().counter("gl_uniform_uploads_total", "glUniform calls made through Shader");
+        return counter;
+    }
+    // utility uniform functions; the const char* versions keep string literals from building a std::string per call
     // ------------------------------------------------------------------------
+    void setBool(const char* name, bool value) const
+    {
+        uniformUploads().add();
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
+    }
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(name.c_str(), value);
     }
     // ------------------------------------------------------------------------
+    void setInt(const char* name, int value) const
+    {
+        uniformUploads().add();
+        glUniform1i(glGetUniformLocation(ID, name), value);
+    }
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(name.c_str(), value);
     }
     // ------------------------------------------------------------------------
+    void setFloat(const char* name, float value) const
+    {
+        uniformUploads().add();
+        glUniform1f(glGetUniformLocation(ID, name), value);
+    }
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(name.c_str(), value);
     }
     // ------------------------------------------------------------------------
+    void setVec2(const char* name, const glm::vec2& value) const
+    {
+        uniformUploads().add();
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    }
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(name.c_str(), value);
+    }
+    void setVec2(const char* name, float x, float y) const
+    {
+        uniformUploads().add();
+        glUniform2f(glGetUniformLocation(ID, name), x, y);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(name.c_str(), x, y);
     }
     // ------------------------------------------------------------------------
+    void setVec3(const char* name, const glm::vec3& value) const
+    {
+        uniformUploads().add();
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    }
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(name.c_str(), value);
+    }
+    void setVec3(const char* name, float x, float y, float z) const
+    {
+        uniformUploads().add();
+        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(name.c_str(), x, y, z);
     }
     // ------------------------------------------------------------------------
+    void setVec4(const char* name, const glm::vec4& value) const
+    {
+        uniformUploads().add();
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    }
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(name.c_str(), value);
+    }
+    void setVec4(const char* name, float x, float y, float z, float w) const
+    {
+        uniformUploads().add();
+        glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(name.c_str(), x, y, z, w);
     }
     // ------------------------------------------------------------------------
+    void setMat2(const char* name, const glm::mat2& mat) const
+    {
+        uniformUploads().add();
+        glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(name.c_str(), mat);
     }
     // ------------------------------------------------------------------------
+    void setMat3(const char* name, const glm::mat3& mat) const
+    {
+        uniformUploads().add();
+        glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(name.c_str(), mat);
     }
     // ------------------------------------------------------------------------
+    void setMat4(const char* name, const glm::mat4& mat) const
+    {
+        uniformUploads().add();
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(name.c_str(), mat);
     }
 
 private:
@@ -0,0 +1,266 @@
+//
+//  shader_variants.h
+//  3D Object Drawing
+//
+
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GL_KHR_parallel_shader_compile; not part of a core 3.3 loader
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Feature bits of a variant; each one becomes a #define in both stages
+enum Shader_Feature {
+    SHADER_LIT = 1,
+    SHADER_INSTANCED = 2,
+    SHADER_TEXTURED = 4,
+    SHADER_SHADOWED = 8,
+    SHADER_MULTIVIEW = 16,
+    SHADER_OVERDRAW = 32
+};
+
+const int SHADER_FEATURE_COUNT = 6;
+const char* const SHADER_FEATURE_NAMES[SHADER_FEATURE_COUNT] = { "LIT", "INSTANCED", "TEXTURED", "SHADOWED", "MULTIVIEW", "OVERDRAW" };
+
+typedef void (*MaxShaderCompilerThreadsProc)(GLuint count);
+
+
+// Builds permutations of one vertex/fragment pair by injecting a #define per feature after the #version line.
+// Variants compile lazily on first get() or in bulk through request(); nothing here waits for the driver.
+// With GL_KHR_parallel_shader_compile the driver compiles on its own threads and poll() asks whether a program
+// is done; without it poll() checks the link status a frame after submission, which gives drivers that compile
+// in the background the same head start.
+class ShaderVariants
+{
+public:
+    bool ParallelCompile;
+
+    ShaderVariants(const char* vertexPath, const char* fragmentPath) : ParallelCompile(false)
+    {
+        vertexSource = readSource(vertexPath);
+        fragmentSource = readSource(fragmentPath);
+    }
+
+    // call once after glad is loaded; loader is the same proc address function glad was given
+    void enableParallelCompile(GLADloadproc loader)
+    {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount && !ParallelCompile; i++)
+        {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+                ParallelCompile = true;
+        }
+        if (!ParallelCompile)
+            return;
+        MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+        if (!maxThreads)
+            maxThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+        // 0xFFFFFFFF lets the driver pick
+        if (maxThreads)
+            maxThreads(0xFFFFFFFFu);
+    }
+
+    // starts compiling every listed variant that has not been started yet
+    void request(const unsigned int* featureSets, int count)
+    {
+        for (int i = 0; i < count; i++)
+            start(featureSets[i]);
+    }
+
+    // the variant if it is linked, otherwise NULL; the first call starts the compile
+    const Shader* get(unsigned int features)
+    {
+        Variant& variant = start(features);
+        return variant.state == VARIANT_READY ? &variant.shader : NULL;
+    }
+
+    // the variant right away: compiled and linked before it returns, like a plain Shader, for the program that
+    // has to draw from the first frame; a failed link prints its logs and leaves a program that draws nothing
+    const Shader& build(unsigned int features)
+    {
+        Variant& variant = start(features);
+        if (variant.state == VARIANT_COMPILING)
+            finish(features, variant);
+        return variant.shader;
+    }
+
+    // once per frame: finishes variants whose compile the driver reports done
+    void poll()
+    {
+        for (std::unordered_map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            Variant& variant = it->second;
+            if (variant.state != VARIANT_COMPILING)
+                continue;
+            if (ParallelCompile)
+            {
+                GLint done = GL_FALSE;
+                glGetProgramiv(variant.shader.ID, GL_COMPLETION_STATUS_KHR, &done);
+                if (!done)
+                    continue;
+            }
+            else if (variant.polls++ == 0)
+                continue;
+            finish(it->first, variant);
+        }
+    }
+
+    // blocks until every started variant is done, e.g. for a benchmark that wants them all up front
+    void waitAll()
+    {
+        for (std::unordered_map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            if (it->second.state == VARIANT_COMPILING)
+                finish(it->first, it->second);
+        }
+    }
+
+    int pendingCount() const
+    {
+        int pending = 0;
+        for (std::unordered_map<unsigned int, Variant>::const_iterator it = variants.begin(); it != variants.end(); ++it)
+            pending += it->second.state == VARIANT_COMPILING;
+        return pending;
+    }
+
+    static std::string featureName(unsigned int features)
+    {
+        std::string name;
+        for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+        {
+            if (features & (1u << i))
+                name += name.empty() ? SHADER_FEATURE_NAMES[i] : std::string("|") + SHADER_FEATURE_NAMES[i];
+        }
+        return name.empty() ? std::string("BASE") : name;
+    }
+
+    // delete every program; call while the context is still current
+    void release()
+    {
+        for (std::unordered_map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            if (it->second.shader.ID)
+                glDeleteProgram(it->second.shader.ID);
+        }
+        variants.clear();
+    }
+
+private:
+    enum Variant_State {
+        VARIANT_COMPILING,
+        VARIANT_READY,
+        VARIANT_FAILED
+    };
+
+    struct Variant
+    {
+        Shader shader;
+        unsigned int vertex, fragment;
+        int state;
+        int polls;
+        std::chrono::steady_clock::time_point submitted;
+
+        Variant() : shader(0u), vertex(0), fragment(0), state(VARIANT_COMPILING), polls(0) {}
+    };
+
+    std::string vertexSource, fragmentSource;
+    std::unordered_map<unsigned int, Variant> variants;
+
+    static std::string readSource(const char* path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return std::string();
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // submits compile and link without asking for any status, so the calls return right away
+    Variant& start(unsigned int features)
+    {
+        std::unordered_map<unsigned int, Variant>::iterator it = variants.find(features);
+        if (it != variants.end())
+            return it->second;
+        Variant& variant = variants[features];
+        variant.submitted = std::chrono::steady_clock::now();
+        variant.vertex = compileStage(GL_VERTEX_SHADER, vertexSource, features);
+        variant.fragment = compileStage(GL_FRAGMENT_SHADER, fragmentSource, features);
+        variant.shader.ID = glCreateProgram();
+        glAttachShader(variant.shader.ID, variant.vertex);
+        glAttachShader(variant.shader.ID, variant.fragment);
+        glLinkProgram(variant.shader.ID);
+        return variant;
+    }
+
+    static unsigned int compileStage(GLenum type, const std::string& source, unsigned int features)
+    {
+        // the #version line has to stay first; #line keeps error messages pointing at the file's own lines
+        size_t versionEnd = source.find('\n');
+        versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+        std::string version = source.substr(0, versionEnd);
+        std::string defines;
+        for (int i = 0; i < SHADER_FEATURE_COUNT; i++)
+        {
+            if (features & (1u << i))
+                defines += std::string("#define ") + SHADER_FEATURE_NAMES[i] + "\n";
+        }
+        defines += "#line 2\n";
+        const char* parts[3] = { version.c_str(), defines.c_str(), source.c_str() + versionEnd };
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 3, parts, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void finish(unsigned int features, Variant& variant)
+    {
+        GLint linked = GL_FALSE;
+        glGetProgramiv(variant.shader.ID, GL_LINK_STATUS, &linked);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - variant.submitted).count();
+        if (linked)
+        {
+            variant.state = VARIANT_READY;
+            std::cout << "SHADER::VARIANT " << featureName(features) << " ready after " << ms << " ms"
+                << (ParallelCompile ? " (parallel compile)" : "") << std::endl;
+        }
+        else
+        {
+            variant.state = VARIANT_FAILED;
+            GLchar infoLog[1024];
+            glGetShaderInfoLog(variant.vertex, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_VARIANT " << featureName(features) << " vertex:\n" << infoLog << std::endl;
+            glGetShaderInfoLog(variant.fragment, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_VARIANT " << featureName(features) << " fragment:\n" << infoLog << std::endl;
+            glGetProgramInfoLog(variant.shader.ID, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_VARIANT " << featureName(features) << " link:\n" << infoLog << std::endl;
+        }
+        glDeleteShader(variant.vertex);
+        glDeleteShader(variant.fragment);
+        variant.vertex = variant.fragment = 0;
+    }
+};
+#endif
@@ -0,0 +1,218 @@
+//
+//  sim_pipeline.h
+//  3D Object Drawing
+//
+
+#ifndef SIM_PIPELINE_H
+#define SIM_PIPELINE_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+// Default simulation values
+const double SIM_TICK_SECONDS = 1.0 / 60.0;
+const int SIM_MAX_CATCH_UP_TICKS = 5;       // after a longer stall the simulation skips time instead of rushing
+
+
+// Lock-free single-producer/single-consumer handoff of whole frames. The producer fills its private slot and
+// swaps it into the middle; the consumer swaps the middle for its own slot whenever a fresher one is there.
+// Neither side ever waits and neither touches the slot the other one is using. With three slots the producer
+// can always start the next frame while the consumer still reads the previous one; a frame the consumer never
+// took is simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : writeIndex(0), readIndex(1), middle(2)
+    {
+    }
+
+    // all three, for setting them up before the threads start
+    T& slot(int index) { return slots[index]; }
+
+    // producer side
+    T& writeSlot() { return slots[writeIndex]; }
+
+    // hands the write slot over; true if it replaced a frame the consumer never saw
+    bool publish()
+    {
+        unsigned int previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+        return (previous & FRESH) != 0;
+    }
+
+    // consumer side: switches to the newest published frame; false if there is none since the last call
+    bool acquire()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            return false;
+        // only the producer can change the middle in between, and it leaves a fresh frame there too
+        unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readSlot() const { return slots[readIndex]; }
+
+private:
+    enum { INDEX_MASK = 3, FRESH = 4 };
+
+    T slots[3];
+    unsigned int writeIndex;                // producer only
+    unsigned int readIndex;                 // consumer only
+    std::atomic<unsigned int> middle;       // slot index, plus FRESH while the consumer has not taken it
+};
+
+// Runs a fixed timestep simulation on its own thread and hands every tick's Frame to the render thread
+// through a TripleBuffer. The render thread only picks up the newest frame, so a frame costs roughly the
+// longer of the two stages instead of their sum, and the simulation advances at the same rate whatever the
+// frame rate. tick(frame, dt, time) fills the frame for the tick scheduled at time (glfwGetTime seconds);
+// the state becomes current at that time, so the renderer interpolates towards it over the following tick.
+// Frame has a double tickTime, set here, and an unsigned int changes the tick sets to what it changed; those
+// bits reach the renderer even when the frame itself is replaced before it was taken.
+// With Threaded off the same ticks run inline from update(), for comparison and for debugging.
+template <typename Frame>
+class SimulationPipeline
+{
+public:
+    typedef std::function<void(Frame& frame, double dt, double time)> TickFunction;
+
+    bool Threaded;
+    double TickSeconds;
+    // post an empty GLFW event when a tick changed something, for a render loop that sleeps in glfwWaitEvents
+    bool WakeRenderer;
+
+    SimulationPipeline() : Threaded(true), TickSeconds(SIM_TICK_SECONDS), WakeRenderer(false), running(false), nextTick(0.0), changes(0), ticks(0),
+        replaced(0), tickNs(0), maxTickNs(0)
+    {
+    }
+
+    ~SimulationPipeline()
+    {
+        stop();
+    }
+
+    // runs the first tick right away, so a frame is there before the render loop starts
+    void start(const TickFunction& tickFunction)
+    {
+        tick = tickFunction;
+        nextTick = glfwGetTime();
+        runTick();
+        buffers.acquire();
+        changes.store(0);
+        if (!Threaded)
+            return;
+        running.store(true);
+        thread = std::thread([this]() { threadLoop(); });
+    }
+
+    void stop()
+    {
+        if (!running.exchange(false))
+            return;
+        thread.join();
+    }
+
+    // render thread, once per frame: runs due ticks when not threaded, then takes the newest frame; true if
+    // it is new since the last call. changed gets every tick's changes since the last call.
+    bool update(unsigned int& changed)
+    {
+        if (!Threaded)
+        {
+            double now = glfwGetTime();
+            if (now - nextTick > SIM_MAX_CATCH_UP_TICKS * TickSeconds)
+                nextTick = now - SIM_MAX_CATCH_UP_TICKS * TickSeconds;
+            while (nextTick <= now)
+                runTick();
+        }
+        // the bits first: they are set after the publish, so the frame they came with is taken below or is already ours
+        changed = changes.exchange(0, std::memory_order_acquire);
+        return buffers.acquire();
+    }
+
+    // the newest frame the render thread has taken
+    const Frame& frame() const
+    {
+        return buffers.readSlot();
+    }
+
+    // how far the render time is from the current frame's tick towards the next, in 0..1
+    float blend(const Frame& current, double now) const
+    {
+        return (float)std::max(0.0, std::min(1.0, (now - current.tickTime) / TickSeconds));
+    }
+
+    // every frame slot, e.g. to reserve space up front
+    Frame& slot(int index)
+    {
+        return buffers.slot(index);
+    }
+
+    // tick rate, cost and frames the renderer never saw, since the last call
+    void printStats(double seconds)
+    {
+        unsigned int tickCount = ticks.exchange(0);
+        unsigned int replacedCount = replaced.exchange(0);
+        uint64_t ns = tickNs.exchange(0);
+        uint64_t maxNs = maxTickNs.exchange(0);
+        if (tickCount == 0 || seconds <= 0.0)
+            return;
+        std::cout << "SIM:: " << (Threaded ? "own thread" : "inline") << ", " << tickCount / seconds << " ticks/s, tick mean/max "
+            << ns / 1.0e6 / tickCount << "/" << maxNs / 1.0e6 << " ms, " << replacedCount << " frames replaced before rendering" << std::endl;
+    }
+
+private:
+    TripleBuffer<Frame> buffers;
+    TickFunction tick;
+    std::thread thread;
+    std::atomic<bool> running;
+    double nextTick;
+    std::atomic<unsigned int> changes;
+    std::atomic<unsigned int> ticks, replaced;
+    std::atomic<uint64_t> tickNs, maxTickNs;
+
+    void runTick()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Frame& frame = buffers.writeSlot();
+        tick(frame, TickSeconds, nextTick);
+        frame.tickTime = nextTick;
+        unsigned int tickChanges = frame.changes;
+        if (buffers.publish())
+            replaced.fetch_add(1, std::memory_order_relaxed);
+        changes.fetch_or(tickChanges, std::memory_order_release);
+        if (tickChanges != 0 && WakeRenderer && Threaded)
+            glfwPostEmptyEvent();
+        nextTick += TickSeconds;
+
+        uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        tickNs.fetch_add(ns, std::memory_order_relaxed);
+        if (ns > maxTickNs.load(std::memory_order_relaxed))
+            maxTickNs.store(ns, std::memory_order_relaxed);
+    }
+
+    void threadLoop()
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            double now = glfwGetTime();
+            if (now < nextTick)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(nextTick - now));
+                continue;
+            }
+            if (now - nextTick > SIM_MAX_CATCH_UP_TICKS * TickSeconds)
+                nextTick = now - SIM_MAX_CATCH_UP_TICKS * TickSeconds;
+            runTick();
+        }
+    }
+};
+#endif
@@ -0,0 +1,127 @@
+//
+//  soft_framebuffer.h
+//  3D Object Drawing
+//
+
+#ifndef SOFT_FRAMEBUFFER_H
+#define SOFT_FRAMEBUFFER_H
+
+#include <glm/glm.hpp>
+
+#include "overdraw_stats.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Default CPU renderer values, shared by the rasterizer and the ray tracer
+const int SOFT_TILE_SIZE = 64;              // pixels per tile side; a multiple of the 4 pixel span
+const glm::vec3 SOFT_LIGHT_DIRECTION = glm::vec3(0.37f, 0.84f, 0.4f);  // fragmentShader.fs LIGHT_DIRECTION
+const glm::vec3 SOFT_CLEAR_COLOR = glm::vec3(0.2f, 0.3f, 0.3f);
+
+
+inline uint32_t softPackColor(const glm::vec3& color)
+{
+    uint32_t r = (uint32_t)(glm::clamp(color.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(glm::clamp(color.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(glm::clamp(color.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | 0xFF000000u;
+}
+
+// The headless color and depth target. Storage is padded to whole tiles so spans never need bounds checks;
+// only the width x height corner is ever read back. fragments holds per-pixel fragment counts while the
+// rasterizer's overdraw mode is on and stays empty otherwise.
+struct SoftFramebuffer
+{
+    int width, height;
+    int stride, rows;
+    std::vector<uint32_t> color;    // RGBA8, R in the lowest byte
+    std::vector<float> depth;
+    std::vector<uint32_t> fragments;
+
+    SoftFramebuffer() : width(0), height(0), stride(0), rows(0) {}
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        stride = (w + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE * SOFT_TILE_SIZE;
+        rows = (h + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE * SOFT_TILE_SIZE;
+        color.assign((size_t)stride * rows, 0);
+        depth.assign((size_t)stride * rows, 1.0f);
+        fragments.clear();
+    }
+
+    uint32_t pixel(int x, int y) const { return color[(size_t)y * stride + x]; }
+
+    // binary PPM, top row first
+    bool writePpm(const char* path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> row((size_t)width * 3);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t c = pixel(x, y);
+                row[x * 3 + 0] = (unsigned char)(c & 0xFF);
+                row[x * 3 + 1] = (unsigned char)((c >> 8) & 0xFF);
+                row[x * 3 + 2] = (unsigned char)((c >> 16) & 0xFF);
+            }
+            file.write((const char*)&row[0], row.size());
+        }
+        return (bool)file;
+    }
+
+    // fragment count statistics over the visible pixels; empty unless the last draw counted them
+    OverdrawStats overdrawStats() const
+    {
+        OverdrawStats stats;
+        if (fragments.empty())
+            return stats;
+        for (int y = 0; y < height; y++)
+            stats.addRow(&fragments[(size_t)y * stride], width);
+        return stats;
+    }
+
+    // the fragment counts as a heatmap PPM, colored like the GL overdraw view
+    bool writeOverdrawPpm(const char* path, float heatMax = OVERDRAW_HEAT_MAX) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file || fragments.empty())
+            return false;
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> row((size_t)width * 3);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t c = softPackColor(overdrawHeatColor((float)fragments[(size_t)y * stride + x], heatMax));
+                row[x * 3 + 0] = (unsigned char)(c & 0xFF);
+                row[x * 3 + 1] = (unsigned char)((c >> 8) & 0xFF);
+                row[x * 3 + 2] = (unsigned char)((c >> 16) & 0xFF);
+            }
+            file.write((const char*)&row[0], row.size());
+        }
+        return (bool)file;
+    }
+
+    // FNV-1a over the visible pixels, for comparing images
+    uint64_t checksum() const
+    {
+        uint64_t hash = 1469598103934665603ull;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                hash ^= pixel(x, y);
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+};
+#endif
@@ -0,0 +1,465 @@
+//
+//  soft_rasterizer.h
+//  3D Object Drawing
+//
+
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_data.h"
+#include "scene.h"
+#include "soft_framebuffer.h"
+#include "soft_simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Default software rasterizer values
+const int SOFT_GEOMETRY_CHUNKS = 64;        // draw list slices; fixed, so the image does not depend on the thread count
+const float SOFT_GUARD_BAND = 8.0f;         // triangles reaching further than this (in NDC) outside the view are clipped
+
+
+struct SoftRasterStats
+{
+    size_t submittedTriangles;      // triangles of the drawn nodes
+    size_t rasterizedTriangles;     // what survived rejection and clipping
+    size_t binEntries;              // triangle references over all tiles
+    double geometryMs;
+    double rasterMs;
+};
+
+
+// A CPU backend behind the same interface as the GL path: a culled draw list of scene nodes plus the camera's
+// view and projection. It implements vertexShader.vs / fragmentShader.fs in their base and LIT forms: flat node
+// color, and with Lit the face normal against the fixed light. Textures are not sampled (there are no CPU copies
+// of them), so textured nodes draw their tint, as the GL path does while a texture is still streaming.
+//
+// Geometry runs over fixed slices of the draw list in parallel: vertices are transformed four components at a
+// time, triangles are rejected or clipped (near plane and a guard band), set up with their three edge functions
+// and binned into the 64x64 pixel tiles they touch. Tiles are then rasterized in parallel, each by one thread,
+// four pixels per step against the edge functions and the depth buffer (less-than, as glEnable(GL_DEPTH_TEST)).
+// Meshes are drawn two-sided like the GL path, which has no face culling enabled.
+// With Overdraw on, every pixel also counts its fragments into the framebuffer's fragments, the same counts the
+// GL overdraw view accumulates, so overdraw can be measured without a window.
+class SoftRasterizer
+{
+public:
+    bool Lit;
+    Overdraw_Mode Overdraw;
+    SoftRasterStats Stats;
+
+    // every worker of the pool is used for both stages; give it a pool it does not share with long jobs
+    explicit SoftRasterizer(ThreadPool& pool) : Lit(true), Overdraw(OVERDRAW_OFF), workers(pool), framebuffer(NULL), nodes(NULL), nodeCount(0), tilesX(0), tilesY(0)
+    {
+        memset(&Stats, 0, sizeof(Stats));
+        chunks.resize(SOFT_GEOMETRY_CHUNKS);
+    }
+
+    // a mesh in the 8 float vertex format; the handle is what SceneNode::mesh refers to
+    int addMesh(const MeshData& mesh)
+    {
+        meshes.push_back(mesh);
+        return (int)meshes.size() - 1;
+    }
+
+    void draw(SoftFramebuffer& target, const glm::mat4& view, const glm::mat4& projection, const SceneNode* const* drawList, size_t drawCount)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        framebuffer = &target;
+        viewProjection = projection * view;
+        nodes = drawList;
+        nodeCount = drawCount;
+        tilesX = target.stride / SOFT_TILE_SIZE;
+        tilesY = target.rows / SOFT_TILE_SIZE;
+        // sized once; the tiles clear their part
+        if (Overdraw != OVERDRAW_OFF)
+            target.fragments.resize((size_t)target.stride * target.rows);
+        else
+            target.fragments.clear();
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            chunks[c].triangles.clear();
+            chunks[c].bins.resize((size_t)tilesX * tilesY);
+            for (size_t t = 0; t < chunks[c].bins.size(); t++)
+                chunks[c].bins[t].clear();
+            chunks[c].submitted = 0;
+        }
+
+        nextItem = 0;
+        workers.runOnAll([this](unsigned int) { geometryWorker(); });
+        std::chrono::steady_clock::time_point binned = std::chrono::steady_clock::now();
+
+        nextItem = 0;
+        workers.runOnAll([this](unsigned int) { rasterWorker(); });
+        std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+
+        Stats.submittedTriangles = Stats.rasterizedTriangles = Stats.binEntries = 0;
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            Stats.submittedTriangles += chunks[c].submitted;
+            Stats.rasterizedTriangles += chunks[c].triangles.size();
+            for (size_t t = 0; t < chunks[c].bins.size(); t++)
+                Stats.binEntries += chunks[c].bins[t].size();
+        }
+        Stats.geometryMs = std::chrono::duration<double, std::milli>(binned - start).count();
+        Stats.rasterMs = std::chrono::duration<double, std::milli>(done - binned).count();
+    }
+
+private:
+    // a set-up screen space triangle; edge and depth values are taken at its bounding box origin (pixel centers)
+    // so rasterization only ever adds small integer offsets to them
+    struct SoftTriangle
+    {
+        float edgeA[3], edgeB[3], edgeOrigin[3], edgeBias[3];
+        float zOrigin, dzdx, dzdy;
+        uint32_t color;
+        int minX, minY, maxX, maxY;
+    };
+
+    struct GeometryChunk
+    {
+        std::vector<SoftTriangle> triangles;
+        std::vector<std::vector<uint32_t> > bins;  // per tile, indices into triangles
+        std::vector<glm::vec4> clipPositions;       // scratch for one node's vertices
+        std::vector<unsigned char> outcodes;
+        size_t submitted;
+    };
+
+    // outcode bits: the view volume's planes for rejection, and one bit for leaving the guard band
+    enum Clip_Plane {
+        CLIP_LEFT = 1, CLIP_RIGHT = 2, CLIP_BOTTOM = 4, CLIP_TOP = 8, CLIP_NEAR = 16, CLIP_FAR = 32,
+        CLIP_GUARD = 64
+    };
+    static const int CLIP_PLANE_COUNT = 5;  // what clipAndEmit clips against: near and the four guard band sides
+
+    ThreadPool& workers;
+    std::vector<MeshData> meshes;
+    std::vector<GeometryChunk> chunks;
+    SoftFramebuffer* framebuffer;
+    glm::mat4 viewProjection;
+    const SceneNode* const* nodes;
+    size_t nodeCount;
+    int tilesX, tilesY;
+    std::atomic<int> nextItem;
+
+    void geometryWorker()
+    {
+        for (;;)
+        {
+            int c = nextItem.fetch_add(1);
+            if (c >= (int)chunks.size())
+                return;
+            size_t first = nodeCount * c / chunks.size();
+            size_t last = nodeCount * (c + 1) / chunks.size();
+            for (size_t i = first; i < last; i++)
+                processNode(chunks[c], *nodes[i]);
+        }
+    }
+
+    void rasterWorker()
+    {
+        for (;;)
+        {
+            int tile = nextItem.fetch_add(1);
+            if (tile >= tilesX * tilesY)
+                return;
+            rasterizeTile(tile);
+        }
+    }
+
+    static unsigned char outcode(const glm::vec4& p)
+    {
+        unsigned char code = 0;
+        if (p.x < -p.w) code |= CLIP_LEFT;
+        if (p.x > p.w) code |= CLIP_RIGHT;
+        if (p.y < -p.w) code |= CLIP_BOTTOM;
+        if (p.y > p.w) code |= CLIP_TOP;
+        if (p.z < -p.w) code |= CLIP_NEAR;
+        if (p.z > p.w) code |= CLIP_FAR;
+        if (std::fabs(p.x) > SOFT_GUARD_BAND * p.w || std::fabs(p.y) > SOFT_GUARD_BAND * p.w)
+            code |= CLIP_GUARD;
+        return code;
+    }
+
+    // vertexShader.vs: gl_Position = projection * view * model * aPos, four lanes per matrix column
+    static void transformVertices(const glm::mat4& mvp, const float* vertices, size_t vertexCount, glm::vec4* out)
+    {
+        SoftFloat4 c0 = soft4(mvp[0].x, mvp[0].y, mvp[0].z, mvp[0].w);
+        SoftFloat4 c1 = soft4(mvp[1].x, mvp[1].y, mvp[1].z, mvp[1].w);
+        SoftFloat4 c2 = soft4(mvp[2].x, mvp[2].y, mvp[2].z, mvp[2].w);
+        SoftFloat4 c3 = soft4(mvp[3].x, mvp[3].y, mvp[3].z, mvp[3].w);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            const float* p = vertices + v * MESH_VERTEX_FLOATS;
+            SoftFloat4 r = c0 * soft4(p[0]) + c1 * soft4(p[1]) + c2 * soft4(p[2]) + c3;
+            soft4Store(&out[v].x, r);
+        }
+    }
+
+    void processNode(GeometryChunk& chunk, const SceneNode& node)
+    {
+        const float* vertices = CUBE_VERTICES;
+        const unsigned int* indices = CUBE_INDICES;
+        size_t vertexCount = CUBE_VERTEX_COUNT, indexCount = CUBE_INDEX_COUNT;
+        if (node.mesh != CUBE_MESH && node.mesh >= 0 && node.mesh < (int)meshes.size())
+        {
+            const MeshData& mesh = meshes[node.mesh];
+            vertices = &mesh.vertices[0];
+            indices = &mesh.indices[0];
+            vertexCount = mesh.vertexCount();
+            indexCount = mesh.indices.size();
+        }
+
+        glm::mat4 mvp = viewProjection * node.model;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(node.model)));
+        chunk.clipPositions.resize(vertexCount);
+        chunk.outcodes.resize(vertexCount);
+        transformVertices(mvp, vertices, vertexCount, &chunk.clipPositions[0]);
+        for (size_t v = 0; v < vertexCount; v++)
+            chunk.outcodes[v] = outcode(chunk.clipPositions[v]);
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            chunk.submitted++;
+            unsigned int i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+            unsigned char all = chunk.outcodes[i0] & chunk.outcodes[i1] & chunk.outcodes[i2];
+            if (all & (CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR))
+                continue;
+
+            // fragmentShader.fs: flat color; LIT scales it by the face normal against the light
+            glm::vec3 color = node.color;
+            if (Lit)
+            {
+                glm::vec3 p0(vertices[i0 * MESH_VERTEX_FLOATS], vertices[i0 * MESH_VERTEX_FLOATS + 1], vertices[i0 * MESH_VERTEX_FLOATS + 2]);
+                glm::vec3 p1(vertices[i1 * MESH_VERTEX_FLOATS], vertices[i1 * MESH_VERTEX_FLOATS + 1], vertices[i1 * MESH_VERTEX_FLOATS + 2]);
+                glm::vec3 p2(vertices[i2 * MESH_VERTEX_FLOATS], vertices[i2 * MESH_VERTEX_FLOATS + 1], vertices[i2 * MESH_VERTEX_FLOATS + 2]);
+                glm::vec3 normal = normalMatrix * glm::cross(p1 - p0, p2 - p0);
+                float length = glm::length(normal);
+                float light = length > 0.0f ? std::fabs(glm::dot(normal / length, SOFT_LIGHT_DIRECTION)) : 0.0f;
+                color = color * (0.35f + 0.65f * light);
+            }
+            uint32_t packed = softPackColor(color);
+
+            unsigned char any = chunk.outcodes[i0] | chunk.outcodes[i1] | chunk.outcodes[i2];
+            if (any & (CLIP_NEAR | CLIP_GUARD))
+                clipAndEmit(chunk, chunk.clipPositions[i0], chunk.clipPositions[i1], chunk.clipPositions[i2], packed);
+            else
+                emitTriangle(chunk, chunk.clipPositions[i0], chunk.clipPositions[i1], chunk.clipPositions[i2], packed);
+        }
+    }
+
+    // signed distance to clip plane p: near, then the four guard band planes
+    static float planeDistance(const glm::vec4& v, int plane)
+    {
+        switch (plane)
+        {
+        case 0: return v.z + v.w;
+        case 1: return SOFT_GUARD_BAND * v.w + v.x;
+        case 2: return SOFT_GUARD_BAND * v.w - v.x;
+        case 3: return SOFT_GUARD_BAND * v.w + v.y;
+        default: return SOFT_GUARD_BAND * v.w - v.y;
+        }
+    }
+
+    // Sutherland-Hodgman against the near plane and the guard band, then a fan of what is left
+    void clipAndEmit(GeometryChunk& chunk, const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, uint32_t color)
+    {
+        glm::vec4 polygon[2][3 + CLIP_PLANE_COUNT];
+        int count = 3;
+        polygon[0][0] = a;
+        polygon[0][1] = b;
+        polygon[0][2] = c;
+        int current = 0;
+        for (int plane = 0; plane < CLIP_PLANE_COUNT && count >= 3; plane++)
+        {
+            const glm::vec4* in = polygon[current];
+            glm::vec4* out = polygon[current ^ 1];
+            int outCount = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const glm::vec4& p = in[i];
+                const glm::vec4& q = in[(i + 1) % count];
+                float dp = planeDistance(p, plane), dq = planeDistance(q, plane);
+                if (dp >= 0.0f)
+                    out[outCount++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f))
+                    out[outCount++] = p + (q - p) * (dp / (dp - dq));
+            }
+            count = outCount;
+            current ^= 1;
+        }
+        for (int i = 1; i + 1 < count; i++)
+            emitTriangle(chunk, polygon[current][0], polygon[current][i], polygon[current][i + 1], color);
+    }
+
+    // perspective divide, viewport transform, edge setup and binning
+    void emitTriangle(GeometryChunk& chunk, const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, uint32_t color)
+    {
+        const float width = (float)framebuffer->width, height = (float)framebuffer->height;
+        float w0 = 1.0f / c0.w, w1 = 1.0f / c1.w, w2 = 1.0f / c2.w;
+        // screen space with y down, so row 0 is the top of the image
+        SoftFloat4 x = soft4((c0.x * w0 * 0.5f + 0.5f) * width, (c1.x * w1 * 0.5f + 0.5f) * width, (c2.x * w2 * 0.5f + 0.5f) * width, 0.0f);
+        SoftFloat4 y = soft4((0.5f - c0.y * w0 * 0.5f) * height, (0.5f - c1.y * w1 * 0.5f) * height, (0.5f - c2.y * w2 * 0.5f) * height, 0.0f);
+        float z[3] = { c0.z * w0 * 0.5f + 0.5f, c1.z * w1 * 0.5f + 0.5f, c2.z * w2 * 0.5f + 0.5f };
+
+        // edge i runs from vertex i+1 to vertex i+2 and is zero on that side; all three set up in one go:
+        // A = ya - yb, B = xb - xa
+        float xs[4], ys[4];
+        soft4Store(xs, x);
+        soft4Store(ys, y);
+        SoftFloat4 xa = soft4(xs[1], xs[2], xs[0], 0.0f), xb = soft4(xs[2], xs[0], xs[1], 0.0f);
+        SoftFloat4 ya = soft4(ys[1], ys[2], ys[0], 0.0f), yb = soft4(ys[2], ys[0], ys[1], 0.0f);
+        SoftFloat4 edgeA = ya - yb;
+        SoftFloat4 edgeB = xb - xa;
+        float A[4], B[4];
+        soft4Store(A, edgeA);
+        soft4Store(B, edgeB);
+        float area = A[0] * (xs[0] - xs[1]) + B[0] * (ys[0] - ys[1]);
+        if (!(std::fabs(area) > 1e-8f))
+            return;
+        // two-sided: flip clockwise triangles so the inside is always positive
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+
+        float minXf = std::min(xs[0], std::min(xs[1], xs[2])), maxXf = std::max(xs[0], std::max(xs[1], xs[2]));
+        float minYf = std::min(ys[0], std::min(ys[1], ys[2])), maxYf = std::max(ys[0], std::max(ys[1], ys[2]));
+        SoftTriangle tri;
+        tri.minX = std::max(0, (int)std::floor(minXf));
+        tri.minY = std::max(0, (int)std::floor(minYf));
+        tri.maxX = std::min(framebuffer->width - 1, (int)std::floor(maxXf));
+        tri.maxY = std::min(framebuffer->height - 1, (int)std::floor(maxYf));
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        float originX = tri.minX + 0.5f, originY = tri.minY + 0.5f;
+        SoftFloat4 signs = soft4(sign);
+        SoftFloat4 origin = (edgeA * (soft4(originX) - xa) + edgeB * (soft4(originY) - ya)) * signs;
+        soft4Store(A, edgeA * signs);
+        soft4Store(B, edgeB * signs);
+        float E[4];
+        soft4Store(E, origin);
+        float invArea = 1.0f / (area * sign);
+        for (int i = 0; i < 3; i++)
+        {
+            tri.edgeA[i] = A[i];
+            tri.edgeB[i] = B[i];
+            tri.edgeOrigin[i] = E[i];
+            // top-left rule: pixels exactly on an edge belong to the triangle only for left and top edges,
+            // so shared edges are drawn once; E >= denorm_min is E > 0 for the others
+            bool topLeft = A[i] > 0.0f || (A[i] == 0.0f && B[i] > 0.0f);
+            tri.edgeBias[i] = topLeft ? 0.0f : std::numeric_limits<float>::denorm_min();
+        }
+        // depth is linear in screen space: z = sum(E_i * z_i) / area
+        tri.dzdx = (A[0] * z[0] + A[1] * z[1] + A[2] * z[2]) * invArea;
+        tri.dzdy = (B[0] * z[0] + B[1] * z[1] + B[2] * z[2]) * invArea;
+        tri.zOrigin = (E[0] * z[0] + E[1] * z[1] + E[2] * z[2]) * invArea;
+        tri.color = color;
+
+        uint32_t index = (uint32_t)chunk.triangles.size();
+        chunk.triangles.push_back(tri);
+        int tileX0 = tri.minX / SOFT_TILE_SIZE, tileX1 = tri.maxX / SOFT_TILE_SIZE;
+        int tileY0 = tri.minY / SOFT_TILE_SIZE, tileY1 = tri.maxY / SOFT_TILE_SIZE;
+        for (int ty = tileY0; ty <= tileY1; ty++)
+        {
+            for (int tx = tileX0; tx <= tileX1; tx++)
+                chunk.bins[(size_t)ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    void rasterizeTile(int tile)
+    {
+        SoftFramebuffer& target = *framebuffer;
+        int tileX = (tile % tilesX) * SOFT_TILE_SIZE, tileY = (tile / tilesX) * SOFT_TILE_SIZE;
+
+        // the clear happens here too, so it is spread over the threads and the tile stays in cache
+        uint32_t clear = softPackColor(SOFT_CLEAR_COLOR);
+        for (int y = tileY; y < tileY + SOFT_TILE_SIZE; y++)
+        {
+            uint32_t* colorRow = &target.color[(size_t)y * target.stride + tileX];
+            float* depthRow = &target.depth[(size_t)y * target.stride + tileX];
+            std::fill(colorRow, colorRow + SOFT_TILE_SIZE, clear);
+            std::fill(depthRow, depthRow + SOFT_TILE_SIZE, 1.0f);
+            if (Overdraw != OVERDRAW_OFF)
+            {
+                uint32_t* countRow = &target.fragments[(size_t)y * target.stride + tileX];
+                std::fill(countRow, countRow + SOFT_TILE_SIZE, 0u);
+            }
+        }
+
+        const SoftFloat4 lanes = soft4(0.0f, 1.0f, 2.0f, 3.0f);
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            const GeometryChunk& chunk = chunks[c];
+            const std::vector<uint32_t>& bin = chunk.bins[tile];
+            for (size_t b = 0; b < bin.size(); b++)
+            {
+                const SoftTriangle& tri = chunk.triangles[bin[b]];
+                // tile starts are multiples of 4, so aligning down never leaves the tile
+                int x0 = std::max(tri.minX, tileX) & ~3;
+                int x1 = std::min(tri.maxX, tileX + SOFT_TILE_SIZE - 1);
+                int y0 = std::max(tri.minY, tileY);
+                int y1 = std::min(tri.maxY, tileY + SOFT_TILE_SIZE - 1);
+
+                SoftFloat4 stepA[3], edgeA[3], edgeB[3], edgeOrigin[3], bias[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    edgeA[i] = soft4(tri.edgeA[i]);
+                    edgeB[i] = soft4(tri.edgeB[i]);
+                    edgeOrigin[i] = soft4(tri.edgeOrigin[i]);
+                    stepA[i] = soft4(tri.edgeA[i] * 4.0f);
+                    bias[i] = soft4(tri.edgeBias[i]);
+                }
+                SoftFloat4 dzdx = soft4(tri.dzdx), stepZ = soft4(tri.dzdx * 4.0f);
+                uint32_t colors[4] = { tri.color, tri.color, tri.color, tri.color };
+                SoftFloat4 color = soft4LoadBits(colors);
+
+                SoftFloat4 dx = soft4((float)(x0 - tri.minX)) + lanes;
+                for (int y = y0; y <= y1; y++)
+                {
+                    SoftFloat4 dy = soft4((float)(y - tri.minY));
+                    SoftFloat4 e0 = edgeOrigin[0] + edgeA[0] * dx + edgeB[0] * dy;
+                    SoftFloat4 e1 = edgeOrigin[1] + edgeA[1] * dx + edgeB[1] * dy;
+                    SoftFloat4 e2 = edgeOrigin[2] + edgeA[2] * dx + edgeB[2] * dy;
+                    SoftFloat4 z = soft4(tri.zOrigin) + dzdx * dx + soft4(tri.dzdy) * dy;
+                    size_t row = (size_t)y * target.stride;
+                    for (int x = x0; x <= x1; x += 4)
+                    {
+                        SoftFloat4 inside = soft4Ge(e0, bias[0]) & soft4Ge(e1, bias[1]) & soft4Ge(e2, bias[2]);
+                        if (soft4Any(inside))
+                        {
+                            float* depth = &target.depth[row + x];
+                            SoftFloat4 stored = soft4Load(depth);
+                            SoftFloat4 pass = inside & soft4Lt(z, stored);
+                            if (soft4Any(pass))
+                            {
+                                soft4Store(depth, soft4Select(pass, z, stored));
+                                uint32_t* pixels = &target.color[row + x];
+                                soft4StoreBits(pixels, soft4Select(pass, color, soft4LoadBits(pixels)));
+                            }
+                            if (Overdraw != OVERDRAW_OFF)
+                            {
+                                int counted = soft4Mask(Overdraw == OVERDRAW_RASTERIZED ? inside : pass);
+                                uint32_t* fragments = &target.fragments[row + x];
+                                for (int i = 0; i < 4; i++)
+                                    fragments[i] += (counted >> i) & 1;
+                            }
+                        }
+                        e0 = e0 + stepA[0];
+                        e1 = e1 + stepA[1];
+                        e2 = e2 + stepA[2];
+                        z = z + stepZ;
+                    }
+                }
+            }
+        }
+    }
+};
+#endif
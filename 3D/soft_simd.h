@@ -0,0 +1,117 @@
+//
+//  soft_simd.h
+//  3D Object Drawing
+//
+
+#ifndef SOFT_SIMD_H
+#define SOFT_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_SIMD_SSE 1
+#endif
+
+// Four floats processed together: SSE2 where the compiler has it, plain arrays elsewhere.
+// Masks are all-ones or all-zero lanes, as the SSE compares produce them.
+#ifdef SOFT_SIMD_SSE
+struct SoftFloat4
+{
+    __m128 v;
+};
+inline SoftFloat4 soft4(float s) { SoftFloat4 r; r.v = _mm_set1_ps(s); return r; }
+inline SoftFloat4 soft4(float a, float b, float c, float d) { SoftFloat4 r; r.v = _mm_setr_ps(a, b, c, d); return r; }
+inline SoftFloat4 soft4Load(const float* p) { SoftFloat4 r; r.v = _mm_loadu_ps(p); return r; }
+inline void soft4Store(float* p, SoftFloat4 a) { _mm_storeu_ps(p, a.v); }
+inline SoftFloat4 soft4LoadBits(const uint32_t* p) { SoftFloat4 r; r.v = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)p)); return r; }
+inline void soft4StoreBits(uint32_t* p, SoftFloat4 a) { _mm_storeu_si128((__m128i*)p, _mm_castps_si128(a.v)); }
+inline SoftFloat4 operator+(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_add_ps(a.v, b.v); return r; }
+inline SoftFloat4 operator-(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_sub_ps(a.v, b.v); return r; }
+inline SoftFloat4 operator*(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_mul_ps(a.v, b.v); return r; }
+inline SoftFloat4 operator/(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_div_ps(a.v, b.v); return r; }
+inline SoftFloat4 operator&(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_and_ps(a.v, b.v); return r; }
+inline SoftFloat4 operator|(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_or_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4AndNot(SoftFloat4 mask, SoftFloat4 a) { SoftFloat4 r; r.v = _mm_andnot_ps(mask.v, a.v); return r; }
+inline SoftFloat4 soft4Min(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_min_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4Max(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_max_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4Abs(SoftFloat4 a) { SoftFloat4 r; r.v = _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); return r; }
+inline SoftFloat4 soft4Ge(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_cmpge_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4Gt(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_cmpgt_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4Lt(SoftFloat4 a, SoftFloat4 b) { SoftFloat4 r; r.v = _mm_cmplt_ps(a.v, b.v); return r; }
+inline SoftFloat4 soft4Select(SoftFloat4 mask, SoftFloat4 a, SoftFloat4 b)
+{
+    SoftFloat4 r;
+    r.v = _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    return r;
+}
+inline bool soft4Any(SoftFloat4 mask) { return _mm_movemask_ps(mask.v) != 0; }
+// one bit per lane, lane 0 in bit 0
+inline int soft4Mask(SoftFloat4 mask) { return _mm_movemask_ps(mask.v); }
+// SSE2 has no floor: truncate and step down where that rounded up; only for |a| below 2^31
+inline SoftFloat4 soft4Floor(SoftFloat4 a)
+{
+    SoftFloat4 r;
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    r.v = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+    return r;
+}
+#else
+struct SoftFloat4
+{
+    float v[4];
+};
+inline SoftFloat4 soft4(float s) { SoftFloat4 r = { { s, s, s, s } }; return r; }
+inline SoftFloat4 soft4(float a, float b, float c, float d) { SoftFloat4 r = { { a, b, c, d } }; return r; }
+inline SoftFloat4 soft4Load(const float* p) { SoftFloat4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void soft4Store(float* p, SoftFloat4 a) { memcpy(p, a.v, sizeof(a.v)); }
+inline SoftFloat4 soft4LoadBits(const uint32_t* p) { SoftFloat4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void soft4StoreBits(uint32_t* p, SoftFloat4 a) { memcpy(p, a.v, sizeof(a.v)); }
+inline uint32_t soft4Bits(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+inline float soft4Float(uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+inline SoftFloat4 operator+(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline SoftFloat4 operator-(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline SoftFloat4 operator*(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline SoftFloat4 operator/(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] /= b.v[i]; return a; }
+inline SoftFloat4 operator&(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(soft4Bits(a.v[i]) & soft4Bits(b.v[i])); return a; }
+inline SoftFloat4 operator|(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(soft4Bits(a.v[i]) | soft4Bits(b.v[i])); return a; }
+inline SoftFloat4 soft4AndNot(SoftFloat4 mask, SoftFloat4 a) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(~soft4Bits(mask.v[i]) & soft4Bits(a.v[i])); return a; }
+// same operand order as _mm_min_ps/_mm_max_ps: b comes back when either is NaN
+inline SoftFloat4 soft4Min(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline SoftFloat4 soft4Max(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline SoftFloat4 soft4Abs(SoftFloat4 a) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(soft4Bits(a.v[i]) & 0x7FFFFFFFu); return a; }
+inline SoftFloat4 soft4Ge(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(a.v[i] >= b.v[i] ? 0xFFFFFFFFu : 0u); return a; }
+inline SoftFloat4 soft4Gt(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(a.v[i] > b.v[i] ? 0xFFFFFFFFu : 0u); return a; }
+inline SoftFloat4 soft4Lt(SoftFloat4 a, SoftFloat4 b) { for (int i = 0; i < 4; i++) a.v[i] = soft4Float(a.v[i] < b.v[i] ? 0xFFFFFFFFu : 0u); return a; }
+inline SoftFloat4 soft4Select(SoftFloat4 mask, SoftFloat4 a, SoftFloat4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.v[i] = soft4Bits(mask.v[i]) ? a.v[i] : b.v[i];
+    return a;
+}
+inline bool soft4Any(SoftFloat4 mask) { for (int i = 0; i < 4; i++) if (soft4Bits(mask.v[i])) return true; return false; }
+inline int soft4Mask(SoftFloat4 mask) { int bits = 0; for (int i = 0; i < 4; i++) if (soft4Bits(mask.v[i]) >> 31) bits |= 1 << i; return bits; }
+inline SoftFloat4 soft4Floor(SoftFloat4 a) { for (int i = 0; i < 4; i++) a.v[i] = std::floor(a.v[i]); return a; }
+#endif
+
+// sine and cosine of four angles in radians, |x| below about 10^5. The angle is reduced to a quarter turn
+// around zero and both functions come from their Taylor series there: errors stay below 1e-6.
+inline void soft4SinCos(SoftFloat4 x, SoftFloat4& s, SoftFloat4& c)
+{
+    // quadrant, and the remainder in [-pi/4, pi/4]; pi/2 is split in two parts so the remainder stays exact
+    SoftFloat4 quadrant = soft4Floor(x * soft4(0.63661977f) + soft4(0.5f));
+    SoftFloat4 r = x - quadrant * soft4(1.5703125f) - quadrant * soft4(4.8382679e-4f);
+    SoftFloat4 r2 = r * r;
+    SoftFloat4 sinR = r + r * r2 * (soft4(-1.0f / 6.0f) + r2 * (soft4(1.0f / 120.0f) + r2 * (soft4(-1.0f / 5040.0f) + r2 * soft4(1.0f / 362880.0f))));
+    SoftFloat4 cosR = soft4(1.0f) + r2 * (soft4(-0.5f) + r2 * (soft4(1.0f / 24.0f) + r2 * (soft4(-1.0f / 720.0f) + r2 * soft4(1.0f / 40320.0f))));
+    // quadrant 0..3: odd ones swap the two, 2 and 3 negate the sine, 1 and 2 the cosine
+    SoftFloat4 q = quadrant - soft4Floor(quadrant * soft4(0.25f)) * soft4(4.0f);
+    SoftFloat4 odd = soft4Lt(soft4Abs(q - soft4(1.0f)), soft4(0.5f)) | soft4Lt(soft4Abs(q - soft4(3.0f)), soft4(0.5f));
+    SoftFloat4 sinQ = soft4Select(odd, cosR, sinR);
+    SoftFloat4 cosQ = soft4Select(odd, sinR, cosR);
+    s = soft4Select(soft4Gt(q, soft4(1.5f)), soft4(0.0f) - sinQ, sinQ);
+    c = soft4Select(soft4Lt(soft4Abs(q - soft4(1.5f)), soft4(1.0f)), soft4(0.0f) - cosQ, cosQ);
+}
+#endif
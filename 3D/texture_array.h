@@ -0,0 +1,648 @@
+//
+//  texture_array.h
+//  3D Object Drawing
+//
+
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include "mesh_asset.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// block compressed formats that are extensions in a core 3.3 loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+// texture handle of nodes drawn with their flat color only
+const int NO_TEXTURE = -1;
+
+// Default texture values
+const int TEXTURE_ARRAY_LAYERS = 16;                             // most textures sharing one array
+const int TEXTURE_ARRAY_UNIT_BASE = 1;                           // unit 0 stays free for ordinary 2D textures
+const int MAX_TEXTURE_ARRAYS = 15;                               // units 1..15; GL 3.3 guarantees 16 per stage
+const size_t TEXTURE_VRAM_BUDGET_BYTES = 64 * 1024 * 1024;       // array storage the streamer may allocate
+const size_t TEXTURE_UPLOAD_BUDGET_BYTES = 2 * 1024 * 1024;      // mip bytes uploaded per frame
+
+
+// One mip level inside TextureImage::data; level 0 is the largest
+struct TextureLevel
+{
+    int width, height;
+    size_t offset, size;
+};
+
+// A block compressed image straight from a DDS or KTX2 file
+struct TextureImage
+{
+    unsigned int format;
+    int blockBytes;
+    int width, height;
+    std::vector<TextureLevel> levels;
+    std::vector<char> data;
+};
+
+inline size_t compressedLevelSize(int width, int height, int blockBytes)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+inline unsigned int readU32(const std::vector<char>& bytes, size_t offset)
+{
+    unsigned int value;
+    memcpy(&value, &bytes[offset], 4);
+    return value;
+}
+
+inline unsigned long long readU64(const std::vector<char>& bytes, size_t offset)
+{
+    unsigned long long value;
+    memcpy(&value, &bytes[offset], 8);
+    return value;
+}
+
+inline unsigned int fourCC(const char* code)
+{
+    return (unsigned int)(unsigned char)code[0] | ((unsigned int)(unsigned char)code[1] << 8) |
+        ((unsigned int)(unsigned char)code[2] << 16) | ((unsigned int)(unsigned char)code[3] << 24);
+}
+
+// fills in the mip chain of a tightly packed image starting at offset
+inline bool layoutLevels(TextureImage& image, int levelCount, size_t offset, std::string& error)
+{
+    int w = image.width, h = image.height;
+    image.levels.clear();
+    for (int i = 0; i < levelCount; i++)
+    {
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.offset = offset;
+        level.size = compressedLevelSize(w, h, image.blockBytes);
+        offset += level.size;
+        image.levels.push_back(level);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    if (offset > image.data.size())
+    {
+        error = "truncated mip chain";
+        return false;
+    }
+    return true;
+}
+
+inline bool readTextureFile(const std::string& path, std::vector<char>& bytes, std::string& error)
+{
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        error = "file not found";
+        return false;
+    }
+    bytes.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(bytes.data(), bytes.size());
+    return true;
+}
+
+// DDS with BC1/BC3/BC4/BC5 FourCCs or a DX10 header carrying BC1/3/4/5/7
+inline bool loadDds(const std::string& path, TextureImage& image, std::string& error)
+{
+    if (!readTextureFile(path, image.data, error))
+        return false;
+    const std::vector<char>& bytes = image.data;
+    if (bytes.size() < 128 || memcmp(&bytes[0], "DDS ", 4) != 0)
+    {
+        error = "not a DDS file";
+        return false;
+    }
+    image.height = (int)readU32(bytes, 12);
+    image.width = (int)readU32(bytes, 16);
+    int levelCount = (int)readU32(bytes, 28);
+    unsigned int code = readU32(bytes, 84);
+    unsigned int caps2 = readU32(bytes, 112);
+    if (caps2 & 0x200200) // cube map or volume
+    {
+        error = "only 2D textures are supported";
+        return false;
+    }
+    size_t offset = 128;
+    image.format = 0;
+    if (code == fourCC("DXT1")) { image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; image.blockBytes = 8; }
+    else if (code == fourCC("DXT5")) { image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; image.blockBytes = 16; }
+    else if (code == fourCC("ATI1") || code == fourCC("BC4U")) { image.format = GL_COMPRESSED_RED_RGTC1; image.blockBytes = 8; }
+    else if (code == fourCC("ATI2") || code == fourCC("BC5U")) { image.format = GL_COMPRESSED_RG_RGTC2; image.blockBytes = 16; }
+    else if (code == fourCC("DX10") && bytes.size() >= 148)
+    {
+        offset = 148;
+        switch (readU32(bytes, 128))
+        {
+        case 71: image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+        case 72: image.format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+        case 77: image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; image.blockBytes = 16; break;
+        case 78: image.format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; image.blockBytes = 16; break;
+        case 80: image.format = GL_COMPRESSED_RED_RGTC1; image.blockBytes = 8; break;
+        case 83: image.format = GL_COMPRESSED_RG_RGTC2; image.blockBytes = 16; break;
+        case 98: image.format = GL_COMPRESSED_RGBA_BPTC_UNORM; image.blockBytes = 16; break;
+        case 99: image.format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; image.blockBytes = 16; break;
+        }
+        if (readU32(bytes, 140) > 1)
+        {
+            error = "DDS arrays are not supported";
+            return false;
+        }
+    }
+    if (image.format == 0)
+    {
+        error = "not a BCn compressed DDS";
+        return false;
+    }
+    if (image.width <= 0 || image.height <= 0)
+    {
+        error = "bad image size";
+        return false;
+    }
+    return layoutLevels(image, levelCount > 0 ? levelCount : 1, offset, error);
+}
+
+// KTX2 with a BCn vkFormat and no supercompression
+inline bool loadKtx2(const std::string& path, TextureImage& image, std::string& error)
+{
+    static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    if (!readTextureFile(path, image.data, error))
+        return false;
+    const std::vector<char>& bytes = image.data;
+    if (bytes.size() < 80 || memcmp(&bytes[0], identifier, 12) != 0)
+    {
+        error = "not a KTX2 file";
+        return false;
+    }
+    unsigned int vkFormat = readU32(bytes, 12);
+    image.width = (int)readU32(bytes, 20);
+    image.height = (int)readU32(bytes, 24);
+    if (readU32(bytes, 28) != 0 || readU32(bytes, 32) > 1 || readU32(bytes, 36) != 1)
+    {
+        error = "only 2D textures are supported";
+        return false;
+    }
+    int levelCount = (int)readU32(bytes, 40);
+    if (levelCount == 0)
+        levelCount = 1;
+    if (readU32(bytes, 44) != 0)
+    {
+        error = "supercompressed KTX2 is not supported";
+        return false;
+    }
+    image.format = 0;
+    switch (vkFormat)
+    {
+    case 131: image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+    case 132: image.format = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+    case 133: image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+    case 134: image.format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; image.blockBytes = 8; break;
+    case 137: image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; image.blockBytes = 16; break;
+    case 138: image.format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; image.blockBytes = 16; break;
+    case 139: image.format = GL_COMPRESSED_RED_RGTC1; image.blockBytes = 8; break;
+    case 141: image.format = GL_COMPRESSED_RG_RGTC2; image.blockBytes = 16; break;
+    case 145: image.format = GL_COMPRESSED_RGBA_BPTC_UNORM; image.blockBytes = 16; break;
+    case 146: image.format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; image.blockBytes = 16; break;
+    }
+    if (image.format == 0)
+    {
+        error = "not a BCn compressed KTX2";
+        return false;
+    }
+    if (image.width <= 0 || image.height <= 0 || bytes.size() < 80 + 24 * (size_t)levelCount)
+    {
+        error = "bad header";
+        return false;
+    }
+    // the level index lists level 0 first; the data itself is stored smallest mip first
+    int w = image.width, h = image.height;
+    image.levels.clear();
+    for (int i = 0; i < levelCount; i++)
+    {
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.offset = (size_t)readU64(bytes, 80 + 24 * i);
+        level.size = (size_t)readU64(bytes, 80 + 24 * i + 8);
+        if (level.size != compressedLevelSize(w, h, image.blockBytes) || level.offset + level.size > bytes.size())
+        {
+            error = "bad level index";
+            return false;
+        }
+        image.levels.push_back(level);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    return true;
+}
+
+inline bool loadCompressedTexture(const std::string& path, TextureImage& image, std::string& error)
+{
+    size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? std::string() : path.substr(dot);
+    if (extension == ".dds" || extension == ".DDS")
+        return loadDds(path, image, error);
+    if (extension == ".ktx2" || extension == ".KTX2")
+        return loadKtx2(path, image, error);
+    error = "unknown texture container";
+    return false;
+}
+
+// One texture on its way from disk into a layer of a texture array
+struct TextureAsset
+{
+    std::string path;
+    std::atomic<int> state;
+    TextureImage image;
+    std::string error;
+    int array, layer;
+    int residentLevel;      // finest mip uploaded; levels.size() while nothing is
+    double requestTime, parseEnd;
+
+    TextureAsset() : state(ASSET_QUEUED), array(-1), layer(-1), residentLevel(0), requestTime(0.0), parseEnd(0.0) {}
+};
+
+// What a draw needs to sample its texture: the unit its array lives on, its layer and the finest mip it may use
+struct TextureBinding
+{
+    int unit;
+    float layer;
+    float minLod;   // relative to the array's base level, for textureLod
+};
+
+// Loads BCn textures in the background into GL_TEXTURE_2D_ARRAYs, one array per format, size and mip count.
+// Every array stays bound to its own texture unit, so a draw selects its texture with uniforms instead of a bind.
+// Mips stream smallest first across all textures; finer levels are allocated for a whole array only while the
+// VRAM budget allows, and each layer's minimum LOD keeps the shader off levels its data has not reached yet.
+// An array has storage for the layers it holds and no more: a texture joining one that already has levels
+// allocated reallocates it a layer larger and copies the old layers across through a buffer on the GPU.
+class TextureArrayManager
+{
+public:
+    size_t VramBudgetBytes;
+    size_t UploadBudgetBytes;
+    // statistics
+    size_t CompressedBytes;     // mip data of every loaded texture
+    size_t Rgba8Bytes;          // the same mip chains stored as RGBA8
+    size_t VramBytes;           // allocated array storage, for the layers in use
+    int BindsThisFrame;
+    int TotalBinds;
+
+    TextureArrayManager(ThreadPool& pool, size_t vramBudgetBytes = TEXTURE_VRAM_BUDGET_BYTES, size_t uploadBudgetBytes = TEXTURE_UPLOAD_BUDGET_BYTES)
+        : VramBudgetBytes(vramBudgetBytes), UploadBudgetBytes(uploadBudgetBytes), CompressedBytes(0), Rgba8Bytes(0), VramBytes(0),
+          BindsThisFrame(0), TotalBinds(0), workers(pool)
+    {
+    }
+
+    ~TextureArrayManager()
+    {
+        // parse jobs hold pointers to our assets
+        workers.waitIdle();
+    }
+
+    // returns a handle right away; the same path always maps to the same handle
+    int requestTexture(const char* path)
+    {
+        std::unordered_map<std::string, int>::iterator it = handles.find(path);
+        if (it != handles.end())
+            return it->second;
+
+        int handle = (int)textures.size();
+        textures.push_back(std::unique_ptr<TextureAsset>(new TextureAsset()));
+        TextureAsset* texture = textures.back().get();
+        texture->path = path;
+        texture->requestTime = assetClockMs();
+        handles[texture->path] = handle;
+
+        workers.submit([texture]() {
+            texture->state.store(ASSET_LOADING);
+            bool ok = loadCompressedTexture(texture->path, texture->image, texture->error);
+            texture->parseEnd = assetClockMs();
+            texture->state.store(ok ? ASSET_PARSED : ASSET_FAILED, std::memory_order_release);
+        });
+        return handle;
+    }
+
+    // render thread, once per frame: places parsed textures in arrays and streams mips within the budgets;
+    // true if a texture was placed or a level uploaded
+    bool update()
+    {
+        BindsThisFrame = 0;
+        bool placed = false;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            TextureAsset& texture = *textures[i];
+            int state = texture.state.load(std::memory_order_acquire);
+            if (state == ASSET_FAILED && !texture.error.empty())
+            {
+                // a texture that is not on disk keeps its flat colour quietly; only broken files are worth a message
+                if (texture.error != "file not found")
+                    std::cout << "TEXTURE::LOAD_FAILED " << texture.path << ": " << texture.error << std::endl;
+                texture.error.clear();
+            }
+            else if (state == ASSET_PARSED)
+            {
+                place(texture);
+                placed = true;
+            }
+        }
+
+        // always the smallest pending mip next, so every texture gets its low levels before anyone gets detail
+        size_t budget = UploadBudgetBytes;
+        bool uploaded = false;
+        for (;;)
+        {
+            TextureAsset* next = NULL;
+            size_t nextBytes = 0;
+            for (size_t i = 0; i < textures.size(); i++)
+            {
+                TextureAsset& texture = *textures[i];
+                if (texture.state.load(std::memory_order_relaxed) != ASSET_UPLOADING)
+                    continue;
+                size_t bytes = texture.image.levels[texture.residentLevel - 1].size;
+                if (!next || bytes < nextBytes)
+                {
+                    next = &texture;
+                    nextBytes = bytes;
+                }
+            }
+            // a level larger than the whole budget still goes through on a frame with nothing else
+            if (!next || (uploaded && nextBytes > budget))
+                break;
+            if (!uploadLevel(*next))
+                continue;
+            budget = nextBytes > budget ? 0 : budget - nextBytes;
+            uploaded = true;
+        }
+        glActiveTexture(GL_TEXTURE0);
+        return placed || uploaded;
+    }
+
+    // textures still on their way: queued, parsing or streaming levels
+    int pendingCount() const
+    {
+        int pending = 0;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            int state = textures[i]->state.load(std::memory_order_relaxed);
+            pending += state != ASSET_RESIDENT && state != ASSET_FAILED;
+        }
+        return pending;
+    }
+
+    // false while the texture has no mip on the GPU; the draw then uses its flat color
+    bool binding(int handle, TextureBinding& out) const
+    {
+        if (handle < 0 || handle >= (int)textures.size())
+            return false;
+        const TextureAsset& texture = *textures[handle];
+        int state = texture.state.load(std::memory_order_relaxed);
+        if ((state != ASSET_UPLOADING && state != ASSET_RESIDENT) || texture.residentLevel >= (int)texture.image.levels.size())
+            return false;
+        const TextureArray& array = arrays[texture.array];
+        out.unit = array.unit;
+        out.layer = (float)texture.layer;
+        out.minLod = (float)(texture.residentLevel - array.baseLevel);
+        return true;
+    }
+
+    int arrayCount() const
+    {
+        return (int)arrays.size();
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        workers.waitIdle();
+        for (size_t i = 0; i < arrays.size(); i++)
+            glDeleteTextures(1, &arrays[i].ID);
+        arrays.clear();
+    }
+
+private:
+    struct TextureArray
+    {
+        unsigned int ID;
+        unsigned int format;
+        int blockBytes;
+        int width, height, levelCount;
+        int usedLayers;
+        int allocatedLayers;    // layers the storage of levels baseLevel and up has room for
+        int baseLevel;          // finest level with storage; levelCount while none has
+        int unit;
+    };
+
+    ThreadPool& workers;
+    std::vector<std::unique_ptr<TextureAsset> > textures;
+    std::unordered_map<std::string, int> handles;
+    std::vector<TextureArray> arrays;
+
+    void place(TextureAsset& texture)
+    {
+        const TextureImage& image = texture.image;
+        int levelCount = (int)image.levels.size();
+        int found = -1;
+        for (size_t i = 0; i < arrays.size() && found < 0; i++)
+        {
+            const TextureArray& array = arrays[i];
+            if (array.format == image.format && array.width == image.width && array.height == image.height &&
+                array.levelCount == levelCount && array.usedLayers < TEXTURE_ARRAY_LAYERS)
+                found = (int)i;
+        }
+        if (found < 0)
+        {
+            if ((int)arrays.size() == MAX_TEXTURE_ARRAYS)
+            {
+                std::cout << "TEXTURE::LOAD_FAILED " << texture.path << ": no texture unit left for another format or size" << std::endl;
+                texture.state.store(ASSET_FAILED, std::memory_order_relaxed);
+                return;
+            }
+            TextureArray array;
+            array.format = image.format;
+            array.blockBytes = image.blockBytes;
+            array.width = image.width;
+            array.height = image.height;
+            array.levelCount = levelCount;
+            array.usedLayers = 0;
+            array.allocatedLayers = 0;
+            array.baseLevel = levelCount;
+            array.unit = TEXTURE_ARRAY_UNIT_BASE + (int)arrays.size();
+            createArrayTexture(array);
+            found = (int)arrays.size();
+            arrays.push_back(array);
+        }
+        if (!growArray(arrays[found], arrays[found].usedLayers + 1))
+        {
+            std::cout << "TEXTURE::BUDGET " << texture.path << ": no room for another layer in array " << found << std::endl;
+            texture.state.store(ASSET_FAILED, std::memory_order_relaxed);
+            return;
+        }
+        texture.array = found;
+        texture.layer = arrays[found].usedLayers++;
+        texture.residentLevel = levelCount;
+        for (int i = 0; i < levelCount; i++)
+        {
+            CompressedBytes += image.levels[i].size;
+            Rgba8Bytes += (size_t)image.levels[i].width * image.levels[i].height * 4;
+        }
+        texture.state.store(ASSET_UPLOADING, std::memory_order_relaxed);
+    }
+
+    // uploads the next finer mip of one texture; false when the budget stopped it instead
+    bool uploadLevel(TextureAsset& texture)
+    {
+        TextureArray& array = arrays[texture.array];
+        int level = texture.residentLevel - 1;
+        glActiveTexture(GL_TEXTURE0 + array.unit);
+        if (level < array.baseLevel)
+        {
+            // storage for a level covers every layer of the array
+            size_t cost = 0;
+            for (int l = level; l < array.baseLevel; l++)
+                cost += levelSize(array, l) * array.allocatedLayers;
+            if (VramBytes + cost > VramBudgetBytes)
+            {
+                std::cout << "TEXTURE::BUDGET " << texture.path << " stays at mip " << texture.residentLevel << std::endl;
+                finish(texture);
+                return false;
+            }
+            while (array.baseLevel > level)
+            {
+                array.baseLevel--;
+                const TextureLevel& storage = texture.image.levels[array.baseLevel];
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, array.baseLevel, array.format, storage.width, storage.height, array.allocatedLayers, 0,
+                    (GLsizei)(storage.size * array.allocatedLayers), NULL);
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.baseLevel);
+            VramBytes += cost;
+        }
+
+        const TextureLevel& source = texture.image.levels[level];
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer, source.width, source.height, 1, array.format,
+            (GLsizei)source.size, texture.image.data.data() + source.offset);
+        texture.residentLevel = level;
+        if (level == 0)
+            finish(texture);
+        return true;
+    }
+
+    static size_t levelSize(const TextureArray& array, int level)
+    {
+        return compressedLevelSize(std::max(1, array.width >> level), std::max(1, array.height >> level), array.blockBytes);
+    }
+
+    // a new texture object on the array's unit; the only binds an array ever gets
+    void createArrayTexture(TextureArray& array)
+    {
+        glGenTextures(1, &array.ID);
+        glActiveTexture(GL_TEXTURE0 + array.unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.ID);
+        BindsThisFrame++;
+        TotalBinds++;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levelCount - 1);
+    }
+
+    // Gives the array room for layers. Without levels allocated yet that is only the count; otherwise the levels
+    // are read into a pixel buffer, reallocated the larger size in a new texture object and filled back from the
+    // buffer, all without a round trip to the CPU. False when the larger levels would not fit the VRAM budget.
+    bool growArray(TextureArray& array, int layers)
+    {
+        if (layers <= array.allocatedLayers)
+            return true;
+        size_t layerBytes = 0;
+        for (int l = array.baseLevel; l < array.levelCount; l++)
+            layerBytes += levelSize(array, l);
+        size_t cost = layerBytes * (layers - array.allocatedLayers);
+        if (VramBytes + cost > VramBudgetBytes)
+            return false;
+        if (array.baseLevel < array.levelCount)
+        {
+            unsigned int copy;
+            glGenBuffers(1, &copy);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, copy);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)(layerBytes * array.allocatedLayers), NULL, GL_STREAM_COPY);
+            glActiveTexture(GL_TEXTURE0 + array.unit);
+            size_t offset = 0;
+            for (int l = array.baseLevel; l < array.levelCount; l++)
+            {
+                glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, l, (void*)offset);
+                offset += levelSize(array, l) * array.allocatedLayers;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glDeleteTextures(1, &array.ID);
+
+            createArrayTexture(array);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.baseLevel);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, copy);
+            offset = 0;
+            for (int l = array.baseLevel; l < array.levelCount; l++)
+            {
+                int width = std::max(1, array.width >> l), height = std::max(1, array.height >> l);
+                size_t bytes = levelSize(array, l);
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, array.format, width, height, layers, 0, (GLsizei)(bytes * layers), NULL);
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, 0, width, height, array.allocatedLayers, array.format,
+                    (GLsizei)(bytes * array.allocatedLayers), (const void*)offset);
+                offset += bytes * array.allocatedLayers;
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &copy);
+        }
+        array.allocatedLayers = layers;
+        VramBytes += cost;
+        return true;
+    }
+
+    void finish(TextureAsset& texture)
+    {
+        const TextureImage& image = texture.image;
+        std::cout << "TEXTURE::RESIDENT " << texture.path << ": " << image.width << "x" << image.height << ", mip " << texture.residentLevel << " of "
+            << image.levels.size() << ", array " << texture.array << " layer " << texture.layer << ", parse " << texture.parseEnd - texture.requestTime
+            << " ms, total " << assetClockMs() - texture.requestTime << " ms" << std::endl;
+        // the GPU copy is all we need from now on; the level table stays for binding()
+        std::vector<char>().swap(texture.image.data);
+        texture.state.store(ASSET_RESIDENT, std::memory_order_relaxed);
+    }
+};
+#endif
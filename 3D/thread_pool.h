@@ -0,0 +1,119 @@
+//
+//  thread_pool.h
+//  3D Object Drawing
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads pulling jobs from a shared queue.
+// Jobs must not touch OpenGL: the context belongs to the render thread.
+class ThreadPool
+{
+public:
+    // threadCount 0 picks one worker per core, leaving one core for the render thread
+    explicit ThreadPool(unsigned int threadCount = 0) : stopping(false), busy(0)
+    {
+        if (threadCount == 0)
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            threadCount = cores > 1 ? cores - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // blocks until the queue is empty and no job is running
+    void waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return jobs.empty() && busy == 0; });
+    }
+
+    // Runs job(worker) once per worker, worker being 0..size()-1, and waits for those calls only.
+    // For data-parallel work that splits itself between the calls; never call it from inside a job.
+    void runOnAll(const std::function<void(unsigned int)>& job)
+    {
+        std::mutex doneMutex;
+        std::condition_variable done;
+        unsigned int running = size();
+        for (unsigned int i = 0; i < size(); i++)
+        {
+            submit([&job, &doneMutex, &done, &running, i]
+            {
+                job(i);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--running == 0)
+                    done.notify_all();
+            });
+        }
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&running] { return running == 0; });
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool stopping;
+    unsigned int busy;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                busy++;
+            }
+            job();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+                if (jobs.empty() && busy == 0)
+                    idle.notify_all();
+            }
+        }
+    }
+};
+#endif
@@ -1,16 +1,58 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec2 aTexCoord;
+#ifdef INSTANCED
+layout (location = 3) in mat4 aModel;          // per instance; takes the place of the model uniform
+layout (location = 7) in vec3 aInstanceColor;  // per instance; takes the place of COLOR
+#endif
 
 out vec4 color;
+out vec2 texCoord;
+out vec3 worldPos;
+#ifdef SHADOWED
+out vec4 lightSpacePos;
+uniform mat4 lightSpaceMatrix;
+#endif
 
 uniform vec3 COLOR;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef MULTIVIEW
+// every draw is instanced once per view; gl_InstanceID picks the view (see multi_view.h)
+const int MAX_VIEWS = 4;
+uniform mat4 viewProjections[MAX_VIEWS];
+uniform vec4 viewRects[MAX_VIEWS];  // NDC center xy and half size zw of the view's part of the viewport
+uniform int viewCount;
+out float gl_ClipDistance[4];
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+#ifdef INSTANCED
+    vec4 position = aModel * vec4(aPos, 1.0f);
+    color = vec4(aInstanceColor, 1.0f);
+#else
+    vec4 position = model * vec4(aPos, 1.0f);
     color = vec4(COLOR, 1.0f);
+#endif
+#ifdef MULTIVIEW
+    int viewIndex = gl_InstanceID % viewCount;
+    vec4 clip = viewProjections[viewIndex] * position;
+    // the view's own frustum sides, then squeeze its [-w, w] square into its rectangle
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+    clip.xy = clip.xy * viewRects[viewIndex].zw + viewRects[viewIndex].xy * clip.w;
+    gl_Position = clip;
+#else
+    gl_Position = projection * view * position;
+#endif
+    texCoord = aTexCoord;
+    worldPos = position.xyz;
+#ifdef SHADOWED
+    lightSpacePos = lightSpaceMatrix * position;
+#endif
 }
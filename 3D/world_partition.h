@@ -0,0 +1,439 @@
+//
+//  world_partition.h
+//  3D Object Drawing
+//
+
+#ifndef WORLD_PARTITION_H
+#define WORLD_PARTITION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "scene.h"
+#include "shader.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Lifetime of a world cell; the worker owns it while CELL_LOADING, the render thread otherwise
+enum Cell_State {
+    CELL_LOADING,
+    CELL_LOADED,
+    CELL_RESIDENT
+};
+
+// Default world partition values
+const float WORLD_CELL_SIZE = 5.0f;                     // one room per cell
+const int WORLD_LOAD_RADIUS = 2;                        // cells around the camera's cell that should be resident
+const float WORLD_PREFETCH_SECONDS = 1.5f;              // the prefetch window sits this far ahead along the movement
+const int WORLD_MAX_LOADS_IN_FLIGHT = 4;
+const size_t WORLD_CPU_BUDGET_BYTES = 1024 * 1024;      // node tables of resident cells
+const size_t WORLD_GPU_BUDGET_BYTES = 1024 * 1024;      // instance buffers of resident cells
+const int WORLD_INSTANCE_FLOATS = 19;                   // model matrix and color, attributes 3-7 of the INSTANCED variant
+
+
+// One square of the world with everything in it
+struct WorldCell
+{
+    int x, z;
+    std::atomic<int> state;
+    // CPU side, filled by the loader on a worker thread
+    Scene content;
+    std::vector<float> instances;   // GPU ready copy of the nodes; freed once uploaded
+    glm::vec3 boundsMin, boundsMax;
+    // GPU side, valid once resident
+    GLuint VAO, instanceVBO;
+    GLuint divisor;
+    size_t cpuBytes, gpuBytes;
+    unsigned int lastWanted;        // update() tick the cell was last inside a window; the least recent is evicted first
+    bool prefetched;                // asked for by the prefetch window only, so far
+    double requestTime;
+
+    WorldCell() : x(0), z(0), state(CELL_LOADING), boundsMin(0.0f), boundsMax(0.0f), VAO(0), instanceVBO(0), divisor(1), cpuBytes(0), gpuBytes(0),
+        lastWanted(0), prefetched(false), requestTime(0.0) {}
+};
+
+// Streams a world too large to keep resident, one square cell at a time. Every update() wants the cells within
+// LoadRadius of the camera's cell, nearest first, and a window of the same size around where the camera will be in
+// PrefetchSeconds at its current velocity. Wanted cells are built by the loader on worker threads; the render
+// thread uploads their nodes as one instance buffer and draws each cell with a single instanced call.
+// Cells that fall out of the windows stay cached until a load needs their memory: then the least recently wanted
+// go first, so the resident set never exceeds CpuBudgetBytes and GpuBudgetBytes however big the world is.
+// A finished load that the camera has moved away from, or that cannot fit without evicting a wanted cell, is dropped.
+class WorldPartition
+{
+public:
+    // builds cell (cellX, cellZ) into an empty scene; runs on a worker thread
+    typedef std::function<void(int cellX, int cellZ, Scene& cell)> CellLoader;
+
+    float CellSize;
+    int LoadRadius;
+    float PrefetchSeconds;
+    int MaxLoadsInFlight;
+    size_t CpuBudgetBytes;
+    size_t GpuBudgetBytes;
+
+    WorldPartition(ThreadPool& pool, int cellsX, int cellsZ, const CellLoader& cellLoader) : CellSize(WORLD_CELL_SIZE), LoadRadius(WORLD_LOAD_RADIUS),
+        PrefetchSeconds(WORLD_PREFETCH_SECONDS), MaxLoadsInFlight(WORLD_MAX_LOADS_IN_FLIGHT), CpuBudgetBytes(WORLD_CPU_BUDGET_BYTES),
+        GpuBudgetBytes(WORLD_GPU_BUDGET_BYTES), workers(pool), loader(cellLoader), sizeX(cellsX), sizeZ(cellsZ), cubeVBO(0), cubeEBO(0), tick(0),
+        inFlight(0), residentCpuBytes(0), residentGpuBytes(0), velocity(0.0f), lastPosition(0.0f), moved(false), budgetWarned(false),
+        evictedThisTick(false)
+    {
+        resetStats();
+    }
+
+    ~WorldPartition()
+    {
+        // load jobs hold pointers to our cells
+        workers.waitIdle();
+    }
+
+    // after the context is current
+    void init()
+    {
+        glGenBuffers(1, &cubeVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
+        glGenBuffers(1, &cubeEBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        std::cout << "WORLD:: " << sizeX << "x" << sizeZ << " cells of " << CellSize << ", load radius " << LoadRadius << ", budget "
+            << CpuBudgetBytes / 1024 << " KiB CPU, " << GpuBudgetBytes / 1024 << " KiB GPU" << std::endl;
+    }
+
+    // delete every GL object; call while the context is still current
+    void release()
+    {
+        workers.waitIdle();
+        for (CellMap::iterator it = cells.begin(); it != cells.end(); ++it)
+            freeGpu(*it->second);
+        cells.clear();
+        glDeleteBuffers(1, &cubeVBO);
+        glDeleteBuffers(1, &cubeEBO);
+        cubeVBO = cubeEBO = 0;
+    }
+
+    // render thread, once per frame after the camera moved: starts loads for the windows around the camera, admits
+    // finished ones within the budget; true if the resident set changed
+    bool update(glm::vec3 cameraPosition, float deltaTime)
+    {
+        tick++;
+        evictedThisTick = false;
+        if (moved && deltaTime > 0.0f)
+            velocity = glm::mix(velocity, (cameraPosition - lastPosition) / deltaTime, 0.2f);
+        lastPosition = cameraPosition;
+        moved = true;
+
+        // the camera's window, nearest cells first, then the prefetch window
+        int cameraX = (int)std::floor(cameraPosition.x / CellSize);
+        int cameraZ = (int)std::floor(cameraPosition.z / CellSize);
+        wanted.clear();
+        addWindow(cameraX, cameraZ, cameraX, cameraZ, false);
+        glm::vec3 ahead = cameraPosition + velocity * PrefetchSeconds;
+        int aheadX = (int)std::floor(ahead.x / CellSize);
+        int aheadZ = (int)std::floor(ahead.z / CellSize);
+        if (aheadX != cameraX || aheadZ != cameraZ)
+            addWindow(aheadX, aheadZ, cameraX, cameraZ, true);
+        std::stable_sort(wanted.begin(), wanted.end(), [](const WantedCell& a, const WantedCell& b) { return a.priority < b.priority; });
+
+        for (size_t i = 0; i < wanted.size(); i++)
+        {
+            const WantedCell& w = wanted[i];
+            long long key = cellKey(w.x, w.z);
+            CellMap::iterator it = cells.find(key);
+            if (it != cells.end())
+            {
+                WorldCell& cell = *it->second;
+                cell.lastWanted = tick;
+                if (!w.prefetch && cell.prefetched)
+                {
+                    cell.prefetched = false;
+                    if (cell.state.load(std::memory_order_relaxed) == CELL_RESIDENT)
+                        prefetchHits++;
+                }
+                continue;
+            }
+            if (inFlight >= MaxLoadsInFlight)
+                continue;
+            startLoad(key, w);
+        }
+
+        // admit finished loads
+        bool changed = false;
+        for (CellMap::iterator it = cells.begin(); it != cells.end();)
+        {
+            WorldCell& cell = *it->second;
+            if (cell.state.load(std::memory_order_acquire) != CELL_LOADED)
+            {
+                ++it;
+                continue;
+            }
+            inFlight--;
+            if (cell.lastWanted != tick)
+            {
+                // the camera moved on while it loaded
+                dropped++;
+                it = cells.erase(it);
+                continue;
+            }
+            size_t gpuBytes = cell.instances.size() * sizeof(float);
+            if (!makeRoom(cell.cpuBytes, gpuBytes))
+            {
+                if (!budgetWarned)
+                    std::cout << "ERROR::WORLD:: the memory budget cannot hold the load radius; cells are being dropped" << std::endl;
+                budgetWarned = true;
+                dropped++;
+                it = cells.erase(it);
+                continue;
+            }
+            upload(cell);
+            residentCpuBytes += cell.cpuBytes;
+            residentGpuBytes += cell.gpuBytes;
+            cell.state.store(CELL_RESIDENT, std::memory_order_relaxed);
+            loadMs.add(clockMs() - cell.requestTime);
+            changed = true;
+            ++it;
+        }
+        return changed || evictedThisTick;
+    }
+
+    // draws the resident cells that pass isVisible; the bound shader is an INSTANCED variant with its camera uniforms
+    // set. viewInstances is the number of views each node is repeated for (see multi_view.h).
+    void draw(const Shader& shader, int viewInstances, const std::function<bool(const glm::vec3&, const glm::vec3&)>& isVisible)
+    {
+        shader.setFloat("textureLayer", -1.0f);
+        drawnCells = 0;
+        for (CellMap::iterator it = cells.begin(); it != cells.end(); ++it)
+        {
+            WorldCell& cell = *it->second;
+            if (cell.state.load(std::memory_order_relaxed) != CELL_RESIDENT || cell.content.nodes.empty() || !isVisible(cell.boundsMin, cell.boundsMax))
+                continue;
+            glBindVertexArray(cell.VAO);
+            // with several views every node is repeated once per view, so the per-node attributes advance that much slower
+            if (cell.divisor != (GLuint)viewInstances)
+            {
+                cell.divisor = viewInstances;
+                for (int i = 0; i < 5; i++)
+                    glVertexAttribDivisor(3 + i, cell.divisor);
+            }
+            glDrawElementsInstanced(GL_TRIANGLES, CUBE_INDEX_COUNT, GL_UNSIGNED_INT, 0, (GLsizei)cell.content.nodes.size() * viewInstances);
+            drawnCells++;
+        }
+        glBindVertexArray(0);
+    }
+
+    size_t cpuBytes() const { return residentCpuBytes; }
+    size_t gpuBytes() const { return residentGpuBytes; }
+    int loadingCount() const { return inFlight; }
+
+    // resident set, latencies and traffic since the last call
+    void printStats()
+    {
+        int resident = 0;
+        for (CellMap::const_iterator it = cells.begin(); it != cells.end(); ++it)
+        {
+            if (it->second->state.load(std::memory_order_relaxed) == CELL_RESIDENT)
+                resident++;
+        }
+        std::cout << "WORLD:: " << resident << " cells resident (" << drawnCells << " drawn), " << residentCpuBytes / 1024 << "/" << CpuBudgetBytes / 1024
+            << " KiB CPU, " << residentGpuBytes / 1024 << "/" << GpuBudgetBytes / 1024 << " KiB GPU, " << inFlight << " loading; " << loadMs.count
+            << " loads mean/max " << loadMs.mean() << "/" << loadMs.max << " ms, " << evictMs.count << " evictions mean/max " << evictMs.mean()
+            << "/" << evictMs.max << " ms, " << prefetchHits << " prefetch hits, " << dropped << " dropped" << std::endl;
+        resetStats();
+    }
+
+private:
+    typedef std::unordered_map<long long, std::unique_ptr<WorldCell> > CellMap;
+
+    struct WantedCell
+    {
+        int x, z;
+        int priority;
+        bool prefetch;
+    };
+
+    struct Stat
+    {
+        double sum, max;
+        unsigned int count;
+
+        void add(double ms)
+        {
+            sum += ms;
+            max = std::max(max, ms);
+            count++;
+        }
+        double mean() const { return count ? sum / count : 0.0; }
+    };
+
+    ThreadPool& workers;
+    CellLoader loader;
+    int sizeX, sizeZ;
+    GLuint cubeVBO, cubeEBO;
+    CellMap cells;
+    std::vector<WantedCell> wanted;
+    unsigned int tick;
+    int inFlight;
+    size_t residentCpuBytes, residentGpuBytes;
+    glm::vec3 velocity;
+    glm::vec3 lastPosition;
+    bool moved;
+    bool budgetWarned;
+    bool evictedThisTick;
+    int drawnCells;
+    unsigned int prefetchHits, dropped;
+    Stat loadMs, evictMs;
+
+    static long long cellKey(int x, int z)
+    {
+        return ((long long)x << 32) | (unsigned int)z;
+    }
+
+    static double clockMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void resetStats()
+    {
+        Stat zero = { 0.0, 0.0, 0 };
+        loadMs = evictMs = zero;
+        prefetchHits = dropped = 0;
+        drawnCells = 0;
+    }
+
+    // the square of cells within LoadRadius of (centerX, centerZ) that lie in the world; the prefetch window skips
+    // what the camera's window already has and ranks behind all of it
+    void addWindow(int centerX, int centerZ, int cameraX, int cameraZ, bool prefetch)
+    {
+        for (int dz = -LoadRadius; dz <= LoadRadius; dz++)
+        {
+            for (int dx = -LoadRadius; dx <= LoadRadius; dx++)
+            {
+                WantedCell w = { centerX + dx, centerZ + dz, std::max(std::abs(dx), std::abs(dz)), prefetch };
+                if (w.x < 0 || w.z < 0 || w.x >= sizeX || w.z >= sizeZ)
+                    continue;
+                if (prefetch)
+                {
+                    if (std::max(std::abs(w.x - cameraX), std::abs(w.z - cameraZ)) <= LoadRadius)
+                        continue;
+                    w.priority += LoadRadius + 1;
+                }
+                wanted.push_back(w);
+            }
+        }
+    }
+
+    void startLoad(long long key, const WantedCell& w)
+    {
+        WorldCell* cell = new WorldCell();
+        cells[key] = std::unique_ptr<WorldCell>(cell);
+        cell->x = w.x;
+        cell->z = w.z;
+        cell->lastWanted = tick;
+        cell->prefetched = w.prefetch;
+        cell->requestTime = clockMs();
+        inFlight++;
+
+        const CellLoader* load = &loader;
+        workers.submit([cell, load]() {
+            (*load)(cell->x, cell->z, cell->content);
+            const std::vector<SceneNode>& nodes = cell->content.nodes;
+            cell->instances.resize(nodes.size() * WORLD_INSTANCE_FLOATS);
+            cell->boundsMin = glm::vec3(1e30f);
+            cell->boundsMax = glm::vec3(-1e30f);
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                float* instance = &cell->instances[i * WORLD_INSTANCE_FLOATS];
+                memcpy(instance, &nodes[i].model[0][0], 16 * sizeof(float));
+                memcpy(instance + 16, &nodes[i].color[0], 3 * sizeof(float));
+                cell->boundsMin = glm::min(cell->boundsMin, nodes[i].boundsMin);
+                cell->boundsMax = glm::max(cell->boundsMax, nodes[i].boundsMax);
+            }
+            cell->content.nodes.shrink_to_fit();
+            cell->cpuBytes = nodes.capacity() * sizeof(SceneNode);
+            cell->state.store(CELL_LOADED, std::memory_order_release);
+        });
+    }
+
+    // evicts resident cells that were not wanted this tick, least recently wanted first, until the new bytes fit
+    bool makeRoom(size_t cpuNeeded, size_t gpuNeeded)
+    {
+        while (residentCpuBytes + cpuNeeded > CpuBudgetBytes || residentGpuBytes + gpuNeeded > GpuBudgetBytes)
+        {
+            CellMap::iterator victim = cells.end();
+            for (CellMap::iterator it = cells.begin(); it != cells.end(); ++it)
+            {
+                const WorldCell& cell = *it->second;
+                if (cell.state.load(std::memory_order_relaxed) != CELL_RESIDENT || cell.lastWanted == tick)
+                    continue;
+                if (victim == cells.end() || cell.lastWanted < victim->second->lastWanted)
+                    victim = it;
+            }
+            if (victim == cells.end())
+                return false;
+            double start = clockMs();
+            residentCpuBytes -= victim->second->cpuBytes;
+            residentGpuBytes -= victim->second->gpuBytes;
+            freeGpu(*victim->second);
+            cells.erase(victim);
+            evictMs.add(clockMs() - start);
+            evictedThisTick = true;
+        }
+        return true;
+    }
+
+    void upload(WorldCell& cell)
+    {
+        glGenVertexArrays(1, &cell.VAO);
+        glBindVertexArray(cell.VAO);
+        // the cube, laid out as in main.cpp
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)12);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)24);
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        // one model matrix (four columns) and color per node
+        cell.gpuBytes = cell.instances.size() * sizeof(float);
+        glGenBuffers(1, &cell.instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cell.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, cell.gpuBytes, cell.instances.empty() ? NULL : &cell.instances[0], GL_STATIC_DRAW);
+        bufferUploads().add();
+        bufferUploadBytes().add(cell.gpuBytes);
+        const GLsizei stride = WORLD_INSTANCE_FLOATS * sizeof(float);
+        for (int i = 0; i < 5; i++)
+        {
+            glVertexAttribPointer(3 + i, i < 4 ? 4 : 3, GL_FLOAT, GL_FALSE, stride, (void*)(i * 4 * sizeof(float)));
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribDivisor(3 + i, 1);
+        }
+        cell.divisor = 1;
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        std::vector<float>().swap(cell.instances);
+    }
+
+    void freeGpu(WorldCell& cell)
+    {
+        if (cell.VAO)
+            glDeleteVertexArrays(1, &cell.VAO);
+        if (cell.instanceVBO)
+            glDeleteBuffers(1, &cell.instanceVBO);
+        cell.VAO = cell.instanceVBO = 0;
+    }
+};
+#endif